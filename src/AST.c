@@ -0,0 +1,61 @@
+#include "AST.h"
+#include "Arena.h"
+#include "GenericList.h"
+#include "Util.h"
+#include <string.h>
+
+typedef struct ASTContext
+{
+    Arena* astArena;
+} ASTContext;
+
+#ifndef CUSTOM_COMP
+static _Thread_local ASTContext* ctx = NULL;
+#endif
+#ifdef CUSTOM_COMP
+static ASTContext* ctx = NULL;
+#endif
+
+ASTContext* AST_CreateContext()
+{
+    ASTContext* context = xmalloc(sizeof(ASTContext));
+    memset(context, 0, sizeof(ASTContext));
+    return context;
+}
+
+void AST_DisposeContext(ASTContext* context)
+{
+    if (ctx == context)
+        ctx = NULL;
+    free(context);
+}
+
+void AST_UseContext(ASTContext* context)
+{
+    ctx = context;
+}
+
+void AST_SetArena(Arena* arena)
+{
+    ctx->astArena = arena;
+}
+
+void* AST_Alloc(size_t size)
+{
+    return Arena_Alloc(ctx->astArena, size);
+}
+
+void* AST_CopyList(GenericList* list)
+{
+    void* data = NULL;
+    if (list->count != 0)
+        data = Arena_Copy(ctx->astArena, list->data, list->count * list->memberSize);
+
+    GenericList_Dispose(list);
+    return data;
+}
+
+char* AST_CopyString(const char* str)
+{
+    return Arena_Copy(ctx->astArena, str, strlen(str) + 1);
+}
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "Arena.h"
 #include "Scope.h"
 #include "Token.h"
 #include "Type.h"
@@ -167,6 +168,8 @@ typedef struct
     AST_ExpressionType type;
     SourceLocation loc;
     char* id;
+    // Set if the variable isn't live after this access (Liveness.h)
+    bool isLastUse;
 } AST_Expression_VariableAccess;
 
 // Not generated by the parser, merely
@@ -220,6 +223,10 @@ typedef struct
     AST_Expression* cond;
     AST_Statement* ifTrue;
     AST_Statement* ifFalse;
+    // Live sets at the start of both branches and after the statement (Liveness.h)
+    uint16_t* liveTrue;
+    uint16_t* liveFalse;
+    uint16_t* liveAfter;
 } AST_Statement_If;
 
 typedef struct
@@ -228,6 +235,7 @@ typedef struct
     SourceLocation loc;
     AST_Expression* cond;
     AST_Statement* body;
+    uint16_t* liveAfter;
 } AST_Statement_While;
 
 typedef struct
@@ -236,6 +244,7 @@ typedef struct
     SourceLocation loc;
     AST_Expression* cond;
     AST_Statement* body;
+    uint16_t* liveAfter;
 } AST_Statement_Do;
 
 typedef struct
@@ -247,6 +256,7 @@ typedef struct
     AST_Expression* count;
     AST_Statement* body;
     Scope* statementScope;
+    uint16_t* liveAfter;
 } AST_Statement_For;
 
 typedef struct
@@ -254,6 +264,7 @@ typedef struct
     AST_Statement** statements;
     size_t numStatements;
     uint16_t id;
+    uint16_t* live;
 } AST_Statement_Switch_SwitchCase;
 
 typedef struct
@@ -265,6 +276,8 @@ typedef struct
     size_t numCases;
     AST_Statement** defaultCaseStmts;
     size_t numStmtsDefCase;
+    uint16_t* liveDefault;
+    uint16_t* liveAfter;
 
 } AST_Statement_Switch;
 
@@ -275,7 +288,9 @@ typedef struct
     AST_Expression* value;
     char* variableName;
     VariableType* variableType;
-    AST_Expression_VariableAccess* lastAccess;
+    // Index of the variable in live sets, -1 if it isn't tracked
+    int liveIndex;
+    bool isLive;
 
 } AST_Statement_Declaration;
 
@@ -300,6 +315,7 @@ typedef struct
     AST_StatementType type;
     SourceLocation loc;
     const char* code;
+    uint16_t* liveAfter;
 } AST_Statement_ASM;
 
 typedef struct
@@ -315,3 +331,22 @@ typedef struct
     SourceLocation loc;
     const char* label;
 } AST_Statement_Goto;
+
+// AST nodes and the arrays they reference are allocated from the arena set
+// here, so they only live until the owner resets it (once code for the function was generated).
+void AST_SetArena(Arena* arena);
+void* AST_Alloc(size_t size);
+// Moves the contents of list into the arena and disposes the list.
+void* AST_CopyList(GenericList* list);
+// Copies str into the arena. Strings of tokens don't outlive the tokens.
+char* AST_CopyString(const char* str);
+
+#ifndef CUSTOM_COMP
+typedef struct ASTContext ASTContext;
+#endif
+#ifdef CUSTOM_COMP
+typedef struct ASTContext {} ASTContext;
+#endif
+ASTContext* AST_CreateContext();
+void AST_DisposeContext(ASTContext* context);
+void AST_UseContext(ASTContext* context);
@@ -0,0 +1,921 @@
+#include "Allocator.h"
+#include "Spill.h"
+#include "Util.h"
+#include <stdlib.h>
+#include <string.h>
+
+// A web is the live range of a register: the values joined by the phis that merge
+// them, which all have to be in the same register.
+typedef struct
+{
+    // Register code generation picked, -1 for virtual registers
+    int original;
+    // Registers clobbered by a call while the web is live
+    uint16_t forbidden;
+    // Reads and writes, each weighted by 8 to the power of its loop depth
+    size_t cost;
+    // Number of interfering webs that are neither coalesced nor simplified
+    size_t degree;
+    // The web this one was coalesced into, or itself
+    size_t alias;
+    bool simplified;
+    int color;
+} Web;
+
+typedef struct
+{
+    size_t dst;
+    size_t src;
+} Move;
+
+typedef struct
+{
+    SSA* ssa;
+    // Registers from here on hold values of spilled webs for a single instruction
+    int firstTemporary;
+    // Web of each value, SIZE_MAX for flags and register values nothing reads or writes
+    size_t* webOfValue;
+    size_t numWebs;
+    Web* webs;
+    // Interference bit matrix, numWebs by numWebs
+    uint16_t* interference;
+    // Words per row of the block live sets
+    size_t rowSize;
+    uint16_t* liveIn;
+    uint16_t* liveOut;
+    // Webs of the phis that merge garbage from each edge, which aren't live on it
+    GenericList* garbage;
+    size_t* depth;
+    GenericList moves;
+} Allocator;
+
+typedef enum
+{
+    Outcome_Colored,
+    // Spill code was added, the function has to be colored again
+    Outcome_Spilled,
+    Outcome_Failed,
+} Outcome;
+
+// Deeper loop nests don't make a difference to the choice of spill candidates
+static const size_t MAX_LOOP_DEPTH = 4;
+// Spill code for the temporaries of spill code is a sign that it doesn't get any better
+static const int MAX_SPILL_ROUNDS = 8;
+
+static IRInstruction* Instruction(SSA* ssa, size_t i)
+{
+    return GenericList_At(&ssa->function->instructions, i);
+}
+
+static IRBlock* Block(SSA* ssa, size_t i)
+{
+    return GenericList_At(&ssa->function->blocks, i);
+}
+
+// Bit sets are arrays of 16-bit words
+static bool HasBit(const uint16_t* set, size_t i)
+{
+    return (set[i / 16] & (1 << (i % 16))) != 0;
+}
+
+static void SetBit(uint16_t* set, size_t i)
+{
+    set[i / 16] |= 1 << (i % 16);
+}
+
+static void ClearBit(uint16_t* set, size_t i)
+{
+    set[i / 16] &= ~(1 << (i % 16));
+}
+
+static int NumColors(uint16_t forbidden)
+{
+    int num = 0;
+    for (int r = 0; r < IR_NUM_PHYSICAL_REGISTERS; r++)
+    {
+        if (((int)forbidden & (1 << r)) == 0)
+            num++;
+    }
+    return num;
+}
+
+static size_t AddCost(size_t cost, size_t weight)
+{
+    if (cost + weight < cost)
+        return SIZE_MAX;
+    return cost + weight;
+}
+
+static bool IsRegisterValue(SSA* ssa, int32_t value)
+{
+    return value != -1 && SSA_Value(ssa, value)->location != ssa->flagsLocation;
+}
+
+static bool IsRegisterMove(const IRInstruction* inst)
+{
+    return inst->op == IR_Mov && inst->flag == Flag_None && inst->dst.type == IROperand_Register &&
+           inst->b.type == IROperand_Register;
+}
+
+// Reads and writes the same register, which three operands might not be able to encode
+static bool IsTied(const IRInstruction* inst)
+{
+    return inst->op != IR_Mov && inst->op != IR_Not && inst->dst.type == IROperand_Register &&
+           IR_OperandEquals(inst->dst, inst->a);
+}
+
+// The allocator doesn't know the registers unreachable code writes
+static bool HasUnreachableCode(SSA* ssa)
+{
+    for (size_t b = 0; b < ssa->numBlocks; b++)
+    {
+        if (ssa->blocks[b].reachable)
+            continue;
+        IRBlock* block = Block(ssa, b);
+        for (size_t i = block->first; i < block->end; i++)
+        {
+            IROpcode op = Instruction(ssa, i)->op;
+            if (op <= IR_Not || op == IR_Call)
+                return true;
+        }
+    }
+    return false;
+}
+
+// Virtual registers have to be assigned even there
+static void RemoveUnreachableCode(SSA* ssa)
+{
+    for (size_t b = 0; b < ssa->numBlocks; b++)
+    {
+        if (ssa->blocks[b].reachable)
+            continue;
+        IRBlock* block = Block(ssa, b);
+        for (size_t i = block->first; i < block->end; i++)
+        {
+            IRInstruction* inst = Instruction(ssa, i);
+            if (inst->op <= IR_Not || inst->op == IR_Call)
+                inst->op = IR_Nop;
+        }
+    }
+}
+
+// Registers are garbage at entry and after a call that clobbers them. Code that may read them
+// then, like a conditional move that keeps the old contents, doesn't depend on what they hold.
+static bool IsKnown(SSA* ssa, int32_t value)
+{
+    return IsRegisterValue(ssa, value) && SSA_Value(ssa, value)->kind != SSAValue_Unknown;
+}
+
+static void MarkLive(SSA* ssa, bool* live, int32_t* work, size_t* numWork, int32_t value)
+{
+    if (!IsKnown(ssa, value) || live[(size_t)value])
+        return;
+    live[(size_t)value] = true;
+    work[(*numWork)++] = value;
+}
+
+// Marks the register values read by instructions, and the phi arguments they are merged from
+static void MarkLiveValues(SSA* ssa, bool* live)
+{
+    int32_t* work = xmalloc((ssa->values.count + 1) * sizeof(int32_t));
+    size_t numWork = 0;
+    for (size_t j = 0; j < ssa->numOrdered; j++)
+    {
+        IRBlock* block = Block(ssa, ssa->order[j]);
+        for (size_t i = block->first; i < block->end; i++)
+        {
+            for (int slot = IRSlot_Dst; slot <= IRSlot_B; slot++)
+                MarkLive(ssa, live, work, &numWork, ssa->instructions[i].use[slot]);
+        }
+    }
+
+    while (numWork != 0)
+    {
+        int32_t v = work[--numWork];
+        SSAValue* value = SSA_Value(ssa, v);
+        if (value->kind != SSAValue_Phi)
+            continue;
+        for (size_t k = 0; k < SSA_NumPhiArgs(ssa, v); k++)
+            MarkLive(ssa, live, work, &numWork, *(int32_t*)GenericList_At(&ssa->phiArgs, value->firstArg + k));
+    }
+    free(work);
+}
+
+static size_t Find(size_t* parent, size_t v)
+{
+    while (parent[v] != v)
+    {
+        parent[v] = parent[parent[v]];
+        v = parent[v];
+    }
+    return v;
+}
+
+static void Union(size_t* parent, int32_t a, int32_t b)
+{
+    size_t rootA = Find(parent, (size_t)a);
+    size_t rootB = Find(parent, (size_t)b);
+    if (rootA != rootB)
+        parent[rootB] = rootA;
+}
+
+static void AddToWeb(Allocator* alloc, size_t* parent, int32_t value)
+{
+    size_t root = Find(parent, (size_t)value);
+    if (alloc->webOfValue[root] == SIZE_MAX)
+        alloc->webOfValue[root] = alloc->numWebs++;
+    alloc->webOfValue[(size_t)value] = alloc->webOfValue[root];
+}
+
+// Joins live phis with their arguments, conditional writes with the value they may keep and
+// writes with the value they read from the same register. Garbage isn't part of any web.
+static void BuildWebs(Allocator* alloc, const bool* live)
+{
+    SSA* ssa = alloc->ssa;
+    size_t numValues = ssa->values.count;
+    size_t* parent = xmalloc((numValues + 1) * sizeof(size_t));
+    for (size_t v = 0; v < numValues; v++)
+        parent[v] = v;
+
+    for (size_t v = 0; v < numValues; v++)
+    {
+        SSAValue* value = SSA_Value(ssa, (int32_t)v);
+        if (!live[v] || value->kind != SSAValue_Phi)
+            continue;
+        for (size_t k = 0; k < SSA_NumPhiArgs(ssa, (int32_t)v); k++)
+        {
+            int32_t arg = *(int32_t*)GenericList_At(&ssa->phiArgs, value->firstArg + k);
+            if (arg != -1 && live[(size_t)arg])
+                Union(parent, (int32_t)v, arg);
+        }
+    }
+    for (size_t j = 0; j < ssa->numOrdered; j++)
+    {
+        IRBlock* block = Block(ssa, ssa->order[j]);
+        for (size_t i = block->first; i < block->end; i++)
+        {
+            SSAInstruction* s = &ssa->instructions[i];
+            if (s->def != -1 && IsKnown(ssa, s->use[IRSlot_Dst]))
+                Union(parent, s->def, s->use[IRSlot_Dst]);
+            if (s->def != -1 && IsTied(Instruction(ssa, i)) && IsKnown(ssa, s->use[IRSlot_A]))
+                Union(parent, s->def, s->use[IRSlot_A]);
+        }
+    }
+
+    alloc->webOfValue = xmalloc((numValues + 1) * sizeof(size_t));
+    for (size_t v = 0; v < numValues; v++)
+        alloc->webOfValue[v] = SIZE_MAX;
+    for (size_t v = 0; v < numValues; v++)
+    {
+        if (live[v])
+            AddToWeb(alloc, parent, (int32_t)v);
+    }
+    for (size_t j = 0; j < ssa->numOrdered; j++)
+    {
+        IRBlock* block = Block(ssa, ssa->order[j]);
+        for (size_t i = block->first; i < block->end; i++)
+        {
+            if (ssa->instructions[i].def != -1)
+                AddToWeb(alloc, parent, ssa->instructions[i].def);
+        }
+    }
+    free(parent);
+
+    alloc->webs = xmalloc((alloc->numWebs + 1) * sizeof(Web));
+    for (size_t w = 0; w < alloc->numWebs; w++)
+    {
+        Web* web = &alloc->webs[w];
+        memset(web, 0, sizeof(Web));
+        web->alias = w;
+        web->color = -1;
+        web->original = -1;
+    }
+    for (size_t v = 0; v < numValues; v++)
+    {
+        int location = SSA_Value(ssa, (int32_t)v)->location;
+        if (alloc->webOfValue[v] != SIZE_MAX && location < IR_NUM_PHYSICAL_REGISTERS)
+            alloc->webs[alloc->webOfValue[v]].original = location;
+        // Spilling them again wouldn't free any registers
+        if (alloc->webOfValue[v] != SIZE_MAX && location >= alloc->firstTemporary)
+            alloc->webs[alloc->webOfValue[v]].cost = SIZE_MAX;
+    }
+}
+
+static size_t WebOf(Allocator* alloc, int32_t value)
+{
+    if (!IsKnown(alloc->ssa, value))
+        return SIZE_MAX;
+    return alloc->webOfValue[(size_t)value];
+}
+
+static void FindGarbageEdges(Allocator* alloc, const bool* live)
+{
+    SSA* ssa = alloc->ssa;
+    alloc->garbage = xmalloc((ssa->edges.count + 1) * sizeof(GenericList));
+    for (size_t e = 0; e < ssa->edges.count; e++)
+        alloc->garbage[e] = GenericList_Create(sizeof(size_t));
+
+    for (size_t v = 0; v < ssa->values.count; v++)
+    {
+        SSAValue* value = SSA_Value(ssa, (int32_t)v);
+        if (!live[v] || value->kind != SSAValue_Phi)
+            continue;
+        SSABlock* block = &ssa->blocks[value->block];
+        for (size_t k = 0; k < block->numPreds; k++)
+        {
+            int32_t arg = *(int32_t*)GenericList_At(&ssa->phiArgs, value->firstArg + k);
+            if (arg == -1 || !live[(size_t)arg])
+                GenericList_Append(&alloc->garbage[ssa->predEdges[block->firstPred + k]], &alloc->webOfValue[v]);
+        }
+    }
+}
+
+static bool Dominates(SSA* ssa, size_t a, size_t b)
+{
+    for (; b != SIZE_MAX; b = ssa->blocks[b].idom)
+    {
+        if (b == a)
+            return true;
+    }
+    return false;
+}
+
+// Number of natural loops each block is in. A loop is headed by a block that
+// dominates some of its predecessors, and contains the blocks that reach them.
+static void ComputeLoopDepths(Allocator* alloc)
+{
+    SSA* ssa = alloc->ssa;
+    alloc->depth = xmalloc((ssa->numBlocks + 1) * sizeof(size_t));
+    memset(alloc->depth, 0, (ssa->numBlocks + 1) * sizeof(size_t));
+    bool* inLoop = xmalloc(ssa->numBlocks + 1);
+    size_t* work = xmalloc((ssa->numBlocks + 1) * sizeof(size_t));
+
+    for (size_t j = 0; j < ssa->numOrdered; j++)
+    {
+        size_t header = ssa->order[j];
+        SSABlock* block = &ssa->blocks[header];
+        memset(inLoop, 0, ssa->numBlocks + 1);
+        inLoop[header] = true;
+        size_t numWork = 0;
+        bool isHeader = false;
+        for (size_t p = 0; p < block->numPreds; p++)
+        {
+            size_t pred = SSA_Edge(ssa, ssa->predEdges[block->firstPred + p])->from;
+            if (!ssa->blocks[pred].reachable || !Dominates(ssa, header, pred))
+                continue;
+            isHeader = true;
+            if (!inLoop[pred])
+            {
+                inLoop[pred] = true;
+                work[numWork++] = pred;
+            }
+        }
+        if (!isHeader)
+            continue;
+
+        while (numWork != 0)
+        {
+            SSABlock* b = &ssa->blocks[work[--numWork]];
+            for (size_t p = 0; p < b->numPreds; p++)
+            {
+                size_t pred = SSA_Edge(ssa, ssa->predEdges[b->firstPred + p])->from;
+                if (ssa->blocks[pred].reachable && !inLoop[pred])
+                {
+                    inLoop[pred] = true;
+                    work[numWork++] = pred;
+                }
+            }
+        }
+        for (size_t b = 0; b < ssa->numBlocks; b++)
+        {
+            if (inLoop[b])
+                alloc->depth[b]++;
+        }
+    }
+    free(inLoop);
+    free(work);
+}
+
+static size_t Weight(Allocator* alloc, size_t block)
+{
+    size_t weight = 1;
+    for (size_t d = 0; d < alloc->depth[block] && d < MAX_LOOP_DEPTH; d++)
+        weight *= 8;
+    return weight;
+}
+
+// Webs read and written by instruction i, SIZE_MAX for none
+static size_t UseWeb(Allocator* alloc, size_t i, int slot)
+{
+    return WebOf(alloc, alloc->ssa->instructions[i].use[slot]);
+}
+
+static size_t DefWeb(Allocator* alloc, size_t i)
+{
+    return WebOf(alloc, alloc->ssa->instructions[i].def);
+}
+
+static void ComputeLiveness(Allocator* alloc)
+{
+    SSA* ssa = alloc->ssa;
+    size_t rowSize = alloc->rowSize;
+    size_t setSize = (ssa->numBlocks * rowSize + 1) * sizeof(uint16_t);
+    uint16_t* gen = xmalloc(setSize);
+    uint16_t* kill = xmalloc(setSize);
+    alloc->liveIn = xmalloc(setSize);
+    alloc->liveOut = xmalloc(setSize);
+    memset(gen, 0, setSize);
+    memset(kill, 0, setSize);
+    memset(alloc->liveIn, 0, setSize);
+    memset(alloc->liveOut, 0, setSize);
+
+    for (size_t j = 0; j < ssa->numOrdered; j++)
+    {
+        size_t b = ssa->order[j];
+        IRBlock* block = Block(ssa, b);
+        for (size_t i = block->first; i < block->end; i++)
+        {
+            for (int slot = IRSlot_Dst; slot <= IRSlot_B; slot++)
+            {
+                size_t use = UseWeb(alloc, i, slot);
+                if (use != SIZE_MAX && !HasBit(&kill[b * rowSize], use))
+                    SetBit(&gen[b * rowSize], use);
+            }
+            size_t def = DefWeb(alloc, i);
+            if (def != SIZE_MAX)
+                SetBit(&kill[b * rowSize], def);
+        }
+    }
+
+    // Backward problem, so blocks are visited in postorder
+    uint16_t* edgeLive = xmalloc((rowSize + 1) * sizeof(uint16_t));
+    bool changed = true;
+    while (changed)
+    {
+        changed = false;
+        for (size_t j = ssa->numOrdered; j > 0; j--)
+        {
+            size_t b = ssa->order[j - 1];
+            SSABlock* block = &ssa->blocks[b];
+            uint16_t* out = &alloc->liveOut[b * rowSize];
+            for (size_t s = 0; s < block->numSuccs; s++)
+            {
+                size_t edge = ssa->succEdges[block->firstSucc + s];
+                memcpy(edgeLive, &alloc->liveIn[SSA_Edge(ssa, edge)->to * rowSize], rowSize * sizeof(uint16_t));
+                GenericList* garbage = &alloc->garbage[edge];
+                for (size_t g = 0; g < garbage->count; g++)
+                    ClearBit(edgeLive, *(size_t*)GenericList_At(garbage, g));
+                for (size_t k = 0; k < rowSize; k++)
+                    out[k] |= edgeLive[k];
+            }
+            for (size_t k = 0; k < rowSize; k++)
+            {
+                uint16_t in = gen[b * rowSize + k] | (out[k] & ~kill[b * rowSize + k]);
+                if (in != alloc->liveIn[b * rowSize + k])
+                {
+                    alloc->liveIn[b * rowSize + k] = in;
+                    changed = true;
+                }
+            }
+        }
+    }
+    free(gen);
+    free(kill);
+    free(edgeLive);
+}
+
+static bool Interferes(Allocator* alloc, size_t a, size_t b)
+{
+    return HasBit(alloc->interference, a * alloc->numWebs + b);
+}
+
+static void AddInterference(Allocator* alloc, size_t a, size_t b)
+{
+    if (a == b || Interferes(alloc, a, b))
+        return;
+    SetBit(alloc->interference, a * alloc->numWebs + b);
+    SetBit(alloc->interference, b * alloc->numWebs + a);
+    alloc->webs[a].degree++;
+    alloc->webs[b].degree++;
+}
+
+// Registers the call at instruction i clobbers
+static uint16_t CallClobbers(SSA* ssa, size_t i)
+{
+    uint16_t clobbers = 0;
+    for (int32_t v = ssa->instructions[i].firstClobber;
+         (size_t)v < ssa->values.count && SSA_Value(ssa, v)->inst == i; v++)
+    {
+        int location = SSA_Value(ssa, v)->location;
+        if (location < IR_NUM_PHYSICAL_REGISTERS)
+            clobbers |= 1 << location;
+    }
+    return clobbers;
+}
+
+// Writes interfere with the webs live after them. A move doesn't interfere with
+// its source, so the two can be coalesced.
+static void VisitInstruction(Allocator* alloc, uint16_t* live, size_t i, size_t weight)
+{
+    SSA* ssa = alloc->ssa;
+    IRInstruction* inst = Instruction(ssa, i);
+
+    if (inst->op == IR_Call)
+    {
+        uint16_t clobbers = CallClobbers(ssa, i);
+        for (size_t w = 0; w < alloc->numWebs; w++)
+        {
+            if (HasBit(live, w))
+                alloc->webs[w].forbidden |= clobbers;
+        }
+    }
+
+    size_t def = DefWeb(alloc, i);
+    if (def != SIZE_MAX)
+    {
+        size_t src = SIZE_MAX;
+        if (IsRegisterMove(inst))
+        {
+            src = UseWeb(alloc, i, IRSlot_B);
+            Move move;
+            move.dst = def;
+            move.src = src;
+            if (src != SIZE_MAX && src != def)
+                GenericList_Append(&alloc->moves, &move);
+        }
+        for (size_t k = 0; k < alloc->rowSize; k++)
+        {
+            if (live[k] == 0)
+                continue;
+            for (size_t w = k * 16; w < k * 16 + 16; w++)
+            {
+                if (w != src && HasBit(live, w))
+                    AddInterference(alloc, def, w);
+            }
+        }
+        ClearBit(live, def);
+        alloc->webs[def].cost = AddCost(alloc->webs[def].cost, weight);
+    }
+
+    for (int slot = IRSlot_Dst; slot <= IRSlot_B; slot++)
+    {
+        size_t use = UseWeb(alloc, i, slot);
+        if (use != SIZE_MAX)
+        {
+            SetBit(live, use);
+            alloc->webs[use].cost = AddCost(alloc->webs[use].cost, weight);
+        }
+    }
+}
+
+static void BuildInterference(Allocator* alloc)
+{
+    SSA* ssa = alloc->ssa;
+    size_t matrixSize = ((alloc->numWebs * alloc->numWebs + 15) / 16 + 1) * sizeof(uint16_t);
+    alloc->interference = xmalloc(matrixSize);
+    memset(alloc->interference, 0, matrixSize);
+    uint16_t* live = xmalloc((alloc->rowSize + 1) * sizeof(uint16_t));
+
+    for (size_t j = 0; j < ssa->numOrdered; j++)
+    {
+        size_t b = ssa->order[j];
+        IRBlock* block = Block(ssa, b);
+        memcpy(live, &alloc->liveOut[b * alloc->rowSize], alloc->rowSize * sizeof(uint16_t));
+        size_t weight = Weight(alloc, b);
+        for (size_t i = block->end; i > block->first; i--)
+            VisitInstruction(alloc, live, i - 1, weight);
+    }
+    free(live);
+}
+
+static size_t Alias(Allocator* alloc, size_t w)
+{
+    while (alloc->webs[w].alias != w)
+        w = alloc->webs[w].alias;
+    return w;
+}
+
+static bool IsNode(Allocator* alloc, size_t w)
+{
+    return alloc->webs[w].alias == w && !alloc->webs[w].simplified;
+}
+
+// Briggs: the merged web has fewer neighbours of significant degree than it has colors
+static bool CanCoalesce(Allocator* alloc, size_t a, size_t b)
+{
+    uint16_t forbidden = alloc->webs[a].forbidden | alloc->webs[b].forbidden;
+    int numColors = NumColors(forbidden);
+    int numSignificant = 0;
+    for (size_t n = 0; n < alloc->numWebs; n++)
+    {
+        if (n == a || n == b || !IsNode(alloc, n))
+            continue;
+        bool neighbourOfA = Interferes(alloc, a, n);
+        bool neighbourOfB = Interferes(alloc, b, n);
+        if (!neighbourOfA && !neighbourOfB)
+            continue;
+        size_t degree = alloc->webs[n].degree;
+        // Loses one of the two neighbours
+        if (neighbourOfA && neighbourOfB)
+            degree--;
+        if (degree >= (size_t)NumColors(alloc->webs[n].forbidden))
+            numSignificant++;
+    }
+    return numSignificant < numColors;
+}
+
+static void Merge(Allocator* alloc, size_t a, size_t b)
+{
+    Web* into = &alloc->webs[a];
+    Web* from = &alloc->webs[b];
+    for (size_t n = 0; n < alloc->numWebs; n++)
+    {
+        if (n == a || !IsNode(alloc, n) || !Interferes(alloc, b, n))
+            continue;
+        if (Interferes(alloc, a, n))
+            alloc->webs[n].degree--;
+        else
+        {
+            SetBit(alloc->interference, a * alloc->numWebs + n);
+            SetBit(alloc->interference, n * alloc->numWebs + a);
+            into->degree++;
+        }
+    }
+    from->alias = a;
+    into->forbidden |= from->forbidden;
+    into->cost = AddCost(into->cost, from->cost);
+    if (into->original == -1)
+        into->original = from->original;
+}
+
+static void Coalesce(Allocator* alloc)
+{
+    bool changed = true;
+    while (changed)
+    {
+        changed = false;
+        for (size_t m = 0; m < alloc->moves.count; m++)
+        {
+            Move* move = GenericList_At(&alloc->moves, m);
+            size_t a = Alias(alloc, move->dst);
+            size_t b = Alias(alloc, move->src);
+            if (a != b && !Interferes(alloc, a, b) && CanCoalesce(alloc, a, b))
+            {
+                Merge(alloc, a, b);
+                changed = true;
+            }
+        }
+    }
+}
+
+// Next web to take out of the graph: one with fewer neighbours than colors, which can always
+// be colored. Otherwise the cheapest web per neighbour, which might not get a color.
+static size_t SelectForRemoval(Allocator* alloc)
+{
+    size_t candidate = SIZE_MAX;
+    size_t candidateCost = SIZE_MAX;
+    for (size_t w = 0; w < alloc->numWebs; w++)
+    {
+        if (!IsNode(alloc, w))
+            continue;
+        Web* web = &alloc->webs[w];
+        if (web->degree < (size_t)NumColors(web->forbidden))
+            return w;
+        size_t cost = web->cost / (web->degree + 1);
+        if (candidate == SIZE_MAX || cost < candidateCost)
+        {
+            candidate = w;
+            candidateCost = cost;
+        }
+    }
+    return candidate;
+}
+
+static size_t Simplify(Allocator* alloc, size_t* stack)
+{
+    size_t numStack = 0;
+    size_t w;
+    while ((w = SelectForRemoval(alloc)) != SIZE_MAX)
+    {
+        for (size_t n = 0; n < alloc->numWebs; n++)
+        {
+            if (n != w && IsNode(alloc, n) && Interferes(alloc, w, n))
+                alloc->webs[n].degree--;
+        }
+        alloc->webs[w].simplified = true;
+        stack[numStack++] = w;
+    }
+    return numStack;
+}
+
+static bool IsFree(uint16_t used, int color)
+{
+    return color != -1 && ((int)used & (1 << color)) == 0;
+}
+
+// Prefers the color of a web it is moved to or from, then the register code generation picked
+static int PickColor(Allocator* alloc, size_t w, uint16_t used)
+{
+    for (size_t m = 0; m < alloc->moves.count; m++)
+    {
+        Move* move = GenericList_At(&alloc->moves, m);
+        size_t dst = Alias(alloc, move->dst);
+        size_t src = Alias(alloc, move->src);
+        int color = -1;
+        if (dst == w)
+            color = alloc->webs[src].color;
+        else if (src == w)
+            color = alloc->webs[dst].color;
+        if (IsFree(used, color))
+            return color;
+    }
+    if (IsFree(used, alloc->webs[w].original))
+        return alloc->webs[w].original;
+    for (int r = 0; r < IR_NUM_PHYSICAL_REGISTERS; r++)
+    {
+        if (IsFree(used, r))
+            return r;
+    }
+    return -1;
+}
+
+// Returns false if some webs didn't get a color
+static bool Select(Allocator* alloc, const size_t* stack, size_t numStack)
+{
+    bool colored = true;
+    for (size_t k = numStack; k > 0; k--)
+    {
+        size_t w = stack[k - 1];
+        uint16_t used = alloc->webs[w].forbidden;
+        for (size_t n = 0; n < alloc->numWebs; n++)
+        {
+            if (alloc->webs[n].alias == n && alloc->webs[n].color != -1 && Interferes(alloc, w, n))
+                used |= 1 << alloc->webs[n].color;
+        }
+        alloc->webs[w].color = PickColor(alloc, w, used);
+        if (alloc->webs[w].color == -1)
+            colored = false;
+    }
+    return colored;
+}
+
+static void Recolor(Allocator* alloc, IROperand* op, size_t web)
+{
+    if (web != SIZE_MAX)
+        op->value = (int32_t)alloc->webs[Alias(alloc, web)].color;
+}
+
+// Virtual registers that are read while they hold garbage, like ones that are never written
+static void AssignGarbage(IROperand* op)
+{
+    if ((op->type == IROperand_Register || op->type == IROperand_MemoryRegister) &&
+        (int)op->value >= IR_NUM_PHYSICAL_REGISTERS)
+        op->value = 0;
+}
+
+// Rewrites the registers with their colors. Moves between coalesced webs disappear.
+static void Rewrite(Allocator* alloc)
+{
+    SSA* ssa = alloc->ssa;
+    for (size_t j = 0; j < ssa->numOrdered; j++)
+    {
+        IRBlock* block = Block(ssa, ssa->order[j]);
+        for (size_t i = block->first; i < block->end; i++)
+        {
+            IRInstruction* inst = Instruction(ssa, i);
+            // Moves and nots only read b
+            bool tied = IR_OperandEquals(inst->dst, inst->a);
+            for (int slot = IRSlot_A; slot <= IRSlot_B; slot++)
+                Recolor(alloc, IR_OperandAt(inst, slot), UseWeb(alloc, i, slot));
+            size_t def = DefWeb(alloc, i);
+            if (def == SIZE_MAX)
+                Recolor(alloc, &inst->dst, UseWeb(alloc, i, IRSlot_Dst));
+            else
+                Recolor(alloc, &inst->dst, def);
+            if (tied)
+                inst->a = inst->dst;
+            for (int slot = IRSlot_Dst; slot <= IRSlot_B; slot++)
+                AssignGarbage(IR_OperandAt(inst, slot));
+
+            if (inst->op == IR_Mov && inst->dst.type == IROperand_Register && IR_OperandEquals(inst->dst, inst->b))
+                inst->op = IR_Nop;
+        }
+    }
+}
+
+// Gives the webs that didn't get a color stack slots, shared by webs that don't interfere,
+// and moves their values there. The number of slots is added to *oNumSlots.
+static bool Spill(Allocator* alloc, int* oNumSlots)
+{
+    int* slotOfWeb = xmalloc((alloc->numWebs + 1) * sizeof(int));
+    int numSlots = 0;
+    for (size_t w = 0; w < alloc->numWebs; w++)
+    {
+        slotOfWeb[w] = -1;
+        if (alloc->webs[w].alias != w || alloc->webs[w].color != -1)
+            continue;
+        int slot = 0;
+        size_t n = 0;
+        while (n < w)
+        {
+            if (slotOfWeb[n] == slot && Interferes(alloc, w, n))
+            {
+                slot++;
+                n = 0;
+            }
+            else
+                n++;
+        }
+        slotOfWeb[w] = slot;
+        if (slot >= numSlots)
+            numSlots = slot + 1;
+    }
+
+    SSA* ssa = alloc->ssa;
+    int* slotOfValue = xmalloc((ssa->values.count + 1) * sizeof(int));
+    for (size_t v = 0; v < ssa->values.count; v++)
+    {
+        size_t web = WebOf(alloc, (int32_t)v);
+        slotOfValue[v] = -1;
+        if (web != SIZE_MAX)
+            slotOfValue[v] = slotOfWeb[Alias(alloc, web)];
+    }
+    bool spilled = Spill_Run(ssa, slotOfValue, numSlots);
+    if (spilled)
+        *oNumSlots += numSlots;
+    free(slotOfWeb);
+    free(slotOfValue);
+    return spilled;
+}
+
+// numSlots is the number of slots earlier rounds spilled to, increased if this one spills
+static Outcome Allocate(SSA* ssa, int firstTemporary, bool mustAssign, int* numSlots)
+{
+    if (mustAssign)
+        RemoveUnreachableCode(ssa);
+    else if (HasUnreachableCode(ssa))
+        return Outcome_Failed;
+
+    bool* live = xmalloc(ssa->values.count + 1);
+    memset(live, 0, ssa->values.count + 1);
+    MarkLiveValues(ssa, live);
+
+    Allocator alloc;
+    memset(&alloc, 0, sizeof(Allocator));
+    alloc.ssa = ssa;
+    alloc.firstTemporary = firstTemporary;
+    alloc.moves = GenericList_Create(sizeof(Move));
+    BuildWebs(&alloc, live);
+    FindGarbageEdges(&alloc, live);
+    free(live);
+    alloc.rowSize = (alloc.numWebs + 15) / 16;
+
+    ComputeLoopDepths(&alloc);
+    ComputeLiveness(&alloc);
+    BuildInterference(&alloc);
+    Coalesce(&alloc);
+
+    size_t* stack = xmalloc((alloc.numWebs + 1) * sizeof(size_t));
+    size_t numStack = Simplify(&alloc, stack);
+    Outcome outcome = Outcome_Failed;
+    if (Select(&alloc, stack, numStack))
+    {
+        Rewrite(&alloc);
+        if (*numSlots != 0)
+            Spill_RemoveRedundantAccesses(ssa, *numSlots);
+        outcome = Outcome_Colored;
+    }
+    else if (mustAssign && Spill(&alloc, numSlots))
+        outcome = Outcome_Spilled;
+
+    free(stack);
+    free(alloc.webOfValue);
+    free(alloc.webs);
+    free(alloc.interference);
+    free(alloc.liveIn);
+    free(alloc.liveOut);
+    free(alloc.depth);
+    for (size_t e = 0; e < ssa->edges.count; e++)
+        GenericList_Dispose(&alloc.garbage[e]);
+    free(alloc.garbage);
+    GenericList_Dispose(&alloc.moves);
+    return outcome;
+}
+
+bool Allocator_Run(SSA* ssa)
+{
+    IRFunction* function = ssa->function;
+    // Only code with virtual registers is spilled: variables at -O1 and expressions that ran out of machine registers
+    bool mustAssign = IR_HasVirtualRegisters(function);
+    int firstTemporary = ssa->flagsLocation;
+
+    int numSlots = 0;
+    Outcome outcome = Allocate(ssa, firstTemporary, mustAssign, &numSlots);
+    for (int round = 1; outcome == Outcome_Spilled && round < MAX_SPILL_ROUNDS; round++)
+    {
+        SSA* spilled = SSA_Build(function);
+        outcome = Allocate(spilled, firstTemporary, true, &numSlots);
+        SSA_Dispose(spilled);
+    }
+    return outcome == Outcome_Colored;
+}
@@ -0,0 +1,11 @@
+#pragma once
+#include "SSA.h"
+#include <stdbool.h>
+
+// Reassigns the registers of a function by graph coloring (Chaitin-Briggs). The live ranges
+// of its values are colored with the machine registers, coalescing moves where that keeps the
+// graph colorable, and registers clobbered by a call are kept free for values live across it.
+// Returns false and leaves the code as it is if the function can't be colored. Functions with
+// virtual registers spill the cheapest live ranges to the stack (Spill.h) until they can be,
+// and only return false if that fails.
+bool Allocator_Run(SSA* ssa);
@@ -0,0 +1,93 @@
+#include "Arena.h"
+#include "Util.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct ArenaBlock
+{
+    ArenaBlock* next;
+    size_t used;
+    size_t size;
+} ArenaBlock;
+
+static const size_t ARENA_ALIGNMENT = 16;
+
+static size_t AlignUp(size_t n)
+{
+    return (n + ARENA_ALIGNMENT - 1) & ~(ARENA_ALIGNMENT - 1);
+}
+
+static char* BlockData(ArenaBlock* block)
+{
+    return (char*)block + AlignUp(sizeof(ArenaBlock));
+}
+
+static ArenaBlock* NewBlock(size_t size, ArenaBlock* next)
+{
+    ArenaBlock* block = xmalloc(AlignUp(sizeof(ArenaBlock)) + size);
+    block->next = next;
+    block->used = 0;
+    block->size = size;
+    return block;
+}
+
+Arena Arena_Create(size_t blockSize)
+{
+    return (Arena){NULL, blockSize};
+}
+
+void* Arena_Alloc(Arena* this, size_t size)
+{
+    size = AlignUp(size);
+
+    ArenaBlock* block = this->blocks;
+    if (block == NULL || block->used + size > block->size)
+    {
+        size_t newSize = this->blockSize;
+        if (size > newSize)
+            newSize = size;
+        block = this->blocks = NewBlock(newSize, this->blocks);
+    }
+
+    void* retval = BlockData(block) + block->used;
+    block->used += size;
+    return retval;
+}
+
+void* Arena_Copy(Arena* this, const void* data, size_t size)
+{
+    void* retval = Arena_Alloc(this, size);
+    memcpy(retval, data, size);
+    return retval;
+}
+
+void Arena_Reset(Arena* this)
+{
+    if (this->blocks == NULL)
+        return;
+
+    // The first block allocated is the last in the list.
+    ArenaBlock* block = this->blocks;
+    while (block->next != NULL)
+    {
+        ArenaBlock* next = block->next;
+        free(block);
+        block = next;
+    }
+
+    block->used = 0;
+    this->blocks = block;
+}
+
+void Arena_Dispose(Arena* this)
+{
+    ArenaBlock* block = this->blocks;
+    while (block != NULL)
+    {
+        ArenaBlock* next = block->next;
+        free(block);
+        block = next;
+    }
+    this->blocks = NULL;
+}
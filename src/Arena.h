@@ -0,0 +1,25 @@
+#pragma once
+#include <stddef.h>
+
+#ifndef CUSTOM_COMP
+typedef struct ArenaBlock ArenaBlock;
+#endif
+#ifdef CUSTOM_COMP
+typedef struct ArenaBlock {} ArenaBlock;
+#endif
+
+// Region allocator. Allocations are bump-allocated from large blocks
+// and can only be released all at once, using Arena_Reset or Arena_Dispose.
+typedef struct
+{
+    ArenaBlock* blocks;
+    size_t blockSize;
+} Arena;
+
+Arena Arena_Create(size_t blockSize);
+void* Arena_Alloc(Arena* this, size_t size);
+void* Arena_Copy(Arena* this, const void* data, size_t size);
+
+// Releases all allocations, but keeps the first block around for reuse.
+void Arena_Reset(Arena* this);
+void Arena_Dispose(Arena* this);
@@ -0,0 +1,108 @@
+#include "Backend.h"
+#include "Outfile.h"
+#include "Relocation.h"
+#include <assert.h>
+
+static const char* opcodeNames[14] = {"add", "sub", "mul",  "and",  "div",  "or",  "xor",
+                                      "shl", "shr", "mulh", "mulq", "invq", "mov", "not"};
+
+static void PrintOperand(IROperand operand)
+{
+    switch (operand.type)
+    {
+        case IROperand_Register:
+            assert((int)operand.value < IR_NUM_PHYSICAL_REGISTERS);
+            OutWrite("r%i", operand.value);
+            break;
+        case IROperand_Zero: OutWrite("rz"); break;
+        case IROperand_IP: OutWrite("ip"); break;
+        case IROperand_SP: OutWrite("sp"); break;
+        case IROperand_Literal:
+            if (operand.dataRelative)
+                Relocation_AddText(Relocation_Text, Outfile_TextLength());
+            OutWrite("%i", operand.value);
+            break;
+        case IROperand_Memory:
+            if (operand.dataRelative)
+                Relocation_AddText(Relocation_Text, Outfile_TextLength() + 1);
+            OutWrite("[%i]", operand.value);
+            break;
+        case IROperand_MemoryRegister:
+            assert((int)operand.value < IR_NUM_PHYSICAL_REGISTERS);
+            OutWrite("[r%i]", operand.value);
+            break;
+        case IROperand_Stack:
+            if (operand.value == 0)
+                OutWrite("[sp]");
+            else
+                OutWrite("[sp-%i]", operand.value);
+            break;
+        case IROperand_Push: OutWrite("[sp++]"); break;
+        case IROperand_Label:;
+            const char* name = IR_LabelName(operand.value);
+            // Generated labels carry their id as the first number, functions start with _
+            if (name[0] != '_')
+            {
+                size_t idOffset = 0;
+                while (name[idOffset] != 0 && (name[idOffset] < '0' || name[idOffset] > '9'))
+                    idOffset++;
+                Relocation_AddText(Relocation_Label, Outfile_TextLength() + idOffset);
+            }
+            OutWrite("%s", name);
+            break;
+        default: assert(0);
+    }
+}
+
+static void PrintFlag(Flag flag)
+{
+    if (flag != Flag_None)
+        OutWrite(Flags_FlagToString(flag));
+}
+
+static void PrintInstruction(const IRInstruction* inst)
+{
+    switch (inst->op)
+    {
+        case IR_Jump:
+            OutWrite("jmp");
+            PrintFlag(inst->flag);
+            OutWrite(" ");
+            PrintOperand(inst->a);
+            OutWrite("\n");
+            break;
+        case IR_Call:
+            OutWrite("add [sp++], ip, 1\njmp ");
+            PrintOperand(inst->a);
+            OutWrite("\n");
+            break;
+        case IR_Label:
+            PrintOperand(inst->a);
+            OutWrite(":\n");
+            break;
+        case IR_Asm: OutWrite("%s\n", inst->text); break;
+        case IR_Nop: break;
+        default:
+            assert(inst->op <= IR_Not);
+            OutWrite(opcodeNames[inst->op]);
+            PrintFlag(inst->flag);
+            OutWrite(" ");
+            if (!IR_OperandEquals(inst->dst, inst->a))
+            {
+                PrintOperand(inst->dst);
+                OutWrite(", ");
+            }
+            PrintOperand(inst->a);
+            OutWrite(", ");
+            PrintOperand(inst->b);
+            OutWrite("\n");
+            break;
+    }
+}
+
+void Backend_PrintFunction(const IRFunction* function)
+{
+    OutWrite("_%s:\n", function->name);
+    for (size_t i = 0; i < function->instructions.count; i++)
+        PrintInstruction(GenericList_At(&function->instructions, i));
+}
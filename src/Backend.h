@@ -0,0 +1,5 @@
+#pragma once
+#include "IR.h"
+
+// Prints the function as assembly to the output file.
+void Backend_PrintFunction(const IRFunction* function);
@@ -1,8 +1,9 @@
 #include "CG_Binop.h"
 #include "../AST.h"
 #include "../Flags.h"
-#include "../Outfile.h"
+#include "../IR.h"
 #include "../Register.h"
+#include "../Relocation.h"
 #include "../Stack.h"
 #include "../Token.h"
 #include "../Type.h"
@@ -51,8 +52,6 @@ void CodeGen_StructMemberAccess(AST_Expression_BinOp* expr, Scope* scope, Value*
     if ((outStructMemberVar = GenericList_Find(&outStruct->members, CompareVariableToID, memberExpr->id)) == NULL)
         ErrorAtLocation("Invalid struct member", expr->exprB->loc);
 
-    free(expr->exprB);
-
     if (oValue == NULL)
     {
         bool err;
@@ -94,6 +93,7 @@ void CodeGen_StructMemberAccess(AST_Expression_BinOp* expr, Scope* scope, Value*
         {
             srcValue = Value_Memory((uint16_t)(structValue.address + outStructMemberVar->value.address),
                                     outStructMemberVar->value.size);
+            srcValue.dataRelative = structValue.dataRelative;
 
             *oReadOnly = structReadOnly;
         }
@@ -115,7 +115,7 @@ void CodeGen_StructMemberAccess(AST_Expression_BinOp* expr, Scope* scope, Value*
                 structValue.addressType = AddressType_Register;
 
                 srcValue = structValue;
-                OutWrite("add r%i, %i\n", Value_GetR0(&srcValue), Value_Literal(outStructMemberVar->value.address));
+                IR_Emit2(IR_Add, IR_Register(Value_GetR0(&srcValue)), IR_Literal(outStructMemberVar->value.address));
 
                 *oReadOnly = false;
 
@@ -160,8 +160,13 @@ void CodeGen_StructMemberAccess(AST_Expression_BinOp* expr, Scope* scope, Value*
         }
         else
         {
-            // (Make sure oValue is a register, as we will turn it into a memory register)
-            if (oValue->addressType != AddressType_None && oValue->addressType != AddressType_Register)
+            // (Make sure oValue is a new register, as we will turn it into a memory register that isn't read only.
+            // A requested register belongs to the caller, who would free it along with the result. Without one,
+            // a struct pointer that isn't read only would be reused as destination.)
+            if (oValue->addressType != AddressType_None ||
+                (!structReadOnly &&
+                 (structValue.addressType == AddressType_Memory ||
+                  structValue.addressType == AddressType_MemoryRelative)))
                 *oValue = Value_Register(1);
 
             // Assertion should also hold
@@ -215,7 +220,7 @@ void CodeGen_Assignment(AST_Expression_BinOp* expr, Scope* scope, Value* oValue,
         if (!IsPrimitiveType(leftType))
             ErrorAtLocation("Invalid assignment", expr->loc);
 
-        AST_Expression_Value* exprA = xmalloc(sizeof(AST_Expression_Value));
+        AST_Expression_Value* exprA = AST_Alloc(sizeof(AST_Expression_Value));
         exprA->type = AST_ExpressionType_Value;
         exprA->value = leftVal;
         exprA->loc = expr->loc;
@@ -359,7 +364,7 @@ void BinopAdd32(Value* dstValue, Value* srcA, Value* srcB, bool srcAro, bool src
     GenerateNativeOP(NativeOP_Add, &dstLow, srcALow, srcBLow, true, true);
 
     // Carry
-    OutWrite("add_c r%i, 1\n", Value_GetR0(carry));
+    IR_EmitConditional(IR_Add, Flag_C, IR_Register(Value_GetR0(carry)), IR_Register(Value_GetR0(carry)), IR_Literal((int32_t)1));
 
     // High Word
     GenerateNativeOP(NativeOP_Add, &dstHigh, srcAHigh, srcBHigh, true, true);
@@ -406,7 +411,7 @@ void BinopSub32(Value* dstValue, Value* srcA, Value* srcB, bool srcAro)
     GenerateNativeOP(NativeOP_Sub, &dstLow, srcALow, srcBLow, true, true);
 
     // Borrow
-    OutWrite("sub_nc r%i, 1\n", Value_GetR0(carry));
+    IR_EmitConditional(IR_Sub, Flag_NC, IR_Register(Value_GetR0(carry)), IR_Register(Value_GetR0(carry)), IR_Literal((int32_t)1));
 
     // High Word
     GenerateNativeOP(NativeOP_Sub, &dstHigh, srcAHigh, srcBHigh, true, true);
@@ -535,8 +540,9 @@ void BinopEquality(BinOp op, Value* dstValue, Value* srcA, Value* srcB, bool src
 
         assert(dstValue->size == 1);
 
-        OutWrite("mov r%i, 0\n", Value_GetR0(dstValue));
-        OutWrite("mov%s r%i, 1\n", Flags_FlagToString(returnFlag), Value_GetR0(dstValue));
+        IR_EmitMove(IR_Mov, IR_Register(Value_GetR0(dstValue)), IR_Literal((int32_t)0));
+        IR_EmitConditional(IR_Mov, returnFlag, IR_Register(Value_GetR0(dstValue)), IR_Register(Value_GetR0(dstValue)),
+                           IR_Literal((int32_t)1));
     }
 }
 
@@ -684,7 +690,7 @@ void BinopComparison(BinOp op, Value* dstValue, Value* srcA, Value* srcB, bool s
         GenerateNativeOP(NativeOP_Sub, &dstLow, srcALow, srcBLow, true, true);
 
         // Borrow
-        OutWrite("sub_nc r%i, 1\n", Value_GetR0(carry));
+        IR_EmitConditional(IR_Sub, Flag_NC, IR_Register(Value_GetR0(carry)), IR_Register(Value_GetR0(carry)), IR_Literal((int32_t)1));
 
         // High Word
         GenerateNativeOP(NativeOP_Sub, &dstHigh, srcAHigh, srcBHigh, true, true);
@@ -737,8 +743,9 @@ void BinopComparison(BinOp op, Value* dstValue, Value* srcA, Value* srcB, bool s
             *dstValue = Value_Register(1);
         }
 
-        OutWrite("mov r%i, 0\n", Value_GetR0(dstValue));
-        OutWrite("mov%s r%i, 1\n", Flags_FlagToString(returnFlag), Value_GetR0(dstValue));
+        IR_EmitMove(IR_Mov, IR_Register(Value_GetR0(dstValue)), IR_Literal((int32_t)0));
+        IR_EmitConditional(IR_Mov, returnFlag, IR_Register(Value_GetR0(dstValue)), IR_Register(Value_GetR0(dstValue)),
+                           IR_Literal((int32_t)1));
     }
 }
 
@@ -793,7 +800,7 @@ void BinopShiftLeft32(Value* dstValue, Value* srcA, Value* srcB)
         n = Value_Register(1);
     }
 
-    OutWrite("mov r%i, 65535\n", Value_GetR0(&outShifted));
+    IR_EmitMove(IR_Mov, IR_Register(Value_GetR0(&outShifted)), IR_Literal((int32_t)65535));
     GenerateNativeOP(NativeOP_Sub, &n, Value_Literal((int32_t)16), srcBLow, true, true);
     GenerateNativeOP(NativeOP_ShiftLeft, &outShifted, outShifted, n, true, true);
 
@@ -850,7 +857,7 @@ void BinopShiftRight32(Value* dstValue, Value* srcA, Value* srcB)
         n = Value_Register(1);
     }
 
-    OutWrite("mov r%i, 65535\n", Value_GetR0(&outShifted));
+    IR_EmitMove(IR_Mov, IR_Register(Value_GetR0(&outShifted)), IR_Literal((int32_t)65535));
     GenerateNativeOP(NativeOP_Sub, &n, Value_Literal((int32_t)16), srcBLow, true, true);
     GenerateNativeOP(NativeOP_ShiftRight, &outShifted, outShifted, n, true, true);
 
@@ -970,9 +977,13 @@ void CodeGen_ArrayAccess(AST_Expression_BinOp* expr, Scope* scope, Value* oValue
         if (elementSize != 1)
         {
             if (indexValue.addressType == AddressType_Literal)
+            {
+                if (indexValue.dataRelative)
+                    Relocation_AssumeFixed();
                 indexValue.address *= (int32_t)elementSize;
+            }
             else
-                OutWrite("mul r%i, %i\n", Value_GetR0(oValue), elementSize);
+                IR_Emit2(IR_Mul, IR_Register(Value_GetR0(oValue)), IR_Literal((int32_t)elementSize));
         }
 
         if (arrayValue.addressType == AddressType_Memory)
@@ -984,6 +995,9 @@ void CodeGen_ArrayAccess(AST_Expression_BinOp* expr, Scope* scope, Value* oValue
                 oValue->addressType = AddressType_Memory;
                 oValue->size = elementSize;
                 oValue->address = arrayValue.address + indexValue.address;
+                oValue->dataRelative = arrayValue.dataRelative || indexValue.dataRelative;
+                if (arrayValue.dataRelative && indexValue.dataRelative)
+                    Relocation_AssumeFixed();
 
                 // Not needed, for the sake of completeness
                 // if (!arrayReadOnly)
@@ -995,7 +1009,9 @@ void CodeGen_ArrayAccess(AST_Expression_BinOp* expr, Scope* scope, Value* oValue
             }
             else
             {
-                OutWrite("add r%i, %i\n", Value_GetR0(oValue), arrayValue.address);
+                IROperand address = IR_Literal(arrayValue.address);
+                address.dataRelative = arrayValue.dataRelative;
+                IR_Emit2(IR_Add, IR_Register(Value_GetR0(oValue)), address);
                 *oReadOnly = false;
             }
         }
@@ -1008,6 +1024,8 @@ void CodeGen_ArrayAccess(AST_Expression_BinOp* expr, Scope* scope, Value* oValue
             {
                 Value_FreeValue(oValue);
 
+                if (indexValue.dataRelative)
+                    Relocation_AssumeFixed();
                 oValue->addressType = AddressType_MemoryRelative;
                 oValue->address = arrayValue.address - indexValue.address;
                 oValue->size = elementSize;
@@ -1018,11 +1036,11 @@ void CodeGen_ArrayAccess(AST_Expression_BinOp* expr, Scope* scope, Value* oValue
             }
             else
             {
-                OutWrite("add r%i, sp\n", Value_GetR0(oValue));
+                IR_Emit2(IR_Add, IR_Register(Value_GetR0(oValue)), IR_SP());
                 if (delta > 0)
-                    OutWrite("sub r%i, %i\n", Value_GetR0(oValue), delta);
+                    IR_Emit2(IR_Sub, IR_Register(Value_GetR0(oValue)), IR_Literal((int32_t)delta));
                 else if (delta < 0)
-                    OutWrite("add r%i, %i\n", Value_GetR0(oValue), -delta);
+                    IR_Emit2(IR_Add, IR_Register(Value_GetR0(oValue)), IR_Literal((int32_t)(-delta)));
             }
         }
         else if (arrayValue.addressType == AddressType_MemoryRegister)
@@ -1083,20 +1101,26 @@ void CodeGen_LogicalAndOr(const AST_Expression_BinOp* expr, Scope* scope, Value*
     Value boolean = Value_Register(1);
 
     // These actually dont even need to be conditional, the branch handles it already.
+    IROperand booleanRegister = IR_Register(Value_GetR0(&boolean));
     if (expr->op == BinOp_LogicalAnd)
-        OutWrite("mov%s r%i, 0\n", Flags_FlagToString(Flags_Invert((Flag)left.address)), Value_GetR0(&boolean));
+        IR_EmitConditional(IR_Mov, Flags_Invert((Flag)left.address), booleanRegister, booleanRegister, IR_Literal((int32_t)0));
     else
-        OutWrite("mov%s r%i, 1\n", Flags_FlagToString((Flag)left.address), Value_GetR0(&boolean));
+        IR_EmitConditional(IR_Mov, (Flag)left.address, booleanRegister, booleanRegister, IR_Literal((int32_t)1));
 
     int id = GetLabelID();
+    char endLabel[32];
+    if (expr->op == BinOp_LogicalAnd)
+        sprintf(&endLabel[0], "AND_END_%i", id);
+    else
+        sprintf(&endLabel[0], "OR_END_%i", id);
 
     int spOffsetPostCond = Stack_GetOffset();
     int stackSizePostCond = Stack_GetSize();
 
     if (expr->op == BinOp_LogicalAnd)
-        OutWrite("jmp%s AND_END_%zi\n", Flags_FlagToString(Flags_Invert((Flag)left.address)), id);
+        IR_EmitJump(Flags_Invert((Flag)left.address), &endLabel[0]);
     else
-        OutWrite("jmp%s OR_END_%zi\n", Flags_FlagToString((Flag)left.address), id);
+        IR_EmitJump((Flag)left.address, &endLabel[0]);
 
     bool rightReadOnly;
     Value right = boolean;
@@ -1112,10 +1136,7 @@ void CodeGen_LogicalAndOr(const AST_Expression_BinOp* expr, Scope* scope, Value*
 
     Stack_ToAddress(-spOffsetPostCond);
 
-    if (expr->op == BinOp_LogicalAnd)
-        OutWrite("AND_END_%u:\n", id);
-    else
-        OutWrite("OR_END_%u:\n", id);
+    IR_EmitLabel(&endLabel[0]);
 
     Stack_SetOffset(spOffsetPostCond);
     Stack_SetSize(stackSizePostCond);
@@ -1248,6 +1269,15 @@ void CodeGen_BinaryOperator(AST_Expression_BinOp* expr, Scope* scope, Value* oVa
 
         *oValue = Value_Literal(newLiteral);
         *oReadOnly = false;
+
+        // Only an address plus or minus a number moves along with the address
+        if (expr->op == BinOp_Add)
+            oValue->dataRelative = left.dataRelative != right.dataRelative;
+        else if (expr->op == BinOp_Sub)
+            oValue->dataRelative = left.dataRelative && !right.dataRelative;
+        if ((left.dataRelative || right.dataRelative) && !oValue->dataRelative &&
+            !(expr->op == BinOp_Sub && left.dataRelative && right.dataRelative))
+            Relocation_AssumeFixed();
     }
     else
     {
@@ -12,9 +12,10 @@
 #include "../Flags.h"
 #include "../Function.h"
 #include "../GenericList.h"
+#include "../IR.h"
 #include "../Optimizer.h"
-#include "../Outfile.h"
 #include "../Register.h"
+#include "../Relocation.h"
 #include "../Scope.h"
 #include "../Stack.h"
 #include "../Struct.h"
@@ -27,10 +28,50 @@
 #include "CG_NativeOP.h"
 #include "CG_UnOp.h"
 
-int labelIDCounter = 0;
+typedef struct CG_ExpressionContext
+{
+    int labelIDCounter;
+} CG_ExpressionContext;
+
+#ifndef CUSTOM_COMP
+static _Thread_local CG_ExpressionContext* ctx = NULL;
+#endif
+#ifdef CUSTOM_COMP
+static CG_ExpressionContext* ctx = NULL;
+#endif
+
+CG_ExpressionContext* CG_Expression_CreateContext()
+{
+    CG_ExpressionContext* context = xmalloc(sizeof(CG_ExpressionContext));
+    memset(context, 0, sizeof(CG_ExpressionContext));
+    return context;
+}
+
+void CG_Expression_DisposeContext(CG_ExpressionContext* context)
+{
+    if (ctx == context)
+        ctx = NULL;
+    free(context);
+}
+
+void CG_Expression_UseContext(CG_ExpressionContext* context)
+{
+    ctx = context;
+}
+
 int GetLabelID()
 {
-    return labelIDCounter++;
+    return ctx->labelIDCounter++;
+}
+
+int PeekLabelID()
+{
+    return ctx->labelIDCounter;
+}
+
+void SetLabelID(int id)
+{
+    ctx->labelIDCounter = id;
 }
 
 static void CodeGen_ListLiteral(AST_Expression_ListLiteral* expr, Scope* scope, Value* oValue, VariableType** oType,
@@ -52,6 +93,8 @@ static void CodeGen_ListLiteral(AST_Expression_ListLiteral* expr, Scope* scope,
             assert(outValue.addressType == AddressType_Literal || outValue.addressType == AddressType_Memory);
             if (outValue.addressType == AddressType_Literal)
             {
+                if (outValue.dataRelative)
+                    Relocation_AddDataWord();
                 if (outValue.size == 1)
                     AllocateGlobalWord((int)outValue.address);
                 else if (outValue.size == 2)
@@ -93,12 +136,11 @@ static void CodeGen_ListLiteral(AST_Expression_ListLiteral* expr, Scope* scope,
     else
     {
         *oValue = Value_Memory(GetGlobalDataIndex() - totalSize, totalSize);
+        oValue->dataRelative = Relocation_IsRecording();
     }
 
     if (oType != NULL)
         *oType = Type_AddReference(&AnyVariableType);
-
-    free(expr->expressions);
 }
 
 void CodeGen_TypeCast(AST_Expression_TypeCast* expr, Scope* scope, Value* oValue, VariableType** oType, bool* oReadOnly)
@@ -140,7 +182,8 @@ void CodeGen_TypeCast(AST_Expression_TypeCast* expr, Scope* scope, Value* oValue
         {
             if (newSize <= outValue.size && outValue.addressType == AddressType_Memory)
             {
-                *oValue = Value_Memory((int)outValue.address, newSize);
+                *oValue = outValue;
+                oValue->size = newSize;
                 *oReadOnly = true;
             }
             else if (newSize <= outValue.size && outValue.addressType == AddressType_MemoryRelative)
@@ -160,7 +203,7 @@ void CodeGen_TypeCast(AST_Expression_TypeCast* expr, Scope* scope, Value* oValue
                 Value_GenerateMemCpy(*oValue, outValue);
 
                 if (newSize == 2 && outValue.size == 1)
-                    OutWrite("mov r%i, 0\n", Value_GetR1(oValue));
+                    IR_EmitMove(IR_Mov, IR_Register(Value_GetR1(oValue)), IR_Literal((int32_t)0));
                 *oReadOnly = false;
             }
         }
@@ -169,7 +212,7 @@ void CodeGen_TypeCast(AST_Expression_TypeCast* expr, Scope* scope, Value* oValue
             if (outValue.addressType == AddressType_Register && outValue.size == 1 && newSize == 2)
             {
                 int newRegister = Registers_GetFree();
-                OutWrite("mov r%i, 0\n", newRegister);
+                IR_EmitMove(IR_Mov, IR_Register(newRegister), IR_Literal((int32_t)0));
                 *oValue = Value_FromRegisters((int)outValue.address, newRegister);
                 *oReadOnly = false;
             }
@@ -183,7 +226,8 @@ void CodeGen_TypeCast(AST_Expression_TypeCast* expr, Scope* scope, Value* oValue
             {
                 if (newSize <= outValue.size && outValue.addressType == AddressType_Memory)
                 {
-                    *oValue = Value_Memory((int)outValue.address, newSize);
+                    *oValue = outValue;
+                    oValue->size = newSize;
                     *oReadOnly = false;
                 }
                 else if (newSize <= outValue.size && outValue.addressType == AddressType_MemoryRelative)
@@ -203,7 +247,7 @@ void CodeGen_TypeCast(AST_Expression_TypeCast* expr, Scope* scope, Value* oValue
                     Value_GenerateMemCpy(*oValue, outValue);
 
                     if (newSize == 2 && outValue.size == 1)
-                        OutWrite("mov r%i, 0\n", Value_GetR1(oValue));
+                        IR_EmitMove(IR_Mov, IR_Register(Value_GetR1(oValue)), IR_Literal((int32_t)0));
                     *oReadOnly = false;
                 }
             }
@@ -239,11 +283,14 @@ void CodeGen_FunctionCall(const AST_Expression_FunctionCall* expr, Scope* scope,
     int allocatedSizeInWords = 0;
 
     int numAllocForPushing = Registers_GetNumUsedMasked(outFunc->modifiedRegisters);
+    // Virtual registers aren't pushed, they are spilled if live across the call
     if (oValue != NULL && oValue->addressType == AddressType_Register)
     {
-        if (numAllocForPushing != 0 && outFunc->modifiedRegisters & Value_GetR0(oValue))
+        if (numAllocForPushing != 0 && Value_GetR0(oValue) < Register_Virtual &&
+            outFunc->modifiedRegisters & Value_GetR0(oValue))
             numAllocForPushing--;
-        if (numAllocForPushing != 0 && oValue->size == 2 && outFunc->modifiedRegisters & Value_GetR1(oValue))
+        if (numAllocForPushing != 0 && oValue->size == 2 && Value_GetR1(oValue) < Register_Virtual &&
+            outFunc->modifiedRegisters & Value_GetR1(oValue))
             numAllocForPushing--;
     }
     // Up
@@ -337,8 +384,6 @@ void CodeGen_FunctionCall(const AST_Expression_FunctionCall* expr, Scope* scope,
         Type_RemoveReference(parType);
     }
 
-    free(expr->parameters);
-
     if (parameterIndex < outFunc->parameters.count)
         ErrorAtLocation("Invalid number of parameters", expr->loc);
 
@@ -361,20 +406,20 @@ void CodeGen_FunctionCall(const AST_Expression_FunctionCall* expr, Scope* scope,
         Stack_ToAddress((int)spaceForSavingRegisters.address);
         pushedRegisters = Registers_PushAllUsedMasked(&numPushed, outFunc->modifiedRegisters);
 
-        // ... and then set it to used again.
-        if (oValue != NULL && oValue->addressType == AddressType_Register)
-        {
-            Register_GetSpecific(Value_GetR0(oValue));
-            if (oValue->size == 2)
-                Register_GetSpecific(Value_GetR1(oValue));
-        }
-
         Stack_Offset(numPushed);
         Stack_Align();
         // OffsetStackPointer(numUsed);
     }
     else
         Stack_Align();
+
+    // ... and then set it to used again, whether or not anything was pushed.
+    if (oValue != NULL && oValue->addressType == AddressType_Register)
+    {
+        Register_GetSpecific(Value_GetR0(oValue));
+        if (oValue->size == 2)
+            Register_GetSpecific(Value_GetR1(oValue));
+    }
     // else
     // curStackPointerOffset -= numUsed;
 
@@ -387,31 +432,24 @@ void CodeGen_FunctionCall(const AST_Expression_FunctionCall* expr, Scope* scope,
         switch (funcPointer->value.addressType)
         {
             case AddressType_Register:
-                OutWrite("add [sp++], ip, 1\n");
-                OutWrite("jmp r%i\n", Value_GetR0(&funcPointer->value));
+                IR_EmitCall(IR_Register(Value_GetR0(&funcPointer->value)), outFunc->modifiedRegisters);
                 break;
             case AddressType_Literal:
-                OutWrite("add [sp++], ip, 1\n");
-                OutWrite("jmp %i\n", funcPointer->value.address);
-                break;
             case AddressType_Memory:
-                OutWrite("add [sp++], ip, 1\n");
-                OutWrite("jmp [%i]\n", funcPointer->value.address);
+                IR_EmitCall(Value_ToOperand(&funcPointer->value), outFunc->modifiedRegisters);
                 break;
             default:
                 temp = Value_Register(1);
                 Value_GenerateMemCpy(temp, funcPointer->value);
                 Stack_Align();
-                OutWrite("add [sp++], ip, 1\n");
-                OutWrite("jmp r%i\n", Value_GetR0(&temp));
+                IR_EmitCall(IR_Register(Value_GetR0(&temp)), outFunc->modifiedRegisters);
                 Value_FreeValue(&temp);
                 break;
         }
     }
     else
     {
-        OutWrite("add [sp++], ip, 1\n");
-        OutWrite("jmp _%s\n", expr->id);
+        IR_EmitCall(IR_FunctionLabel(expr->id), outFunc->modifiedRegisters);
     }
 
     // OutWrite("nop\n");
@@ -436,7 +474,7 @@ void CodeGen_FunctionCall(const AST_Expression_FunctionCall* expr, Scope* scope,
             *oReadOnly = true;
         }
 
-        Value_GenerateMemCpy(*oValue, (Value){(int32_t)sizeOfRetval, AddressType_MemoryRelative, sizeOfRetval});
+        Value_GenerateMemCpy(*oValue, (Value){(int32_t)sizeOfRetval, AddressType_MemoryRelative, sizeOfRetval, false});
     }
 
     if (sizeOfRetval > 0 && !IsPrimitiveType(outFunc->returnType) && oValue != NULL)
@@ -494,12 +532,17 @@ void CodeGen_VariableAccess(AST_Expression_VariableAccess* expr, Scope* scope, V
         {
             // TODO fix this hack to get address at compile time
             if (Function_GetCurrent() == NULL && oValue->addressType == AddressType_Memory)
+            {
+                bool dataRelative = oValue->dataRelative;
                 *oValue = Value_Literal(oValue->address);
+                oValue->dataRelative = dataRelative;
+            }
             else
                 *oValue = outVar->value;
         }
 
-        if (outVar->lastAccess == expr)
+        assert(!outVar->released);
+        if (expr->isLastUse && outVar->liveIndex != -1)
         {
             if (oReadOnly != NULL)
                 *oReadOnly = 0;
@@ -507,7 +550,7 @@ void CodeGen_VariableAccess(AST_Expression_VariableAccess* expr, Scope* scope, V
             {
                 Value_FreeValue(&outVar->value);
             }
-            Scope_DeleteVariable(scope, outVar);
+            outVar->released = true;
         }
         else if (oReadOnly != NULL)
             *oReadOnly = 1;
@@ -525,7 +568,7 @@ void CodeGen_VariableAccess(AST_Expression_VariableAccess* expr, Scope* scope, V
             if (oType != NULL)
                 *oType = Type_AddReference(&AnyVariableType);
             *oValue = Value_Register(1);
-            OutWrite("mov r%i, _%s\n", Value_GetR0(oValue), expr->id);
+            IR_EmitMove(IR_Mov, IR_Register(Value_GetR0(oValue)), IR_FunctionLabel(expr->id));
             *oReadOnly = 0;
             return;
         };
@@ -542,12 +585,17 @@ void CodeGen_TernaryOp(AST_Expression_TernaryOp* expr, Scope* scope, Value* oVal
     bool outReadOnly;
     CodeGen_Expression(expr->cond, scope, &outValue, NULL, &outReadOnly);
 
+    char elseLabel[32];
+    char endLabel[32];
+    sprintf(&elseLabel[0], "else%u", ternId);
+    sprintf(&endLabel[0], "n_else%u", ternId);
+
     if (outValue.addressType == AddressType_Flag)
-        OutWrite("jmp%s else%u\n", Flags_FlagToString(Flags_Invert((Flag)outValue.address)), ternId);
+        IR_EmitJump(Flags_Invert((Flag)outValue.address), &elseLabel[0]);
     else
     {
         Value_ToFlag(&outValue);
-        OutWrite("jmp_z else%u\n", ternId);
+        IR_EmitJump(Flag_Z, &elseLabel[0]);
     }
 
     if (!outReadOnly)
@@ -579,13 +627,12 @@ void CodeGen_TernaryOp(AST_Expression_TernaryOp* expr, Scope* scope, Value* oVal
         leftValue = newValue;
     }
 
+    // Both branches reach the end with the stack pointer where the left value left it
     int spOffsetPostLeft = Stack_GetOffset();
     int stackSizePostLeft = Stack_GetSize();
 
-    Stack_ToAddress(-spOffsetPostCond);
-
-    OutWrite("jmp n_else%u\n", ternId);
-    OutWrite("else%u:\n", ternId);
+    IR_EmitJump(Flag_None, &endLabel[0]);
+    IR_EmitLabel(&elseLabel[0]);
     Stack_SetOffset(spOffsetPostCond);
     Stack_SetSize(stackSizePostCond);
 
@@ -614,7 +661,7 @@ void CodeGen_TernaryOp(AST_Expression_TernaryOp* expr, Scope* scope, Value* oVal
 
     Stack_ToAddress(-spOffsetPostLeft);
 
-    OutWrite("n_else%u:\n", ternId);
+    IR_EmitLabel(&endLabel[0]);
 
     Stack_SetOffset(spOffsetPostLeft);
     Stack_SetSize(stackSizePostLeft);
@@ -639,9 +686,7 @@ void FreeExpressionTree(AST_Expression* expr, Scope* scope)
             // Special handling for structs, as the always have a "variable access"
             // as right side that isn't referring to an actual variable, but rather
             // a struct member. We don't want it to be treated as a normal var.
-            if (binop->op == BinOp_StructAccessDot || binop->op == BinOp_StructAccessArrow)
-                free(binop->exprB);
-            else
+            if (binop->op != BinOp_StructAccessDot && binop->op != BinOp_StructAccessArrow)
                 FreeExpressionTree(binop->exprB, scope);
             break;
         case AST_ExpressionType_FunctionCall:;
@@ -661,15 +706,14 @@ void FreeExpressionTree(AST_Expression* expr, Scope* scope)
             // needs to be freed to avoid a register leak.
             Variable* outVar = NULL;
             if ((outVar = Scope_FindVariable(scope, ((AST_Expression_VariableAccess*)expr)->id)) != NULL)
-                if (outVar->lastAccess == expr)
+                if (((AST_Expression_VariableAccess*)expr)->isLastUse && outVar->liveIndex != -1)
                 {
                     Value_FreeValue(&outVar->value);
-                    Scope_DeleteVariable(scope, outVar);
+                    outVar->released = true;
                 }
             break;
         default:;
     }
-    free(expr);
 }
 
 void CodeGen_Expression(AST_Expression* expr, Scope* scope, Value* oValue, VariableType** oType, bool* oReadOnly)
@@ -713,6 +757,7 @@ void CodeGen_Expression(AST_Expression* expr, Scope* scope, Value* oValue, Varia
             {
                 uint16_t index = AllocateAndWriteStringLiteral(((AST_Expression_StringLiteral*)expr)->data);
                 *oValue = Value_Literal((int32_t)index);
+                oValue->dataRelative = Relocation_IsRecording();
                 *oReadOnly = false;
             }
             break;
@@ -754,6 +799,4 @@ void CodeGen_Expression(AST_Expression* expr, Scope* scope, Value* oValue, Varia
     }
     // printf("Expr %i, %i, %s; AVT %i, %i, %i\n", expr->type, expr->loc.lineNumber, expr->loc.sourceFile,
     // AnyVariableType.token, AnyVariableType.pointerLevel, AnyVariableType.qualifiers);
-
-    free(expr);
 }
@@ -6,7 +6,22 @@
 #include "../Token.h"
 
 void CodeGen_Expression(AST_Expression* expr, Scope* scope, Value* oValue, VariableType** oType, bool* oReadOnly);
+// Discards an expression without generating code for it. The nodes themselves
+// live in the function arena; this only releases variables last accessed in it.
 void FreeExpressionTree(AST_Expression* expr, Scope* scope);
 void PrintExpressionTree(AST_Expression* expr);
 
-int GetLabelID();
\ No newline at end of file
+int GetLabelID();
+// Next label id, without allocating it
+int PeekLabelID();
+void SetLabelID(int id);
+
+#ifndef CUSTOM_COMP
+typedef struct CG_ExpressionContext CG_ExpressionContext;
+#endif
+#ifdef CUSTOM_COMP
+typedef struct CG_ExpressionContext {} CG_ExpressionContext;
+#endif
+CG_ExpressionContext* CG_Expression_CreateContext();
+void CG_Expression_DisposeContext(CG_ExpressionContext* context);
+void CG_Expression_UseContext(CG_ExpressionContext* context);
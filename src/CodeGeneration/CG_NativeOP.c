@@ -1,9 +1,8 @@
 #include "CG_NativeOP.h"
+#include "../Relocation.h"
 
 const bool isCommutative[14] = {true,  false, true, false, true,  true,  true,
                               false, false, true, true,  false, false, false};
-const char* nativeOpToOpcode[14] = {"add", "sub", "mul",  "and",  "div",  "or",  "xor",
-                                  "shl", "shr", "mulh", "mulq", "invq", "mov", "not"};
 
 typedef enum
 {
@@ -33,6 +32,7 @@ bool IsValidOperation(const Value* dst, const Value* srcA, const Value* srcB)
 
     UsedAddr addr = Addr_None;
     uint16_t usedLiteral = 0;
+    bool literalRelative = false;
 
     const Value* operands[3] = {srcA, srcB, dst};
 
@@ -44,20 +44,24 @@ bool IsValidOperation(const Value* dst, const Value* srcA, const Value* srcB)
         const Value* op = operands[i];
         if (op->addressType == AddressType_Memory)
         {
-            if (usesLiteral && (usedLiteral != (int16_t)op->address))
+            if (usesLiteral && !Relocation_Equal((int32_t)usedLiteral, literalRelative,
+                                                 (int32_t)(int16_t)op->address, op->dataRelative))
                 return false;
             if (addr != Addr_None && addr != Literal)
                 return false;
             usesLiteral = true;
             addr = Literal;
             usedLiteral = (uint16_t)op->address;
+            literalRelative = op->dataRelative;
         }
         else if (op->addressType == AddressType_Literal)
         {
-            if (usesLiteral && usedLiteral != (int16_t)op->address)
+            if (usesLiteral && !Relocation_Equal((int32_t)usedLiteral, literalRelative,
+                                                 (int32_t)(int16_t)op->address, op->dataRelative))
                 return false;
             usesLiteral = true;
             usedLiteral = (uint16_t)op->address;
+            literalRelative = op->dataRelative;
         }
         else if (op->addressType == AddressType_MemoryRegister)
         {
@@ -80,18 +84,21 @@ bool IsValidOperation(const Value* dst, const Value* srcA, const Value* srcB)
             }
             else
             {
-                if (usesLiteral && usedLiteral != delta)
+                if (usesLiteral && !Relocation_Equal((int32_t)usedLiteral, literalRelative, (int32_t)delta, false))
                     return false;
                 if (addr != Addr_None && addr != SPRelative)
                     return false;
                 usesLiteral = true;
                 addr = SPRelative;
                 usedLiteral = (uint16_t)delta;
+                literalRelative = false;
             }
         }
 
         if (((usedLiteral & (~0xFF)) || addr == Literal) && threeOperands)
             return false;
+        if (literalRelative && threeOperands)
+            Relocation_AssumeAtMost((int32_t)usedLiteral, (int32_t)0xFF);
 
         // Can't use SP-relative addressing and the unmodified value of SP at the same time.
         if (addr == SPRelative && ((srcA->addressType == AddressType_Register && ((int)srcA->address) == Register_SP) ||
@@ -105,27 +112,26 @@ void GenerateValidOperation(const Value* dst, const Value* srcA, const Value* sr
 {
     assert(IsValidOperation(dst, srcA, srcB));
 
-    OutWrite(nativeOpToOpcode[op]);
-    OutWrite(" ");
+    // In order of the operands in the instruction, taking [sp++] moves the stack pointer offset
+    IROperand dstOperand = IR_Zero();
+    bool twoOperands = Value_Equals(dst, srcA);
+    if (!twoOperands)
+        dstOperand = Value_ToOperand(dst);
+    IROperand a = Value_ToOperand(srcA);
+    IROperand b = Value_ToOperand(srcB);
+    if (twoOperands)
+        dstOperand = a;
 
-    if (dst->address != srcA->address || dst->addressType != srcA->addressType || dst->size != srcA->size)
-    {
-        PrintValueAsOperand(dst);
-        OutWrite(", ");
-    }
-    PrintValueAsOperand(srcA);
-    OutWrite(", ");
-    PrintValueAsOperand(srcB);
-    OutWrite("\n");
+    IR_Emit3((IROpcode)op, dstOperand, a, b);
 }
 
 void GenerateNativeOP(NativeOP op, Value* oValue, Value left, Value right, bool leftReadOnly, bool rightReadOnly)
 {
     assert(op >= 0 && op <= NativeOP_Not);
 
-    if (left.addressType == AddressType_Literal && left.address == 0)
+    if (left.addressType == AddressType_Literal && Relocation_IsZero(left.address, left.dataRelative))
         left = Value_FromRegister(-1);
-    if (right.addressType == AddressType_Literal && right.address == 0)
+    if (right.addressType == AddressType_Literal && Relocation_IsZero(right.address, right.dataRelative))
         right = Value_FromRegister(-1);
 
     bool usingRequestedOutputValue = false;
@@ -239,7 +245,9 @@ void GenerateNativeOP(NativeOP op, Value* oValue, Value left, Value right, bool
         else if (oValue->addressType == AddressType_Memory)
         {
             temp = Value_Register(1);
-            OutWrite("mov r%i, %i\n", Value_GetR0(&temp), oValue->address);
+            IROperand address = IR_Literal(oValue->address);
+            address.dataRelative = oValue->dataRelative;
+            IR_EmitMove(IR_Mov, IR_Register(Value_GetR0(&temp)), address);
             temp.addressType = AddressType_MemoryRegister;
             temp.size = oValue->size;
             oldOValue = *oValue;
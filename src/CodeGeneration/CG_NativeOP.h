@@ -1,5 +1,5 @@
 #pragma once
-#include "../Outfile.h"
+#include "../IR.h"
 #include "../Value.h"
 
 typedef enum
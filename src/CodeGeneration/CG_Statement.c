@@ -11,9 +11,10 @@
 #include "../Flags.h"
 #include "../Function.h"
 #include "../GenericList.h"
+#include "../IR.h"
 #include "../Optimizer.h"
-#include "../Outfile.h"
 #include "../Register.h"
+#include "../Relocation.h"
 #include "../Scope.h"
 #include "../Stack.h"
 #include "../Token.h"
@@ -33,7 +34,38 @@ typedef struct
     char currentBreakLabel[32];
 } LoopState;
 
-LoopState loopState;
+typedef struct CG_StatementContext
+{
+    LoopState loopState;
+    // See CodeGen_SetVirtualVariables
+    bool virtualVariables;
+} CG_StatementContext;
+
+#ifndef CUSTOM_COMP
+static _Thread_local CG_StatementContext* ctx = NULL;
+#endif
+#ifdef CUSTOM_COMP
+static CG_StatementContext* ctx = NULL;
+#endif
+
+CG_StatementContext* CG_Statement_CreateContext()
+{
+    CG_StatementContext* context = xmalloc(sizeof(CG_StatementContext));
+    memset(context, 0, sizeof(CG_StatementContext));
+    return context;
+}
+
+void CG_Statement_DisposeContext(CG_StatementContext* context)
+{
+    if (ctx == context)
+        ctx = NULL;
+    free(context);
+}
+
+void CG_Statement_UseContext(CG_StatementContext* context)
+{
+    ctx = context;
+}
 
 /*typedef struct
 {
@@ -69,8 +101,8 @@ static void CodeGen_ReturnStatement(AST_Statement_Return* stmt, Scope* scope)
 
         int returnValueSize = SizeInWords(returnType);
 
-        Value outValue =
-            (Value){(int32_t)(Stack_GetSize() + returnValueSize + 1), AddressType_MemoryRelative, returnValueSize};
+        Value outValue = (Value){(int32_t)(Stack_GetSize() + returnValueSize + 1), AddressType_MemoryRelative,
+                                 returnValueSize, false};
 
         VariableType* outType = NULL;
         bool outReadOnly;
@@ -81,8 +113,8 @@ static void CodeGen_ReturnStatement(AST_Statement_Return* stmt, Scope* scope)
 
         Type_RemoveReference(outType);
 
-        Value returnValue =
-            (Value){(int32_t)(Stack_GetSize() + returnValueSize + 1), AddressType_MemoryRelative, returnValueSize};
+        Value returnValue = (Value){(int32_t)(Stack_GetSize() + returnValueSize + 1), AddressType_MemoryRelative,
+                                    returnValueSize, false};
         if (!Value_Equals(&outValue, &returnValue))
             Value_GenerateMemCpy(returnValue, outValue);
 
@@ -91,7 +123,7 @@ static void CodeGen_ReturnStatement(AST_Statement_Return* stmt, Scope* scope)
     }
 
     Stack_ToAddress(Stack_GetSize() + 1);
-    OutWrite("mov ip, [sp]\n");
+    IR_EmitMove(IR_Mov, IR_IP(), IR_Stack(0));
 
     // Reset the stack to was it was before the return
     // otherwise some unreachable instructions that align the stack
@@ -101,21 +133,37 @@ static void CodeGen_ReturnStatement(AST_Statement_Return* stmt, Scope* scope)
     Stack_SetSize(stackSize);
 }
 
+// Drops what a branch left on the stack, like returned structs, so the stack
+// pointer is the same on all paths to the join
+static void LeaveBranch(Scope* scope, int stackSize, int spOffset)
+{
+    int delta = Stack_GetSize() - stackSize;
+    Stack_Offset(delta);
+    ShiftAddressSpace(scope, -delta);
+    Stack_SetSize(stackSize);
+    Stack_ToAddress(-spOffset);
+}
+
 static void CodeGen_IfStatement(AST_Statement_If* stmt, Scope* scope)
 {
     int ifId = GetLabelID();
+    char elseLabel[32];
+    char endLabel[32];
+    sprintf(&elseLabel[0], "else%u", ifId);
+    sprintf(&endLabel[0], "n_else%u", ifId);
+
     Value outValue = FlagValue;
     bool outReadOnly;
     CodeGen_Expression(stmt->cond, scope, &outValue, NULL, &outReadOnly);
 
     if (outValue.addressType == AddressType_Flag)
     {
-        OutWrite("jmp%s else%u\n", Flags_FlagToString(Flags_Invert((Flag)outValue.address)), ifId);
+        IR_EmitJump(Flags_Invert((Flag)outValue.address), &elseLabel[0]);
     }
     else
     {
         Value_ToFlag(&outValue);
-        OutWrite("jmp_z else%u\n", ifId);
+        IR_EmitJump(Flag_Z, &elseLabel[0]);
         //OutWrite("nop\n");
     }
 
@@ -125,35 +173,32 @@ static void CodeGen_IfStatement(AST_Statement_If* stmt, Scope* scope)
     if (!outReadOnly)
         Value_FreeValue(&outValue);
 
+    Scope_SetLive(scope, stmt->liveTrue);
     CodeGen_Statement(stmt->ifTrue, scope);
 
-    // if (Stack_GetSize() != stackSizePostCond)
-    //     ErrorAtLocation("Invalid if-statement body", stmt->loc);
-
-    Stack_ToAddress(-spOffsetPostCond);
+    LeaveBranch(scope, stackSizePostCond, spOffsetPostCond);
 
     if (stmt->ifFalse != NULL)
     {
         // SetCurStackPointerOffset(spOffsetPostCond);
         // SetStackSize(stackSizePostCond);
 
-        OutWrite("jmp n_else%u\n", ifId);
+        IR_EmitJump(Flag_None, &endLabel[0]);
         //OutWrite("nop\n");
-        OutWrite("else%u:\n", ifId);
+        IR_EmitLabel(&elseLabel[0]);
 
+        Scope_SetLive(scope, stmt->liveFalse);
         CodeGen_Statement(stmt->ifFalse, scope);
 
-        // if (Stack_GetSize() != stackSizePostCond)
-        //     ErrorAtLocation("Invalid else body", stmt->loc);
-
-        Stack_ToAddress(-spOffsetPostCond);
-        OutWrite("n_else%u:\n", ifId);
+        LeaveBranch(scope, stackSizePostCond, spOffsetPostCond);
+        IR_EmitLabel(&endLabel[0]);
     }
     else
-        OutWrite("else%u:\n", ifId);
+        IR_EmitLabel(&elseLabel[0]);
 
     Stack_SetOffset(spOffsetPostCond);
     Stack_SetSize(stackSizePostCond);
+    Scope_SetLive(scope, stmt->liveAfter);
 }
 
 static void CodeGen_WhileLoop(AST_Statement_While* stmt, Scope* scope)
@@ -164,97 +209,99 @@ static void CodeGen_WhileLoop(AST_Statement_While* stmt, Scope* scope)
     // We need to keep track of the loops continue/break label name
     // as well as the current stack size for continue/break.
 
-    LoopState oldLoopState = loopState;
+    LoopState oldLoopState = ctx->loopState;
 
-    loopState.currentLoopContinueStackSize = Stack_GetSize();
-    sprintf(&loopState.currentContinueLabel[0], "while_loop%u", whileId);
-    sprintf(&loopState.currentBreakLabel[0], "while_end%u", whileId);
+    ctx->loopState.currentLoopContinueStackSize = Stack_GetSize();
+    sprintf(&ctx->loopState.currentContinueLabel[0], "while_loop%u", whileId);
+    sprintf(&ctx->loopState.currentBreakLabel[0], "while_end%u", whileId);
 
-    OutWrite("while_loop%u:\n", whileId);
+    IR_EmitLabel(&ctx->loopState.currentContinueLabel[0]);
     Value outValue = FlagValue;
     bool outReadOnly;
     CodeGen_Expression(stmt->cond, scope, &outValue, NULL, &outReadOnly);
 
-    if (!(outValue.addressType == AddressType_Literal && outValue.address != 0))
+    if (!(outValue.addressType == AddressType_Literal &&
+          !Relocation_IsZero(outValue.address, outValue.dataRelative)))
     {
         if (outValue.addressType == AddressType_Flag)
         {
-            OutWrite("jmp%s while_end%u\n", Flags_FlagToString(Flags_Invert((Flag)outValue.address)), whileId);
+            IR_EmitJump(Flags_Invert((Flag)outValue.address), &ctx->loopState.currentBreakLabel[0]);
             //OutWrite("nop\n");
         }
         else
         {
             Value_ToFlag(&outValue);
-            OutWrite("jmp_z while_end%u\n", whileId);
+            IR_EmitJump(Flag_Z, &ctx->loopState.currentBreakLabel[0]);
             //OutWrite("nop\n");
         }
     }
 
-    loopState.currentLoopBreakSpOffset = Stack_GetOffset();
-    loopState.currentLoopBreakStackSize = Stack_GetSize();
+    ctx->loopState.currentLoopBreakSpOffset = Stack_GetOffset();
+    ctx->loopState.currentLoopBreakStackSize = Stack_GetSize();
 
     if (!outReadOnly)
         Value_FreeValue(&outValue);
 
     CodeGen_Statement(stmt->body, scope);
 
-    int delta = Stack_GetSize() - loopState.currentLoopContinueStackSize;
+    int delta = Stack_GetSize() - ctx->loopState.currentLoopContinueStackSize;
     Stack_Offset(delta);
     ShiftAddressSpace(scope, -delta);
-    Stack_SetSize(loopState.currentLoopContinueStackSize);
+    Stack_SetSize(ctx->loopState.currentLoopContinueStackSize);
     Stack_Align();
 
-    OutWrite("jmp while_loop%u\n", whileId);
+    IR_EmitJump(Flag_None, &ctx->loopState.currentContinueLabel[0]);
     //OutWrite("nop\n");
-    OutWrite("while_end%u:\n", whileId);
+    IR_EmitLabel(&ctx->loopState.currentBreakLabel[0]);
 
-    Stack_SetOffset(loopState.currentLoopBreakSpOffset);
-    Stack_SetSize(loopState.currentLoopBreakStackSize);
+    Stack_SetOffset(ctx->loopState.currentLoopBreakSpOffset);
+    Stack_SetSize(ctx->loopState.currentLoopBreakStackSize);
 
-    Scope_DeleteVariablesAfterLoop(scope, stmt);
+    Scope_SetLive(scope, stmt->liveAfter);
 
-    loopState = oldLoopState;
+    ctx->loopState = oldLoopState;
 }
 
 static void CodeGen_DoWhileLoop(AST_Statement_Do* stmt, Scope* scope)
 {
     Stack_Align();
     int doId = GetLabelID();
-    LoopState oldLoopState = loopState;
+    LoopState oldLoopState = ctx->loopState;
 
-    sprintf(&loopState.currentContinueLabel[0], "do_loop%u", doId);
-    sprintf(&loopState.currentBreakLabel[0], "do_end%u", doId);
+    sprintf(&ctx->loopState.currentContinueLabel[0], "do_loop%u", doId);
+    sprintf(&ctx->loopState.currentBreakLabel[0], "do_end%u", doId);
 
-    loopState.currentLoopContinueStackSize = Stack_GetSize();
-    OutWrite("do_loop%u:\n", doId);
-    loopState.currentLoopBreakSpOffset = 0;
-    loopState.currentLoopBreakStackSize = loopState.currentLoopContinueStackSize;
+    ctx->loopState.currentLoopContinueStackSize = Stack_GetSize();
+    IR_EmitLabel(&ctx->loopState.currentContinueLabel[0]);
+    ctx->loopState.currentLoopBreakSpOffset = 0;
+    ctx->loopState.currentLoopBreakStackSize = ctx->loopState.currentLoopContinueStackSize;
 
     CodeGen_Statement(stmt->body, scope);
 
     Value outValue = FlagValue;
     bool outReadOnly;
 
-    int delta = Stack_GetSize() - loopState.currentLoopContinueStackSize;
+    int delta = Stack_GetSize() - ctx->loopState.currentLoopContinueStackSize;
     Stack_Offset(delta);
     ShiftAddressSpace(scope, -delta);
-    Stack_SetSize(loopState.currentLoopContinueStackSize);
+    Stack_SetSize(ctx->loopState.currentLoopContinueStackSize);
     Stack_Align();
     CodeGen_Expression(stmt->cond, scope, &outValue, NULL, &outReadOnly);
 
     if (Stack_GetOffset() != 0)
         ErrorAtLocation("Invalid do-while-loop condition", stmt->loc);
 
-    if (!(outValue.addressType == AddressType_Literal && outValue.address != 0))
+    if (!(outValue.addressType == AddressType_Literal &&
+          !Relocation_IsZero(outValue.address, outValue.dataRelative)))
     {
         if (outValue.addressType == AddressType_Flag)
         {
-            OutWrite("jmp%s do_loop%u\n", Flags_FlagToString((Flag)outValue.address), doId);
+            IR_EmitJump((Flag)outValue.address, &ctx->loopState.currentContinueLabel[0]);
         }
         else
         {
             Value_ToFlag(&outValue);
-            OutWrite("jmp_nz do_loop%u\n", doId);
+            IR_EmitJump(Flag_NZ, &ctx->loopState.currentContinueLabel[0]);
         }
     }
 
@@ -262,11 +309,11 @@ static void CodeGen_DoWhileLoop(AST_Statement_Do* stmt, Scope* scope)
         Value_FreeValue(&outValue);
 
     //OutWrite("nop\n");
-    OutWrite("do_end%u:\n", doId);
+    IR_EmitLabel(&ctx->loopState.currentBreakLabel[0]);
 
-    Scope_DeleteVariablesAfterLoop(scope, stmt);
+    Scope_SetLive(scope, stmt->liveAfter);
 
-    loopState = oldLoopState;
+    ctx->loopState = oldLoopState;
 }
 
 static void CodeGen_ForLoop(AST_Statement_For* stmt, Scope* scope)
@@ -282,15 +329,17 @@ static void CodeGen_ForLoop(AST_Statement_For* stmt, Scope* scope)
     CodeGen_Statement(stmt->init, statementVars);
     Stack_Align();
 
-    OutWrite("for_loop%u:\n", forLoopId);
+    char loopLabel[32];
+    sprintf(&loopLabel[0], "for_loop%u", forLoopId);
+    IR_EmitLabel(&loopLabel[0]);
 
     // We need to keep track of the loops continue/break label name
     // as well as the current stack size for continue/break.
-    LoopState oldLoopState = loopState;
+    LoopState oldLoopState = ctx->loopState;
 
-    loopState.currentLoopContinueStackSize = Stack_GetSize();
-    sprintf(&loopState.currentContinueLabel[0], "for_continue%u", forLoopId);
-    sprintf(&loopState.currentBreakLabel[0], "for_break%u", forLoopId);
+    ctx->loopState.currentLoopContinueStackSize = Stack_GetSize();
+    sprintf(&ctx->loopState.currentContinueLabel[0], "for_continue%u", forLoopId);
+    sprintf(&ctx->loopState.currentBreakLabel[0], "for_break%u", forLoopId);
 
     Value outValue = FlagValue;
     bool outReadOnly;
@@ -298,42 +347,44 @@ static void CodeGen_ForLoop(AST_Statement_For* stmt, Scope* scope)
     // AlignStack();
     if (outValue.addressType == AddressType_Flag)
     {
-        OutWrite("jmp%s for_break%u\n", Flags_FlagToString(Flags_Invert((Flag)outValue.address)), forLoopId);
+        IR_EmitJump(Flags_Invert((Flag)outValue.address), &ctx->loopState.currentBreakLabel[0]);
         //OutWrite("nop\n");
     }
     else
     {
         Value_ToFlag(&outValue);
-        OutWrite("jmp_z for_break%u\n", forLoopId);
+        IR_EmitJump(Flag_Z, &ctx->loopState.currentBreakLabel[0]);
         //OutWrite("nop\n");
     }
 
     int spOffsetPostCond = Stack_GetOffset();
     int stackSizePostCond = Stack_GetSize();
+    ctx->loopState.currentLoopBreakSpOffset = spOffsetPostCond;
+    ctx->loopState.currentLoopBreakStackSize = stackSizePostCond;
 
     if (!outReadOnly)
         Value_FreeValue(&outValue);
 
     CodeGen_Statement(stmt->body, statementVars);
 
-    int delta = Stack_GetSize() - loopState.currentLoopContinueStackSize;
+    int delta = Stack_GetSize() - ctx->loopState.currentLoopContinueStackSize;
     Stack_Offset(delta);
     ShiftAddressSpace(scope, -delta);
-    Stack_SetSize(loopState.currentLoopContinueStackSize);
+    Stack_SetSize(ctx->loopState.currentLoopContinueStackSize);
     Stack_Align();
-    OutWrite("for_continue%u:\n", forLoopId);
+    IR_EmitLabel(&ctx->loopState.currentContinueLabel[0]);
 
     CodeGen_Expression(stmt->count, statementVars, NULL, NULL, &outReadOnly);
 
-    delta = Stack_GetSize() - loopState.currentLoopContinueStackSize;
+    delta = Stack_GetSize() - ctx->loopState.currentLoopContinueStackSize;
     Stack_Offset(delta);
     ShiftAddressSpace(scope, -delta);
-    Stack_SetSize(loopState.currentLoopContinueStackSize);
+    Stack_SetSize(ctx->loopState.currentLoopContinueStackSize);
     Stack_Align();
 
-    OutWrite("jmp for_loop%u\n", forLoopId);
+    IR_EmitJump(Flag_None, &loopLabel[0]);
     //OutWrite("nop\n");
-    OutWrite("for_break%u:\n", forLoopId);
+    IR_EmitLabel(&ctx->loopState.currentBreakLabel[0]);
 
     Stack_SetOffset(spOffsetPostCond);
     Stack_SetSize(stackSizePostCond);
@@ -343,11 +394,10 @@ static void CodeGen_ForLoop(AST_Statement_For* stmt, Scope* scope)
     ShiftAddressSpace(scope, -delta);
     Stack_SetSize(oldStackSize);
     Scope_Dispose(statementVars);
-    free(statementVars);
 
-    Scope_DeleteVariablesAfterLoop(scope, stmt);
+    Scope_SetLive(scope, stmt->liveAfter);
 
-    loopState = oldLoopState;
+    ctx->loopState = oldLoopState;
 }
 
 static void CodeGen_Scope(AST_Statement_Scope* stmt, Scope* scope)
@@ -373,8 +423,6 @@ static void CodeGen_Scope(AST_Statement_Scope* stmt, Scope* scope)
     assert((~usedRegisters & Registers_GetUsed()) == 0);
 
     Registers_SetPreferred(&scope->preferredRegisters[0]);
-    free(stmt->scope);
-    free(stmt->statements);
 }
 
 static int CompareUInt16(const void* a, const void* b)
@@ -389,14 +437,29 @@ static int CompareUInt16(const void* a, const void* b)
     return -1;
 }
 
+// Moves the stack pointer back to where it was when the switch started, for code that
+// continues at one of its labels
+static void RestoreBreakStack()
+{
+    int delta = Stack_GetSize() - ctx->loopState.currentLoopBreakStackSize;
+    int n = Stack_GetOffset() + delta - ctx->loopState.currentLoopBreakSpOffset;
+    if (n > 0)
+        IR_Emit2(IR_Sub, IR_SP(), IR_Literal((int32_t)n));
+    else if (n < 0)
+        IR_Emit2(IR_Add, IR_SP(), IR_Literal((int32_t)(-n)));
+
+    Stack_SetOffset(ctx->loopState.currentLoopBreakSpOffset);
+    Stack_SetSize(ctx->loopState.currentLoopBreakStackSize);
+}
+
 static void CodeGen_SwitchCase(AST_Statement_Switch* stmt, Scope* scope)
 {
 
     int switchId = GetLabelID();
 
-    LoopState oldLoopState = loopState;
-    sprintf(&loopState.currentBreakLabel[0], "switch_%u_break", switchId);
-    memcpy(&loopState.currentContinueLabel[0], &oldLoopState.currentContinueLabel[0], 32);
+    LoopState oldLoopState = ctx->loopState;
+    sprintf(&ctx->loopState.currentBreakLabel[0], "switch_%u_break", switchId);
+    memcpy(&ctx->loopState.currentContinueLabel[0], &oldLoopState.currentContinueLabel[0], 32);
 
     Value outValue = NullValue;
     bool outReadOnly;
@@ -416,11 +479,15 @@ static void CodeGen_SwitchCase(AST_Statement_Switch* stmt, Scope* scope)
     }
 
     // AlignStack();
-    loopState.currentLoopBreakStackSize = Stack_GetSize();
-    loopState.currentLoopBreakSpOffset = Stack_GetOffset();
+    ctx->loopState.currentLoopBreakStackSize = Stack_GetSize();
+    ctx->loopState.currentLoopBreakSpOffset = Stack_GetOffset();
 
     AST_Statement_Switch_SwitchCase* listCases = stmt->cases;
 
+    char defaultLabel[32];
+    char caseLabel[32];
+    sprintf(&defaultLabel[0], "switch_%u_default", switchId);
+
     if (stmt->numCases > 0)
     {
         uint16_t* labelsList = xmalloc(sizeof(uint16_t) * stmt->numCases);
@@ -434,27 +501,30 @@ static void CodeGen_SwitchCase(AST_Statement_Switch* stmt, Scope* scope)
         uint16_t lowestId = labelsList[0];
 
         // Lower bounds check
-        OutWrite("sub r%i, %i\n", Value_GetR0(&outValue), lowestId);
-        OutWrite("jmp_s switch_%u_default\n", switchId);
+        IROperand selector = IR_Register(Value_GetR0(&outValue));
+        IR_Emit2(IR_Sub, selector, IR_Literal((int32_t)lowestId));
+        IR_EmitJump(Flag_S, &defaultLabel[0]);
 
         // Upper bounds check
-        OutWrite("sub rz, %i, r%i\n", labelsList[stmt->numCases - 1] - lowestId, Value_GetR0(&outValue));
-        OutWrite("jmp_s switch_%u_default\n", switchId);
+        IR_Emit3(IR_Sub, IR_Zero(), IR_Literal((int32_t)(labelsList[stmt->numCases - 1] - lowestId)), selector);
+        IR_EmitJump(Flag_S, &defaultLabel[0]);
 
-        OutWrite("add r%i, 1\n", Value_GetR0(&outValue));
-        OutWrite("add ip, r%i\n", Value_GetR0(&outValue));
+        // The jump table, one jump instruction per entry
+        IR_Emit2(IR_Add, selector, IR_Literal((int32_t)1));
+        IR_Emit2(IR_Add, IR_IP(), selector);
         if (!outReadOnly)
             Value_FreeValue(&outValue);
-        OutWrite("jmp switch_%u_default\n", switchId);
+        IR_EmitJump(Flag_None, &defaultLabel[0]);
 
         int lastIndex = lowestId - 1;
         for (size_t j = 0; j < stmt->numCases; j++)
         {
             int delta = (labelsList[j] - lastIndex) - 1;
             while (delta--)
-                OutWrite("jmp switch_%u_default\n", switchId);
+                IR_EmitJump(Flag_None, &defaultLabel[0]);
 
-            OutWrite("jmp switch_%u_case_%u\n", switchId, labelsList[j]);
+            sprintf(&caseLabel[0], "switch_%u_case_%u", switchId, labelsList[j]);
+            IR_EmitJump(Flag_None, &caseLabel[0]);
             lastIndex = labelsList[j];
         }
 
@@ -463,10 +533,12 @@ static void CodeGen_SwitchCase(AST_Statement_Switch* stmt, Scope* scope)
 
         for (size_t j = 0; j < stmt->numCases; j++)
         {
-            Stack_SetOffset(loopState.currentLoopBreakSpOffset);
-            Stack_SetSize(loopState.currentLoopBreakStackSize);
+            // The previous case falls through to this one
+            RestoreBreakStack();
 
-            OutWrite("switch_%u_case_%u:\n", switchId, listCases[j].id);
+            sprintf(&caseLabel[0], "switch_%u_case_%u", switchId, listCases[j].id);
+            IR_EmitLabel(&caseLabel[0]);
+            Scope_SetLive(scope, listCases[j].live);
 
             AST_Statement** stmts = listCases[j].statements;
             size_t len = listCases[j].numStatements;
@@ -474,13 +546,11 @@ static void CodeGen_SwitchCase(AST_Statement_Switch* stmt, Scope* scope)
             {
                 CodeGen_Statement(stmts[k], scope);
             }
-            free(stmts);
         }
 
-        Stack_SetOffset(loopState.currentLoopBreakSpOffset);
-        Stack_SetSize(loopState.currentLoopBreakStackSize);
-
-        OutWrite("switch_%u_default:\n", switchId);
+        RestoreBreakStack();
+        IR_EmitLabel(&defaultLabel[0]);
+        Scope_SetLive(scope, stmt->liveDefault);
         if (stmt->defaultCaseStmts != NULL)
         {
             for (size_t j = 0; j < stmt->numStmtsDefCase; j++)
@@ -489,28 +559,47 @@ static void CodeGen_SwitchCase(AST_Statement_Switch* stmt, Scope* scope)
         free(labelsList);
     }
 
-    free(stmt->cases);
-    if (stmt->defaultCaseStmts != NULL)
-        free(stmt->defaultCaseStmts);
-
     // Implicit break at the end of the switch:
-    int delta = Stack_GetSize() - loopState.currentLoopBreakStackSize;
-    int n = Stack_GetOffset() + delta - loopState.currentLoopBreakSpOffset;
-    if (n > 0)
-        OutWrite("sub sp, %i\n", n);
-    else if (n < 0)
-        OutWrite("add sp, %i\n", -n);
-
-    Stack_SetOffset(loopState.currentLoopBreakSpOffset);
-    Stack_SetSize(loopState.currentLoopBreakStackSize);
-    OutWrite("switch_%u_break:\n", switchId);
+    RestoreBreakStack();
+    IR_EmitLabel(&ctx->loopState.currentBreakLabel[0]);
 
-    Scope_DeleteVariablesAfterLoop(scope, stmt);
-    loopState = oldLoopState;
+    Scope_SetLive(scope, stmt->liveAfter);
+    ctx->loopState = oldLoopState;
 
     return;
 }
 
+void CodeGen_SetVirtualVariables(bool enabled)
+{
+    ctx->virtualVariables = enabled;
+}
+
+// Register for a variable of the given size
+static Value VariableRegister(int size)
+{
+    if (!ctx->virtualVariables)
+        return Value_Register(size);
+    if (size == 1)
+        return Value_FromRegister(Registers_GetVirtual());
+    int r0 = Registers_GetVirtual();
+    return Value_FromRegisters(r0, Registers_GetVirtual());
+}
+
+void CodeGen_Parameters(Scope* scope)
+{
+    if (!ctx->virtualVariables)
+        return;
+    for (size_t i = 0; i < scope->variables.count; i++)
+    {
+        Variable* param = GenericList_At(&scope->variables, i);
+        if (!IsPrimitiveType(param->type) || (param->type->qualifiers & Qualifier_Stack))
+            continue;
+        Value val = VariableRegister(SizeInWords(param->type));
+        Value_GenerateMemCpy(val, param->value);
+        param->value = val;
+    }
+}
+
 static void CodeGen_Declaration(AST_Statement_Declaration* stmt, Scope* scope)
 {
 
@@ -518,20 +607,15 @@ static void CodeGen_Declaration(AST_Statement_Declaration* stmt, Scope* scope)
     int size = SizeInWords(type);
     Variable v;
 
-    v = (Variable){type, stmt->variableName, {(int32_t)0, AddressType_Register, size}, stmt->lastAccess};
+    v = (Variable){type, stmt->variableName, {(int32_t)0, AddressType_Register, size, false}, stmt->liveIndex, false};
 
     // Normal variable
     if (IsPrimitiveType(type))
     {
-        // The CPU has 8 registers, we keep a few for temporary values,
-        // the rest can be used for variables.
-        bool storeInRegister =
-            (Registers_GetNumUsed() + size <= 5) && (v.type->qualifiers & Qualifier_OptimizerRegister);
-
-        // If the register qualifier was explicitly specified, we assume the user knows
-        // what they're doing and decrease the number of registers kept free for temp values.
-        if (Registers_GetNumPreferred() - 1 >= size && (Qualifier_Register & v.type->qualifiers))
-            storeInRegister = true;
+        // Where the allocator runs on the function, it decides which variables stay in machine registers.
+        // Otherwise only those declared register are put in registers, if there are enough to spare.
+        bool storeInRegister = ctx->virtualVariables ||
+                               (Registers_GetNumPreferred() - 1 >= size && (Qualifier_Register & v.type->qualifiers));
 
         // If the address of the value is ever taken, it is always put on the stack.
         if ((v.type->qualifiers & Qualifier_Stack))
@@ -557,7 +641,7 @@ static void CodeGen_Declaration(AST_Statement_Declaration* stmt, Scope* scope)
             {
                 if (storeInRegister)
                 {
-                    val = Value_Register(size);
+                    val = VariableRegister(size);
                     Value_GenerateMemCpy(val, outValue);
                 }
                 else
@@ -573,11 +657,11 @@ static void CodeGen_Declaration(AST_Statement_Declaration* stmt, Scope* scope)
             {
                 if (storeInRegister)
                 {
-                    if (outValue.addressType == AddressType_Register)
+                    if (outValue.addressType == AddressType_Register && !ctx->virtualVariables)
                         val = outValue;
                     else
                     {
-                        val = Value_Register(size);
+                        val = VariableRegister(size);
                         Value_GenerateMemCpy(val, outValue);
                         Value_FreeValue(&outValue);
                     }
@@ -599,7 +683,7 @@ static void CodeGen_Declaration(AST_Statement_Declaration* stmt, Scope* scope)
                 // In case this variable is 32 bit, but the result of the expression
                 // is only 16 bit
                 if (outValueSize == 1 && size == 2)
-                    OutWrite("mov r%i, 0\n", Value_GetR1(&val));
+                    IR_EmitMove(IR_Mov, IR_Register(Value_GetR1(&val)), IR_Literal((int32_t)0));
             }
         }
         else
@@ -607,7 +691,7 @@ static void CodeGen_Declaration(AST_Statement_Declaration* stmt, Scope* scope)
             if (!storeInRegister)
                 val = GetValueOnStack(size, scope);
             else
-                val = Value_Register(size);
+                val = VariableRegister(size);
         }
 
         v.value = val;
@@ -663,52 +747,52 @@ static void CodeGen_Declaration(AST_Statement_Declaration* stmt, Scope* scope)
         v.value = val;
     }
 
-    if (v.lastAccess == NULL)
+    // Never used after the declaration
+    if (!stmt->isLive)
     {
         Value_FreeValue(&v.value);
-        Type_RemoveReference(type);
+        v.released = true;
     }
-    else
-        Scope_AddVariable(scope, v);
+    Scope_AddVariable(scope, v);
 }
 
 static void CodeGen_Break(AST_Statement* stmt)
 {
-    if (loopState.currentBreakLabel[0] == 0)
+    if (ctx->loopState.currentBreakLabel[0] == 0)
         ErrorAtLocation("Invalid break", stmt->loc);
 
-    int delta = Stack_GetSize() - loopState.currentLoopBreakStackSize;
-    int n = Stack_GetOffset() + delta - loopState.currentLoopBreakSpOffset;
+    int delta = Stack_GetSize() - ctx->loopState.currentLoopBreakStackSize;
+    int n = Stack_GetOffset() + delta - ctx->loopState.currentLoopBreakSpOffset;
 
     if (n > 0)
-        OutWrite("sub sp, %i\n", n);
+        IR_Emit2(IR_Sub, IR_SP(), IR_Literal((int32_t)n));
     else if (n < 0)
-        OutWrite("add sp, %i\n", -n);
+        IR_Emit2(IR_Add, IR_SP(), IR_Literal((int32_t)(-n)));
 
-    OutWrite("jmp %s\n", loopState.currentBreakLabel);
+    IR_EmitJump(Flag_None, &ctx->loopState.currentBreakLabel[0]);
 }
 
 static void CodeGen_Continue(AST_Statement* stmt)
 {
-    if (loopState.currentContinueLabel[0] == 0)
+    if (ctx->loopState.currentContinueLabel[0] == 0)
         ErrorAtLocation("Invalid continue", stmt->loc);
 
-    int delta = Stack_GetSize() - loopState.currentLoopContinueStackSize;
+    int delta = Stack_GetSize() - ctx->loopState.currentLoopContinueStackSize;
     int n = Stack_GetOffset() + delta;
 
     if (n > 0)
-        OutWrite("sub sp, %i\n", n);
+        IR_Emit2(IR_Sub, IR_SP(), IR_Literal((int32_t)n));
     if (n < 0)
-        OutWrite("add sp, %i\n", -n);
+        IR_Emit2(IR_Add, IR_SP(), IR_Literal((int32_t)(-n)));
 
-    OutWrite("jmp %s\n", &loopState.currentContinueLabel);
+    IR_EmitJump(Flag_None, &ctx->loopState.currentContinueLabel[0]);
 }
 
 void CodeGen_InlineAssembly(AST_Statement_ASM* stmt, Scope* scope)
 {
     Stack_Align();
-    OutWrite("%s\n", stmt->code);
-    Scope_DeleteVariablesAfterLoop(scope, stmt);
+    IR_EmitAsm(stmt->code);
+    Scope_SetLive(scope, stmt->liveAfter);
 }
 
 void CodeGen_Statement(AST_Statement* stmt, Scope* scope)
@@ -756,6 +840,4 @@ void CodeGen_Statement(AST_Statement* stmt, Scope* scope)
         default:
             assert(0);
     }
-
-    free(stmt);
 }
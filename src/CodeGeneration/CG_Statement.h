@@ -5,4 +5,20 @@
 #include "../Variables.h"
 
 void CompileStatement(TokenArray* t, size_t* i, Scope* scope);
-void CodeGen_Statement(AST_Statement* stmt, Scope* scope);
\ No newline at end of file
+void CodeGen_Statement(AST_Statement* stmt, Scope* scope);
+// Whether the variables of the function that is generated next are put in virtual registers,
+// for the allocator (Allocator.h) to decide which of them stay in machine registers.
+void CodeGen_SetVirtualVariables(bool enabled);
+// Moves the parameters of the function, which are the variables of scope, to registers
+// like other variables
+void CodeGen_Parameters(Scope* scope);
+
+#ifndef CUSTOM_COMP
+typedef struct CG_StatementContext CG_StatementContext;
+#endif
+#ifdef CUSTOM_COMP
+typedef struct CG_StatementContext {} CG_StatementContext;
+#endif
+CG_StatementContext* CG_Statement_CreateContext();
+void CG_Statement_DisposeContext(CG_StatementContext* context);
+void CG_Statement_UseContext(CG_StatementContext* context);
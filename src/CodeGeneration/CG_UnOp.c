@@ -2,6 +2,7 @@
 #include "../AST.h"
 #include "../Outfile.h"
 #include "../Register.h"
+#include "../Relocation.h"
 #include "../Stack.h"
 #include "../Token.h"
 #include "../Type.h"
@@ -341,7 +342,11 @@ void CodeGen_ExpressionUnaryOperator(AST_Expression_UnOp* expr, Scope* scope, Va
         {
             oValue->addressType = AddressType_Literal;
             oValue->size = in.size;
+            oValue->dataRelative = false;
             *oReadOnly = true;
+            // The result doesn't move along with an address
+            if (in.dataRelative)
+                Relocation_AssumeFixed();
 
             switch (expr->op)
             {
@@ -1,22 +1,37 @@
 #include "Compiler.h"
 #include "AST.h"
+#include "Arena.h"
+#include "Backend.h"
 #include "CodeGeneration/CG_Expression.h"
 #include "CodeGeneration/CG_Statement.h"
 #include "Data.h"
 #include "Error.h"
+#include "Flags.h"
 #include "Function.h"
 #include "GenericList.h"
+#include "IR.h"
+#include "IncludeCache.h"
+#include "Intern.h"
+#include "Lexer.h"
+#include "Liveness.h"
 #include "Optimizer.h"
 #include "Outfile.h"
+#include "PCH.h"
+#include "Parallel.h"
 #include "Parser/P_Expression.h"
 #include "Parser/P_Statement.h"
 #include "Parser/P_Type.h"
+#include "Passes.h"
+#include "Peephole.h"
+#include "Preprocessor.h"
 #include "Register.h"
+#include "Relocation.h"
 #include "Scope.h"
 #include "Stack.h"
 #include "Struct.h"
 #include "Token.h"
 #include "Type.h"
+#include "Util.h"
 #include "Value.h"
 #include "Variables.h"
 //#include "Graphviz_AST.h"
@@ -25,6 +40,350 @@
 #include <stdlib.h>
 #include <string.h>
 
+// A function body that was parsed, but not generated yet
+typedef struct
+{
+    size_t functionIndex;
+    // Functions declared after the body are invisible to it
+    size_t numVisibleFunctions;
+    uint16_t modifiedRegisters;
+    Scope* scope;
+    GenericList statements;
+    // Where the definition starts, for errors that are found while generating its code
+    SourceLocation loc;
+    // Of the definition, to balance the work of the workers
+    size_t numTokens;
+    bool hasInlineASM;
+} PendingFunction;
+
+typedef struct CompilerContext
+{
+    // Backs the AST and optimizer state of the items currently being compiled.
+    // Released in one go once no function body is waiting for code generation.
+    Arena functionArena;
+    const char* pchOutput;
+    bool generatedHeader;
+    int numWorkers;
+    int optimizationLevel;
+    // Firing counts of the peephole rules, NULL unless they are reported
+    size_t* peepholeCounts;
+    GenericList pendingFunctions;
+    size_t pendingTokens;
+
+    ASTContext* ast;
+    CG_ExpressionContext* expression;
+    CG_StatementContext* statement;
+    DataContext* data;
+    FlagsContext* flags;
+    FunctionContext* function;
+    IRContext* ir;
+    IncludeCacheContext* includeCache;
+    InternContext* intern;
+    LexerContext* lexer;
+    OptimizerContext* optimizer;
+    OutfileContext* outfile;
+    PCHContext* pch;
+    PreprocessorContext* preprocessor;
+    RegisterContext* registers;
+    StackContext* stack;
+    TokenContext* token;
+} CompilerContext;
+
+#ifndef CUSTOM_COMP
+static _Thread_local CompilerContext* ctx = NULL;
+#endif
+#ifdef CUSTOM_COMP
+static CompilerContext* ctx = NULL;
+#endif
+
+CompilerContext* Compiler_CreateContext()
+{
+    CompilerContext* context = xmalloc(sizeof(CompilerContext));
+    memset(context, 0, sizeof(CompilerContext));
+    context->numWorkers = 1;
+    context->optimizationLevel = 1;
+    context->pendingFunctions = GenericList_Create(sizeof(PendingFunction));
+    context->ast = AST_CreateContext();
+    context->expression = CG_Expression_CreateContext();
+    context->statement = CG_Statement_CreateContext();
+    context->data = Data_CreateContext();
+    context->flags = Flags_CreateContext();
+    context->function = Function_CreateContext();
+    context->ir = IR_CreateContext();
+    context->includeCache = IncludeCache_CreateContext();
+    context->intern = Intern_CreateContext();
+    context->lexer = Lexer_CreateContext();
+    context->optimizer = Optimizer_CreateContext();
+    context->outfile = Outfile_CreateContext();
+    context->pch = PCH_CreateContext();
+    context->preprocessor = Preprocessor_CreateContext();
+    context->registers = Registers_CreateContext();
+    context->stack = Stack_CreateContext();
+    context->token = Token_CreateContext();
+    return context;
+}
+
+static void DiscardPendingFunctions(CompilerContext* context)
+{
+    for (size_t i = 0; i < context->pendingFunctions.count; i++)
+    {
+        PendingFunction* pending = GenericList_At(&context->pendingFunctions, i);
+        GenericList_Dispose(&pending->statements);
+        free(pending->scope);
+    }
+    GenericList_Dispose(&context->pendingFunctions);
+    context->pendingFunctions = GenericList_Create(sizeof(PendingFunction));
+    context->pendingTokens = 0;
+}
+
+void Compiler_DisposeContext(CompilerContext* context)
+{
+    DiscardPendingFunctions(context);
+    GenericList_Dispose(&context->pendingFunctions);
+    AST_DisposeContext(context->ast);
+    CG_Expression_DisposeContext(context->expression);
+    CG_Statement_DisposeContext(context->statement);
+    Data_DisposeContext(context->data);
+    Flags_DisposeContext(context->flags);
+    Function_DisposeContext(context->function);
+    IR_DisposeContext(context->ir);
+    IncludeCache_DisposeContext(context->includeCache);
+    Intern_DisposeContext(context->intern);
+    Lexer_DisposeContext(context->lexer);
+    Optimizer_DisposeContext(context->optimizer);
+    Outfile_DisposeContext(context->outfile);
+    PCH_DisposeContext(context->pch);
+    Preprocessor_DisposeContext(context->preprocessor);
+    Registers_DisposeContext(context->registers);
+    Stack_DisposeContext(context->stack);
+    Token_DisposeContext(context->token);
+    free(context->peepholeCounts);
+    if (ctx == context)
+        ctx = NULL;
+    free(context);
+}
+
+void Compiler_ResetContext()
+{
+    IncludeCache_AbortRecordings();
+
+    DiscardPendingFunctions(ctx);
+    Arena_Dispose(&ctx->functionArena);
+    ctx->pchOutput = NULL;
+    ctx->generatedHeader = false;
+
+    AST_DisposeContext(ctx->ast);
+    CG_Expression_DisposeContext(ctx->expression);
+    CG_Statement_DisposeContext(ctx->statement);
+    Data_DisposeContext(ctx->data);
+    Flags_DisposeContext(ctx->flags);
+    Function_DisposeContext(ctx->function);
+    IR_DisposeContext(ctx->ir);
+    Lexer_DisposeContext(ctx->lexer);
+    Optimizer_DisposeContext(ctx->optimizer);
+    Outfile_DisposeContext(ctx->outfile);
+    PCH_DisposeContext(ctx->pch);
+    Preprocessor_DisposeContext(ctx->preprocessor);
+    Registers_DisposeContext(ctx->registers);
+    Stack_DisposeContext(ctx->stack);
+    Token_DisposeContext(ctx->token);
+
+    ctx->ast = AST_CreateContext();
+    ctx->expression = CG_Expression_CreateContext();
+    ctx->statement = CG_Statement_CreateContext();
+    ctx->data = Data_CreateContext();
+    ctx->flags = Flags_CreateContext();
+    ctx->function = Function_CreateContext();
+    ctx->ir = IR_CreateContext();
+    ctx->lexer = Lexer_CreateContext();
+    ctx->optimizer = Optimizer_CreateContext();
+    ctx->outfile = Outfile_CreateContext();
+    ctx->pch = PCH_CreateContext();
+    ctx->preprocessor = Preprocessor_CreateContext();
+    ctx->registers = Registers_CreateContext();
+    ctx->stack = Stack_CreateContext();
+    ctx->token = Token_CreateContext();
+    Compiler_UseContext(ctx);
+}
+
+void Compiler_UseContext(CompilerContext* context)
+{
+    ctx = context;
+    AST_UseContext(context->ast);
+    CG_Expression_UseContext(context->expression);
+    CG_Statement_UseContext(context->statement);
+    Data_UseContext(context->data);
+    Flags_UseContext(context->flags);
+    Function_UseContext(context->function);
+    IR_UseContext(context->ir);
+    IncludeCache_UseContext(context->includeCache);
+    Intern_UseContext(context->intern);
+    Lexer_UseContext(context->lexer);
+    Optimizer_UseContext(context->optimizer);
+    Outfile_UseContext(context->outfile);
+    PCH_UseContext(context->pch);
+    Preprocessor_UseContext(context->preprocessor);
+    Registers_UseContext(context->registers);
+    Stack_UseContext(context->stack);
+    Token_UseContext(context->token);
+}
+
+void Compiler_SetPCHOutput(const char* path)
+{
+    ctx->pchOutput = path;
+}
+
+void Compiler_SetNumWorkers(int numWorkers)
+{
+    ctx->numWorkers = numWorkers;
+}
+
+void Compiler_SetOptimizationLevel(int level)
+{
+    ctx->optimizationLevel = level;
+}
+
+void Compiler_SetPeepholeReport(bool enabled)
+{
+    free(ctx->peepholeCounts);
+    ctx->peepholeCounts = NULL;
+    if (enabled)
+    {
+        ctx->peepholeCounts = xmalloc(PeepholeRule_Count * sizeof(size_t));
+        memset(ctx->peepholeCounts, 0, PeepholeRule_Count * sizeof(size_t));
+    }
+}
+
+void Compiler_PrintPeepholeReport()
+{
+    if (ctx->peepholeCounts == NULL)
+        return;
+    for (int rule = 0; rule < PeepholeRule_Count; rule++)
+        printf("%s: %zu\n", Peephole_RuleName((PeepholeRule)rule), ctx->peepholeCounts[rule]);
+}
+
+void Compiler_TakePeepholeCounts(size_t* counts)
+{
+    memset(counts, 0, PeepholeRule_Count * sizeof(size_t));
+    if (ctx->peepholeCounts == NULL)
+        return;
+    memcpy(counts, ctx->peepholeCounts, PeepholeRule_Count * sizeof(size_t));
+    memset(ctx->peepholeCounts, 0, PeepholeRule_Count * sizeof(size_t));
+}
+
+void Compiler_AddPeepholeCounts(const size_t* counts)
+{
+    if (ctx->peepholeCounts == NULL)
+        return;
+    for (int rule = 0; rule < PeepholeRule_Count; rule++)
+        ctx->peepholeCounts[rule] += counts[rule];
+}
+
+// Batches smaller than this are generated in process, handing them to the workers costs more
+static const size_t MIN_PARALLEL_TOKENS = 4096;
+// Bodies are generated once this many tokens are waiting, so the AST doesn't pile up
+static const size_t MAX_PENDING_TOKENS = 32768;
+
+static uint32_t GenerateFunction(size_t index)
+{
+    PendingFunction* pending = GenericList_At(&ctx->pendingFunctions, index);
+    Function* function = Function_At(pending->functionIndex);
+
+    // A worker may have generated other bodies before, which must not show
+    function->modifiedRegisters = pending->modifiedRegisters;
+    Function_SetCurrent(function);
+    Function_LimitVisible(pending->numVisibleFunctions);
+    Registers_SetPreferred(&pending->scope->preferredRegisters[0]);
+    // The allocator places the variables where it runs on the code
+    CodeGen_SetVirtualVariables(ctx->optimizationLevel >= 1 && !pending->hasInlineASM);
+
+    // Part of code generation, so workers can share it
+    Liveness_Run(&pending->statements);
+    IR_BeginFunction(function->identifier);
+    CodeGen_Parameters(pending->scope);
+    for (size_t j = 0; j < pending->statements.count; j++)
+    {
+        CodeGen_Statement(*((AST_Statement**)GenericList_At(&pending->statements, j)), pending->scope);
+    }
+
+    Function_SetCurrent(NULL);
+    Function_LimitVisible(SIZE_MAX);
+
+    if (function->returnType->token == VoidKeyword)
+    {
+        Stack_ToAddress(Stack_GetSize() + 1);
+        IR_EmitMove(IR_Mov, IR_IP(), IR_Stack(0));
+    }
+    IRFunction* code = IR_EndFunction();
+    if (!Passes_Run(code, ctx->optimizationLevel))
+        ErrorAtLocation("Out of registers", pending->loc);
+    // Virtual registers may have ended up in any register during code generation
+    if (!IR_DependsOnAddresses(code))
+        function->modifiedRegisters = IR_ModifiedRegisters(code);
+    if (ctx->optimizationLevel >= 1)
+        Peephole_Run(code, ctx->peepholeCounts);
+    Backend_PrintFunction(code);
+
+    // All function variables are now out of scope
+    Registers_FreeAll();
+
+    Stack_SetSize(0);
+    Stack_SetOffset(0);
+    return (uint32_t)function->modifiedRegisters;
+}
+
+// Generates code for all function bodies that are waiting for it, in source order.
+static void GeneratePendingFunctions()
+{
+    size_t count = ctx->pendingFunctions.count;
+    if (count == 0)
+        return;
+
+    // Might be in the middle of parsing another body
+    Function* current = Function_GetCurrent();
+
+    uint32_t* modifiedRegisters = xmalloc(count * sizeof(uint32_t));
+    if (ctx->numWorkers > 1 && count > 1 && ctx->pendingTokens >= MIN_PARALLEL_TOKENS)
+    {
+        // Started once per file, they parse along with this process from here on
+        if (!Parallel_HasFollowers())
+            Parallel_StartFollowers(ctx->numWorkers);
+        size_t* weights = xmalloc(count * sizeof(size_t));
+        for (size_t i = 0; i < count; i++)
+            weights[i] = ((PendingFunction*)GenericList_At(&ctx->pendingFunctions, i))->numTokens;
+        Parallel_CompileOnFollowers(count, weights, GenerateFunction, modifiedRegisters);
+        free(weights);
+    }
+    else
+    {
+        for (size_t i = 0; i < count; i++)
+            modifiedRegisters[i] = GenerateFunction(i);
+    }
+    Function_SetCurrent(current);
+
+    for (size_t i = 0; i < count; i++)
+    {
+        PendingFunction* pending = GenericList_At(&ctx->pendingFunctions, i);
+        Function_At(pending->functionIndex)->modifiedRegisters = (uint16_t)modifiedRegisters[i];
+        Scope_Dispose(pending->scope);
+    }
+    free(modifiedRegisters);
+    DiscardPendingFunctions(ctx);
+}
+
+void Compiler_FinishFunction(Function* function)
+{
+    for (size_t i = 0; i < ctx->pendingFunctions.count; i++)
+    {
+        PendingFunction* pending = GenericList_At(&ctx->pendingFunctions, i);
+        if (Function_At(pending->functionIndex) == function)
+        {
+            GeneratePendingFunctions();
+            return;
+        }
+    }
+}
+
 static bool CompileGlobalVariable(TokenArray* t, size_t* i, Scope* globalScope)
 {
     // Declaration (and Assignment)
@@ -45,8 +404,12 @@ static bool CompileGlobalVariable(TokenArray* t, size_t* i, Scope* globalScope)
             return false;
         }
 
+        // Takes up global data after that of the waiting bodies
+        GeneratePendingFunctions();
+
         int size = SizeInWords(type);
-        Variable v = {type, id, (Value){(int32_t)GetGlobalDataIndex(), AddressType_Memory, size}, NULL};
+        Value value = {(int32_t)GetGlobalDataIndex(), AddressType_Memory, size, Relocation_IsRecording()};
+        Variable v = {type, id, value, -1, false};
 
         if (t->tokens[(*i)].type == Assignment)
         {
@@ -64,21 +427,28 @@ static bool CompileGlobalVariable(TokenArray* t, size_t* i, Scope* globalScope)
 
             VariableType* outType;
             bool outReadOnly;
+            IR_BeginFunction(id);
             CodeGen_Expression(outExpr, globalScope, &v.value, &outType, &outReadOnly);
+            bool generatedCode = IR_EndFunction()->instructions.count != 0;
 
             // if(!VariableTypeCheck(outType, type))
             //     ErrorAtIndex("Invalid type", oldI);
 
             Type_RemoveReference(outType);
+            Arena_Reset(&ctx->functionArena);
 
             if (size != -1 && v.value.size != size) ErrorAtIndex("Invalid size", oldI);
 
-            if (v.value.addressType != AddressType_Literal && v.value.addressType != AddressType_Memory)
+            if (generatedCode ||
+                (v.value.addressType != AddressType_Literal && v.value.addressType != AddressType_Memory))
                 ErrorAtIndex("Global variable must be compile-time constant", oldI);
 
             if (v.value.addressType == AddressType_Literal && !(type->qualifiers & Qualifier_Const))
             {
                 v.value.addressType = AddressType_Memory;
+                if (v.value.dataRelative)
+                    Relocation_AddDataWord();
+                v.value.dataRelative = Relocation_IsRecording();
                 if (size == 1)
                     v.value.address = (int32_t)AllocateGlobalWord((uint16_t)v.value.address);
                 else if (size == 2)
@@ -100,9 +470,10 @@ static bool CompileGlobalVariable(TokenArray* t, size_t* i, Scope* globalScope)
             v.value.address = (int32_t)AllocateGlobalValue(size);
             v.value.size = size;
             v.value.addressType = AddressType_Memory;
+            v.value.dataRelative = Relocation_IsRecording();
         }
 
-        Inc(i);
+        (*i)++;
 
         if (Scope_NameIsUsed(globalScope, id)) ErrorAtIndex("Identifier already used!", *i);
 
@@ -128,12 +499,13 @@ bool CompileTypedef(TokenArray* t, size_t* i, Scope* scope)
         return false;
     }
 
-    const char* id = t->tokens[*i].data;
+    const char* id = Token_GetData(&t->tokens[*i]);
     
     Typedef* old;
     if ((old = Scope_FindTypedef(scope, (char*)id)))
     {
         // FIXME: this should only work if old is an incomplete type AND only with typedefs in current scope
+        GeneratePendingFunctions();
         Type_RemoveReference(old->type);
         old->type = type;
     }
@@ -148,6 +520,7 @@ static bool CodeGenFunction(TokenArray* t, size_t* i, Scope* globalScope)
     size_t oldI = *i;
 
     char* identifier = NULL;
+    SourceLocation loc = Token_GetLocation(*i);
     VariableTypeFunctionPointer* funcType =
         (VariableTypeFunctionPointer*)ParseVariableType(t->tokens, i, t->curLength, globalScope, &identifier, true);
     if (funcType == NULL || funcType->token != FunctionPointerToken)
@@ -156,23 +529,25 @@ static bool CodeGenFunction(TokenArray* t, size_t* i, Scope* globalScope)
         return false;
     }
 
-    VariableType* returnType = funcType->func.returnType;
 
     if (identifier == NULL) SyntaxErrorAtIndex(*i);
     if (Scope_NameIsUsed(globalScope, identifier)) ErrorAtIndex("Identifier already used", *i);
 
     Function newFunc = funcType->func;
     newFunc.identifier = identifier;
-    Function* outFunc = NULL;
     Function* function;
 
     free(funcType); // hacky, bypass reference counting
 
     // Overwriting a forward declaration
-    if ((outFunc = Function_Find(identifier)) != NULL)
+    size_t functionIndex = Function_FindIndex(identifier);
+    if (functionIndex != SIZE_MAX)
     {
+        Function* outFunc = Function_At(functionIndex);
         if (!outFunc->isForwardDecl || outFunc->parameters.count != newFunc.parameters.count)
             ErrorAtIndex("Identifier already used", *i);
+        // Waiting bodies that call the function saw the declaration
+        GeneratePendingFunctions();
 
         // Checking types
         for (size_t j = 0; j < outFunc->parameters.count; j++)
@@ -191,23 +566,28 @@ static bool CodeGenFunction(TokenArray* t, size_t* i, Scope* globalScope)
     }
     // Normal declaration
     else
+    {
+        functionIndex = Function_Count();
         function = Function_Add(newFunc);
+    }
 
     // Function w/o body
     if (t->tokens[*i].type == Semicolon)
     {
         function->isForwardDecl = true;
         function->modifiedRegisters = 0xFFFF;
-        Inc(i);
+        // Might be the last token, e.g. in headers
+        (*i)++;
     }
     else
     {
         Function_SetCurrent(function);
 
         GenericList parameters = function->parameters;
-        Scope functionScope = Scope_Create(globalScope);
-        GenericList_Dispose(&functionScope.variables);
-        functionScope.variables = GenericList_CreateCopy(parameters);
+        Scope* functionScope = xmalloc(sizeof(Scope));
+        *functionScope = Scope_Create(globalScope);
+        GenericList_Dispose(&functionScope->variables);
+        functionScope->variables = GenericList_CreateCopy(parameters);
 
         for (size_t i = 0; i < parameters.count; i++)
         {
@@ -219,87 +599,106 @@ static bool CodeGenFunction(TokenArray* t, size_t* i, Scope* globalScope)
         { // Parse
             PopCur(i, CBrOpen);
             Optimizer_EnterNewScope();
+            for (size_t j = 0; j < functionScope->variables.count; j++)
+                Optimizer_LogParameter(GenericList_At(&functionScope->variables, j));
 
             AST_Statement* outStmt;
             while (t->tokens[*i].type != CBrClose)
             {
-                ParseStatement(t, i, &functionScope, &outStmt);
+                ParseStatement(t, i, functionScope, &outStmt);
                 GenericList_Append(&statements, &outStmt);
             }
-            Optimizer_ExitScope(&functionScope.preferredRegisters[0]);
-            Registers_SetPreferred(&functionScope.preferredRegisters[0]);
+            Optimizer_ExitScope(&functionScope->preferredRegisters[0]);
         }
+        Function_SetCurrent(NULL);
 
         // if (strcmp(function->identifier, "Value_GenerateMemCpy") == 0)
         //     FunctionASTGraphviz(function, statements);
 
-        { // Code Generation
-            OutWrite("_%s:\n", identifier);
-            for (size_t j = 0; j < statements.count; j++)
-            {
-                CodeGen_Statement(*((AST_Statement**)GenericList_At(&statements, j)), &functionScope);
-            }
-        }
-
-        GenericList_Dispose(&statements);
-        Function_SetCurrent(NULL);
-
-        if (returnType->token == VoidKeyword)
-        {
-            Stack_ToAddress(Stack_GetSize() + 1);
-            OutWrite("mov ip, [sp]\n");
-        }
-
         if (t->tokens[*i].type != CBrClose) SyntaxErrorAtIndex(*i);
         // The increment here is purposefully unsafe, as the CBrClose might
         // have been the last token
         (*i)++;
 
-        // All function variables are now out of scope
-        Registers_FreeAll();
-
-        Stack_SetSize(0);
-        Stack_SetOffset(0);
-
-        Scope_Dispose(&functionScope);
+        PendingFunction pending = {functionIndex, Function_Count(), function->modifiedRegisters,
+                                   functionScope, statements, loc, *i - oldI, Optimizer_HasInlineASM()};
+        GenericList_Append(&ctx->pendingFunctions, &pending);
+        ctx->pendingTokens += pending.numTokens;
+        // Data of a precompiled header is captured in process
+        if (ctx->numWorkers <= 1 || ctx->pchOutput != NULL)
+            GeneratePendingFunctions();
     }
     return true;
 }
 
-static bool generatedHeader = false;
 static void GenerateHeader()
 {
     OutWrite("add [sp++], ip, 2\n");
     OutWrite("jmp _main\n__term_loop:\njmp __term_loop\n");
 }
 
-void Compile(TokenArray t)
+CompilerState Compiler_GetState()
+{
+    CompilerState state = {GetGlobalDataIndex(), PeekLabelID(), ctx->generatedHeader};
+    return state;
+}
+
+void Compiler_SetState(CompilerState state)
+{
+    Init(state.dataIndex);
+    SetLabelID(state.labelID);
+    ctx->generatedHeader = state.generatedHeader;
+}
+
+void Compile(TokenArray* t)
 {
     Scope globalScope = Scope_Create(NULL);
 
-    if (!generatedHeader)
+    if (!ctx->generatedHeader)
     {
         GenerateHeader();
-        generatedHeader = true;
+        ctx->generatedHeader = true;
     }
 
     Function_InitFunctions();
+    if (ctx->pchOutput != NULL) PCH_BeginWrite(Token_GetFileName(t->currentFileId));
+    if (PCH_IsLoaded()) PCH_PopulateScope(&globalScope);
 
-    size_t i = 0;
-    size_t oldI = 0;
+    ctx->functionArena = Arena_Create(1 << 15);
+    AST_SetArena(&ctx->functionArena);
 
-    while (i < t.curLength)
+    // Items are lexed as they are compiled, so only the tokens
+    // of the current item have to be kept around.
+    size_t i = 0;
+    while (Lexer_LexItem(t, i))
     {
-        CompileGlobalVariable(&t, &i, &globalScope);
-        if (i >= t.curLength) break;
-        CompileTypedef(&t, &i, &globalScope);
-        if (i >= t.curLength) break;
-        CodeGenFunction(&t, &i, &globalScope);
+        size_t oldI = i;
+
+        CompileGlobalVariable(t, &i, &globalScope);
+        if (i == oldI) CompileTypedef(t, &i, &globalScope);
+        if (i == oldI) CodeGenFunction(t, &i, &globalScope);
 
         if (i == oldI) SyntaxErrorAtIndex(i);
-        oldI = i;
+        i -= Lexer_Release(t, i);
+
+        if (ctx->pendingTokens >= MAX_PENDING_TOKENS)
+            GeneratePendingFunctions();
+        if (ctx->pendingFunctions.count == 0)
+            Arena_Reset(&ctx->functionArena);
+        Outfile_FlushIfFull();
+    }
+    GeneratePendingFunctions();
+    Parallel_StopFollowers();
+
+    if (ctx->pchOutput != NULL)
+    {
+        PCH_Write(ctx->pchOutput, &globalScope);
+        ctx->pchOutput = NULL;
     }
 
     Scope_Dispose(&globalScope);
     Function_DeleteFunctions();
+
+    AST_SetArena(NULL);
+    Arena_Dispose(&ctx->functionArena);
 }
\ No newline at end of file
@@ -3,4 +3,58 @@
 #include "Scope.h"
 #include "Token.h"
 
-void Compile(TokenArray t);
\ No newline at end of file
+#ifndef CUSTOM_COMP
+typedef struct CompilerContext CompilerContext;
+#endif
+#ifdef CUSTOM_COMP
+typedef struct CompilerContext {} CompilerContext;
+#endif
+
+// A context holds all state of the compiler: defines, the include cache, interned strings,
+// output files and the state of the translation unit being compiled. Contexts don't share
+// anything, so several compilations can run at once, each on its own thread and context.
+// All other compiler functions operate on the context the calling thread used last.
+CompilerContext* Compiler_CreateContext();
+// Closes the output files of the context and frees everything it owns.
+void Compiler_DisposeContext(CompilerContext* context);
+void Compiler_UseContext(CompilerContext* context);
+// Returns the current context to the state of a new one, except for its caches (interned strings
+// and the include cache). Also cleans up after an error aborted compilation, see Error_SetRecoveryPoint.
+void Compiler_ResetContext();
+
+void Compile(TokenArray* t);
+
+// Output state that carries over from one translation unit to the next. The output
+// of a unit only depends on its source and the state it is compiled with.
+typedef struct
+{
+    size_t dataIndex; // next free global data address
+    int labelID;      // next label id
+    bool generatedHeader;
+} CompilerState;
+
+CompilerState Compiler_GetState();
+void Compiler_SetState(CompilerState state);
+
+// If set, the global scope of the next compiled file is written as a precompiled header.
+void Compiler_SetPCHOutput(const char* path);
+
+// With more than one worker, function bodies are parsed ahead and code for them is generated
+// in batches on numWorkers worker processes, see Parallel_CompileOnFollowers. The output is the
+// same as with one worker.
+void Compiler_SetNumWorkers(int numWorkers);
+// Optimization level of the generated code, see Passes_Run. Defaults to 1, which also
+// runs the peephole optimizer (Peephole.h).
+void Compiler_SetOptimizationLevel(int level);
+// If enabled, counts how often each peephole rule fires in this process from now on.
+void Compiler_SetPeepholeReport(bool enabled);
+// Prints the counts, if enabled.
+void Compiler_PrintPeepholeReport();
+// Moves the counts into counts (PeepholeRule_Count of them, all 0 if not enabled) and
+// counts from 0 again. Workers report theirs to the parent this way.
+void Compiler_TakePeepholeCounts(size_t* counts);
+// Adds counts to the counts, if enabled.
+void Compiler_AddPeepholeCounts(const size_t* counts);
+// Generates code for function now if its body is waiting for it, e.g. because
+// its modified registers are needed.
+void Compiler_FinishFunction(Function* function);
\ No newline at end of file
@@ -1,37 +1,98 @@
 #include "Data.h"
+#include "GenericList.h"
 #include "Outfile.h"
+#include "Util.h"
 #include <stddef.h>
 #include <stdint.h>
 #include <string.h>
 
-size_t globalDataIndex = 0;
+typedef struct DataContext
+{
+    size_t globalDataIndex;
+    GenericList* capture;
+    bool captureRelocatable;
+} DataContext;
+
+#ifndef CUSTOM_COMP
+static _Thread_local DataContext* ctx = NULL;
+#endif
+#ifdef CUSTOM_COMP
+static DataContext* ctx = NULL;
+#endif
+
+DataContext* Data_CreateContext()
+{
+    DataContext* context = xmalloc(sizeof(DataContext));
+    memset(context, 0, sizeof(DataContext));
+    context->captureRelocatable = true;
+    return context;
+}
+
+void Data_DisposeContext(DataContext* context)
+{
+    if (ctx == context)
+        ctx = NULL;
+    free(context);
+}
+
+void Data_UseContext(DataContext* context)
+{
+    ctx = context;
+}
+
+
+static void CaptureWord(uint16_t word)
+{
+    if (ctx->capture != NULL)
+        GenericList_Append(ctx->capture, &word);
+}
+
+void SetDataCapture(GenericList* words)
+{
+    ctx->capture = words;
+    if (words != NULL)
+        ctx->captureRelocatable = true;
+}
+
+bool DataCaptureIsRelocatable()
+{
+    return ctx->captureRelocatable;
+}
+
 size_t AllocateGlobalValue(size_t size)
 {
     OutWriteZeros(size);
-    size_t retval = globalDataIndex;
-    globalDataIndex += size;
+    for (size_t i = 0; i < size; i++)
+        CaptureWord(0);
+    size_t retval = ctx->globalDataIndex;
+    ctx->globalDataIndex += size;
     return retval;
 }
 
 size_t AllocateGlobalWord(uint16_t word)
 {
     OutWriteData((void*)(&word), sizeof(uint16_t));
-    size_t retval = globalDataIndex;
-    globalDataIndex += 1;
+    CaptureWord(word);
+    size_t retval = ctx->globalDataIndex;
+    ctx->globalDataIndex += 1;
     return retval;
 }
 
 size_t AllocateGlobalDoubleWord(uint32_t dword)
 {
     OutWriteData((void*)(&dword), sizeof(uint32_t));
-    size_t retval = globalDataIndex;
-    globalDataIndex += 2;
+    CaptureWord((uint16_t)(dword & 0xFFFF));
+    CaptureWord((uint16_t)(dword >> 16));
+    size_t retval = ctx->globalDataIndex;
+    ctx->globalDataIndex += 2;
     return retval;
 }
 
 size_t AllocateAndWriteStringLiteral(const char* str)
 {
-    size_t retval = globalDataIndex;
+    // Pointers to the literal are absolute addresses
+    ctx->captureRelocatable = false;
+    size_t retval = ctx->globalDataIndex;
     size_t len = 1;
     while (*str != 0)
     {
@@ -46,10 +107,10 @@ size_t AllocateAndWriteStringLiteral(const char* str)
 
 size_t GetGlobalDataIndex()
 {
-    return globalDataIndex;
+    return ctx->globalDataIndex;
 }
 
 void Init(size_t dataAddress)
 {
-    globalDataIndex = dataAddress;
+    ctx->globalDataIndex = dataAddress;
 }
\ No newline at end of file
@@ -1,4 +1,6 @@
 #pragma once
+#include "GenericList.h"
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 
@@ -8,4 +10,19 @@ size_t AllocateGlobalWord(uint16_t word);
 size_t AllocateGlobalDoubleWord(uint32_t dword);
 size_t AllocateAndWriteStringLiteral(const char* str);
 size_t GetGlobalDataIndex();
-void Init(size_t dataAddress);
\ No newline at end of file
+void Init(size_t dataAddress);
+
+// While set, every word of global data that is allocated is also appended to words (as uint16_t).
+void SetDataCapture(GenericList* words);
+// False if the captured data contains absolute addresses, i.e. can't be moved.
+bool DataCaptureIsRelocatable();
+
+#ifndef CUSTOM_COMP
+typedef struct DataContext DataContext;
+#endif
+#ifdef CUSTOM_COMP
+typedef struct DataContext {} DataContext;
+#endif
+DataContext* Data_CreateContext();
+void Data_DisposeContext(DataContext* context);
+void Data_UseContext(DataContext* context);
@@ -2,8 +2,43 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+#include "Error.h"
 #include "Token.h"
 
+#ifndef CUSTOM_COMP
+static _Thread_local jmp_buf* recoveryPoint = NULL;
+static _Thread_local void (*cleanup)() = NULL;
+
+void Error_SetRecoveryPoint(jmp_buf* point)
+{
+    recoveryPoint = point;
+}
+
+void Error_SetCleanup(void (*function)())
+{
+    cleanup = function;
+}
+#endif
+
+void Error_Abort()
+{
+#ifndef CUSTOM_COMP
+    if (cleanup != NULL)
+    {
+        // Only runs once, even if it fails itself
+        void (*function)() = cleanup;
+        cleanup = NULL;
+        function();
+    }
+    if (recoveryPoint != NULL)
+    {
+        fflush(stdout);
+        longjmp(*recoveryPoint, 1);
+    }
+#endif
+    exit(1);
+}
+
 typedef enum
 {
     TermColor_Black,
@@ -44,7 +79,7 @@ void ErrorAtLine(const char* error, int lineNumber)
     SetTerminalStyle(TermColor_White, true);
     printf(" %s\n", error);
     ResetTerminalStyle();
-    exit(1);
+    Error_Abort();
 }
 void ErrorAtLineInFile(const char* error, int lineNumber, const char* fileName)
 {
@@ -55,7 +90,7 @@ void ErrorAtLineInFile(const char* error, int lineNumber, const char* fileName)
     SetTerminalStyle(TermColor_White, true);
     printf(" %s\n", error);
     ResetTerminalStyle();
-    exit(1);
+    Error_Abort();
 }
 void Error(const char* error)
 {
@@ -64,18 +99,18 @@ void Error(const char* error)
     SetTerminalStyle(TermColor_White, true);
     printf(" %s\n", error);
     ResetTerminalStyle();
-    exit(1);
+    Error_Abort();
 }
 void ErrorAtLocation(const char* error, SourceLocation location)
 {
     SetTerminalStyle(TermColor_White, true);
-    printf("%s:%i: ", location.sourceFile, location.lineNumber);
+    printf("%s:%u: ", location.sourceFile, location.lineNumber);
     SetTerminalStyle(TermColor_Red, true);
     printf("error:");
     SetTerminalStyle(TermColor_White, true);
     printf(" %s\n", error);
     ResetTerminalStyle();
-    exit(1);
+    Error_Abort();
 }
 void ErrorAtIndex(const char* error, size_t tokenIndex)
 {
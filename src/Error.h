@@ -1,5 +1,19 @@
 #pragma once
 #include "Token.h"
+#ifndef CUSTOM_COMP
+#include <setjmp.h>
+#endif
+
+// Errors are printed to stdout and end the process, unless a recovery point is set.
+// Then compilation is aborted by a longjmp to it, see Compiler_ResetContext.
+#ifndef CUSTOM_COMP
+void Error_SetRecoveryPoint(jmp_buf* point);
+// Runs function once when compilation is aborted, before the process ends or recovers.
+// NULL removes it again.
+void Error_SetCleanup(void (*function)());
+#endif
+// Aborts compilation after an error was reported.
+void Error_Abort();
 
 void ErrorAtLine(const char* error, int lineNumber);
 void ErrorAtLineInFile(const char* error, int lineNumber, const char* fileName);
@@ -9,4 +23,4 @@ void ErrorAtLocation(const char* error, SourceLocation location);
 void ErrorAtIndex(const char* error, size_t tokenIndex);
 void SyntaxErrorAtIndex(size_t tokenIndex);
 void ErrorAtToken(const char* error, Token* token);
-void SyntaxErrorAtToken(Token* token);
\ No newline at end of file
+void SyntaxErrorAtToken(Token* token);
@@ -1,26 +1,57 @@
 #include "Flags.h"
+#include "Util.h"
 #include <assert.h>
 #include <stdlib.h>
+#include <string.h>
 
 static const char* flagToString[8] = {
     "_nz", "_z", "_np", "_p", "_ns", "_s", "_nc", "_c",
 };
 
-static Flag lastExpressionAsBoolInFlag;
+typedef struct FlagsContext
+{
+    Flag lastExpressionAsBoolInFlag;
+} FlagsContext;
+
+#ifndef CUSTOM_COMP
+static _Thread_local FlagsContext* ctx = NULL;
+#endif
+#ifdef CUSTOM_COMP
+static FlagsContext* ctx = NULL;
+#endif
+
+FlagsContext* Flags_CreateContext()
+{
+    FlagsContext* context = xmalloc(sizeof(FlagsContext));
+    memset(context, 0, sizeof(FlagsContext));
+    return context;
+}
+
+void Flags_DisposeContext(FlagsContext* context)
+{
+    if (ctx == context)
+        ctx = NULL;
+    free(context);
+}
+
+void Flags_UseContext(FlagsContext* context)
+{
+    ctx = context;
+}
 
 void Flags_SetExpressionAsBoolInFlag(Flag f)
 {
-    lastExpressionAsBoolInFlag = f;
+    ctx->lastExpressionAsBoolInFlag = f;
 }
 
 void Flags_ClearResult()
 {
-    lastExpressionAsBoolInFlag = Flag_None;
+    ctx->lastExpressionAsBoolInFlag = Flag_None;
 }
 
 Flag Flags_GetResultAsFlag()
 {
-    return lastExpressionAsBoolInFlag;
+    return ctx->lastExpressionAsBoolInFlag;
 }
 
 const char* Flags_FlagToString(Flag f)
@@ -16,4 +16,14 @@ void Flags_SetExpressionAsBoolInFlag(Flag f);
 void Flags_ClearResult();
 Flag Flags_GetResultAsFlag();
 const char* Flags_FlagToString(Flag f);
-Flag Flags_Invert(Flag f);
\ No newline at end of file
+Flag Flags_Invert(Flag f);
+
+#ifndef CUSTOM_COMP
+typedef struct FlagsContext FlagsContext;
+#endif
+#ifdef CUSTOM_COMP
+typedef struct FlagsContext {} FlagsContext;
+#endif
+FlagsContext* Flags_CreateContext();
+void Flags_DisposeContext(FlagsContext* context);
+void Flags_UseContext(FlagsContext* context);
@@ -2,30 +2,63 @@
 #include "GenericList.h"
 #include "Token.h"
 #include "Type.h"
+#include "Util.h"
 #include "Variables.h"
+#include <string.h>
 
-static GenericList functions;
-static Function* curFunction = NULL;
+typedef struct FunctionContext
+{
+    GenericList functions;
+    Function* curFunction;
+    size_t numVisible;
+} FunctionContext;
+
+#ifndef CUSTOM_COMP
+static _Thread_local FunctionContext* ctx = NULL;
+#endif
+#ifdef CUSTOM_COMP
+static FunctionContext* ctx = NULL;
+#endif
+
+FunctionContext* Function_CreateContext()
+{
+    FunctionContext* context = xmalloc(sizeof(FunctionContext));
+    memset(context, 0, sizeof(FunctionContext));
+    context->numVisible = SIZE_MAX;
+    return context;
+}
+
+void Function_DisposeContext(FunctionContext* context)
+{
+    if (ctx == context)
+        ctx = NULL;
+    free(context);
+}
+
+void Function_UseContext(FunctionContext* context)
+{
+    ctx = context;
+}
 
 Function* Function_GetCurrent()
 {
-    return curFunction;
+    return ctx->curFunction;
 }
 void Function_SetCurrent(Function* f)
 {
-    curFunction = f;
+    ctx->curFunction = f;
 }
 
 void Function_InitFunctions()
 {
-    functions = GenericList_Create(sizeof(Function));
+    ctx->functions = GenericList_Create(sizeof(Function));
 }
 
 void Function_DeleteFunctions()
 {
-    for (size_t i = 0; i < functions.count; i++)
+    for (size_t i = 0; i < ctx->functions.count; i++)
     {
-        Function* handle = GenericList_At(&functions, i);
+        Function* handle = GenericList_At(&ctx->functions, i);
         for (size_t j = 0; j < handle->parameters.count; j++)
         {
 
@@ -38,25 +71,51 @@ void Function_DeleteFunctions()
         Type_RemoveReference(handle->returnType);
     }
 
-    GenericList_Dispose(&functions);
+    GenericList_Dispose(&ctx->functions);
 }
 
 void* Function_Add(Function f)
 {
-    return GenericList_Append(&functions, &f);
+    return GenericList_Append(&ctx->functions, &f);
 }
 
-static bool CompareFunctionToID(const void* variable, const void* identifier)
+size_t Function_FindIndex(char* identifier)
 {
-    Function* f = (Function*)variable;
-    char* id = (char*)identifier;
+    size_t count = ctx->functions.count;
+    if (ctx->numVisible < count)
+        count = ctx->numVisible;
 
-    return strcmp(f->identifier, id) == 0;
+    // Identifiers are interned
+    for (size_t i = 0; i < count; i++)
+    {
+        Function* f = GenericList_At(&ctx->functions, i);
+        if (f->identifier == identifier)
+            return i;
+    }
+    return SIZE_MAX;
 }
 
 Function* Function_Find(char* identifier)
 {
-    return GenericList_Find(&functions, CompareFunctionToID, identifier);
+    size_t index = Function_FindIndex(identifier);
+    if (index == SIZE_MAX)
+        return NULL;
+    return GenericList_At(&ctx->functions, index);
+}
+
+void Function_LimitVisible(size_t count)
+{
+    ctx->numVisible = count;
+}
+
+size_t Function_Count()
+{
+    return ctx->functions.count;
+}
+
+Function* Function_At(size_t index)
+{
+    return GenericList_At(&ctx->functions, index);
 }
 
 Function Function_Create(char* identifier, VariableType* returnType)
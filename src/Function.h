@@ -29,7 +29,25 @@ void Function_DeleteFunctions();
 void* Function_Add(Function f);
 
 Function* Function_Find(char* identifier);
+// Index of the function for Function_At, or SIZE_MAX if there is none
+size_t Function_FindIndex(char* identifier);
+// Limits Function_Find to the first count functions, e.g. to those that were declared
+// when a function body was parsed. SIZE_MAX lifts the limit.
+void Function_LimitVisible(size_t count);
+
+size_t Function_Count();
+Function* Function_At(size_t index);
 
 Function Function_Create(char* identifier, VariableType* returnType);
 
 void Function_Dispose(Function* this);
+
+#ifndef CUSTOM_COMP
+typedef struct FunctionContext FunctionContext;
+#endif
+#ifdef CUSTOM_COMP
+typedef struct FunctionContext {} FunctionContext;
+#endif
+FunctionContext* Function_CreateContext();
+void Function_DisposeContext(FunctionContext* context);
+void Function_UseContext(FunctionContext* context);
@@ -0,0 +1,466 @@
+#include "IR.h"
+#include "Arena.h"
+#include "Relocation.h"
+#include "Util.h"
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct IRContext
+{
+    bool collecting;
+    IRFunction function;
+    // Function name, label names and inline assembly of the function
+    Arena strings;
+    // Names of the labels used in the function, by label number
+    GenericList labels;
+    // Open addressing table of label number + 1 by name, 0 for empty slots
+    size_t* labelTable;
+    size_t labelTableSize;
+} IRContext;
+
+#ifndef CUSTOM_COMP
+static _Thread_local IRContext* ctx = NULL;
+#endif
+#ifdef CUSTOM_COMP
+static IRContext* ctx = NULL;
+#endif
+
+IRContext* IR_CreateContext()
+{
+    IRContext* context = xmalloc(sizeof(IRContext));
+    memset(context, 0, sizeof(IRContext));
+    context->function.instructions = GenericList_Create(sizeof(IRInstruction));
+    context->function.blocks = GenericList_Create(sizeof(IRBlock));
+    context->strings = Arena_Create(4096);
+    context->labels = GenericList_Create(sizeof(char*));
+    return context;
+}
+
+void IR_DisposeContext(IRContext* context)
+{
+    GenericList_Dispose(&context->function.instructions);
+    GenericList_Dispose(&context->function.blocks);
+    Arena_Dispose(&context->strings);
+    GenericList_Dispose(&context->labels);
+    free(context->labelTable);
+    if (ctx == context)
+        ctx = NULL;
+    free(context);
+}
+
+void IR_UseContext(IRContext* context)
+{
+    ctx = context;
+}
+
+static IROperand Operand(IROperandType type, int32_t value)
+{
+    IROperand operand;
+    operand.type = type;
+    operand.value = value;
+    operand.dataRelative = false;
+    return operand;
+}
+
+IROperand IR_Register(int r)
+{
+    return Operand(IROperand_Register, (int32_t)r);
+}
+
+IROperand IR_Zero()
+{
+    return Operand(IROperand_Zero, (int32_t)0);
+}
+
+IROperand IR_IP()
+{
+    return Operand(IROperand_IP, (int32_t)0);
+}
+
+IROperand IR_SP()
+{
+    return Operand(IROperand_SP, (int32_t)0);
+}
+
+IROperand IR_Literal(int32_t literal)
+{
+    return Operand(IROperand_Literal, literal);
+}
+
+IROperand IR_Memory(int32_t address)
+{
+    return Operand(IROperand_Memory, address);
+}
+
+IROperand IR_MemoryRegister(int r)
+{
+    return Operand(IROperand_MemoryRegister, (int32_t)r);
+}
+
+IROperand IR_Stack(int delta)
+{
+    assert(delta >= 0);
+    return Operand(IROperand_Stack, (int32_t)delta);
+}
+
+IROperand IR_Push()
+{
+    return Operand(IROperand_Push, (int32_t)0);
+}
+
+bool IR_OperandEquals(IROperand a, IROperand b)
+{
+    return a.type == b.type && Relocation_Equal(a.value, a.dataRelative, b.value, b.dataRelative);
+}
+
+IROperand* IR_OperandAt(IRInstruction* inst, int slot)
+{
+    if (slot == IRSlot_Dst)
+        return &inst->dst;
+    if (slot == IRSlot_A)
+        return &inst->a;
+    return &inst->b;
+}
+
+bool IR_HasVirtualRegisters(IRFunction* function)
+{
+    for (size_t i = 0; i < function->instructions.count; i++)
+    {
+        IRInstruction* inst = GenericList_At(&function->instructions, i);
+        for (int slot = IRSlot_Dst; slot <= IRSlot_B; slot++)
+        {
+            IROperand* op = IR_OperandAt(inst, slot);
+            if ((op->type == IROperand_Register || op->type == IROperand_MemoryRegister) &&
+                (int)op->value >= IR_NUM_PHYSICAL_REGISTERS)
+                return true;
+        }
+    }
+    return false;
+}
+
+// Calls of the function itself modify the registers it modifies anyway
+static bool IsSelfCall(IRFunction* function, const IRInstruction* inst)
+{
+    if (inst->a.type != IROperand_Label)
+        return false;
+    const char* label = IR_LabelName(inst->a.value);
+    return label[0] == '_' && strcmp(label + 1, function->name) == 0;
+}
+
+uint16_t IR_ModifiedRegisters(IRFunction* function)
+{
+    uint16_t modified = 0;
+    for (size_t i = 0; i < function->instructions.count; i++)
+    {
+        IRInstruction* inst = GenericList_At(&function->instructions, i);
+        if (inst->op <= IR_Not && inst->dst.type == IROperand_Register &&
+            (int)inst->dst.value < IR_NUM_PHYSICAL_REGISTERS)
+            modified |= 1 << (int)inst->dst.value;
+        else if (inst->op == IR_Call && !IsSelfCall(function, inst))
+            modified |= inst->clobbers;
+    }
+    return modified;
+}
+
+bool IR_DependsOnAddresses(IRFunction* function)
+{
+    for (size_t i = 0; i < function->instructions.count; i++)
+    {
+        IRInstruction* inst = GenericList_At(&function->instructions, i);
+        if (inst->op == IR_Asm)
+            return true;
+        if (inst->op > IR_Not)
+            continue;
+        bool jumpTable = inst->op == IR_Add && inst->dst.type == IROperand_IP && inst->a.type == IROperand_IP;
+        if ((inst->a.type == IROperand_IP && !jumpTable && inst->op != IR_Mov && inst->op != IR_Not) ||
+            inst->b.type == IROperand_IP)
+            return true;
+    }
+    return false;
+}
+
+typedef enum
+{
+    Address_None,
+    Address_Literal,
+    Address_Register,
+    Address_SP,
+    Address_SPRelative,
+} AddressKind;
+
+// Literal and address used by the operands of an instruction so far
+typedef struct
+{
+    bool usesLiteral;
+    int32_t literal;
+    bool literalRelative;
+    AddressKind address;
+    int32_t addressRegister;
+} Encoding;
+
+static bool AddLiteral(Encoding* encoding, int32_t literal, bool relative)
+{
+    if (encoding->usesLiteral &&
+        !Relocation_Equal(encoding->literal, encoding->literalRelative, literal & 0xFFFF, relative))
+        return false;
+    encoding->usesLiteral = true;
+    encoding->literal = literal & 0xFFFF;
+    encoding->literalRelative = relative;
+    return true;
+}
+
+static bool AddAddress(Encoding* encoding, AddressKind address)
+{
+    if (encoding->address != Address_None && encoding->address != address)
+        return false;
+    encoding->address = address;
+    return true;
+}
+
+static bool AddOperand(Encoding* encoding, const IROperand* op)
+{
+    switch (op->type)
+    {
+        case IROperand_Literal: return AddLiteral(encoding, op->value, op->dataRelative);
+        case IROperand_Memory:
+            return AddLiteral(encoding, op->value, op->dataRelative) && AddAddress(encoding, Address_Literal);
+        case IROperand_MemoryRegister:
+            if (encoding->address == Address_Register && encoding->addressRegister != op->value)
+                return false;
+            encoding->addressRegister = op->value;
+            return AddAddress(encoding, Address_Register);
+        case IROperand_Push: return AddAddress(encoding, Address_SP);
+        case IROperand_Stack:
+            if (op->value == 0)
+                return AddAddress(encoding, Address_SP);
+            return op->value <= 255 && AddLiteral(encoding, op->value, false) &&
+                   AddAddress(encoding, Address_SPRelative);
+        default: return true;
+    }
+}
+
+bool IR_IsEncodable(const IRInstruction* inst)
+{
+    if (inst->op > IR_Not)
+        return true;
+
+    Encoding encoding;
+    memset(&encoding, 0, sizeof(Encoding));
+    encoding.address = Address_None;
+
+    // In the order of the encoding
+    bool threeOperands = !IR_OperandEquals(inst->dst, inst->a);
+    if (!AddOperand(&encoding, &inst->a) || !AddOperand(&encoding, &inst->b))
+        return false;
+    if (threeOperands && !AddOperand(&encoding, &inst->dst))
+        return false;
+
+    if (threeOperands && (encoding.literal > 255 || encoding.address == Address_Literal))
+        return false;
+    if (threeOperands && encoding.literalRelative)
+        Relocation_AssumeAtMost(encoding.literal, (int32_t)0xFF);
+    if (encoding.address == Address_SPRelative && (inst->a.type == IROperand_SP || inst->b.type == IROperand_SP))
+        return false;
+    return true;
+}
+
+static size_t HashName(const char* name)
+{
+    size_t hash = 5381;
+    while (*name != 0)
+    {
+        hash = hash * 33 + (size_t)(*name & 0xFF);
+        name++;
+    }
+    return hash;
+}
+
+static void InsertLabel(int32_t label)
+{
+    size_t mask = ctx->labelTableSize - 1;
+    size_t i = HashName(IR_LabelName(label)) & mask;
+    while (ctx->labelTable[i] != 0)
+        i = (i + 1) & mask;
+    ctx->labelTable[i] = (size_t)label + 1;
+}
+
+IROperand IR_LabelOperand(const char* name)
+{
+    if (ctx->labelTableSize != 0)
+    {
+        size_t mask = ctx->labelTableSize - 1;
+        size_t i = HashName(name) & mask;
+        while (ctx->labelTable[i] != 0)
+        {
+            int32_t label = (int32_t)(ctx->labelTable[i] - 1);
+            if (strcmp(IR_LabelName(label), name) == 0)
+                return Operand(IROperand_Label, label);
+            i = (i + 1) & mask;
+        }
+    }
+
+    // Kept at most half full
+    if (2 * (ctx->labels.count + 1) > ctx->labelTableSize)
+    {
+        free(ctx->labelTable);
+        ctx->labelTableSize = ctx->labelTableSize == 0 ? 64 : 2 * ctx->labelTableSize;
+        ctx->labelTable = xmalloc(ctx->labelTableSize * sizeof(size_t));
+        memset(ctx->labelTable, 0, ctx->labelTableSize * sizeof(size_t));
+        for (size_t i = 0; i < ctx->labels.count; i++)
+            InsertLabel((int32_t)i);
+    }
+
+    char* copy = Arena_Copy(&ctx->strings, name, strlen(name) + 1);
+    int32_t label = (int32_t)ctx->labels.count;
+    GenericList_Append(&ctx->labels, &copy);
+    InsertLabel(label);
+    return Operand(IROperand_Label, label);
+}
+
+IROperand IR_FunctionLabel(const char* identifier)
+{
+    size_t length = strlen(identifier);
+    char* name = xmalloc(length + 2);
+    name[0] = '_';
+    memcpy(name + 1, identifier, length + 1);
+    IROperand label = IR_LabelOperand(name);
+    free(name);
+    return label;
+}
+
+const char* IR_LabelName(int32_t label)
+{
+    return *(char**)GenericList_At(&ctx->labels, (size_t)label);
+}
+
+static void StartBlock(size_t first)
+{
+    IRBlock block;
+    block.first = first;
+    block.end = first;
+    GenericList_Append(&ctx->function.blocks, &block);
+}
+
+void IR_BeginFunction(const char* name)
+{
+    assert(!ctx->collecting);
+    ctx->collecting = true;
+
+    Arena_Reset(&ctx->strings);
+    ctx->labels.count = 0;
+    if (ctx->labelTableSize != 0)
+        memset(ctx->labelTable, 0, ctx->labelTableSize * sizeof(size_t));
+
+    ctx->function.name = Arena_Copy(&ctx->strings, name, strlen(name) + 1);
+    ctx->function.instructions.count = 0;
+    ctx->function.blocks.count = 0;
+    StartBlock(0);
+}
+
+IRFunction* IR_EndFunction()
+{
+    assert(ctx->collecting);
+    ctx->collecting = false;
+
+    IRBlock* last = GenericList_At(&ctx->function.blocks, ctx->function.blocks.count - 1);
+    if (last->first == last->end && ctx->function.blocks.count > 1)
+        ctx->function.blocks.count--;
+    return &ctx->function;
+}
+
+bool IR_IsCollecting()
+{
+    return ctx->collecting;
+}
+
+// Control only leaves a block at its end
+static bool EndsBlock(const IRInstruction* inst)
+{
+    if (inst->op == IR_Jump || inst->op == IR_Asm)
+        return true;
+    return inst->op <= IR_Not && inst->dst.type == IROperand_IP;
+}
+
+static void Append(IRInstruction* inst)
+{
+    assert(ctx->collecting);
+    GenericList* blocks = &ctx->function.blocks;
+    size_t index = ctx->function.instructions.count;
+
+    IRBlock* block = GenericList_At(blocks, blocks->count - 1);
+    if (inst->op == IR_Label && block->first != index)
+    {
+        StartBlock(index);
+        block = GenericList_At(blocks, blocks->count - 1);
+    }
+    GenericList_Append(&ctx->function.instructions, inst);
+    block->end = index + 1;
+
+    if (EndsBlock(inst))
+        StartBlock(index + 1);
+}
+
+static IRInstruction Instruction(IROpcode op, Flag flag)
+{
+    IRInstruction inst;
+    memset(&inst, 0, sizeof(IRInstruction));
+    inst.op = op;
+    inst.flag = flag;
+    return inst;
+}
+
+void IR_EmitConditional(IROpcode op, Flag flag, IROperand dst, IROperand a, IROperand b)
+{
+    assert(op <= IR_Not);
+    IRInstruction inst = Instruction(op, flag);
+    inst.dst = dst;
+    inst.a = a;
+    inst.b = b;
+    Append(&inst);
+}
+
+void IR_Emit3(IROpcode op, IROperand dst, IROperand a, IROperand b)
+{
+    IR_EmitConditional(op, Flag_None, dst, a, b);
+}
+
+void IR_Emit2(IROpcode op, IROperand a, IROperand b)
+{
+    IR_EmitConditional(op, Flag_None, a, a, b);
+}
+
+void IR_EmitMove(IROpcode op, IROperand dst, IROperand src)
+{
+    assert(op == IR_Mov || op == IR_Not);
+    IR_EmitConditional(op, Flag_None, dst, dst, src);
+}
+
+void IR_EmitJump(Flag flag, const char* label)
+{
+    IRInstruction inst = Instruction(IR_Jump, flag);
+    inst.a = IR_LabelOperand(label);
+    Append(&inst);
+}
+
+void IR_EmitCall(IROperand target, uint16_t clobbers)
+{
+    IRInstruction inst = Instruction(IR_Call, Flag_None);
+    inst.a = target;
+    inst.clobbers = clobbers;
+    Append(&inst);
+}
+
+void IR_EmitLabel(const char* name)
+{
+    IRInstruction inst = Instruction(IR_Label, Flag_None);
+    inst.a = IR_LabelOperand(name);
+    Append(&inst);
+}
+
+void IR_EmitAsm(const char* code)
+{
+    IRInstruction inst = Instruction(IR_Asm, Flag_None);
+    inst.text = Arena_Copy(&ctx->strings, code, strlen(code) + 1);
+    Append(&inst);
+}
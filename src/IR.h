@@ -0,0 +1,166 @@
+#pragma once
+#include "Flags.h"
+#include "GenericList.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Linear three-address code of one function. Code generation lowers the AST into it,
+// the backend (Backend.h) prints it as assembly once the function is complete.
+
+// Opcodes up to IR_Not are machine instructions, in the same order as NativeOP.
+typedef enum
+{
+    IR_Add,
+    IR_Sub,
+    IR_Mul,
+    IR_And,
+    IR_Div,
+    IR_Or,
+    IR_Xor,
+    IR_ShiftLeft,
+    IR_ShiftRight,
+    IR_MulH,
+    IR_MulQ,
+    IR_InvQ,
+    IR_Mov,
+    IR_Not,
+    // Jumps to a
+    IR_Jump,
+    // Pushes the return address and jumps to a
+    IR_Call,
+    // Defines the label a
+    IR_Label,
+    // Inline assembly, text
+    IR_Asm,
+    // Removed instruction, not printed
+    IR_Nop,
+} IROpcode;
+
+typedef enum
+{
+    IROperand_None,
+    // Register number in value. Numbers from IR_NUM_PHYSICAL_REGISTERS up are virtual
+    // registers, which have to be assigned a machine register before printing.
+    IROperand_Register,
+    // rz, reads as zero, writes are discarded
+    IROperand_Zero,
+    IROperand_IP,
+    IROperand_SP,
+    IROperand_Literal,
+    // [value]
+    IROperand_Memory,
+    // [r<value>]
+    IROperand_MemoryRegister,
+    // [sp-value], or [sp] for 0
+    IROperand_Stack,
+    // [sp++]. Used as both destination and first source, it is the same word.
+    IROperand_Push,
+    // Label number in value, see IR_LabelName. Function labels are not defined in the function.
+    IROperand_Label,
+} IROperandType;
+
+typedef struct
+{
+    IROperandType type;
+    int32_t value;
+    // A literal or memory address that is a data address of the unit, see Relocation.h
+    bool dataRelative;
+} IROperand;
+
+typedef struct
+{
+    IROpcode op;
+    // Condition the instruction is executed on, or Flag_None
+    Flag flag;
+    // Always set for machine instructions, printed once if it equals a. Moves
+    // and nots only read b, their a is the same as dst.
+    IROperand dst;
+    IROperand a;
+    IROperand b;
+    // Registers a call may modify
+    uint16_t clobbers;
+    const char* text;
+} IRInstruction;
+
+// Instructions [first, end) of the function. A block starts at a label
+// or after a jump and is only left at its end.
+typedef struct
+{
+    size_t first;
+    size_t end;
+} IRBlock;
+
+typedef struct
+{
+    const char* name;
+    GenericList instructions;
+    GenericList blocks;
+} IRFunction;
+
+static const int IR_NUM_PHYSICAL_REGISTERS = 8;
+
+IROperand IR_Register(int r);
+IROperand IR_Zero();
+IROperand IR_IP();
+IROperand IR_SP();
+IROperand IR_Literal(int32_t literal);
+IROperand IR_Memory(int32_t address);
+IROperand IR_MemoryRegister(int r);
+IROperand IR_Stack(int delta);
+IROperand IR_Push();
+IROperand IR_LabelOperand(const char* name);
+// Label of the function with the given identifier
+IROperand IR_FunctionLabel(const char* identifier);
+bool IR_OperandEquals(IROperand a, IROperand b);
+
+// Operand slots of an instruction, for IR_OperandAt
+typedef enum
+{
+    IRSlot_Dst,
+    IRSlot_A,
+    IRSlot_B,
+} IRSlot;
+
+IROperand* IR_OperandAt(IRInstruction* inst, int slot);
+bool IR_HasVirtualRegisters(IRFunction* function);
+// Switch jump tables are the only code that jumps to a computed address. Anything
+// else that reads ip, like inline assembly, depends on instruction addresses, so the
+// instructions of such a function can't be changed.
+bool IR_DependsOnAddresses(IRFunction* function);
+// Machine registers the code of the function writes, including those the functions it calls modify
+uint16_t IR_ModifiedRegisters(IRFunction* function);
+// Whether a machine instruction has an encoding: one literal, which has to fit 8 bits with
+// three operands, at most one address (a literal address only with two operands) and no
+// sp-relative address together with sp as a value. Other instructions are always encodable.
+bool IR_IsEncodable(const IRInstruction* inst);
+
+// Starts collecting the code of the named function.
+void IR_BeginFunction(const char* name);
+// Returns the collected function, valid until the next IR_BeginFunction.
+IRFunction* IR_EndFunction();
+bool IR_IsCollecting();
+const char* IR_LabelName(int32_t label);
+
+// dst = a <op> b
+void IR_Emit3(IROpcode op, IROperand dst, IROperand a, IROperand b);
+// a = a <op> b
+void IR_Emit2(IROpcode op, IROperand a, IROperand b);
+// dst = src, and dst = ~src for IR_Not
+void IR_EmitMove(IROpcode op, IROperand dst, IROperand src);
+// Same as IR_Emit3, but only executed if flag is set
+void IR_EmitConditional(IROpcode op, Flag flag, IROperand dst, IROperand a, IROperand b);
+void IR_EmitJump(Flag flag, const char* label);
+void IR_EmitCall(IROperand target, uint16_t clobbers);
+void IR_EmitLabel(const char* name);
+void IR_EmitAsm(const char* code);
+
+#ifndef CUSTOM_COMP
+typedef struct IRContext IRContext;
+#endif
+#ifdef CUSTOM_COMP
+typedef struct IRContext {} IRContext;
+#endif
+IRContext* IR_CreateContext();
+void IR_DisposeContext(IRContext* context);
+void IR_UseContext(IRContext* context);
@@ -0,0 +1,335 @@
+#include "IncludeCache.h"
+#include "GenericList.h"
+#include "Intern.h"
+#include "PCH.h"
+#include "Preprocessor.h"
+#include "Token.h"
+#include "Util.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef CUSTOM_COMP
+#include <limits.h>
+#include <sys/stat.h>
+
+typedef struct
+{
+    uint32_t path; // interned canonical path
+    struct timespec mtime;
+    off_t size;
+} FileStamp;
+
+typedef struct
+{
+    FileStamp file;
+    // Name the header was included as. Locations refer to it and relative includes are
+    // resolved against it, so a different spelling is treated as a different header.
+    uint32_t fileId;
+
+    Token* tokens;
+    size_t numTokens;
+    TokenSourceGroup* locations;
+    size_t numLocations;
+    char* strings;
+    size_t stringsLength;
+
+    PreprocessorEvent* events;
+    size_t numEvents;
+    // Headers included by this one
+    FileStamp* dependencies;
+    size_t numDependencies;
+} CachedHeader;
+
+typedef struct
+{
+    FileStamp file;
+    uint32_t fileId;
+    size_t firstToken;
+    size_t firstLocation;
+    size_t firstString;
+    size_t firstEvent;
+    size_t firstDependency;
+} Recording;
+
+typedef struct IncludeCacheContext
+{
+    GenericList cache;
+    GenericList recordings;
+    // Preprocessor events and included files of all headers that are currently being recorded
+    GenericList eventLog;
+    GenericList dependencyLog;
+} IncludeCacheContext;
+
+static _Thread_local IncludeCacheContext* ctx = NULL;
+
+static bool GetFileStamp(const char* path, FileStamp* out)
+{
+    struct stat st;
+    if (stat(path, &st) != 0)
+        return false;
+
+    char* canonical = realpath(path, NULL);
+    if (canonical == NULL)
+        return false;
+    out->path = Intern_Symbol(canonical, strlen(canonical));
+    free(canonical);
+
+    out->mtime = st.st_mtim;
+    out->size = st.st_size;
+    return true;
+}
+
+static bool FileStampEquals(const FileStamp* a, const FileStamp* b)
+{
+    return a->path == b->path && a->size == b->size && a->mtime.tv_sec == b->mtime.tv_sec &&
+           a->mtime.tv_nsec == b->mtime.tv_nsec;
+}
+
+static bool DependenciesValid(const CachedHeader* header)
+{
+    for (size_t i = 0; i < header->numDependencies; i++)
+    {
+        FileStamp current;
+        if (!GetFileStamp(Intern_GetSymbol(header->dependencies[i].path), &current) ||
+            !FileStampEquals(&current, &header->dependencies[i]))
+            return false;
+    }
+    return true;
+}
+
+// Every query has to give the same result as when the header was lexed,
+// taking into account the defines (or once files) added by the header itself up to that point.
+static bool EventsValid(const CachedHeader* header)
+{
+    for (size_t i = 0; i < header->numEvents; i++)
+    {
+        const PreprocessorEvent* e = &header->events[i];
+        bool once = e->type == PreprocessorEvent_OnceQuery;
+        if (e->type != PreprocessorEvent_Query && !once)
+            continue;
+
+        PreprocessorEventType addType = once ? PreprocessorEvent_Once : PreprocessorEvent_Define;
+        bool defined = false;
+        for (size_t j = 0; j < i && !defined; j++)
+            defined = header->events[j].type == addType && header->events[j].symbol == e->symbol;
+
+        if (!defined)
+        {
+            char* name = Intern_GetSymbol(e->symbol);
+            defined = once ? Preprocessor_IsOnceFile(name) : Preprocessor_IsDefined(name);
+        }
+
+        if (defined != e->result)
+            return false;
+    }
+    return true;
+}
+
+static void FreeHeader(CachedHeader* header)
+{
+    free(header->tokens);
+    free(header->locations);
+    free(header->strings);
+    free(header->events);
+    free(header->dependencies);
+    free(header);
+}
+
+static void* CopyRange(const void* data, size_t count, size_t memberSize)
+{
+    if (count == 0)
+        return NULL;
+    void* copy = xmalloc(count * memberSize);
+    memcpy(copy, data, count * memberSize);
+    return copy;
+}
+
+bool IncludeCache_TrySplice(char* path, TokenArray* t)
+{
+    FileStamp stamp;
+    if (!GetFileStamp(path, &stamp))
+        return false;
+
+    uint32_t fileId = Token_GetFileId(path);
+
+    // Queries made during validation must not end up in the log of enclosing recordings
+    GenericList* log = Preprocessor_GetLog();
+    Preprocessor_SetLog(NULL);
+
+    CachedHeader* hit = NULL;
+    for (size_t i = 0; i < ctx->cache.count && hit == NULL; i++)
+    {
+        CachedHeader* header = *(CachedHeader**)GenericList_At(&ctx->cache, i);
+        if (header->file.path != stamp.path)
+            continue;
+
+        if (!FileStampEquals(&header->file, &stamp))
+        {
+            // The file changed, so this version is never going to be used again
+            GenericList_Delete(&ctx->cache, GenericList_At(&ctx->cache, i));
+            FreeHeader(header);
+            i--;
+            continue;
+        }
+
+        if (header->fileId == fileId && DependenciesValid(header) && EventsValid(header))
+            hit = header;
+    }
+
+    if (hit != NULL)
+    {
+        // A precompiled header that is written depends on the files as if they were lexed
+        PCH_AddSource(Intern_GetSymbol(hit->file.path));
+        for (size_t i = 0; i < hit->numDependencies; i++)
+            PCH_AddSource(Intern_GetSymbol(hit->dependencies[i].path));
+
+        Token_AppendTokens(t, hit->tokens, hit->numTokens, hit->locations, hit->numLocations, hit->strings,
+                           hit->stringsLength);
+
+        for (size_t i = 0; i < hit->numEvents; i++)
+        {
+            if (hit->events[i].type == PreprocessorEvent_Define)
+                Preprocessor_Define(Intern_GetSymbol(hit->events[i].symbol));
+            else if (hit->events[i].type == PreprocessorEvent_Once)
+                Preprocessor_AddOnceFile(Intern_GetSymbol(hit->events[i].symbol));
+        }
+
+        // Enclosing headers depend on everything this one did
+        if (ctx->recordings.count != 0)
+        {
+            for (size_t i = 0; i < hit->numEvents; i++)
+                GenericList_Append(&ctx->eventLog, &hit->events[i]);
+            for (size_t i = 0; i < hit->numDependencies; i++)
+                GenericList_Append(&ctx->dependencyLog, &hit->dependencies[i]);
+            GenericList_Append(&ctx->dependencyLog, &hit->file);
+        }
+    }
+
+    Preprocessor_SetLog(log);
+    return hit != NULL;
+}
+
+void IncludeCache_BeginRecording(char* path, TokenArray* t)
+{
+    Recording r;
+    if (!GetFileStamp(path, &r.file))
+        r.file.path = UINT32_MAX;
+    r.fileId = Token_GetFileId(path);
+    r.firstToken = t->curLength;
+    r.firstLocation = t->locationsCount;
+    r.firstString = t->stringsLength;
+    r.firstEvent = ctx->eventLog.count;
+    r.firstDependency = ctx->dependencyLog.count;
+
+    if (ctx->recordings.count == 0)
+        Preprocessor_SetLog(&ctx->eventLog);
+    GenericList_Append(&ctx->recordings, &r);
+}
+
+void IncludeCache_EndRecording(TokenArray* t)
+{
+    Recording r = *(Recording*)GenericList_At(&ctx->recordings, ctx->recordings.count - 1);
+    GenericList_Delete(&ctx->recordings, GenericList_At(&ctx->recordings, ctx->recordings.count - 1));
+
+    if (r.file.path != UINT32_MAX)
+    {
+        CachedHeader* header = xmalloc(sizeof(CachedHeader));
+        header->file = r.file;
+        header->fileId = r.fileId;
+
+        header->numTokens = t->curLength - r.firstToken;
+        header->tokens = CopyRange(&t->tokens[r.firstToken], header->numTokens, sizeof(Token));
+
+        // The first token might have been merged into the location group of the previous one
+        size_t firstLocation = r.firstLocation;
+        if (firstLocation > 0 && t->locations[firstLocation - 1].highestTokenIndex >= r.firstToken)
+            firstLocation--;
+        if (header->numTokens == 0)
+            firstLocation = t->locationsCount;
+        header->numLocations = t->locationsCount - firstLocation;
+        header->locations = CopyRange(&t->locations[firstLocation], header->numLocations, sizeof(TokenSourceGroup));
+        for (size_t i = 0; i < header->numLocations; i++)
+            header->locations[i].highestTokenIndex -= (uint32_t)r.firstToken;
+
+        header->stringsLength = t->stringsLength - r.firstString;
+        header->strings = CopyRange(Token_StringAt(t, (uint32_t)r.firstString), header->stringsLength, 1);
+        for (size_t i = 0; i < header->numTokens; i++)
+            if (header->tokens[i].type == StringLiteral || header->tokens[i].type == AsmKeyword)
+                header->tokens[i].data -= (uint32_t)r.firstString;
+
+        header->numEvents = ctx->eventLog.count - r.firstEvent;
+        header->events = CopyRange(GenericList_At(&ctx->eventLog, r.firstEvent), header->numEvents,
+                                   sizeof(PreprocessorEvent));
+        header->numDependencies = ctx->dependencyLog.count - r.firstDependency;
+        header->dependencies = CopyRange(GenericList_At(&ctx->dependencyLog, r.firstDependency), header->numDependencies,
+                                         sizeof(FileStamp));
+
+        GenericList_Append(&ctx->cache, &header);
+        GenericList_Append(&ctx->dependencyLog, &r.file);
+    }
+
+    if (ctx->recordings.count == 0)
+    {
+        Preprocessor_SetLog(NULL);
+        ctx->eventLog.count = 0;
+        ctx->dependencyLog.count = 0;
+    }
+}
+
+void IncludeCache_AbortRecordings()
+{
+    if (ctx->recordings.count == 0)
+        return;
+    Preprocessor_SetLog(NULL);
+    ctx->recordings.count = 0;
+    ctx->eventLog.count = 0;
+    ctx->dependencyLog.count = 0;
+}
+
+IncludeCacheContext* IncludeCache_CreateContext()
+{
+    IncludeCacheContext* context = xmalloc(sizeof(IncludeCacheContext));
+    context->cache = GenericList_Create(sizeof(CachedHeader*));
+    context->recordings = GenericList_Create(sizeof(Recording));
+    context->eventLog = GenericList_Create(sizeof(PreprocessorEvent));
+    context->dependencyLog = GenericList_Create(sizeof(FileStamp));
+    return context;
+}
+
+void IncludeCache_DisposeContext(IncludeCacheContext* context)
+{
+    for (size_t i = 0; i < context->cache.count; i++)
+        FreeHeader(*(CachedHeader**)GenericList_At(&context->cache, i));
+
+    GenericList_Dispose(&context->cache);
+    GenericList_Dispose(&context->recordings);
+    GenericList_Dispose(&context->eventLog);
+    GenericList_Dispose(&context->dependencyLog);
+    if (ctx == context)
+        ctx = NULL;
+    free(context);
+}
+
+void IncludeCache_UseContext(IncludeCacheContext* context)
+{
+    ctx = context;
+}
+#endif
+
+#ifdef CUSTOM_COMP
+bool IncludeCache_TrySplice(char* path, TokenArray* t)
+{
+    return false;
+}
+void IncludeCache_BeginRecording(char* path, TokenArray* t) {}
+void IncludeCache_EndRecording(TokenArray* t) {}
+void IncludeCache_AbortRecordings() {}
+IncludeCacheContext* IncludeCache_CreateContext()
+{
+    return NULL;
+}
+void IncludeCache_DisposeContext(IncludeCacheContext* context) {}
+void IncludeCache_UseContext(IncludeCacheContext* context) {}
+#endif
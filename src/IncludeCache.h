@@ -0,0 +1,26 @@
+#pragma once
+#include "Token.h"
+#include <stdbool.h>
+
+// Caches the token streams of included headers across translation units.
+// A cached header is reused if the file is unchanged (by canonical path, mtime
+// and size) and all preprocessor queries made while lexing it would give the
+// same results now. Its defines are then replayed instead of re-lexing the file.
+
+// Appends the cached tokens of the header at path to t. If this returns false,
+// the header has to be lexed between BeginRecording and EndRecording instead.
+bool IncludeCache_TrySplice(char* path, TokenArray* t);
+void IncludeCache_BeginRecording(char* path, TokenArray* t);
+void IncludeCache_EndRecording(TokenArray* t);
+// Drops the headers that are being recorded, without caching them.
+void IncludeCache_AbortRecordings();
+
+#ifndef CUSTOM_COMP
+typedef struct IncludeCacheContext IncludeCacheContext;
+#endif
+#ifdef CUSTOM_COMP
+typedef struct IncludeCacheContext {} IncludeCacheContext;
+#endif
+IncludeCacheContext* IncludeCache_CreateContext();
+void IncludeCache_DisposeContext(IncludeCacheContext* context);
+void IncludeCache_UseContext(IncludeCacheContext* context);
@@ -0,0 +1,175 @@
+#include "Intern.h"
+#include "Util.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct
+{
+    char* string;
+    uint32_t hash;
+    uint32_t length;
+    uint32_t id;
+} InternEntry;
+
+#ifndef CUSTOM_COMP
+typedef struct InternBlock InternBlock;
+#endif
+#ifdef CUSTOM_COMP
+typedef struct InternBlock {} InternBlock;
+#endif
+
+// Interned strings are never freed individually, so they are
+// packed into large blocks instead of being allocated one by one.
+// The string data directly follows the block header.
+typedef struct InternBlock
+{
+    InternBlock* next;
+    size_t used;
+} InternBlock;
+
+static const size_t INTERN_BLOCK_SIZE = 16384;
+
+typedef struct InternContext
+{
+    InternEntry* entries;
+    size_t numEntries;
+    size_t maxEntries;
+    // Maps symbol ids back to their strings
+    char** symbols;
+    InternBlock* blocks;
+} InternContext;
+
+#ifndef CUSTOM_COMP
+static _Thread_local InternContext* ctx = NULL;
+#endif
+#ifdef CUSTOM_COMP
+static InternContext* ctx = NULL;
+#endif
+
+InternContext* Intern_CreateContext()
+{
+    InternContext* context = xmalloc(sizeof(InternContext));
+    memset(context, 0, sizeof(InternContext));
+    return context;
+}
+
+void Intern_DisposeContext(InternContext* context)
+{
+    while (context->blocks != NULL)
+    {
+        InternBlock* next = context->blocks->next;
+        free(context->blocks);
+        context->blocks = next;
+    }
+    free(context->entries);
+    free(context->symbols);
+    if (ctx == context)
+        ctx = NULL;
+    free(context);
+}
+
+void Intern_UseContext(InternContext* context)
+{
+    ctx = context;
+}
+
+static uint32_t HashString(const char* str, size_t length)
+{
+    // FNV-1a
+    uint32_t hash = 0x811C9DC5;
+    for (size_t i = 0; i < length; i++)
+    {
+        hash ^= (uint32_t)(str[i] & 0xFF);
+        hash *= 0x01000193;
+    }
+    return hash;
+}
+
+static char* StoreString(const char* str, size_t length)
+{
+    if (ctx->blocks == NULL || ctx->blocks->used + length + 1 > INTERN_BLOCK_SIZE)
+    {
+        size_t size = INTERN_BLOCK_SIZE;
+        if (length + 1 > size)
+            size = length + 1;
+
+        InternBlock* block = xmalloc(sizeof(InternBlock) + size);
+        block->used = 0;
+        block->next = ctx->blocks;
+        ctx->blocks = block;
+    }
+
+    char* copy = (char*)(ctx->blocks + 1) + ctx->blocks->used;
+    memcpy(copy, str, length);
+    copy[length] = 0;
+    ctx->blocks->used += length + 1;
+    return copy;
+}
+
+static void Grow()
+{
+    size_t oldMax = ctx->maxEntries;
+    InternEntry* old = ctx->entries;
+
+    ctx->maxEntries = (oldMax == 0) ? 1024 : oldMax * 2;
+    ctx->entries = xmalloc(ctx->maxEntries * sizeof(InternEntry));
+    memset(ctx->entries, 0, ctx->maxEntries * sizeof(InternEntry));
+    ctx->symbols = xrealloc(ctx->symbols, ctx->maxEntries * sizeof(char*));
+
+    for (size_t i = 0; i < oldMax; i++)
+    {
+        if (old[i].string == NULL)
+            continue;
+
+        size_t j = (size_t)old[i].hash & (ctx->maxEntries - 1);
+        while (ctx->entries[j].string != NULL)
+            j = (j + 1) & (ctx->maxEntries - 1);
+        ctx->entries[j] = old[i];
+    }
+
+    free(old);
+}
+
+uint32_t Intern_Symbol(const char* str, size_t length)
+{
+    // Keep the load factor below 1/2
+    if ((ctx->numEntries + 1) * 2 > ctx->maxEntries)
+        Grow();
+
+    uint32_t hash = HashString(str, length);
+    size_t i = (size_t)hash & (ctx->maxEntries - 1);
+
+    while (ctx->entries[i].string != NULL)
+    {
+        if (ctx->entries[i].hash == hash && (size_t)ctx->entries[i].length == length && memcmp(ctx->entries[i].string, str, length) == 0)
+            return ctx->entries[i].id;
+        i = (i + 1) & (ctx->maxEntries - 1);
+    }
+
+    ctx->entries[i].string = StoreString(str, length);
+    ctx->entries[i].hash = hash;
+    ctx->entries[i].length = (uint32_t)length;
+    ctx->entries[i].id = (uint32_t)ctx->numEntries;
+    ctx->symbols[ctx->numEntries] = ctx->entries[i].string;
+    ctx->numEntries++;
+    return ctx->entries[i].id;
+}
+
+char* Intern_GetSymbol(uint32_t id)
+{
+    return ctx->symbols[(size_t)id];
+}
+
+char* Intern_String(const char* str, size_t length)
+{
+    // Interning may grow the symbol table, so look it up afterwards
+    uint32_t id = Intern_Symbol(str, length);
+    return ctx->symbols[(size_t)id];
+}
+
+char* Intern_CString(const char* str)
+{
+    return Intern_String(str, strlen(str));
+}
@@ -0,0 +1,22 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+// Returns the canonical copy of the given string. Equal strings are always
+// interned to the same pointer, so interned strings can be compared with ==.
+char* Intern_String(const char* str, size_t length);
+char* Intern_CString(const char* str);
+
+// Same as Intern_String, but returns a dense id for the string instead.
+uint32_t Intern_Symbol(const char* str, size_t length);
+char* Intern_GetSymbol(uint32_t id);
+
+#ifndef CUSTOM_COMP
+typedef struct InternContext InternContext;
+#endif
+#ifdef CUSTOM_COMP
+typedef struct InternContext {} InternContext;
+#endif
+InternContext* Intern_CreateContext();
+void Intern_DisposeContext(InternContext* context);
+void Intern_UseContext(InternContext* context);
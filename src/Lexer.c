@@ -1,7 +1,11 @@
 #include "Lexer.h"
 #include "Error.h"
+#include "IncludeCache.h"
+#include "Intern.h"
 #include "Lexer_generated.h"
+#include "PCH.h"
 #include "Preprocessor.h"
+#include "Scan.h"
 #include "Token.h"
 #include "Util.h"
 #include <ctype.h>
@@ -13,6 +17,13 @@
 #include <stdlib.h>
 #include <string.h>
 
+#ifndef CUSTOM_COMP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 char* readFileAsString(char* path, size_t* size)
 {
     FILE* f = fopen(path, "rb");
@@ -36,6 +47,51 @@ char* readFileAsString(char* path, size_t* size)
     return code;
 }
 
+// Maps the source file read-only instead of copying it into a heap buffer.
+// The lexer relies on the code being null terminated, which a mapping only
+// guarantees if the file does not end exactly on a page boundary (the rest of
+// the last page is zero-filled). In that case, and on any error, we fall back
+// to reading the file.
+bool Lexer_OpenSource(char* path, SourceBuffer* out)
+{
+#ifndef CUSTOM_COMP
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0 && (st.st_size % sysconf(_SC_PAGESIZE)) != 0)
+    {
+        void* mapping = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping != MAP_FAILED)
+        {
+            close(fd);
+            madvise(mapping, (size_t)st.st_size, MADV_SEQUENTIAL);
+            out->code = mapping;
+            out->length = (size_t)st.st_size;
+            out->isMapped = true;
+            return true;
+        }
+    }
+    close(fd);
+#endif
+    out->code = readFileAsString(path, &out->length);
+    out->isMapped = false;
+    return out->code != NULL;
+}
+
+void Lexer_CloseSource(SourceBuffer* buf)
+{
+#ifndef CUSTOM_COMP
+    if (buf->isMapped)
+        munmap(buf->code, buf->length);
+    else
+#endif
+        free(buf->code);
+    buf->code = NULL;
+    buf->length = 0;
+}
+
 /*
 static void PrintTokenArray(TokenArray* array)
 {
@@ -43,17 +99,17 @@ static void PrintTokenArray(TokenArray* array)
     {
         printf("Index: %i, Type: %i;", i, array->tokens[i].type);
 
-        if (array->tokens[i].data != NULL)
+        if (Token_GetData(&array->tokens[i]) != NULL)
         {
             printf(" Literal: ");
             switch (array->tokens[i].type)
             {
             case Identifier:
-                printf("\"%s\"", (char*)array->tokens[i].data);
+                printf("\"%s\"", (char*)Token_GetData(&array->tokens[i]));
                 break;
 
             case IntLiteral:
-                printf("%li", *((long*)array->tokens[i].data));
+                printf("%i", (int32_t)array->tokens[i].data);
                 break;
             default:
                 break;
@@ -77,11 +133,6 @@ static bool StringEquals(char* a, const char* b)
     return true;
 }
 
-bool IsNonIDChar(char c)
-{
-    return !((isalpha(c) || c == '_') || ((isdigit(c))));
-}
-
 static bool IsValidIDChar(char c, bool firstChar)
 {
     return (isalpha(c) || c == '_') || (!firstChar && (isdigit(c)));
@@ -104,10 +155,115 @@ static size_t ParseString(size_t streamLength, char* stream, const char* token)
     return SIZE_MAX;
 }
 
-static char buffer[256];
+#ifndef CUSTOM_COMP
+typedef struct LexerFrame LexerFrame;
+#endif
+#ifdef CUSTOM_COMP
+typedef struct LexerFrame {} LexerFrame;
+#endif
+
+// A file that is being lexed. Included files are lexed on top of the file that includes them.
+typedef struct LexerFrame
+{
+    LexerFrame* outer;
+    SourceBuffer source;
+    size_t i;
+    int lineNumber;
+    char* fileName;
+    // File that tokens were attributed to before this one
+    uint32_t outerFileId;
+    // Included files are recorded for the include cache
+    bool isRecording;
+} LexerFrame;
+
+typedef struct LexerContext
+{
+    // Unescaped contents of the current string literal
+    char buffer[256];
+    LexerFrame* currentFrame;
+    // Translation unit between Lexer_Begin and Lexer_End
+    TokenArray* tokens;
+} LexerContext;
+
+#ifndef CUSTOM_COMP
+static _Thread_local LexerContext* ctx = NULL;
+#endif
+#ifdef CUSTOM_COMP
+static LexerContext* ctx = NULL;
+#endif
+
+LexerContext* Lexer_CreateContext()
+{
+    LexerContext* context = xmalloc(sizeof(LexerContext));
+    memset(context, 0, sizeof(LexerContext));
+    return context;
+}
+
+void Lexer_DisposeContext(LexerContext* context)
+{
+    // Only left over if compilation was aborted by an error
+    while (context->currentFrame != NULL)
+    {
+        LexerFrame* f = context->currentFrame;
+        Lexer_CloseSource(&f->source);
+        context->currentFrame = f->outer;
+        free(f);
+    }
+    if (context->tokens != NULL)
+        Token_DeleteArray(context->tokens);
+    if (ctx == context)
+        ctx = NULL;
+    free(context);
+}
+
+void Lexer_UseContext(LexerContext* context)
+{
+    ctx = context;
+}
 
-static bool ParseStringLiteral(TokenArray* t, size_t* i, size_t length, int lineNumber, char* code,
-                               char* sourceFileName)
+static void PushFrame(TokenArray* t, SourceBuffer* source, char* fileName, bool isRecording)
+{
+    LexerFrame* f = xmalloc(sizeof(LexerFrame));
+    f->outer = ctx->currentFrame;
+    f->source = *source;
+    f->i = 0;
+    f->lineNumber = 1;
+    f->fileName = fileName;
+    f->isRecording = isRecording;
+    if (isRecording)
+        IncludeCache_BeginRecording(fileName, t);
+    PCH_AddSource(fileName);
+    f->outerFileId = Token_SetSourceFile(t, Token_GetFileId(fileName));
+    ctx->currentFrame = f;
+}
+
+static void PopFrame(TokenArray* t)
+{
+    LexerFrame* f = ctx->currentFrame;
+    Token_SetSourceFile(t, f->outerFileId);
+    if (f->isRecording)
+        IncludeCache_EndRecording(t);
+    Lexer_CloseSource(&f->source);
+    ctx->currentFrame = f->outer;
+    free(f);
+}
+
+// Operators and punctuation
+static bool ParseNext(char* code, TokenArray* t, size_t* i, int lineNumber)
+{
+    TokenType token = None;
+
+    size_t newI = TokenizeSwitch(code, &token, *i);
+    if (newI == 0)
+        return false;
+
+    *i = newI;
+
+    Token_AppendArray(Token_Get(token), t, (uint32_t)lineNumber);
+    return true;
+}
+
+static bool ParseStringLiteral(TokenArray* t, size_t* i, size_t length, int lineNumber, char* code)
 {
     size_t bufferIndex = 0;
 
@@ -117,6 +273,16 @@ static bool ParseStringLiteral(TokenArray* t, size_t* i, size_t length, int line
     size_t j;
     for (j = (*i) + 1; j < length; j++)
     {
+        // Copy plain characters in bulk, only escapes and the end need a closer look
+        size_t end = Scan_StringBody(code, length, j);
+        if (bufferIndex + (end - j) > 256 - 1)
+            ErrorAtLine("String too long!", lineNumber);
+        memcpy(&ctx->buffer[bufferIndex], &code[j], end - j);
+        bufferIndex += end - j;
+        j = end;
+        if (j >= length)
+            break;
+
         if (bufferIndex > 256 - 1)
             ErrorAtLine("String too long!", lineNumber);
         if (code[j] == '\\')
@@ -127,64 +293,64 @@ static bool ParseStringLiteral(TokenArray* t, size_t* i, size_t length, int line
 
             // Just basic escape sequences
             if (code[j] == '\\')
-                buffer[bufferIndex++] = '\\';
+                ctx->buffer[bufferIndex++] = '\\';
             else if (code[j] == 'n')
-                buffer[bufferIndex++] = '\n';
+                ctx->buffer[bufferIndex++] = '\n';
             else if (code[j] == 'r')
-                buffer[bufferIndex++] = '\r';
+                ctx->buffer[bufferIndex++] = '\r';
             else if (code[j] == '0')
-                buffer[bufferIndex++] = 0;
+                ctx->buffer[bufferIndex++] = 0;
             else if (code[j] == '\'')
-                buffer[bufferIndex++] = '\'';
+                ctx->buffer[bufferIndex++] = '\'';
             else if (code[j] == '\"')
-                buffer[bufferIndex++] = '\"';
+                ctx->buffer[bufferIndex++] = '\"';
             continue;
         }
         if (code[j] == '\"')
             break;
         if (code[j] == '\n')
             ErrorAtLine("Unterminated string literal!", lineNumber);
-        buffer[bufferIndex++] = code[j];
     }
 
-    char* stringLiteral = xmalloc(bufferIndex + 1);
-    memcpy(stringLiteral, &buffer[0], bufferIndex);
+    uint32_t offset = Token_ReserveString(t, bufferIndex + 1);
+    char* stringLiteral = Token_StringAt(t, offset);
+    memcpy(stringLiteral, &ctx->buffer[0], bufferIndex);
     stringLiteral[bufferIndex] = 0; // Null terminate
-    Token_AppendArray(Token_GetString(StringLiteral, stringLiteral), t, lineNumber, sourceFileName);
+    Token_AppendArray((Token){StringLiteral, offset}, t, (uint32_t)lineNumber);
     *i = j + 1;
     return true;
 }
 
+// Identifiers and keywords
 static bool ParseIdentifier(TokenArray* t, size_t* i, size_t length, int lineNumber, char* code, char* sourceFileName)
 {
-    size_t bufferIndex = 0;
+    if (*i >= length || !IsValidIDChar(code[*i], true))
+        return false;
 
-    size_t j;
-    for (j = *i; j < length; j++)
-    {
-        if (bufferIndex > 256 - 1)
-            ErrorAtLineInFile("Identifier too long!", lineNumber, sourceFileName);
+    // Find the end of the identifier first, so it can be interned straight out of the source.
+    size_t j = Scan_Identifier(code, length, *i + 1);
 
-        if (IsValidIDChar(code[j], j == *i))
-            buffer[bufferIndex++] = code[j];
-        else
-            break;
-    }
-    if (bufferIndex > 0)
+    size_t len = j - *i;
+    if (len > 256 - 1)
+        ErrorAtLineInFile("Identifier too long!", lineNumber, sourceFileName);
+
+    TokenType keyword;
+    int32_t literal = 0;
+    if (LookupKeyword(code + *i, len, &keyword, &literal))
     {
-        char* stringLiteral = xmalloc(bufferIndex + 1);
-        if (stringLiteral == NULL)
-            Error("Out of memory!");
-        memcpy(stringLiteral, &buffer[0], bufferIndex);
-        stringLiteral[bufferIndex] = 0; // Null terminate
-        Token_AppendArray(Token_GetString(Identifier, stringLiteral), t, lineNumber, sourceFileName);
-        *i = j;
-        return true;
+        // Inline assembly has its own parser
+        if (keyword == AsmKeyword)
+            return false;
+        Token_AppendArray(Token_GetInt(keyword, literal), t, (uint32_t)lineNumber);
     }
-    return false;
+    else
+        Token_AppendArray(Token_GetIdentifier(code + *i, len), t, (uint32_t)lineNumber);
+
+    *i = j;
+    return true;
 }
 
-static bool ParseIntLiteral(TokenArray* t, size_t* i, int lineNumber, char* code, char* sourceFileName)
+static bool ParseIntLiteral(TokenArray* t, size_t* i, int lineNumber, char* code)
 {
     errno = 0;
     char* end;
@@ -196,7 +362,7 @@ static bool ParseIntLiteral(TokenArray* t, size_t* i, int lineNumber, char* code
         return false;
     *i += end - (code + (*i)); // Skip over parsed literal with i
 
-    int32_t* intPtr = xmalloc(sizeof(int32_t));
+    int32_t value = 0;
 
     // Parsing a fractional literal.
     // These also get turned into int literals as
@@ -217,17 +383,17 @@ static bool ParseIntLiteral(TokenArray* t, size_t* i, int lineNumber, char* code
             div *= 10;
 
 #ifndef CUSTOM_COMP
-        *intPtr = (int)round((((double)literal + ((double)literalFrac / (div))) * 256.0));
+        value = (int)round((((double)literal + ((double)literalFrac / (div))) * 256.0));
 #endif
     }
     else
-        *intPtr = literal;
+        value = literal;
 
-    Token_AppendArray(Token_GetInt(IntLiteral, intPtr), t, lineNumber, sourceFileName);
+    Token_AppendArray(Token_GetInt(IntLiteral, value), t, (uint32_t)lineNumber);
     return true;
 }
 
-static bool ParseCharLiteral(TokenArray* t, size_t* i, size_t length, int lineNumber, char* code, char* sourceFileName)
+static bool ParseCharLiteral(TokenArray* t, size_t* i, size_t length, int lineNumber, char* code)
 {
     if (code[*i] == '\'')
     {
@@ -264,9 +430,7 @@ static bool ParseCharLiteral(TokenArray* t, size_t* i, size_t length, int lineNu
             literal = code[*i];
         if (++(*i) >= length || code[*i] != '\'')
             return false;
-        int32_t* copy = xmalloc(sizeof(uint32_t));
-        *copy = (int32_t)literal;
-        Token_AppendArray(Token_GetInt(IntLiteral, copy), t, lineNumber, sourceFileName);
+        Token_AppendArray(Token_GetInt(IntLiteral, (int32_t)literal), t, (uint32_t)lineNumber);
         if (++(*i) >= length)
             return false;
         return true;
@@ -276,23 +440,16 @@ static bool ParseCharLiteral(TokenArray* t, size_t* i, size_t length, int lineNu
 
 static void SkipWhitespace(size_t* i, size_t length, int* lineNumber, char* code, bool allowNewline)
 {
-    size_t len = 0;
+    int newlines = 0;
+    size_t end = Scan_Whitespace(code, length, *i, &newlines);
 
-    while (isspace(code[*i + len]))
-    {
-        if (code[*i + len] == '\n')
-        {
-            if (allowNewline)
-                (*lineNumber)++;
-            else
-                ErrorAtLine("Syntax Error!", *lineNumber);
-        }
-        len++;
-        if (*i + len >= length)
-            ErrorAtLine("Syntax Error!", *lineNumber);
-    }
+    if (newlines != 0 && !allowNewline)
+        ErrorAtLine("Syntax Error!", *lineNumber);
+    if (end != *i && end >= length)
+        ErrorAtLine("Syntax Error!", *lineNumber);
 
-    (*i) += len;
+    *lineNumber += newlines;
+    *i = end;
 }
 
 static bool ParseInlineAssembly(TokenArray* t, size_t* i, size_t length, int* lineNumber, char* code,
@@ -313,9 +470,6 @@ static bool ParseInlineAssembly(TokenArray* t, size_t* i, size_t length, int* li
         if (code[*i] != '{')
             ErrorAtLineInFile("Invalid inline assembly!", *lineNumber, sourceFileName);
 
-        int maxLen = 32;
-        char* assembly = xmalloc(maxLen);
-
         (*i)++;
         int j = 0;
         int k = 0;
@@ -324,6 +478,16 @@ static bool ParseInlineAssembly(TokenArray* t, size_t* i, size_t length, int* li
                 (*lineNumber)++;
         // SkipWhitespace(i, length, lineNumber, code, true);
 
+        // The copied text is never longer than the span up to the closing brace,
+        // so it can be allocated in one go.
+        size_t end = *i + k;
+        while (end < length && code[end] != '}')
+            end++;
+        if (end >= length)
+            ErrorAtLineInFile("Invalid inline assembly!", *lineNumber, sourceFileName);
+        uint32_t offset = Token_ReserveString(t, end - (*i + k) + 1);
+        char* assembly = Token_StringAt(t, offset);
+
         while (code[*i + k] != '}')
         {
             if (*i + k >= length)
@@ -344,19 +508,140 @@ static bool ParseInlineAssembly(TokenArray* t, size_t* i, size_t length, int* li
 
             j++;
             k++;
-            if (j >= maxLen)
-                assembly = xrealloc(assembly, maxLen = maxLen + 32);
         }
 
         assembly[j++] = 0;
         (*i) += k + 1;
-        Token_AppendArray(Token_GetString(AsmKeyword, assembly), t, *lineNumber, sourceFileName);
+        Token_AppendArray((Token){AsmKeyword, offset}, t, (uint32_t)*lineNumber);
         return true;
     }
 
     return false;
 }
 
+// Skips a conditional that is not taken, up to behind its #endif. Returns SIZE_MAX if
+// there is no matching #endif.
+static size_t SkipConditional(char* code, size_t length, size_t i, int* lineNumber)
+{
+    int ifDepth = 1;
+    size_t len;
+
+    while (ifDepth)
+    {
+        if (i >= length)
+            return SIZE_MAX;
+        if (code[i] == '#')
+        {
+            if ((len = ParseStringStrict(length - i, code + i, "#endif")) != SIZE_MAX)
+            {
+                i += len;
+                ifDepth--;
+                continue;
+            }
+            if ((len = ParseStringStrict(length - i, code + i, "#ifdef")) != SIZE_MAX)
+            {
+                i += len;
+                ifDepth++;
+                continue;
+            }
+            if ((len = ParseStringStrict(length - i, code + i, "#ifndef")) != SIZE_MAX)
+            {
+                i += len;
+                ifDepth++;
+                continue;
+            }
+        }
+        if (code[i] == '\n')
+            (*lineNumber)++;
+        i++;
+    }
+    return i;
+}
+
+// Skips whitespace and comments
+static size_t SkipBlank(char* code, size_t length, size_t i)
+{
+    int newlines = 0;
+    while (true)
+    {
+        i = Scan_Whitespace(code, length, i, &newlines);
+        if (i + 1 < length && code[i] == '/' && code[i + 1] == '*')
+            i = Scan_BlockComment(code, length, i + 2, &newlines);
+        else if (i + 1 < length && code[i] == '/' && code[i + 1] == '/')
+            i = Scan_LineComment(code, length, i + 2);
+        else
+            return i;
+    }
+}
+
+// Reads the name behind a directive like the directives themselves do.
+// Returns the index behind it, or SIZE_MAX if there is none.
+static size_t ReadDirectiveName(char* code, size_t length, size_t i, char* name, size_t nameLength)
+{
+    while (i < length && (code[i] == ' ' || code[i] == '\t'))
+        i++;
+
+    size_t j = 0;
+    while (i < length && !isspace(code[i]))
+    {
+        if (j + 1 >= nameLength)
+            return SIZE_MAX;
+        name[j++] = code[i++];
+    }
+    name[j] = 0;
+
+    if (j == 0)
+        return SIZE_MAX;
+    return i;
+}
+
+// Checks if the file is wrapped in a classic include guard: apart from whitespace and
+// comments, it consists only of "#ifndef X", "#define X", ... "#endif". Writes X to macro.
+static bool FindIncludeGuard(char* code, size_t length, char* macro, size_t macroLength)
+{
+    size_t i = SkipBlank(code, length, 0);
+    size_t len = ParseStringStrict(length - i, code + i, "#ifndef");
+    if (len == SIZE_MAX)
+        return false;
+    i = ReadDirectiveName(code, length, i + len, macro, macroLength);
+    if (i == SIZE_MAX)
+        return false;
+    size_t body = i;
+
+    char defined[128];
+    i = SkipBlank(code, length, i);
+    len = ParseStringStrict(length - i, code + i, "#define");
+    if (len == SIZE_MAX || ReadDirectiveName(code, length, i + len, &defined[0], 128) == SIZE_MAX)
+        return false;
+    if (strcmp(macro, &defined[0]) != 0)
+        return false;
+
+    // This is what the lexer skips if the macro is defined
+    int lines = 0;
+    i = SkipConditional(code, length, body, &lines);
+    if (i == SIZE_MAX)
+        return false;
+    i = SkipBlank(code, length, i);
+    return i >= length || code[i] == 0;
+}
+
+// Interned canonical path of a source file, so that a file is identified the same
+// way no matter how it was included. NULL if the file does not exist.
+static char* CanonicalPath(char* path)
+{
+#ifndef CUSTOM_COMP
+    char* resolved = realpath(path, NULL);
+    if (resolved == NULL)
+        return NULL;
+    char* canonical = Intern_CString(resolved);
+    free(resolved);
+    return canonical;
+#endif
+#ifdef CUSTOM_COMP
+    return Intern_CString(path);
+#endif
+}
+
 static bool ParsePreprocessorDirectives(TokenArray* t, size_t* i, size_t length, int* lineNumber, char* code,
                                         char* sourceFileName)
 {
@@ -411,11 +696,28 @@ static bool ParsePreprocessorDirectives(TokenArray* t, size_t* i, size_t length,
                 fileNameBuffer[len++] = 0;
                 (*i)++;
 
-                size_t inclLength = 0;
-                char* includedFile = readFileAsString(&fileNameBuffer[0], &inclLength);
+                // Missing headers (e.g. system headers) are silently skipped.
+                char* canonical = CanonicalPath(&fileNameBuffer[0]);
+                if (canonical == NULL)
+                    return true;
+
+                // Headers that would not add anything are skipped before opening them
+                if (Preprocessor_IsOnceFile(canonical) || Preprocessor_IsIncludeGuarded(canonical))
+                    return true;
+
+                if (IncludeCache_TrySplice(&fileNameBuffer[0], t))
+                    return true;
 
-                LexIntoArray(includedFile, inclLength, t, &fileNameBuffer[0]);
-                free(includedFile);
+                SourceBuffer included;
+                if (Lexer_OpenSource(&fileNameBuffer[0], &included))
+                {
+                    char guard[128];
+                    if (FindIncludeGuard(included.code, included.length, &guard[0], 128))
+                        Preprocessor_SetIncludeGuard(canonical, &guard[0]);
+
+                    // Lexed from here on, on top of this file
+                    PushFrame(t, &included, Intern_CString(&fileNameBuffer[0]), true);
+                }
                 return true;
             }
         }
@@ -448,21 +750,14 @@ static bool ParsePreprocessorDirectives(TokenArray* t, size_t* i, size_t length,
         {
             *i += len;
 
-            const char* iter = sourceFileName;
-            const char* lastSlashSubstring = iter;
-            while (*iter != 0)
-            {
-                if (*iter == '/')
-                {
-                    lastSlashSubstring = iter + 1;
-                }
-                iter++;
-            }
+            char* canonical = CanonicalPath(sourceFileName);
+            if (canonical == NULL)
+                canonical = sourceFileName;
 
-            if (Preprocessor_IsDefined(lastSlashSubstring))
+            if (Preprocessor_IsOnceFile(canonical))
                 *i = length;
             else
-                Preprocessor_Define(lastSlashSubstring);
+                Preprocessor_AddOnceFile(canonical);
 
             return true;
         }
@@ -487,31 +782,9 @@ static bool ParsePreprocessorDirectives(TokenArray* t, size_t* i, size_t length,
             // If not defined, just skip until we find an #endif
             if (!Preprocessor_IsDefined(&buffer[0]))
             {
-                int ifDepth = 1;
-
-                while (ifDepth)
-                {
-                    if (*i >= length)
-                        Error("Unterminated #ifdef");
-                    if (code[*i] == '#')
-                    {
-                        if ((len = ParseStringStrict(length - *i, code + *i, "#endif")) != SIZE_MAX)
-                        {
-                            *i += len;
-                            ifDepth--;
-                            continue;
-                        }
-                        if ((len = ParseStringStrict(length - *i, code + *i, "#ifdef")) != SIZE_MAX)
-                        {
-                            *i += len;
-                            ifDepth++;
-                            continue;
-                        }
-                    }
-                    if (code[*i] == '\n')
-                        (*lineNumber)++;
-                    (*i)++;
-                }
+                *i = SkipConditional(code, length, *i, lineNumber);
+                if (*i == SIZE_MAX)
+                    Error("Unterminated #ifdef");
             }
 
             return true;
@@ -537,31 +810,9 @@ static bool ParsePreprocessorDirectives(TokenArray* t, size_t* i, size_t length,
             // If defined, just skip until we find an #endif
             if (Preprocessor_IsDefined(&buffer[0]))
             {
-                int ifDepth = 1;
-
-                while (ifDepth)
-                {
-                    if (*i >= length)
-                        Error("Unterminated #ifdef");
-                    if (code[*i] == '#')
-                    {
-                        if ((len = ParseStringStrict(length - *i, code + *i, "#endif")) != SIZE_MAX)
-                        {
-                            *i += len;
-                            ifDepth--;
-                            continue;
-                        }
-                        if ((len = ParseStringStrict(length - *i, code + *i, "#ifdef")) != SIZE_MAX)
-                        {
-                            *i += len;
-                            ifDepth++;
-                            continue;
-                        }
-                    }
-                    if (code[*i] == '\n')
-                        (*lineNumber)++;
-                    (*i)++;
-                }
+                *i = SkipConditional(code, length, *i, lineNumber);
+                if (*i == SIZE_MAX)
+                    Error("Unterminated #ifdef");
             }
 
             return true;
@@ -581,85 +832,146 @@ static bool ParsePreprocessorDirectives(TokenArray* t, size_t* i, size_t length,
     return false;
 }
 
-void LexIntoArray(char* code, size_t length, TokenArray* t, char* sourceFileName)
+// Lexes the next token or directive of the innermost file
+static void LexNext(TokenArray* t, LexerFrame* f)
 {
-    // TokenArray t = CreateTokenArray(32);
-    int lineNumber = 1;
-
-    for (size_t i = 0; i < length; NULL)
+    char* code = f->source.code;
+    size_t length = f->source.length;
+    size_t* i = &f->i;
+    int* lineNumber = &f->lineNumber;
+    char* sourceFileName = f->fileName;
+    size_t remLen = length - *i;
+
+    if (isspace(code[*i]))
     {
+        int newlines = 0;
+        *i = Scan_Whitespace(code, length, *i, &newlines);
+        *lineNumber += newlines;
+        return;
+    }
+    size_t len;
 
-        size_t remLen = length - i;
-
-        if (code[i] == 0)
-            break;
+    /* Multiline
+       Comment  */
+    if ((len = ParseString(remLen, code + *i, "/*")) != SIZE_MAX)
+    {
+        int newlines = 0;
+        *i = Scan_BlockComment(code, length, *i + len, &newlines);
+        *lineNumber += newlines;
+        return;
+    }
 
-        if (code[i] == '\n')
-        {
-            i++;
-            lineNumber++;
-            continue;
-        }
+    // Single Line Comment
+    if ((len = ParseString(remLen, code + *i, "//")) != SIZE_MAX)
+    {
+        *i = Scan_LineComment(code, length, *i + len);
+        return;
+    }
 
-        if (isspace(code[i]))
-        {
-            i++;
-            continue;
-        }
-        size_t len;
+    // Actual C Tokens
+    if (ParseNext(code, t, i, *lineNumber))
+        return;
+    if (ParseIdentifier(t, i, length, *lineNumber, code, sourceFileName))
+        return;
+    if (ParseInlineAssembly(t, i, length, lineNumber, code, sourceFileName))
+        return;
+    if (ParseIntLiteral(t, i, *lineNumber, code))
+        return;
+    if (ParseStringLiteral(t, i, length, *lineNumber, code))
+        return;
+    if (ParseCharLiteral(t, i, length, *lineNumber, code))
+        return;
+
+    if (code[*i] == '#' && ParsePreprocessorDirectives(t, i, length, lineNumber, code, sourceFileName))
+        return;
+
+    ErrorAtLineInFile("Unrecognized Symbol!", *lineNumber, sourceFileName);
+}
 
-        /* Multiline
-           Comment  */
-        if ((len = ParseString(remLen, code + i, "/*")) != SIZE_MAX)
-        {
-            i += len;
+// Lexes until there are at least count tokens, or the translation unit ends
+static void LexUntil(TokenArray* t, size_t count)
+{
+    while (t->curLength < count && ctx->currentFrame != NULL)
+    {
+        LexerFrame* f = ctx->currentFrame;
+        if (f->i >= f->source.length || f->source.code[f->i] == 0)
+            PopFrame(t);
+        else
+            LexNext(t, f);
+    }
+}
 
-            while (!(code[i] == '/' && code[i - 1] == '*') && i < length)
-                if (code[i++] == '\n')
-                    lineNumber++;
+TokenArray* Lexer_Begin(char* sourceFilePath)
+{
+    SourceBuffer source;
+    if (!Lexer_OpenSource(sourceFilePath, &source))
+        Error("Invalid source file");
+    TokenArray* t = Token_CreateArray(32);
+    ctx->tokens = t;
+    PushFrame(t, &source, Intern_CString(sourceFilePath), false);
+    return t;
+}
 
-            if (code[i++] == '\n')
-                lineNumber++;
-            continue;
-        }
+bool Lexer_LexItem(TokenArray* t, size_t i)
+{
+    // Items end with a semicolon, except for function definitions, which end with
+    // the brace that closes the body. The body is the first brace behind a ')'.
+    int depth = 0;
+    bool isFunction = false;
+    size_t j = i;
+    while (true)
+    {
+        LexUntil(t, j + 1);
+        if (j >= t->curLength)
+            return j != i;
 
-        // Single Line Comment
-        if ((len = ParseString(remLen, code + i, "//")) != SIZE_MAX)
+        TokenType type = t->tokens[j].type;
+        if (type == CBrOpen)
         {
-            i += len;
-            while (code[i] != '\n' && i < length)
-                i++;
-            continue;
+            if (depth == 0 && j > i && t->tokens[j - 1].type == RBrClose)
+                isFunction = true;
+            depth++;
         }
+        else if (type == CBrClose)
+            depth--;
+        j++;
 
-        // Actual C Tokens
-        if (ParseNext(code, t, sourceFileName, &i, lineNumber))
-            continue;
-        if (ParseInlineAssembly(t, &i, length, &lineNumber, code, sourceFileName))
-            continue;
-        if (ParseIdentifier(t, &i, length, lineNumber, code, sourceFileName))
-            continue;
-        if (ParseIntLiteral(t, &i, lineNumber, code, sourceFileName))
-            continue;
-        if (ParseStringLiteral(t, &i, length, lineNumber, code, sourceFileName))
-            continue;
-        if (ParseCharLiteral(t, &i, length, lineNumber, code, sourceFileName))
-            continue;
+        if ((type == Semicolon && depth == 0) || (type == CBrClose && depth == 0 && isFunction) || depth < 0)
+            break;
+    }
 
-        if (code[i] == '#' && ParsePreprocessorDirectives(t, &i, length, &lineNumber, code, sourceFileName))
-            continue;
+    // One token of lookahead, as if the whole file had been lexed
+    LexUntil(t, j + 1);
+    return true;
+}
 
-        ErrorAtLineInFile("Unrecognized Symbol!", lineNumber, sourceFileName);
-    }
+size_t Lexer_Release(TokenArray* t, size_t i)
+{
+    // Headers that are being recorded for the include cache refer to their tokens by index
+    for (LexerFrame* f = ctx->currentFrame; f != NULL; f = f->outer)
+        if (f->isRecording)
+            return 0;
+
+    // Only compact once the released tokens outweigh the rest,
+    // so each token is moved a bounded number of times.
+    if (i < t->curLength - i)
+        return 0;
+
+    Token_Release(t, i);
+    return i;
 }
+
+void Lexer_End(TokenArray* t)
+{
+    while (ctx->currentFrame != NULL)
+        PopFrame(t);
+    Token_DeleteArray(t);
+    ctx->tokens = NULL;
+}
+
 TokenArray* Lex(char* sourceFilePath)
 {
-    size_t length;
-    char* code = readFileAsString(sourceFilePath, &length);
-    if (code == NULL)
-        Error("Invalid source file");
-    TokenArray* t = Token_CreateArray(32);
-    LexIntoArray(code, length, t, sourceFilePath);
-    free(code);
+    TokenArray* t = Lexer_Begin(sourceFilePath);
+    LexUntil(t, SIZE_MAX);
     return t;
 }
@@ -1,6 +1,39 @@
 #pragma once
 #include "Token.h"
+#include <stdbool.h>
+
+typedef struct
+{
+    char* code;
+    size_t length;
+    bool isMapped;
+} SourceBuffer;
 
 char* readFileAsString(char* path, size_t* size);
-void LexIntoArray(char* code, size_t length, TokenArray* t, char* sourceFileName);
+bool Lexer_OpenSource(char* path, SourceBuffer* out);
+void Lexer_CloseSource(SourceBuffer* buf);
+
+// Translation units are lexed on demand, one top level item (declaration or
+// function definition) at a time. Tokens of items that were compiled can be released.
+TokenArray* Lexer_Begin(char* sourceFilePath);
+// Makes sure that all tokens of the item starting at token i, and the token after it,
+// have been lexed. Returns false if there are no tokens left.
+bool Lexer_LexItem(TokenArray* t, size_t i);
+// Releases the tokens before i, if that is worthwhile. Returns the number of released
+// tokens, which the indices of the remaining tokens are shifted down by.
+size_t Lexer_Release(TokenArray* t, size_t i);
+// Closes all files and deletes t.
+void Lexer_End(TokenArray* t);
+
+// Lexes the whole translation unit at once.
 TokenArray* Lex(char* sourceFilePath);
+
+#ifndef CUSTOM_COMP
+typedef struct LexerContext LexerContext;
+#endif
+#ifdef CUSTOM_COMP
+typedef struct LexerContext {} LexerContext;
+#endif
+LexerContext* Lexer_CreateContext();
+void Lexer_DisposeContext(LexerContext* context);
+void Lexer_UseContext(LexerContext* context);
@@ -1,14 +1,12 @@
 #pragma once
+// Generated by util/GenerateLexer_main.c, do not edit.
 #include "Token.h"
-#include "Util.h"
 #include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
 
-bool IsNonIDChar(char c);
-
-size_t TokenizeSwitch(char* code, TokenType* token, void** tokenData, size_t i)
+size_t TokenizeSwitch(char* code, TokenType* token, size_t i)
 {
-    // Everything in this following switch is auto-generated using util/GenerateParser_main.c.
-    // While the code obviously looks terrible, this is a fast and easy way to parse.
     switch (code[i + 0])
     {
         case '!':
@@ -153,25 +151,6 @@ size_t TokenizeSwitch(char* code, TokenType* token, void** tokenData, size_t i)
         case '?':
             *token = QuestionMark;
             return i + 1;
-        case 'N':
-            if (code[i + 1] == 'U')
-            {
-                if (code[i + 2] == 'L')
-                {
-                    if (code[i + 3] == 'L')
-                    {
-                        if (IsNonIDChar(code[i + 4]))
-                        {
-                            *token = IntLiteral;
-                            int32_t* lit = xmalloc(sizeof(int32_t));
-                            *lit = 0;
-                            *tokenData = lit;
-                            return i + 4;
-                        }
-                    }
-                }
-            }
-            return 0;
         case '[':
             *token = ABrOpen;
             return i + 1;
@@ -186,674 +165,334 @@ size_t TokenizeSwitch(char* code, TokenType* token, void** tokenData, size_t i)
             }
             *token = BitwiseXOR;
             return i + 1;
-        case 'b':
+        case '{':
+            *token = CBrOpen;
+            return i + 1;
+        case '|':
             switch (code[i + 1])
             {
-                case 'o':
-                    if (code[i + 2] == 'o')
-                    {
-                        if (code[i + 3] == 'l')
-                        {
-                            if (IsNonIDChar(code[i + 4]))
-                            {
-                                *token = UintKeyword;
-                                return i + 4;
-                            }
-                        }
-                    }
-                    return 0;
-                case 'r':
-                    if (code[i + 2] == 'e')
-                    {
-                        if (code[i + 3] == 'a')
-                        {
-                            if (code[i + 4] == 'k')
-                            {
-                                if (IsNonIDChar(code[i + 5]))
-                                {
-                                    *token = BreakKeyword;
-                                    return i + 5;
-                                }
-                            }
-                        }
-                    }
-                    return 0;
+                case '=':
+                    *token = AssignmentOR;
+                    return i + 2;
+                case '|':
+                    *token = LogicalOR;
+                    return i + 2;
             }
-            return 0;
-        case 'c':
-            switch (code[i + 1])
+            *token = BitwiseOR;
+            return i + 1;
+        case '}':
+            *token = CBrClose;
+            return i + 1;
+        case '~':
+            *token = BitwiseNOT;
+            return i + 1;
+    }
+    return 0;
+}
+
+static size_t KeywordHash(const char* code, size_t length)
+{
+    return ((size_t)code[0] * 1 + (size_t)code[length / 2] * 6 + (size_t)code[length - 1] * 45 + length) & 127;
+}
+
+// Checks if the identifier code[0..length) is a keyword.
+bool LookupKeyword(const char* code, size_t length, TokenType* token, int32_t* literal)
+{
+    if (length < 2 || length > 8)
+        return false;
+
+    switch (KeywordHash(code, length))
+    {
+        case 3:
+            if (length == 2 && memcmp(code, "do", 2) == 0)
             {
-                case 'a':
-                    if (code[i + 2] == 's')
-                    {
-                        if (code[i + 3] == 'e')
-                        {
-                            if (IsNonIDChar(code[i + 4]))
-                            {
-                                *token = CaseKeyword;
-                                return i + 4;
-                            }
-                        }
-                    }
-                    return 0;
-                case 'h':
-                    if (code[i + 2] == 'a')
-                    {
-                        if (code[i + 3] == 'r')
-                        {
-                            if (IsNonIDChar(code[i + 4]))
-                            {
-                                *token = UintKeyword;
-                                return i + 4;
-                            }
-                        }
-                    }
-                    return 0;
-                case 'o':
-                    if (code[i + 2] == 'n')
-                    {
-                        switch (code[i + 3])
-                        {
-                            case 's':
-                                if (code[i + 4] == 't')
-                                {
-                                    if (IsNonIDChar(code[i + 5]))
-                                    {
-                                        *token = ConstKeyword;
-                                        return i + 5;
-                                    }
-                                }
-                                return 0;
-                            case 't':
-                                if (code[i + 4] == 'i')
-                                {
-                                    if (code[i + 5] == 'n')
-                                    {
-                                        if (code[i + 6] == 'u')
-                                        {
-                                            if (code[i + 7] == 'e')
-                                            {
-                                                if (IsNonIDChar(code[i + 8]))
-                                                {
-                                                    *token = ContinueKeyword;
-                                                    return i + 8;
-                                                }
-                                            }
-                                        }
-                                    }
-                                }
-                                return 0;
-                        }
-                    }
-                    return 0;
+                *token = DoKeyword;
+                return true;
             }
-            return 0;
-        case 'd':
-            switch (code[i + 1])
+            return false;
+        case 4:
+            if (length == 4 && memcmp(code, "void", 4) == 0)
             {
-                case 'e':
-                    if (code[i + 2] == 'f')
-                    {
-                        if (code[i + 3] == 'a')
-                        {
-                            if (code[i + 4] == 'u')
-                            {
-                                if (code[i + 5] == 'l')
-                                {
-                                    if (code[i + 6] == 't')
-                                    {
-                                        if (IsNonIDChar(code[i + 7]))
-                                        {
-                                            *token = DefaultKeyword;
-                                            return i + 7;
-                                        }
-                                    }
-                                }
-                            }
-                        }
-                    }
-                    return 0;
-                case 'o':
-                    if (IsNonIDChar(code[i + 2]))
-                    {
-                        *token = DoKeyword;
-                        return i + 2;
-                    }
+                *token = VoidKeyword;
+                return true;
             }
-            return 0;
-        case 'e':
-            switch (code[i + 1])
+            return false;
+        case 6:
+            if (length == 7 && memcmp(code, "int32_t", 7) == 0)
             {
-                case 'l':
-                    if (code[i + 2] == 's')
-                    {
-                        if (code[i + 3] == 'e')
-                        {
-                            if (IsNonIDChar(code[i + 4]))
-                            {
-                                *token = ElseKeyword;
-                                return i + 4;
-                            }
-                        }
-                    }
-                    return 0;
-                case 'n':
-                    if (code[i + 2] == 'u')
-                    {
-                        if (code[i + 3] == 'm')
-                        {
-                            if (IsNonIDChar(code[i + 4]))
-                            {
-                                *token = EnumKeyword;
-                                return i + 4;
-                            }
-                        }
-                    }
-                    return 0;
+                *token = Int32Keyword;
+                return true;
             }
-            return 0;
-        case 'f':
-            switch (code[i + 1])
+            return false;
+        case 7:
+            if (length == 8 && memcmp(code, "uint16_t", 8) == 0)
             {
-                case 'a':
-                    if (code[i + 2] == 'l')
-                    {
-                        if (code[i + 3] == 's')
-                        {
-                            if (code[i + 4] == 'e')
-                            {
-                                if (IsNonIDChar(code[i + 5]))
-                                {
-                                    *token = IntLiteral;
-                                    int32_t* lit = xmalloc(sizeof(int32_t));
-                                    *lit = 0;
-                                    *tokenData = lit;
-                                    return i + 5;
-                                }
-                            }
-                        }
-                    }
-                    return 0;
-                case 'i':
-                    if (code[i + 2] == 'x')
-                    {
-                        if (code[i + 3] == 'e')
-                        {
-                            if (code[i + 4] == 'd')
-                            {
-                                if (IsNonIDChar(code[i + 5]))
-                                {
-                                    *token = FixedKeyword;
-                                    return i + 5;
-                                }
-                            }
-                        }
-                    }
-                    return 0;
-                case 'o':
-                    if (code[i + 2] == 'r')
-                    {
-                        if (IsNonIDChar(code[i + 3]))
-                        {
-                            *token = ForKeyword;
-                            return i + 3;
-                        }
-                    }
-                    return 0;
+                *token = UintKeyword;
+                return true;
             }
-            return 0;
-        case 'g':
-            if (code[i + 1] == 'o')
+            return false;
+        case 10:
+            if (length == 8 && memcmp(code, "restrict", 8) == 0)
             {
-                if (code[i + 2] == 't')
-                {
-                    if (code[i + 3] == 'o')
-                    {
-                        if (IsNonIDChar(code[i + 4]))
-                        {
-                            *token = GotoKeyword;
-                            return i + 4;
-                        }
-                    }
-                }
+                *token = RestrictKeyword;
+                return true;
             }
-            return 0;
-        case 'i':
-            switch (code[i + 1])
+            return false;
+        case 12:
+            if (length == 6 && memcmp(code, "return", 6) == 0)
             {
-                case 'f':
-                    if (IsNonIDChar(code[i + 2]))
-                    {
-                        *token = IfKeyword;
-                        return i + 2;
-                    }
-                    return 0;
-                case 'n':
-                    if (code[i + 2] == 't')
-                    {
-                        switch (code[i + 3])
-                        {
-                            case '1':
-                                if (code[i + 4] == '6')
-                                {
-                                    if (code[i + 5] == '_')
-                                    {
-                                        if (code[i + 6] == 't')
-                                        {
-                                            if (IsNonIDChar(code[i + 7]))
-                                            {
-                                                *token = IntKeyword;
-                                                return i + 7;
-                                            }
-                                        }
-                                    }
-                                    if (IsNonIDChar(code[i + 5]))
-                                    {
-                                        *token = IntKeyword;
-                                        return i + 5;
-                                    }
-                                }
-                                return 0;
-                            case '3':
-                                if (code[i + 4] == '2')
-                                {
-                                    if (code[i + 5] == '_')
-                                    {
-                                        if (code[i + 6] == 't')
-                                        {
-                                            if (IsNonIDChar(code[i + 7]))
-                                            {
-                                                *token = Int32Keyword;
-                                                return i + 7;
-                                            }
-                                        }
-                                    }
-                                    if (IsNonIDChar(code[i + 5]))
-                                    {
-                                        *token = Int32Keyword;
-                                        return i + 5;
-                                    }
-                                }
-                                return 0;
-                        }
-                        if (IsNonIDChar(code[i + 3]))
-                        {
-                            *token = IntKeyword;
-                            return i + 3;
-                        }
-                    }
-                    return 0;
+                *token = ReturnKeyword;
+                return true;
             }
-            return 0;
-        case 'l':
-            if (code[i + 1] == 'o')
+            return false;
+        case 13:
+            if (length == 3 && memcmp(code, "for", 3) == 0)
             {
-                if (code[i + 2] == 'n')
-                {
-                    if (code[i + 3] == 'g')
-                    {
-                        if (IsNonIDChar(code[i + 4]))
-                        {
-                            *token = Int32Keyword;
-                            return i + 4;
-                        }
-                    }
-                }
+                *token = ForKeyword;
+                return true;
             }
-            return 0;
-        case 'r':
-            if (code[i + 1] == 'e')
+            return false;
+        case 19:
+            if (length == 8 && memcmp(code, "uint32_t", 8) == 0)
             {
-                switch (code[i + 2])
-                {
-                    case 'g':
-                        if (code[i + 3] == 'i')
-                        {
-                            if (code[i + 4] == 's')
-                            {
-                                if (code[i + 5] == 't')
-                                {
-                                    if (code[i + 6] == 'e')
-                                    {
-                                        if (code[i + 7] == 'r')
-                                        {
-                                            if (IsNonIDChar(code[i + 8]))
-                                            {
-                                                *token = RegisterKeyword;
-                                                return i + 8;
-                                            }
-                                        }
-                                    }
-                                }
-                            }
-                        }
-                        return 0;
-                    case 's':
-                        if (code[i + 3] == 't')
-                        {
-                            if (code[i + 4] == 'r')
-                            {
-                                if (code[i + 5] == 'i')
-                                {
-                                    if (code[i + 6] == 'c')
-                                    {
-                                        if (code[i + 7] == 't')
-                                        {
-                                            if (IsNonIDChar(code[i + 8]))
-                                            {
-                                                *token = RestrictKeyword;
-                                                return i + 8;
-                                            }
-                                        }
-                                    }
-                                }
-                            }
-                        }
-                        return 0;
-                    case 't':
-                        if (code[i + 3] == 'u')
-                        {
-                            if (code[i + 4] == 'r')
-                            {
-                                if (code[i + 5] == 'n')
-                                {
-                                    if (IsNonIDChar(code[i + 6]))
-                                    {
-                                        *token = ReturnKeyword;
-                                        return i + 6;
-                                    }
-                                }
-                            }
-                        }
-                        return 0;
-                }
+                *token = Uint32Keyword;
+                return true;
             }
-            return 0;
-        case 's':
-            switch (code[i + 1])
+            return false;
+        case 20:
+            if (length == 5 && memcmp(code, "break", 5) == 0)
             {
-                case 'i':
-                    if (code[i + 2] == 'z')
-                    {
-                        if (code[i + 3] == 'e')
-                        {
-                            switch (code[i + 4])
-                            {
-                                case '_':
-                                    if (code[i + 5] == 't')
-                                    {
-                                        if (IsNonIDChar(code[i + 6]))
-                                        {
-                                            *token = UintKeyword;
-                                            return i + 6;
-                                        }
-                                    }
-                                    return 0;
-                                case 'o':
-                                    if (code[i + 5] == 'f')
-                                    {
-                                        if (IsNonIDChar(code[i + 6]))
-                                        {
-                                            *token = SizeOfKeyword;
-                                            return i + 6;
-                                        }
-                                    }
-                                    return 0;
-                            }
-                        }
-                    }
-                    return 0;
-                case 't':
-                    switch (code[i + 2])
-                    {
-                        case 'a':
-                            if (code[i + 3] == 't')
-                            {
-                                if (code[i + 4] == 'i')
-                                {
-                                    if (code[i + 5] == 'c')
-                                    {
-                                        if (IsNonIDChar(code[i + 6]))
-                                        {
-                                            *token = StaticKeyword;
-                                            return i + 6;
-                                        }
-                                    }
-                                }
-                            }
-                            return 0;
-                        case 'r':
-                            if (code[i + 3] == 'u')
-                            {
-                                if (code[i + 4] == 'c')
-                                {
-                                    if (code[i + 5] == 't')
-                                    {
-                                        if (IsNonIDChar(code[i + 6]))
-                                        {
-                                            *token = StructKeyword;
-                                            return i + 6;
-                                        }
-                                    }
-                                }
-                            }
-                            return 0;
-                    }
-                    return 0;
-                case 'w':
-                    if (code[i + 2] == 'i')
-                    {
-                        if (code[i + 3] == 't')
-                        {
-                            if (code[i + 4] == 'c')
-                            {
-                                if (code[i + 5] == 'h')
-                                {
-                                    if (IsNonIDChar(code[i + 6]))
-                                    {
-                                        *token = SwitchKeyword;
-                                        return i + 6;
-                                    }
-                                }
-                            }
-                        }
-                    }
-                    return 0;
+                *token = BreakKeyword;
+                return true;
             }
-            return 0;
-        case 't':
-            switch (code[i + 1])
+            return false;
+        case 21:
+            if (length == 7 && memcmp(code, "default", 7) == 0)
             {
-                case 'r':
-                    if (code[i + 2] == 'u')
-                    {
-                        if (code[i + 3] == 'e')
-                        {
-                            if (IsNonIDChar(code[i + 4]))
-                            {
-                                *token = IntLiteral;
-                                int32_t* lit = xmalloc(sizeof(int32_t));
-                                *lit = 1;
-                                *tokenData = lit;
-                                return i + 4;
-                            }
-                        }
-                    }
-                    return 0;
-                case 'y':
-                    if (code[i + 2] == 'p')
-                    {
-                        if (code[i + 3] == 'e')
-                        {
-                            if (code[i + 4] == 'd')
-                            {
-                                if (code[i + 5] == 'e')
-                                {
-                                    if (code[i + 6] == 'f')
-                                    {
-                                        if (IsNonIDChar(code[i + 7]))
-                                        {
-                                            *token = TypedefKeyword;
-                                            return i + 7;
-                                        }
-                                    }
-                                }
-                            }
-                        }
-                    }
-                    return 0;
+                *token = DefaultKeyword;
+                return true;
             }
-            return 0;
-        case 'u':
-            switch (code[i + 1])
+            return false;
+        case 24:
+            if (length == 6 && memcmp(code, "static", 6) == 0)
             {
-                case 'i':
-                    if (code[i + 2] == 'n')
-                    {
-                        if (code[i + 3] == 't')
-                        {
-                            switch (code[i + 4])
-                            {
-                                case '1':
-                                    if (code[i + 5] == '6')
-                                    {
-                                        if (code[i + 6] == '_')
-                                        {
-                                            if (code[i + 7] == 't')
-                                            {
-                                                if (IsNonIDChar(code[i + 8]))
-                                                {
-                                                    *token = UintKeyword;
-                                                    return i + 8;
-                                                }
-                                            }
-                                        }
-                                        if (IsNonIDChar(code[i + 6]))
-                                        {
-                                            *token = UintKeyword;
-                                            return i + 6;
-                                        }
-                                    }
-                                    return 0;
-                                case '3':
-                                    if (code[i + 5] == '2')
-                                    {
-                                        if (code[i + 6] == '_')
-                                        {
-                                            if (code[i + 7] == 't')
-                                            {
-                                                if (IsNonIDChar(code[i + 8]))
-                                                {
-                                                    *token = Uint32Keyword;
-                                                    return i + 8;
-                                                }
-                                            }
-                                        }
-                                        if (IsNonIDChar(code[i + 6]))
-                                        {
-                                            *token = Uint32Keyword;
-                                            return i + 6;
-                                        }
-                                    }
-                                    return 0;
-                            }
-                            if (IsNonIDChar(code[i + 4]))
-                            {
-                                *token = UintKeyword;
-                                return i + 4;
-                            }
-                        }
-                    }
-                    return 0;
-                case 'n':
-                    if (code[i + 2] == 'i')
-                    {
-                        if (code[i + 3] == 'o')
-                        {
-                            if (code[i + 4] == 'n')
-                            {
-                                if (IsNonIDChar(code[i + 5]))
-                                {
-                                    *token = UnionKeyword;
-                                    return i + 5;
-                                }
-                            }
-                        }
-                    }
-                    return 0;
+                *token = StaticKeyword;
+                return true;
             }
-            return 0;
-        case 'v':
-            if (code[i + 1] == 'o')
+            return false;
+        case 27:
+            if (length == 6 && memcmp(code, "struct", 6) == 0)
             {
-                if (code[i + 2] == 'i')
-                {
-                    if (code[i + 3] == 'd')
-                    {
-                        if (IsNonIDChar(code[i + 4]))
-                        {
-                            *token = VoidKeyword;
-                            return i + 4;
-                        }
-                    }
-                }
+                *token = StructKeyword;
+                return true;
             }
-            return 0;
-        case 'w':
-            if (code[i + 1] == 'h')
+            return false;
+        case 31:
+            if (length == 4 && memcmp(code, "long", 4) == 0)
             {
-                if (code[i + 2] == 'i')
-                {
-                    if (code[i + 3] == 'l')
-                    {
-                        if (code[i + 4] == 'e')
-                        {
-                            if (IsNonIDChar(code[i + 5]))
-                            {
-                                *token = WhileKeyword;
-                                return i + 5;
-                            }
-                        }
-                    }
-                }
+                *token = Int32Keyword;
+                return true;
             }
-            return 0;
-        case '{':
-            *token = CBrOpen;
-            return i + 1;
-        case '|':
-            switch (code[i + 1])
+            return false;
+        case 34:
+            if (length == 8 && memcmp(code, "continue", 8) == 0)
             {
-                case '=':
-                    *token = AssignmentOR;
-                    return i + 2;
-                case '|':
-                    *token = LogicalOR;
-                    return i + 2;
+                *token = ContinueKeyword;
+                return true;
             }
-            *token = BitwiseOR;
-            return i + 1;
-        case '}':
-            *token = CBrClose;
-            return i + 1;
-        case '~':
-            *token = BitwiseNOT;
-            return i + 1;
+            return false;
+        case 36:
+            if (length == 5 && memcmp(code, "int16", 5) == 0)
+            {
+                *token = IntKeyword;
+                return true;
+            }
+            return false;
+        case 38:
+            if (length == 4 && memcmp(code, "goto", 4) == 0)
+            {
+                *token = GotoKeyword;
+                return true;
+            }
+            return false;
+        case 49:
+            if (length == 6 && memcmp(code, "uint16", 6) == 0)
+            {
+                *token = UintKeyword;
+                return true;
+            }
+            return false;
+        case 51:
+            if (length == 5 && memcmp(code, "while", 5) == 0)
+            {
+                *token = WhileKeyword;
+                return true;
+            }
+            return false;
+        case 52:
+            if (length == 5 && memcmp(code, "false", 5) == 0)
+            {
+                *token = IntLiteral;
+                *literal = 0;
+                return true;
+            }
+            return false;
+        case 54:
+            if (length == 8 && memcmp(code, "register", 8) == 0)
+            {
+                *token = RegisterKeyword;
+                return true;
+            }
+            return false;
+        case 55:
+            if (length == 4 && memcmp(code, "char", 4) == 0)
+            {
+                *token = UintKeyword;
+                return true;
+            }
+            return false;
+        case 59:
+            if (length == 6 && memcmp(code, "size_t", 6) == 0)
+            {
+                *token = UintKeyword;
+                return true;
+            }
+            return false;
+        case 61:
+            if (length == 2 && memcmp(code, "if", 2) == 0)
+            {
+                *token = IfKeyword;
+                return true;
+            }
+            return false;
+        case 63:
+            if (length == 3 && memcmp(code, "asm", 3) == 0)
+            {
+                *token = AsmKeyword;
+                return true;
+            }
+            return false;
+        case 69:
+            if (length == 6 && memcmp(code, "sizeof", 6) == 0)
+            {
+                *token = SizeOfKeyword;
+                return true;
+            }
+            return false;
+        case 70:
+            if (length == 5 && memcmp(code, "union", 5) == 0)
+            {
+                *token = UnionKeyword;
+                return true;
+            }
+            return false;
+        case 71:
+            if (length == 7 && memcmp(code, "typedef", 7) == 0)
+            {
+                *token = TypedefKeyword;
+                return true;
+            }
+            return false;
+        case 79:
+            if (length == 5 && memcmp(code, "fixed", 5) == 0)
+            {
+                *token = FixedKeyword;
+                return true;
+            }
+            return false;
+        case 80:
+            if (length == 4 && memcmp(code, "enum", 4) == 0)
+            {
+                *token = EnumKeyword;
+                return true;
+            }
+            return false;
+        case 90:
+            if (length == 4 && memcmp(code, "case", 4) == 0)
+            {
+                *token = CaseKeyword;
+                return true;
+            }
+            return false;
+        case 92:
+            if (length == 4 && memcmp(code, "else", 4) == 0)
+            {
+                *token = ElseKeyword;
+                return true;
+            }
+            return false;
+        case 96:
+            if (length == 5 && memcmp(code, "const", 5) == 0)
+            {
+                *token = ConstKeyword;
+                return true;
+            }
+            return false;
+        case 100:
+            if (length == 3 && memcmp(code, "int", 3) == 0)
+            {
+                *token = IntKeyword;
+                return true;
+            }
+            return false;
+        case 112:
+            if (length == 5 && memcmp(code, "int32", 5) == 0)
+            {
+                *token = Int32Keyword;
+                return true;
+            }
+            return false;
+        case 113:
+            if (length == 4 && memcmp(code, "uint", 4) == 0)
+            {
+                *token = UintKeyword;
+                return true;
+            }
+            return false;
+        case 118:
+            if (length == 4 && memcmp(code, "NULL", 4) == 0)
+            {
+                *token = IntLiteral;
+                *literal = 0;
+                return true;
+            }
+            return false;
+        case 119:
+            if (length == 4 && memcmp(code, "true", 4) == 0)
+            {
+                *token = IntLiteral;
+                *literal = 1;
+                return true;
+            }
+            return false;
+        case 121:
+            if (length == 6 && memcmp(code, "switch", 6) == 0)
+            {
+                *token = SwitchKeyword;
+                return true;
+            }
+            return false;
+        case 122:
+            if (length == 7 && memcmp(code, "int16_t", 7) == 0)
+            {
+                *token = IntKeyword;
+                return true;
+            }
+            return false;
+        case 124:
+            if (length == 4 && memcmp(code, "bool", 4) == 0)
+            {
+                *token = UintKeyword;
+                return true;
+            }
+            return false;
+        case 125:
+            if (length == 6 && memcmp(code, "uint32", 6) == 0)
+            {
+                *token = Uint32Keyword;
+                return true;
+            }
+            return false;
     }
-    return 0;
+    return false;
 }
-
-bool ParseNext(char* code, TokenArray* t, char* sourceFileName, size_t* i, int lineNumber)
-{
-    TokenType token = None;
-    void* tokenData = NULL;
-
-    size_t newI = TokenizeSwitch(code, &token, &tokenData, *i);
-    if (newI == 0)
-        return false;
-
-    *i = newI;
-
-    Token_AppendArray((Token){token, tokenData}, t, lineNumber, sourceFileName);
-    return true;
-}
\ No newline at end of file
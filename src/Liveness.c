@@ -0,0 +1,632 @@
+#include "Liveness.h"
+#include "Type.h"
+#include "Util.h"
+#include <stdlib.h>
+#include <string.h>
+
+typedef enum
+{
+    // Only a point in the control flow, e.g. a branch, jump or join
+    Node_Point,
+    // Reads or writes a variable
+    Node_Use,
+    // Declares a variable
+    Node_Def,
+} NodeType;
+
+typedef struct
+{
+    NodeType type;
+    int var;
+    // The access of a use (NULL if it isn't one, e.g. for calls of function pointers),
+    // the declaration of a def
+    void* ast;
+    // Where the live set at a point is stored, NULL if it isn't needed
+    uint16_t** oLive;
+    size_t firstSucc;
+    size_t numSuccs;
+} Node;
+
+typedef struct
+{
+    size_t from;
+    size_t to;
+} Edge;
+
+typedef struct
+{
+    const char* name;
+    int var;
+} Visible;
+
+#ifndef CUSTOM_COMP
+typedef struct Block Block;
+typedef struct Region Region;
+#endif
+#ifdef CUSTOM_COMP
+typedef struct Block {} Block;
+typedef struct Region {} Region;
+#endif
+
+// The declarations of a block scope in the order code generation adds them
+typedef struct Block
+{
+    Block* parent;
+    GenericList visible;
+} Block;
+
+// A statement with joins
+typedef struct Region
+{
+    Region* parent;
+    Block* block;
+    // Whether variables are declared into block inside the statement
+    bool declares;
+} Region;
+
+typedef struct
+{
+    GenericList nodes;
+    GenericList edges;
+    int numVars;
+    Block* block;
+    Region* region;
+    // The node added last, code generation falls through from it to the next one unless it's
+    // a jump. SIZE_MAX before the first one.
+    size_t prev;
+    bool prevFalls;
+    // Jump nodes of the breaks and continues of the innermost loop or switch
+    GenericList* breaks;
+    GenericList* continues;
+} Liveness;
+
+// Bit sets are arrays of 16-bit words
+static bool HasBit(const uint16_t* set, size_t i)
+{
+    return (set[i / 16] & (1 << (i % 16))) != 0;
+}
+
+static void SetBit(uint16_t* set, size_t i)
+{
+    set[i / 16] |= 1 << (i % 16);
+}
+
+static void ClearBit(uint16_t* set, size_t i)
+{
+    set[i / 16] &= ~(1 << (i % 16));
+}
+
+static Node* GetNode(Liveness* l, size_t i)
+{
+    return GenericList_At(&l->nodes, i);
+}
+
+static void AddEdge(Liveness* l, size_t from, size_t to)
+{
+    Edge edge = {from, to};
+    GenericList_Append(&l->edges, &edge);
+}
+
+static void AddEdges(Liveness* l, GenericList* from, size_t to)
+{
+    for (size_t i = 0; i < from->count; i++)
+        AddEdge(l, *(size_t*)GenericList_At(from, i), to);
+}
+
+// Adds a node after the previous one. Jumps fall through to it as well (code generation
+// continues with the register state after them), unless it is a join: its register state is
+// restored to the live set. In statements that declare variables into the surrounding scope,
+// joins are kept reachable from jumps too, as variables declared after one was released
+// might have taken its register.
+static size_t AddNode(Liveness* l, NodeType type, int var, void* ast, uint16_t** oLive, bool isJoin)
+{
+    Node node = {type, var, ast, oLive, 0, 0};
+    size_t index = l->nodes.count;
+    GenericList_Append(&l->nodes, &node);
+
+    if (l->prev != SIZE_MAX && (l->prevFalls || !isJoin || l->region->declares))
+        AddEdge(l, l->prev, index);
+    l->prev = index;
+    l->prevFalls = true;
+    return index;
+}
+
+static size_t Point(Liveness* l)
+{
+    return AddNode(l, Node_Point, -1, NULL, NULL, false);
+}
+
+static size_t Join(Liveness* l, uint16_t** oLive)
+{
+    return AddNode(l, Node_Point, -1, NULL, oLive, true);
+}
+
+static void Jump(Liveness* l, GenericList* targets)
+{
+    size_t node = Point(l);
+    if (targets != NULL)
+        GenericList_Append(targets, &node);
+    l->prevFalls = false;
+}
+
+static void EnterBlock(Liveness* l, Block* block)
+{
+    block->parent = l->block;
+    block->visible = GenericList_Create(sizeof(Visible));
+    l->block = block;
+}
+
+static void ExitBlock(Liveness* l)
+{
+    GenericList_Dispose(&l->block->visible);
+    l->block = l->block->parent;
+}
+
+static void EnterRegion(Liveness* l, Region* region)
+{
+    region->parent = l->region;
+    region->block = l->block;
+    region->declares = false;
+    l->region = region;
+}
+
+static void ExitRegion(Liveness* l)
+{
+    l->region = l->region->parent;
+}
+
+// Resolves names like code generation does (Scope_FindVariable), -1 for anything that isn't a
+// tracked local
+static int FindVariable(Liveness* l, const char* name)
+{
+    Block* block = l->block;
+    while (block != NULL)
+    {
+        for (size_t i = block->visible.count; i > 0; i--)
+        {
+            Visible* visible = GenericList_At(&block->visible, i - 1);
+            if (visible->name == name)
+                return visible->var;
+        }
+        block = block->parent;
+    }
+    return -1;
+}
+
+static void WalkExpression(Liveness* l, AST_Expression* expr);
+static void WalkStatement(Liveness* l, AST_Statement* stmt);
+
+static void WalkExpressions(Liveness* l, AST_Expression** exprs, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+        WalkExpression(l, exprs[i]);
+}
+
+static void WalkStatements(Liveness* l, AST_Statement** stmts, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+        WalkStatement(l, stmts[i]);
+}
+
+// The value of the left side of a binary operator may still be the register of a variable it
+// read, e.g. v in v + (a & v), until the operator is generated. Reads of the same variables on
+// the right side (nodes from firstB on) must not release them.
+static void KeepLeftInUse(Liveness* l, size_t firstA, size_t firstB)
+{
+    size_t end = l->nodes.count;
+    for (size_t i = firstA; i < firstB; i++)
+    {
+        Node* left = GetNode(l, i);
+        if (left->type != Node_Use)
+            continue;
+        bool readAgain = false;
+        for (size_t j = firstB; j < end && !readAgain; j++)
+            readAgain = GetNode(l, j)->type == Node_Use && GetNode(l, j)->var == left->var;
+        bool added = false;
+        for (size_t j = end; j < l->nodes.count && !added; j++)
+            added = GetNode(l, j)->var == left->var;
+        if (readAgain && !added)
+            AddNode(l, Node_Use, left->var, NULL, NULL, false);
+    }
+}
+
+// Accesses are visited in the order they are parsed, which is the order they are generated in
+static void WalkExpression(Liveness* l, AST_Expression* expr)
+{
+    if (expr == NULL)
+        return;
+
+    switch (expr->type)
+    {
+        case AST_ExpressionType_BinaryOP:;
+            AST_Expression_BinOp* binop = (AST_Expression_BinOp*)expr;
+            size_t firstA = l->nodes.count;
+            WalkExpression(l, binop->exprA);
+            size_t firstB = l->nodes.count;
+            // The right side of a struct access is the member name
+            if (binop->op != BinOp_StructAccessDot && binop->op != BinOp_StructAccessArrow)
+                WalkExpression(l, binop->exprB);
+            KeepLeftInUse(l, firstA, firstB);
+            // The target of an assignment is written after the right side is evaluated,
+            // so a variable assigned to is still in use after the right side read it
+            if (binop->op >= BinOp_AssignmentAdd && binop->op <= BinOp_Assignment)
+            {
+                AST_Expression* target = binop->exprA;
+                while (target->type == AST_ExpressionType_BinaryOP &&
+                       ((AST_Expression_BinOp*)target)->op == BinOp_StructAccessDot)
+                    target = ((AST_Expression_BinOp*)target)->exprA;
+                int assigned = -1;
+                if (target->type == AST_ExpressionType_VariableAccess)
+                    assigned = FindVariable(l, ((AST_Expression_VariableAccess*)target)->id);
+                if (assigned != -1)
+                    AddNode(l, Node_Use, assigned, NULL, NULL, false);
+            }
+            break;
+        case AST_ExpressionType_TernaryOP:;
+            AST_Expression_TernaryOp* ternary = (AST_Expression_TernaryOp*)expr;
+            WalkExpression(l, ternary->cond);
+            WalkExpression(l, ternary->exprA);
+            WalkExpression(l, ternary->exprB);
+            break;
+        case AST_ExpressionType_UnaryOP: WalkExpression(l, ((AST_Expression_UnOp*)expr)->exprA); break;
+        case AST_ExpressionType_TypeCast: WalkExpression(l, ((AST_Expression_TypeCast*)expr)->exprA); break;
+        case AST_ExpressionType_ListLiteral:;
+            AST_Expression_ListLiteral* list = (AST_Expression_ListLiteral*)expr;
+            WalkExpressions(l, list->expressions, list->numExpr);
+            break;
+        case AST_ExpressionType_FunctionCall:;
+            AST_Expression_FunctionCall* call = (AST_Expression_FunctionCall*)expr;
+            WalkExpressions(l, call->parameters, call->numParameters);
+            // A function pointer is read when calling it
+            int callee = FindVariable(l, call->id);
+            if (callee != -1)
+                AddNode(l, Node_Use, callee, NULL, NULL, false);
+            break;
+        case AST_ExpressionType_VariableAccess:;
+            int var = FindVariable(l, ((AST_Expression_VariableAccess*)expr)->id);
+            if (var != -1)
+                AddNode(l, Node_Use, var, expr, NULL, false);
+            break;
+        default:;
+    }
+}
+
+static void WalkIf(Liveness* l, AST_Statement_If* stmt)
+{
+    WalkExpression(l, stmt->cond);
+    size_t branch = Point(l);
+
+    Region region;
+    EnterRegion(l, &region);
+    Join(l, &stmt->liveTrue);
+    WalkStatement(l, stmt->ifTrue);
+    size_t trueEnd = l->prev;
+    bool trueFalls = l->prevFalls;
+
+    stmt->liveFalse = NULL;
+    if (stmt->ifFalse != NULL)
+    {
+        // The true branch jumps over the false one
+        l->prevFalls = false;
+        AddEdge(l, branch, Join(l, &stmt->liveFalse));
+        WalkStatement(l, stmt->ifFalse);
+    }
+
+    size_t end = Join(l, &stmt->liveAfter);
+    if (stmt->ifFalse == NULL)
+        AddEdge(l, branch, end);
+    else if (trueFalls)
+        AddEdge(l, trueEnd, end);
+    ExitRegion(l);
+}
+
+static void WalkWhile(Liveness* l, AST_Statement_While* stmt)
+{
+    GenericList* oldBreaks = l->breaks;
+    GenericList* oldContinues = l->continues;
+    GenericList breaks = GenericList_Create(sizeof(size_t));
+    GenericList continues = GenericList_Create(sizeof(size_t));
+    Region region;
+    EnterRegion(l, &region);
+
+    size_t header = Point(l);
+    WalkExpression(l, stmt->cond);
+    size_t branch = Point(l);
+
+    l->breaks = &breaks;
+    l->continues = &continues;
+    WalkStatement(l, stmt->body);
+    if (l->prevFalls)
+        AddEdge(l, l->prev, header);
+    l->prevFalls = false;
+    AddEdges(l, &continues, header);
+
+    // Even if the condition is constant, the loop is treated as if it might end there
+    size_t end = Join(l, &stmt->liveAfter);
+    AddEdge(l, branch, end);
+    AddEdges(l, &breaks, end);
+
+    ExitRegion(l);
+    l->breaks = oldBreaks;
+    l->continues = oldContinues;
+    GenericList_Dispose(&breaks);
+    GenericList_Dispose(&continues);
+}
+
+static void WalkDoWhile(Liveness* l, AST_Statement_Do* stmt)
+{
+    GenericList* oldBreaks = l->breaks;
+    GenericList* oldContinues = l->continues;
+    GenericList breaks = GenericList_Create(sizeof(size_t));
+    GenericList continues = GenericList_Create(sizeof(size_t));
+    Region region;
+    EnterRegion(l, &region);
+
+    size_t header = Point(l);
+    l->breaks = &breaks;
+    l->continues = &continues;
+    WalkStatement(l, stmt->body);
+    AddEdges(l, &continues, Point(l));
+
+    WalkExpression(l, stmt->cond);
+    size_t branch = Point(l);
+    AddEdge(l, branch, header);
+
+    size_t end = Join(l, &stmt->liveAfter);
+    AddEdges(l, &breaks, end);
+
+    ExitRegion(l);
+    l->breaks = oldBreaks;
+    l->continues = oldContinues;
+    GenericList_Dispose(&breaks);
+    GenericList_Dispose(&continues);
+}
+
+static void WalkFor(Liveness* l, AST_Statement_For* stmt)
+{
+    GenericList* oldBreaks = l->breaks;
+    GenericList* oldContinues = l->continues;
+    GenericList breaks = GenericList_Create(sizeof(size_t));
+    GenericList continues = GenericList_Create(sizeof(size_t));
+    Block block;
+    EnterBlock(l, &block);
+    WalkStatement(l, stmt->init);
+
+    // Entered after the init statement, its declarations don't outlive the loop
+    Region region;
+    EnterRegion(l, &region);
+    size_t header = Point(l);
+    WalkExpression(l, stmt->cond);
+    size_t branch = Point(l);
+
+    l->breaks = &breaks;
+    l->continues = &continues;
+    WalkStatement(l, stmt->body);
+    AddEdges(l, &continues, Point(l));
+    WalkExpression(l, stmt->count);
+    AddEdge(l, l->prev, header);
+    l->prevFalls = false;
+
+    size_t end = Join(l, &stmt->liveAfter);
+    AddEdge(l, branch, end);
+    AddEdges(l, &breaks, end);
+
+    ExitRegion(l);
+    ExitBlock(l);
+    l->breaks = oldBreaks;
+    l->continues = oldContinues;
+    GenericList_Dispose(&breaks);
+    GenericList_Dispose(&continues);
+}
+
+static void WalkSwitch(Liveness* l, AST_Statement_Switch* stmt)
+{
+    WalkExpression(l, stmt->selector);
+    size_t dispatch = Point(l);
+
+    GenericList* oldBreaks = l->breaks;
+    GenericList breaks = GenericList_Create(sizeof(size_t));
+    Region region;
+    EnterRegion(l, &region);
+
+    // Cases fall through to the next one
+    l->breaks = &breaks;
+    for (size_t i = 0; i < stmt->numCases; i++)
+    {
+        AST_Statement_Switch_SwitchCase* c = &stmt->cases[i];
+        AddEdge(l, dispatch, Join(l, &c->live));
+        WalkStatements(l, c->statements, c->numStatements);
+    }
+    AddEdge(l, dispatch, Join(l, &stmt->liveDefault));
+    WalkStatements(l, stmt->defaultCaseStmts, stmt->numStmtsDefCase);
+
+    size_t end = Join(l, &stmt->liveAfter);
+    AddEdges(l, &breaks, end);
+
+    ExitRegion(l);
+    l->breaks = oldBreaks;
+    GenericList_Dispose(&breaks);
+}
+
+static void WalkDeclaration(Liveness* l, AST_Statement_Declaration* stmt)
+{
+    WalkExpression(l, stmt->value);
+
+    // Variables that are address-of'd might be accessed through pointers anywhere
+    stmt->liveIndex = -1;
+    stmt->isLive = true;
+    if ((stmt->variableType->qualifiers & Qualifier_Stack) == 0)
+    {
+        stmt->liveIndex = l->numVars;
+        l->numVars++;
+        AddNode(l, Node_Def, stmt->liveIndex, stmt, NULL, false);
+    }
+
+    Visible visible = {stmt->variableName, stmt->liveIndex};
+    GenericList_Append(&l->block->visible, &visible);
+
+    Region* region = l->region;
+    while (region != NULL && region->block == l->block)
+    {
+        region->declares = true;
+        region = region->parent;
+    }
+}
+
+// Inline assembly might access any variable
+static void WalkInlineAssembly(Liveness* l, AST_Statement_ASM* stmt)
+{
+    Block* block = l->block;
+    while (block != NULL)
+    {
+        for (size_t i = 0; i < block->visible.count; i++)
+        {
+            Visible* visible = GenericList_At(&block->visible, i);
+            if (visible->var != -1)
+                AddNode(l, Node_Use, visible->var, NULL, NULL, false);
+        }
+        block = block->parent;
+    }
+    AddNode(l, Node_Point, -1, NULL, &stmt->liveAfter, false);
+}
+
+static void WalkStatement(Liveness* l, AST_Statement* stmt)
+{
+    switch (stmt->type)
+    {
+        case AST_StatementType_Expr: WalkExpression(l, ((AST_Statement_Expr*)stmt)->expr); break;
+        case AST_StatementType_If: WalkIf(l, (AST_Statement_If*)stmt); break;
+        case AST_StatementType_While: WalkWhile(l, (AST_Statement_While*)stmt); break;
+        case AST_StatementType_Do: WalkDoWhile(l, (AST_Statement_Do*)stmt); break;
+        case AST_StatementType_For: WalkFor(l, (AST_Statement_For*)stmt); break;
+        case AST_StatementType_Switch: WalkSwitch(l, (AST_Statement_Switch*)stmt); break;
+        case AST_StatementType_Declaration: WalkDeclaration(l, (AST_Statement_Declaration*)stmt); break;
+        case AST_StatementType_Scope:;
+            AST_Statement_Scope* scope = (AST_Statement_Scope*)stmt;
+            Block block;
+            EnterBlock(l, &block);
+            WalkStatements(l, scope->statements, scope->numStatements);
+            ExitBlock(l);
+            break;
+        case AST_StatementType_Return:
+            WalkExpression(l, ((AST_Statement_Return*)stmt)->expr);
+            Jump(l, NULL);
+            break;
+        case AST_StatementType_Break: Jump(l, l->breaks); break;
+        case AST_StatementType_Continue: Jump(l, l->continues); break;
+        case AST_StatementType_ASM: WalkInlineAssembly(l, (AST_Statement_ASM*)stmt); break;
+        default:;
+    }
+}
+
+static void LiveOut(const size_t* succs, const uint16_t* liveIn, Node* node, uint16_t* oOut, size_t rowSize)
+{
+    memset(oOut, 0, rowSize * sizeof(uint16_t));
+    for (size_t s = 0; s < node->numSuccs; s++)
+    {
+        const uint16_t* in = &liveIn[succs[node->firstSucc + s] * rowSize];
+        for (size_t k = 0; k < rowSize; k++)
+            oOut[k] |= in[k];
+    }
+}
+
+static void Solve(Liveness* l)
+{
+    size_t numNodes = l->nodes.count;
+    size_t rowSize = ((size_t)l->numVars + 15) / 16;
+
+    size_t* succs = xmalloc((l->edges.count + 1) * sizeof(size_t));
+    for (size_t i = 0; i < l->edges.count; i++)
+    {
+        Node* from = GetNode(l, ((Edge*)GenericList_At(&l->edges, i))->from);
+        from->numSuccs++;
+    }
+    size_t first = 0;
+    for (size_t i = 0; i < numNodes; i++)
+    {
+        Node* node = GetNode(l, i);
+        node->firstSucc = first;
+        first += node->numSuccs;
+        node->numSuccs = 0;
+    }
+    for (size_t i = 0; i < l->edges.count; i++)
+    {
+        Edge* edge = GenericList_At(&l->edges, i);
+        Node* from = GetNode(l, edge->from);
+        succs[from->firstSucc + from->numSuccs] = edge->to;
+        from->numSuccs++;
+    }
+
+    uint16_t* liveIn = xmalloc((numNodes * rowSize + 1) * sizeof(uint16_t));
+    uint16_t* out = xmalloc((rowSize + 1) * sizeof(uint16_t));
+    memset(liveIn, 0, (numNodes * rowSize + 1) * sizeof(uint16_t));
+
+    // Backward problem, nodes are mostly in program order so they are visited in reverse
+    bool changed = true;
+    while (changed)
+    {
+        changed = false;
+        for (size_t i = numNodes; i > 0; i--)
+        {
+            Node* node = GetNode(l, i - 1);
+            LiveOut(succs, liveIn, node, out, rowSize);
+            if (node->type == Node_Use)
+                SetBit(out, (size_t)node->var);
+            else if (node->type == Node_Def)
+                ClearBit(out, (size_t)node->var);
+
+            uint16_t* in = &liveIn[(i - 1) * rowSize];
+            for (size_t k = 0; k < rowSize; k++)
+            {
+                if (in[k] != out[k])
+                {
+                    in[k] = out[k];
+                    changed = true;
+                }
+            }
+        }
+    }
+
+    for (size_t i = 0; i < numNodes; i++)
+    {
+        Node* node = GetNode(l, i);
+        LiveOut(succs, liveIn, node, out, rowSize);
+        if (node->type == Node_Use && node->ast != NULL)
+            ((AST_Expression_VariableAccess*)node->ast)->isLastUse = !HasBit(out, (size_t)node->var);
+        else if (node->type == Node_Def)
+            ((AST_Statement_Declaration*)node->ast)->isLive = HasBit(out, (size_t)node->var);
+        else if (node->oLive != NULL)
+        {
+            *node->oLive = AST_Alloc((rowSize + 1) * sizeof(uint16_t));
+            memcpy(*node->oLive, out, rowSize * sizeof(uint16_t));
+        }
+    }
+
+    free(succs);
+    free(liveIn);
+    free(out);
+}
+
+void Liveness_Run(GenericList* statements)
+{
+    Liveness l;
+    l.nodes = GenericList_Create(sizeof(Node));
+    l.edges = GenericList_Create(sizeof(Edge));
+    l.numVars = 0;
+    l.block = NULL;
+    l.region = NULL;
+    l.prev = SIZE_MAX;
+    l.prevFalls = true;
+    l.breaks = NULL;
+    l.continues = NULL;
+
+    // Parameters aren't tracked
+    Block block;
+    EnterBlock(&l, &block);
+    WalkStatements(&l, (AST_Statement**)statements->data, statements->count);
+    ExitBlock(&l);
+
+    Solve(&l);
+    GenericList_Dispose(&l.nodes);
+    GenericList_Dispose(&l.edges);
+}
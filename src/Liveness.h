@@ -0,0 +1,15 @@
+#pragma once
+#include "AST.h"
+#include "GenericList.h"
+
+// Computes where the local variables of a function body (a list of AST_Statement*) are live, by
+// backward dataflow over its control flow graph. Reads and writes of a variable are uses, only
+// its declaration ends its live range. The results are stored in the AST for code generation,
+// which releases variables at their last use and at the branch targets and joins they are dead at:
+// - liveIndex of a declaration is the index of the variable in live sets, -1 if it's address-of'd
+//   (it's never released then). isLive is set if the variable is used after the declaration.
+// - isLastUse is set on accesses after which the variable is dead.
+// - Joins store the set of variables live at them, e.g. liveAfter of loops.
+// Code generation is linear, so a join starts with the registers the code before it left.
+// Variables that were released there but are live at the join take their registers back.
+void Liveness_Run(GenericList* statements);
@@ -1,33 +1,184 @@
 
 
+#include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "Compiler.h"
 #include "Error.h"
 #include "Function.h"
+#include "GenericList.h"
 #include "Lexer.h"
 #include "Outfile.h"
+#include "PCH.h"
+#include "Parallel.h"
 #include "Preprocessor.h"
+#include "Server.h"
 #include "Token.h"
 
-int main(int numArgs, char** args)
+typedef struct
+{
+    char* path;
+    // Precompiled header to use, or NULL
+    char* pch;
+    // Path to write the declarations of this file to as a precompiled header, or NULL
+    char* emitPch;
+} CompileJob;
+
+static GenericList jobs;
+static char* loadedPch = NULL;
+
+static uint32_t CompileFile(size_t index)
 {
-    if (!Outfile_TryOpen("out.s"))
-        Error("Could not open \"./out.s\"!");
+    CompileJob* job = GenericList_At(&jobs, index);
+    if (job->pch != loadedPch)
+    {
+        PCH_Dispose();
+        if (job->pch != NULL && !PCH_Load(job->pch))
+            Error("Could not open precompiled header");
+        loadedPch = job->pch;
+    }
+    if (job->emitPch != NULL)
+        Compiler_SetPCHOutput(job->emitPch);
 
-    Preprocessor_Define("CUSTOM_COMP");
+    if (PCH_IsLoaded())
+        PCH_ApplyDefines();
+    TokenArray* arr = Lexer_Begin(job->path);
+    Compile(arr);
+    Lexer_End(arr);
+    Preprocessor_Clear();
+    return 0;
+}
+
+// Value of the short option at args[*i], either attached (-DNAME) or the next argument
+static char* ShortOptionValue(int numArgs, char** args, int* i, const char* missingError)
+{
+    char* value = args[*i] + 2;
+    if (*value != 0)
+        return value;
+    if (*i + 1 >= numArgs)
+        Error(missingError);
+    (*i)++;
+    return args[*i];
+}
 
+// Compiles the files of a command line into the current context.
+static void RunCommandLine(int numArgs, char** args)
+{
+    Preprocessor_Predefine("CUSTOM_COMP");
+
+    // --pch <file> uses a precompiled header for all following files,
+    // --emit-pch <file> writes the declarations of the next file into a precompiled header,
+    // -j <n> compiles the files, or the functions of a single file, on n worker processes,
+    // -D <name> defines name for all files,
+    // -O<level> sets the optimization level, 0 for none (default 1),
+    // --peephole-report prints how often each peephole rule fired,
+    // -o <file> and --data <file> set the assembly and data output (out.s and data.bin).
+    GenericList_Dispose(&jobs);
+    jobs = GenericList_Create(sizeof(CompileJob));
+    loadedPch = NULL;
+    char* pch = NULL;
+    char* emitPch = NULL;
+    char* asmPath = "out.s";
+    char* dataPath = "data.bin";
+    int numWorkers = 1;
+    int optimizationLevel = 1;
+    bool peepholeReport = false;
     for (int i = 1; i < numArgs; i++)
     {
-        TokenArray* arr = Lex(args[i]);
-        Compile(*arr);
-        Token_DeleteArray(arr);
-        Preprocessor_Clear();
+        if (strcmp(args[i], "--pch") == 0 || strcmp(args[i], "--emit-pch") == 0)
+        {
+            if (i + 1 >= numArgs)
+                Error("Missing precompiled header path");
+
+            if (strcmp(args[i], "--emit-pch") == 0)
+                emitPch = args[i + 1];
+            else
+                pch = args[i + 1];
+            i++;
+            continue;
+        }
+        if (strcmp(args[i], "--peephole-report") == 0)
+        {
+            peepholeReport = true;
+            continue;
+        }
+        if (strcmp(args[i], "--data") == 0)
+        {
+            if (i + 1 >= numArgs)
+                Error("Missing data output path");
+            dataPath = args[++i];
+            continue;
+        }
+        if (args[i][0] == '-' && args[i][1] == 'j')
+        {
+            numWorkers = (int)strtol(ShortOptionValue(numArgs, args, &i, "Missing number of workers"), NULL, 10);
+            if (numWorkers < 1)
+                Error("Invalid number of workers");
+            continue;
+        }
+        if (args[i][0] == '-' && args[i][1] == 'D')
+        {
+            char* name = ShortOptionValue(numArgs, args, &i, "Missing name to define");
+            if (!Preprocessor_IsValid(name))
+                Error("Invalid name to define");
+            Preprocessor_Predefine(name);
+            continue;
+        }
+        if (args[i][0] == '-' && args[i][1] == 'O')
+        {
+            char* level = ShortOptionValue(numArgs, args, &i, "Missing optimization level");
+            if (level[0] < '0' || level[0] > '9')
+                Error("Invalid optimization level");
+            optimizationLevel = (int)strtol(level, NULL, 10);
+            continue;
+        }
+        if (args[i][0] == '-' && args[i][1] == 'o')
+        {
+            asmPath = ShortOptionValue(numArgs, args, &i, "Missing output path");
+            continue;
+        }
+
+        CompileJob job = {args[i], pch, emitPch};
+        GenericList_Append(&jobs, &job);
+        emitPch = NULL;
     }
 
-    Preprocessor_End();
-    Outfile_CloseFiles();
+    if (!Outfile_TryOpen(asmPath, dataPath))
+        Error("Could not open output files");
+    Compiler_SetNumWorkers(numWorkers);
+    Compiler_SetOptimizationLevel(optimizationLevel);
+    Compiler_SetPeepholeReport(peepholeReport);
+
+    // Files that load a precompiled header written by an earlier file have to wait
+    // for it, so the files are compiled in batches that end with a file writing one.
+    size_t first = 0;
+    for (size_t i = 0; i < jobs.count; i++)
+    {
+        CompileJob* job = GenericList_At(&jobs, i);
+        if (job->emitPch != NULL || i + 1 == jobs.count)
+        {
+            Parallel_Compile(first, i + 1, numWorkers, CompileFile, NULL);
+            first = i + 1;
+        }
+    }
+    GenericList_Dispose(&jobs);
+    Compiler_PrintPeepholeReport();
+}
+
+int main(int numArgs, char** args)
+{
+    // comp --server <socket> keeps running and compiles the command lines sent by comp --connect <socket> ...
+    if (numArgs == 3 && strcmp(args[1], "--server") == 0)
+        return Server_Run(args[2], RunCommandLine);
+    if (numArgs >= 3 && strcmp(args[1], "--connect") == 0)
+        return Server_Request(args[2], numArgs - 2, &args[2]);
+
+    CompilerContext* context = Compiler_CreateContext();
+    Compiler_UseContext(context);
+    RunCommandLine(numArgs, args);
+    Compiler_DisposeContext(context);
     return 0;
 }
@@ -1,10 +1,8 @@
 #include "Optimizer.h"
 #include "AST.h"
 #include "GenericList.h"
-#include "Token.h"
 #include "Type.h"
 #include "Util.h"
-#include "Value.h"
 #include "Variables.h"
 
 #include <stdbool.h>
@@ -15,22 +13,15 @@
 typedef struct
 {
     const char* id;
-    int16_t lastScore;
-    int16_t currentScore;
-    int definedAtLoopLevel;
-    void* lastAccess;
-    bool isPointer;
-    AST_Statement_Declaration* declaration;
-
+    VariableType* type;
+    bool addressTaken;
 } Optimizer_Variable;
 
 #ifndef CUSTOM_COMP
 typedef struct Optimizer_Scope Optimizer_Scope;
-typedef struct Optimizer_Loop Optimizer_Loop;
 #endif
 #ifdef CUSTOM_COMP
 typedef struct Optimizer_Scope {} Optimizer_Scope;
-typedef struct Optimizer_Loop {} Optimizer_Loop;
 #endif
 typedef struct Optimizer_Scope
 {
@@ -39,186 +30,133 @@ typedef struct Optimizer_Scope
     uint16_t preferredRegisters[8];
 } Optimizer_Scope;
 
-typedef struct Optimizer_Loop
+typedef struct OptimizerContext
 {
-    Optimizer_Loop* parent;
-    GenericList accessedVars;
-} Optimizer_Loop;
+    Optimizer_Scope* curScope;
+    // The function that is parsed has inline assembly
+    bool hasInlineASM;
+} OptimizerContext;
 
-Optimizer_Scope* curScope = NULL;
-int loopLevel = 0;
-Optimizer_Loop* curLoop = NULL;
+#ifndef CUSTOM_COMP
+static _Thread_local OptimizerContext* ctx = NULL;
+#endif
+#ifdef CUSTOM_COMP
+static OptimizerContext* ctx = NULL;
+#endif
 
-void Optimizer_LogDeclaration(AST_Statement_Declaration* declaration)
+OptimizerContext* Optimizer_CreateContext()
 {
-    Optimizer_Variable* v = malloc(sizeof(Optimizer_Variable));
-    v->id = declaration->variableName;
-    v->lastScore = 0;
-    v->currentScore = 0;
-    v->definedAtLoopLevel = loopLevel;
-    v->lastAccess = NULL;
-    v->isPointer = (declaration->variableType->token == PointerToken);
-    v->declaration = declaration;
+    OptimizerContext* context = xmalloc(sizeof(OptimizerContext));
+    memset(context, 0, sizeof(OptimizerContext));
+    return context;
+}
 
-    GenericList_Append(&curScope->variables, &v);
+void Optimizer_DisposeContext(OptimizerContext* context)
+{
+    if (ctx == context)
+        ctx = NULL;
+    free(context);
 }
 
-static bool CompareVarToStr(const void* var, const void* id)
+void Optimizer_UseContext(OptimizerContext* context)
 {
-    Optimizer_Variable** v = (Optimizer_Variable**)var;
-    return strcmp((*v)->id, id) == 0;
+    ctx = context;
 }
 
-void Optimizer_LogAccess(AST_Expression_VariableAccess* access)
+static void AddVariable(const char* id, VariableType* type)
 {
-    if (curScope == NULL)
-        return;
+    Optimizer_Variable* v = AST_Alloc(sizeof(Optimizer_Variable));
+    v->id = id;
+    v->type = type;
+    v->addressTaken = false;
 
-    Optimizer_Scope* scope = curScope;
-    do
-    {
-        Optimizer_Variable** varP = (Optimizer_Variable**)GenericList_Find(&scope->variables, CompareVarToStr, access->id);
-        if (varP != NULL)
-        {
-            Optimizer_Variable* var = *varP;
-
-            if (curLoop != NULL && var->definedAtLoopLevel < loopLevel)
-                GenericList_Append(&curLoop->accessedVars, &var);
-
-            if (var->currentScore != (int16_t)0x8000)
-            {
-                int score = 1;
-                if (var->isPointer)
-                    score = 2;
-                int shamt = (3 * (loopLevel - var->definedAtLoopLevel));
-                var->currentScore += score << shamt;
-            }
-
-            // Actually in this order, last score is the score after the last access
-            var->lastScore = var->currentScore;
-            var->lastAccess = access;
-            return;
-        }
-    } while ((scope = scope->parent) != NULL);
+    GenericList_Append(&ctx->curScope->variables, &v);
+}
+
+void Optimizer_LogDeclaration(AST_Statement_Declaration* declaration)
+{
+    AddVariable(declaration->variableName, declaration->variableType);
+}
+
+void Optimizer_LogParameter(Variable* parameter)
+{
+    AddVariable(parameter->name, parameter->type);
+}
+
+static bool CompareVarToStr(const void* var, const void* id)
+{
+    // Identifiers are interned
+    Optimizer_Variable** v = (Optimizer_Variable**)var;
+    return (*v)->id == id;
 }
 
 void Optimizer_LogFunctionCall(uint16_t modifiedRegisters)
 {
-    if (curScope == NULL)
+    if (ctx->curScope == NULL)
         return;
 
-    Optimizer_Scope* scope = curScope;
+    Optimizer_Scope* scope = ctx->curScope;
     do
     {
         for (int i = 0; i < 8; i++)
             if (modifiedRegisters & (1 << i))
                 scope->preferredRegisters[i]--;
-
-        for (size_t i = 0; i < scope->variables.count; i++)
-        {
-            Optimizer_Variable* var = *(Optimizer_Variable**)GenericList_At(&scope->variables, i);
-            if (var->currentScore != (int16_t)0x8000)
-            {
-                int shamt = (3 * (loopLevel - var->definedAtLoopLevel));
-                var->currentScore -= 2 << shamt;
-            }
-        }
     } while ((scope = scope->parent) != NULL);
 }
 
 void Optimizer_EnterNewScope()
 {
-    Optimizer_Scope* new = xmalloc(sizeof(Optimizer_Scope));
+    // Scope of a function body
+    if (ctx->curScope == NULL)
+        ctx->hasInlineASM = false;
+
+    Optimizer_Scope* new = AST_Alloc(sizeof(Optimizer_Scope));
     memset(&new->preferredRegisters[0], 0xFF, 8 * sizeof(uint16_t));
-    new->parent = curScope;
+    new->parent = ctx->curScope;
     new->variables = GenericList_Create(sizeof(Optimizer_Variable*));
-    curScope = new;
+    ctx->curScope = new;
 }
 
 void Optimizer_ExitScope(uint16_t* const oPrefRegisters)
 {
-    for (size_t i = 0; i < curScope->variables.count; i++)
+    for (size_t i = 0; i < ctx->curScope->variables.count; i++)
     {
-        Optimizer_Variable* var = *(Optimizer_Variable**)GenericList_At(&curScope->variables, i);
-        AST_Statement_Declaration* decl = var->declaration;
-
-        decl->lastAccess = var->lastAccess;
+        Optimizer_Variable* var = *(Optimizer_Variable**)GenericList_At(&ctx->curScope->variables, i);
 
         // Force stack alloc if address-of'ed
-        if (var->lastScore == (int16_t)0x8000)
-            decl->variableType->qualifiers |= Qualifier_Stack;
-        else if (var->lastScore >= (int16_t)0)
-            decl->variableType->qualifiers |= Qualifier_OptimizerRegister;
-        else
-            decl->variableType->qualifiers |= Qualifier_OptimizerStack;
-
-        free(var);
+        if (var->addressTaken)
+            var->type->qualifiers |= Qualifier_Stack;
     }
 
-    memcpy(oPrefRegisters, &curScope->preferredRegisters[0], 8 * sizeof(uint16_t));
+    memcpy(oPrefRegisters, &ctx->curScope->preferredRegisters[0], 8 * sizeof(uint16_t));
 
-    GenericList_Dispose(&curScope->variables);
-    Optimizer_Scope* old = curScope;
-    curScope = old->parent;
-    free(old);
-}
-
-void Optimizer_EnterLoop()
-{
-    Optimizer_Loop* new = xmalloc(sizeof(Optimizer_Loop));
-    new->accessedVars = GenericList_Create(sizeof(Optimizer_Variable*));
-    new->parent = curLoop;
-    curLoop = new;
-    loopLevel++;
+    GenericList_Dispose(&ctx->curScope->variables);
+    ctx->curScope = ctx->curScope->parent;
 }
 
 void Optimizer_LogAddrOf(const char* idOfDerefdVar)
 {
-    if (curScope == NULL)
+    if (ctx->curScope == NULL)
         return;
 
-    Optimizer_Scope* scope = curScope;
+    Optimizer_Scope* scope = ctx->curScope;
     do
     {
         Optimizer_Variable** varP = ((Optimizer_Variable**)GenericList_Find(&scope->variables, CompareVarToStr, idOfDerefdVar));
         if (varP != NULL)
         {
-            Optimizer_Variable* var = *varP;
-            var->currentScore = (int16_t)0x8000;
-            var->lastScore = (int16_t)0x8000;
+            (*varP)->addressTaken = true;
             return;
         }
     } while ((scope = scope->parent) != NULL);
 }
 
-void Optimizer_ExitLoop(void* loop)
+void Optimizer_LogInlineASM()
 {
-    for (size_t i = 0; i < curLoop->accessedVars.count; i++)
-    {
-        Optimizer_Variable** v = GenericList_At(&curLoop->accessedVars, i);
-        Optimizer_Variable* var = *v;
-        var->lastAccess = loop;
-        var->lastScore = var->currentScore;
-    }
-
-    GenericList_Dispose(&curLoop->accessedVars);
-    Optimizer_Loop* old = curLoop;
-    curLoop = old->parent;
-    free(old);
-    loopLevel--;
+    ctx->hasInlineASM = true;
 }
 
-// An inline asm counts as an access to all defined variables, as they might be used in it.
-void Optimizer_LogInlineASM(void* asmNode)
+bool Optimizer_HasInlineASM()
 {
-    Optimizer_Scope* scope = curScope;
-    do
-    {
-        for (size_t i = 0; i < scope->variables.count; i++)
-        {
-            Optimizer_Variable* var = *(Optimizer_Variable**)GenericList_At(&scope->variables, i);
-            var->lastScore = var->currentScore;
-            var->lastAccess = asmNode;
-        }
-    } while ((scope = scope->parent) != NULL);
+    return ctx->hasInlineASM;
 }
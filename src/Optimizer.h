@@ -4,13 +4,26 @@
 #include <stdint.h>
 
 #include "AST.h"
+#include "Variables.h"
 
+// Collects what code generation needs to know about a function body while it is parsed. Variables
+// whose address is taken are put on the stack, the allocator (Allocator.h) places the others.
 void Optimizer_LogDeclaration(AST_Statement_Declaration* declaration);
-void Optimizer_LogAccess(AST_Expression_VariableAccess* access);
+void Optimizer_LogParameter(Variable* parameter);
 void Optimizer_LogFunctionCall(uint16_t modifiedRegisters);
 void Optimizer_EnterNewScope();
 void Optimizer_ExitScope(uint16_t* const oPrefRegisters);
-void Optimizer_EnterLoop();
 void Optimizer_LogAddrOf(const char* idOfDerefdVar);
-void Optimizer_ExitLoop(void* loop);
-void Optimizer_LogInlineASM(void* asmNode);
\ No newline at end of file
+void Optimizer_LogInlineASM();
+// Whether the function body parsed last has inline assembly, which the allocator can't look into
+bool Optimizer_HasInlineASM();
+
+#ifndef CUSTOM_COMP
+typedef struct OptimizerContext OptimizerContext;
+#endif
+#ifdef CUSTOM_COMP
+typedef struct OptimizerContext {} OptimizerContext;
+#endif
+OptimizerContext* Optimizer_CreateContext();
+void Optimizer_DisposeContext(OptimizerContext* context);
+void Optimizer_UseContext(OptimizerContext* context);
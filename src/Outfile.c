@@ -1,21 +1,117 @@
 #include "Outfile.h"
+#include "Util.h"
+#include <assert.h>
 #include <stdarg.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
-static FILE* outFile;
-static FILE* outFileData;
+typedef struct OutfileContext
+{
+    // While no files are open, all output is discarded.
+    FILE* outFile;
+    FILE* outFileData;
+    // Text that was not written to outFile yet
+    char* text;
+    size_t textLength;
+    size_t textCapacity;
+    // Text that was written to outFile already
+    size_t flushedLength;
+    // Zero words at the end of the data that were not written yet. They are skipped
+    // over once more data follows, which leaves a hole in the file instead.
+    size_t pendingZeros;
+} OutfileContext;
+
+#ifndef CUSTOM_COMP
+static _Thread_local OutfileContext* ctx = NULL;
+#endif
+#ifdef CUSTOM_COMP
+static OutfileContext* ctx = NULL;
+#endif
+
+OutfileContext* Outfile_CreateContext()
+{
+    OutfileContext* context = xmalloc(sizeof(OutfileContext));
+    memset(context, 0, sizeof(OutfileContext));
+    return context;
+}
+
+static void FlushText(OutfileContext* context)
+{
+    if (context->textLength != 0)
+        fwrite(context->text, 1, context->textLength, context->outFile);
+    context->flushedLength += context->textLength;
+    context->textLength = 0;
+}
+
+static void WriteZeros(FILE* file, size_t numWords)
+{
+    uint16_t zeros[256];
+    for (size_t i = 0; i < 256; i++)
+        zeros[i] = 0;
+    while (numWords != 0)
+    {
+        size_t n = numWords < 256 ? numWords : 256;
+        fwrite(&zeros[0], sizeof(uint16_t), n, file);
+        numWords -= n;
+    }
+}
+
+static void SkipZeros(OutfileContext* context, size_t numWords)
+{
+#ifndef CUSTOM_COMP
+    // Outputs that can't seek, like pipes, get the zeros written
+    if (fseek(context->outFileData, (long)(numWords * sizeof(uint16_t)), SEEK_CUR) == 0)
+        return;
+#endif
+    WriteZeros(context->outFileData, numWords);
+}
+
+// Writes the pending zeros, the file only has to be extended by the last one.
+static void FlushZeros(OutfileContext* context)
+{
+    if (context->pendingZeros == 0)
+        return;
+    SkipZeros(context, context->pendingZeros - 1);
+    WriteZeros(context->outFileData, 1);
+    context->pendingZeros = 0;
+}
+
+void Outfile_DisposeContext(OutfileContext* context)
+{
+    if (context->outFile != NULL)
+    {
+        FlushText(context);
+        fclose(context->outFile);
+    }
+    if (context->outFileData != NULL)
+    {
+        FlushZeros(context);
+        fclose(context->outFileData);
+    }
+    if (ctx == context)
+        ctx = NULL;
+    free(context->text);
+    free(context);
+}
+
+void Outfile_UseContext(OutfileContext* context)
+{
+    ctx = context;
+}
 
-bool Outfile_TryOpen(char* path)
+bool Outfile_TryOpen(char* path, char* dataPath)
 {
-    outFile = fopen(path, "w");
-    if (outFile == NULL)
+    ctx->outFile = fopen(path, "w");
+    if (ctx->outFile == NULL)
         return false;
+    ctx->flushedLength = 0;
 
-    outFileData = fopen("data.bin", "w");
-    if (outFileData == NULL)
+    ctx->outFileData = fopen(dataPath, "w");
+    if (ctx->outFileData == NULL)
         return false;
 
     return true;
@@ -23,40 +119,181 @@ bool Outfile_TryOpen(char* path)
 
 void Outfile_CloseFiles()
 {
-    fclose(outFile);
-    fclose(outFileData);
+    if (ctx->outFile != NULL)
+    {
+        FlushText(ctx);
+        fclose(ctx->outFile);
+    }
+    if (ctx->outFileData != NULL)
+    {
+        FlushZeros(ctx);
+        fclose(ctx->outFileData);
+    }
+    ctx->outFile = NULL;
+    ctx->outFileData = NULL;
 }
 
+void Outfile_Flush()
+{
+    if (ctx->outFile != NULL)
+        FlushText(ctx);
+    if (ctx->outFileData != NULL)
+        FlushZeros(ctx);
+}
+
+size_t Outfile_TextLength()
+{
+    return ctx->flushedLength + ctx->textLength;
+}
+
+void Outfile_FlushIfFull()
+{
+    // Large enough for a single write to be cheap
+    if (ctx->textLength >= (1 << 16))
+        Outfile_Flush();
+}
+
+#ifndef CUSTOM_COMP
+static char* ReserveText(size_t size)
+{
+    if (ctx->textLength + size > ctx->textCapacity)
+    {
+        ctx->textCapacity = ctx->textCapacity == 0 ? (1 << 16) : ctx->textCapacity * 2;
+        if (ctx->textCapacity < ctx->textLength + size)
+            ctx->textCapacity = ctx->textLength + size;
+        ctx->text = xrealloc(ctx->text, ctx->textCapacity);
+    }
+    return ctx->text + ctx->textLength;
+}
+
+static void AppendText(const char* str, size_t length)
+{
+    memcpy(ReserveText(length), str, length);
+    ctx->textLength += length;
+}
+
+static void AppendUnsigned(uint64_t value, unsigned base)
+{
+    char digits[24];
+    size_t numDigits = 0;
+    do
+    {
+        digits[sizeof(digits) - 1 - numDigits++] = "0123456789abcdef"[value % base];
+        value /= base;
+    } while (value != 0);
+    AppendText(digits + sizeof(digits) - numDigits, numDigits);
+}
+
+static void AppendSigned(int64_t value)
+{
+    if (value < 0)
+    {
+        AppendText("-", 1);
+        AppendUnsigned(-(uint64_t)value, 10);
+    }
+    else
+        AppendUnsigned((uint64_t)value, 10);
+}
+
+// Formats like vprintf, but only knows the conversions the code generator uses:
+// %i, %d, %u, %x (with z or l), %c, %s and %%.
+static void FormatText(const char* format, va_list args)
+{
+    while (*format != 0)
+    {
+        const char* run = format;
+        while (*format != 0 && *format != '%')
+            format++;
+        AppendText(run, format - run);
+        if (*format == 0)
+            break;
+
+        format++;
+        char size = 0;
+        if (*format == 'z' || *format == 'l')
+            size = *format++;
+
+        switch (*format++)
+        {
+            case 'i':
+            case 'd':
+                if (size == 'z')
+                    AppendSigned(va_arg(args, ptrdiff_t));
+                else if (size == 'l')
+                    AppendSigned(va_arg(args, long));
+                else
+                    AppendSigned(va_arg(args, int));
+                break;
+            case 'u':
+            case 'x':
+            {
+                uint64_t value;
+                if (size == 'z')
+                    value = va_arg(args, size_t);
+                else if (size == 'l')
+                    value = va_arg(args, unsigned long);
+                else
+                    value = va_arg(args, unsigned);
+                AppendUnsigned(value, format[-1] == 'x' ? 16 : 10);
+                break;
+            }
+            case 'c':
+            {
+                char c = (char)va_arg(args, int);
+                AppendText(&c, 1);
+                break;
+            }
+            case 's':
+            {
+                const char* str = va_arg(args, const char*);
+                AppendText(str, strlen(str));
+                break;
+            }
+            case '%': AppendText("%", 1); break;
+            default: assert(0);
+        }
+    }
+}
+#endif
+
 void OutWrite(const char* format, ...)
 {
+    if (ctx->outFile == NULL)
+        return;
 #ifndef CUSTOM_COMP
     va_list args;
     va_start(args, format);
-    vfprintf(outFile, format, args);
-    // vprintf(format, args);
+    FormatText(format, args);
     va_end(args);
 #endif
 #ifdef CUSTOM_COMP
-    vfprintf(outFile, format, (void*)(format - 1));
+    vfprintf(ctx->outFile, format, (void*)(format - 1));
 #endif
 }
 
 #ifndef CUSTOM_COMP
 void OutWriteData(const uint8_t* data, size_t len)
 {
-    fwrite(data, sizeof(uint8_t), len, outFileData);
+    if (ctx->outFileData == NULL)
+        return;
+    SkipZeros(ctx, ctx->pendingZeros);
+    ctx->pendingZeros = 0;
+    fwrite(data, sizeof(uint8_t), len, ctx->outFileData);
 }
 #endif
 #ifdef CUSTOM_COMP
 void OutWriteData(const uint16_t* data, size_t len)
 {
-    fwrite(data, sizeof(uint16_t), len, outFileData);
+    if (ctx->outFileData == NULL)
+        return;
+    SkipZeros(ctx, ctx->pendingZeros);
+    ctx->pendingZeros = 0;
+    fwrite(data, sizeof(uint16_t), len, ctx->outFileData);
 }
 #endif
 void OutWriteZeros(size_t size)
 {
-    // Yeah, this is slow...
-    uint16_t zero = 0;
-    while (size--)
-        fwrite(&zero, sizeof(uint16_t), 1, outFileData);
+    if (ctx->outFileData == NULL)
+        return;
+    ctx->pendingZeros += size;
 }
@@ -3,13 +3,33 @@
 #include <stdint.h>
 #include <stdio.h>
 
-bool Outfile_TryOpen(char* path);
+bool Outfile_TryOpen(char* path, char* dataPath);
+// Output written while no files are open is discarded.
 void Outfile_CloseFiles();
+// Text is collected in memory and only written to the file when it is flushed or closed,
+// so the code of the item being compiled can still be looked at before it hits the disk.
 void OutWrite(const char* format, ...);
+// Writes all collected output.
+void Outfile_Flush();
+// Flushes once enough text was collected. Called between items.
+void Outfile_FlushIfFull();
+// Bytes of text written since the files were opened, flushed or not
+size_t Outfile_TextLength();
 #ifndef CUSTOM_COMP
 void OutWriteData(const uint8_t* data, size_t size);
 #endif
 #ifdef CUSTOM_COMP
 void OutWriteData(uint16_t* data, size_t size);
 #endif
-void OutWriteZeros(size_t len);
\ No newline at end of file
+// Zeros cost no writes, a range of them becomes a hole in the data file where possible.
+void OutWriteZeros(size_t len);
+
+#ifndef CUSTOM_COMP
+typedef struct OutfileContext OutfileContext;
+#endif
+#ifdef CUSTOM_COMP
+typedef struct OutfileContext {} OutfileContext;
+#endif
+OutfileContext* Outfile_CreateContext();
+void Outfile_DisposeContext(OutfileContext* context);
+void Outfile_UseContext(OutfileContext* context);
@@ -0,0 +1,693 @@
+#include "PCH.h"
+#include "Data.h"
+#include "Error.h"
+#include "Function.h"
+#include "GenericList.h"
+#include "Intern.h"
+#include "Preprocessor.h"
+#include "Relocation.h"
+#include "Scope.h"
+#include "Struct.h"
+#include "Type.h"
+#include "Util.h"
+#include "Value.h"
+#include "Variables.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef CUSTOM_COMP
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// File layout, all integers are 32 bit little endian:
+//   magic, version
+//   sources:   count, (path, mtime seconds (64 bit), mtime nanoseconds, size (64 bit)) of each file it was built from
+//   defines:   count, strings
+//   once:      count, strings (files that contained #pragma once)
+//   structs:   count, (identifier, sizeInWords, inScope) for each, then members of each
+//   typedefs:  count, (name, type)
+//   enums:     count, names
+//   data:      count, 16 bit words
+//   variables: count, variables (data addresses are relative to the start of data)
+//   functions: count, functions
+// Strings are stored as length + bytes, with length 0xFFFFFFFF for NULL.
+// Types are stored as trees; struct types refer to structs by index.
+static const uint32_t PCH_MAGIC = 0x48435043; // "CPCH"
+static const uint32_t PCH_VERSION = 4;
+
+typedef struct
+{
+    uint8_t* data;
+    size_t length;
+    size_t capacity;
+} WriteBuffer;
+
+typedef struct
+{
+    const uint8_t* data;
+    size_t length;
+    size_t position;
+} ReadBuffer;
+
+// A file the PCH was built from, the PCH is out of date once it changes
+typedef struct
+{
+    char* path; // interned canonical path
+    struct timespec mtime;
+    off_t size;
+} SourceStamp;
+
+typedef struct PCHContext
+{
+    // Mapping of the loaded PCH
+    const uint8_t* pchData;
+    size_t pchLength;
+
+    // Files read by the translation unit that is written as a PCH
+    GenericList sources;
+    bool recordingSources;
+
+    // Global data of the translation unit that is written as a PCH
+    GenericList capturedData;
+    size_t capturedDataBase;
+} PCHContext;
+
+static _Thread_local PCHContext* ctx = NULL;
+
+static void WriteBytes(WriteBuffer* buf, const void* data, size_t length)
+{
+    if (buf->length + length > buf->capacity)
+    {
+        while (buf->length + length > buf->capacity)
+            buf->capacity = buf->capacity == 0 ? 4096 : buf->capacity * 2;
+        buf->data = xrealloc(buf->data, buf->capacity);
+    }
+    memcpy(buf->data + buf->length, data, length);
+    buf->length += length;
+}
+
+static void Write32(WriteBuffer* buf, uint32_t value)
+{
+    WriteBytes(buf, &value, sizeof(uint32_t));
+}
+
+static void Write64(WriteBuffer* buf, uint64_t value)
+{
+    Write32(buf, (uint32_t)value);
+    Write32(buf, (uint32_t)(value >> 32));
+}
+
+static void WriteString(WriteBuffer* buf, const char* str)
+{
+    if (str == NULL)
+    {
+        Write32(buf, UINT32_MAX);
+        return;
+    }
+    uint32_t length = (uint32_t)strlen(str);
+    Write32(buf, length);
+    WriteBytes(buf, str, length);
+}
+
+static uint32_t Read32(ReadBuffer* buf)
+{
+    if (buf->position + sizeof(uint32_t) > buf->length)
+        Error("Corrupt precompiled header");
+    uint32_t value;
+    memcpy(&value, buf->data + buf->position, sizeof(uint32_t));
+    buf->position += sizeof(uint32_t);
+    return value;
+}
+
+static uint64_t Read64(ReadBuffer* buf)
+{
+    uint64_t low = Read32(buf);
+    return low | ((uint64_t)Read32(buf) << 32);
+}
+
+// Strings are interned, so identifiers from the PCH compare equal to those from the lexer.
+static char* ReadString(ReadBuffer* buf)
+{
+    uint32_t length = Read32(buf);
+    if (length == UINT32_MAX)
+        return NULL;
+    if (buf->position + length > buf->length)
+        Error("Corrupt precompiled header");
+    char* str = Intern_String((const char*)buf->data + buf->position, length);
+    buf->position += length;
+    return str;
+}
+
+static void CollectStructs(GenericList* structs, VariableType* type);
+
+static void CollectStructsInFunction(GenericList* structs, Function* func)
+{
+    CollectStructs(structs, func->returnType);
+    for (size_t i = 0; i < func->parameters.count; i++)
+        CollectStructs(structs, ((Variable*)GenericList_At(&func->parameters, i))->type);
+}
+
+static void CollectStruct(GenericList* structs, Struct* s)
+{
+    for (size_t i = 0; i < structs->count; i++)
+        if (*(Struct**)GenericList_At(structs, i) == s)
+            return;
+
+    GenericList_Append(structs, &s);
+    for (size_t i = 0; i < s->members.count; i++)
+        CollectStructs(structs, ((Variable*)GenericList_At(&s->members, i))->type);
+}
+
+static void CollectStructs(GenericList* structs, VariableType* type)
+{
+    switch (type->token)
+    {
+        case PointerToken: CollectStructs(structs, ((VariableTypePtr*)type)->baseType); break;
+        case ArrayToken: CollectStructs(structs, ((VariableTypeArray*)type)->memberType); break;
+        case StructKeyword: CollectStruct(structs, ((VariableTypeStruct*)type)->str); break;
+        case FunctionPointerToken: CollectStructsInFunction(structs, &((VariableTypeFunctionPointer*)type)->func); break;
+        default: break;
+    }
+}
+
+static uint32_t StructIndex(GenericList* structs, Struct* s)
+{
+    for (size_t i = 0; i < structs->count; i++)
+        if (*(Struct**)GenericList_At(structs, i) == s)
+            return (uint32_t)i;
+    assert(0);
+    return 0;
+}
+
+static void WriteType(WriteBuffer* buf, GenericList* structs, VariableType* type);
+static void WriteFunction(WriteBuffer* buf, GenericList* structs, Function* func);
+
+static void WriteVariable(WriteBuffer* buf, GenericList* structs, Variable* var)
+{
+    WriteString(buf, var->name);
+    WriteType(buf, structs, var->type);
+    Write32(buf, (uint32_t)var->value.address);
+    Write32(buf, (uint32_t)var->value.addressType);
+    Write32(buf, (uint32_t)var->value.size);
+}
+
+static void WriteType(WriteBuffer* buf, GenericList* structs, VariableType* type)
+{
+    Write32(buf, (uint32_t)type->token);
+    Write32(buf, (uint32_t)type->qualifiers);
+    switch (type->token)
+    {
+        case PointerToken: WriteType(buf, structs, ((VariableTypePtr*)type)->baseType); break;
+        case ArrayToken:
+            Write32(buf, (uint32_t)((VariableTypeArray*)type)->memberCount);
+            WriteType(buf, structs, ((VariableTypeArray*)type)->memberType);
+            break;
+        case StructKeyword: Write32(buf, StructIndex(structs, ((VariableTypeStruct*)type)->str)); break;
+        case FunctionPointerToken: WriteFunction(buf, structs, &((VariableTypeFunctionPointer*)type)->func); break;
+        default: break;
+    }
+}
+
+static void WriteFunction(WriteBuffer* buf, GenericList* structs, Function* func)
+{
+    WriteString(buf, func->identifier);
+    WriteType(buf, structs, func->returnType);
+    Write32(buf, func->modifiedRegisters);
+    Write32(buf, func->variadicArguments);
+    Write32(buf, func->isForwardDecl);
+    Write32(buf, (uint32_t)func->parameters.count);
+    for (size_t i = 0; i < func->parameters.count; i++)
+        WriteVariable(buf, structs, GenericList_At(&func->parameters, i));
+}
+
+static bool GetSourceStamp(const char* path, SourceStamp* out)
+{
+    struct stat st;
+    if (stat(path, &st) != 0)
+        return false;
+
+    char* canonical = realpath(path, NULL);
+    if (canonical == NULL)
+        return false;
+    out->path = Intern_CString(canonical);
+    free(canonical);
+
+    out->mtime = st.st_mtim;
+    out->size = st.st_size;
+    return true;
+}
+
+static bool SourceStampEquals(const SourceStamp* a, const SourceStamp* b)
+{
+    return a->path == b->path && a->size == b->size && a->mtime.tv_sec == b->mtime.tv_sec &&
+           a->mtime.tv_nsec == b->mtime.tv_nsec;
+}
+
+static void AddSourceStamp(SourceStamp* stamp)
+{
+    for (size_t i = 0; i < ctx->sources.count; i++)
+        if (((SourceStamp*)GenericList_At(&ctx->sources, i))->path == stamp->path)
+            return;
+    GenericList_Append(&ctx->sources, stamp);
+}
+
+static SourceStamp ReadSourceStamp(ReadBuffer* buf)
+{
+    SourceStamp stamp;
+    stamp.path = ReadString(buf);
+    stamp.mtime.tv_sec = (time_t)Read64(buf);
+    stamp.mtime.tv_nsec = (long)Read32(buf);
+    stamp.size = (off_t)Read64(buf);
+    return stamp;
+}
+
+void PCH_BeginWrite(const char* sourcePath)
+{
+    ctx->capturedData = GenericList_Create(sizeof(uint16_t));
+    ctx->capturedDataBase = GetGlobalDataIndex();
+    SetDataCapture(&ctx->capturedData);
+
+    ctx->sources = GenericList_Create(sizeof(SourceStamp));
+    ctx->recordingSources = true;
+    PCH_AddSource(sourcePath);
+    // Declarations from a loaded PCH are written again, so its sources are ours as well
+    if (ctx->pchData != NULL)
+    {
+        ReadBuffer buf = {ctx->pchData, ctx->pchLength, 2 * sizeof(uint32_t)};
+        uint32_t numSources = Read32(&buf);
+        for (uint32_t i = 0; i < numSources; i++)
+        {
+            SourceStamp stamp = ReadSourceStamp(&buf);
+            AddSourceStamp(&stamp);
+        }
+    }
+}
+
+void PCH_AddSource(const char* path)
+{
+    if (!ctx->recordingSources)
+        return;
+    SourceStamp stamp;
+    if (GetSourceStamp(path, &stamp))
+        AddSourceStamp(&stamp);
+}
+
+void PCH_Write(const char* path, Scope* globalScope)
+{
+    SetDataCapture(NULL);
+    if (!DataCaptureIsRelocatable())
+        Error("Precompiled headers can not contain string literals");
+
+    // Function definitions would be missing from the files using the PCH,
+    // global data on the other hand is copied into each of them.
+    for (size_t i = 0; i < Function_Count(); i++)
+    {
+        if (!Function_At(i)->isForwardDecl)
+            Error("Precompiled headers can not contain function definitions");
+    }
+
+    GenericList structs = GenericList_Create(sizeof(Struct*));
+    for (size_t i = 0; i < globalScope->structs.count; i++)
+        CollectStruct(&structs, *(Struct**)GenericList_At(&globalScope->structs, i));
+    for (size_t i = 0; i < globalScope->typedefs.count; i++)
+        CollectStructs(&structs, ((Typedef*)GenericList_At(&globalScope->typedefs, i))->type);
+    for (size_t i = 0; i < globalScope->variables.count; i++)
+        CollectStructs(&structs, ((Variable*)GenericList_At(&globalScope->variables, i))->type);
+    for (size_t i = 0; i < Function_Count(); i++)
+        CollectStructsInFunction(&structs, Function_At(i));
+
+    WriteBuffer buf = {NULL, 0, 0};
+    Write32(&buf, PCH_MAGIC);
+    Write32(&buf, PCH_VERSION);
+
+    Write32(&buf, (uint32_t)ctx->sources.count);
+    for (size_t i = 0; i < ctx->sources.count; i++)
+    {
+        SourceStamp* stamp = GenericList_At(&ctx->sources, i);
+        WriteString(&buf, stamp->path);
+        Write64(&buf, (uint64_t)stamp->mtime.tv_sec);
+        Write32(&buf, (uint32_t)stamp->mtime.tv_nsec);
+        Write64(&buf, (uint64_t)stamp->size);
+    }
+    GenericList_Dispose(&ctx->sources);
+    ctx->recordingSources = false;
+
+    Write32(&buf, (uint32_t)Preprocessor_NumDefines());
+    for (size_t i = 0; i < Preprocessor_NumDefines(); i++)
+        WriteString(&buf, Preprocessor_GetDefine(i));
+    Write32(&buf, (uint32_t)Preprocessor_NumOnceFiles());
+    for (size_t i = 0; i < Preprocessor_NumOnceFiles(); i++)
+        WriteString(&buf, Preprocessor_GetOnceFile(i));
+
+    Write32(&buf, (uint32_t)structs.count);
+    for (size_t i = 0; i < structs.count; i++)
+    {
+        Struct* s = *(Struct**)GenericList_At(&structs, i);
+        bool inScope = false;
+        for (size_t j = 0; j < globalScope->structs.count && !inScope; j++)
+            inScope = *(Struct**)GenericList_At(&globalScope->structs, j) == s;
+
+        WriteString(&buf, s->identifier);
+        Write32(&buf, (uint32_t)s->sizeInWords);
+        Write32(&buf, inScope);
+    }
+    for (size_t i = 0; i < structs.count; i++)
+    {
+        Struct* s = *(Struct**)GenericList_At(&structs, i);
+        Write32(&buf, (uint32_t)s->members.count);
+        for (size_t j = 0; j < s->members.count; j++)
+            WriteVariable(&buf, &structs, GenericList_At(&s->members, j));
+    }
+
+    Write32(&buf, (uint32_t)globalScope->typedefs.count);
+    for (size_t i = 0; i < globalScope->typedefs.count; i++)
+    {
+        Typedef* td = GenericList_At(&globalScope->typedefs, i);
+        WriteString(&buf, td->name);
+        WriteType(&buf, &structs, td->type);
+    }
+
+    Write32(&buf, (uint32_t)globalScope->enums.count);
+    for (size_t i = 0; i < globalScope->enums.count; i++)
+        WriteString(&buf, ((Enum*)GenericList_At(&globalScope->enums, i))->identifier);
+
+    Write32(&buf, (uint32_t)ctx->capturedData.count);
+    WriteBytes(&buf, ctx->capturedData.data, ctx->capturedData.count * sizeof(uint16_t));
+
+    Write32(&buf, (uint32_t)globalScope->variables.count);
+    for (size_t i = 0; i < globalScope->variables.count; i++)
+    {
+        Variable var = *(Variable*)GenericList_At(&globalScope->variables, i);
+        if (var.value.addressType == AddressType_Memory)
+            var.value.address -= (int32_t)ctx->capturedDataBase;
+        WriteVariable(&buf, &structs, &var);
+    }
+
+    Write32(&buf, (uint32_t)Function_Count());
+    for (size_t i = 0; i < Function_Count(); i++)
+        WriteFunction(&buf, &structs, Function_At(i));
+
+    GenericList_Dispose(&structs);
+    GenericList_Dispose(&ctx->capturedData);
+
+    FILE* f = fopen(path, "wb");
+    if (f == NULL || fwrite(buf.data, 1, buf.length, f) != buf.length)
+        Error("Could not write precompiled header");
+    fclose(f);
+    free(buf.data);
+}
+
+bool PCH_Load(const char* path)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat st;
+    void* mapping = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && st.st_size > 0)
+        mapping = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED)
+        return false;
+
+    ctx->pchData = mapping;
+    ctx->pchLength = (size_t)st.st_size;
+
+    ReadBuffer buf = {ctx->pchData, ctx->pchLength, 0};
+    if (Read32(&buf) != PCH_MAGIC || Read32(&buf) != PCH_VERSION)
+        Error("Invalid precompiled header");
+
+    uint32_t numSources = Read32(&buf);
+    for (uint32_t i = 0; i < numSources; i++)
+    {
+        SourceStamp stamp = ReadSourceStamp(&buf);
+        SourceStamp current;
+        if (!GetSourceStamp(stamp.path, &current) || !SourceStampEquals(&current, &stamp))
+        {
+            char message[PATH_MAX + 64];
+            snprintf(message, sizeof(message), "Precompiled header is out of date, %s changed", stamp.path);
+            Error(message);
+        }
+    }
+    return true;
+}
+
+bool PCH_IsLoaded()
+{
+    return ctx->pchData != NULL;
+}
+
+// Moves buf to the defines, past the header and the sources
+static void SkipSources(ReadBuffer* buf)
+{
+    buf->position = 2 * sizeof(uint32_t);
+    uint32_t count = Read32(buf);
+    for (uint32_t i = 0; i < count; i++)
+        ReadSourceStamp(buf);
+}
+
+static void SkipDefines(ReadBuffer* buf)
+{
+    SkipSources(buf);
+    for (int section = 0; section < 2; section++)
+    {
+        uint32_t count = Read32(buf);
+        for (uint32_t i = 0; i < count; i++)
+            ReadString(buf);
+    }
+}
+
+void PCH_ApplyDefines()
+{
+    ReadBuffer buf = {ctx->pchData, ctx->pchLength, 0};
+    SkipSources(&buf);
+    uint32_t count = Read32(&buf);
+    for (uint32_t i = 0; i < count; i++)
+        Preprocessor_Define(ReadString(&buf));
+    count = Read32(&buf);
+    for (uint32_t i = 0; i < count; i++)
+        Preprocessor_AddOnceFile(ReadString(&buf));
+}
+
+static VariableType* ReadType(ReadBuffer* buf, Struct** structs, uint32_t numStructs);
+static Function ReadFunction(ReadBuffer* buf, Struct** structs, uint32_t numStructs);
+
+static Variable ReadVariable(ReadBuffer* buf, Struct** structs, uint32_t numStructs)
+{
+    Variable var;
+    var.name = ReadString(buf);
+    var.type = ReadType(buf, structs, numStructs);
+    var.value.address = (int32_t)Read32(buf);
+    var.value.addressType = (AddressType)Read32(buf);
+    var.value.size = (int)Read32(buf);
+    var.value.dataRelative = false;
+    var.liveIndex = -1;
+    var.released = false;
+    return var;
+}
+
+// Every type is decoded into a fresh tree, just like the parser creates one per declaration.
+static VariableType* ReadType(ReadBuffer* buf, Struct** structs, uint32_t numStructs)
+{
+    TokenType token = (TokenType)Read32(buf);
+    Qualifiers qualifiers = (Qualifiers)Read32(buf);
+
+    VariableType* type;
+    switch (token)
+    {
+        case PointerToken:
+        {
+            VariableTypePtr* ptr = xmalloc(sizeof(VariableTypePtr));
+            ptr->baseType = ReadType(buf, structs, numStructs);
+            type = (VariableType*)ptr;
+            break;
+        }
+        case ArrayToken:
+        {
+            VariableTypeArray* arr = xmalloc(sizeof(VariableTypeArray));
+            arr->memberCount = (int)Read32(buf);
+            arr->memberType = ReadType(buf, structs, numStructs);
+            type = (VariableType*)arr;
+            break;
+        }
+        case StructKeyword:
+        {
+            VariableTypeStruct* str = xmalloc(sizeof(VariableTypeStruct));
+            uint32_t index = Read32(buf);
+            if (index >= numStructs)
+                Error("Corrupt precompiled header");
+            str->str = structs[index];
+            type = (VariableType*)str;
+            break;
+        }
+        case FunctionPointerToken:
+        {
+            VariableTypeFunctionPointer* fptr = xmalloc(sizeof(VariableTypeFunctionPointer));
+            fptr->func = ReadFunction(buf, structs, numStructs);
+            type = (VariableType*)fptr;
+            break;
+        }
+        default: type = xmalloc(sizeof(VariableType)); break;
+    }
+
+    type->token = token;
+    type->qualifiers = qualifiers;
+    type->refCount = 1;
+    return type;
+}
+
+static Function ReadFunction(ReadBuffer* buf, Struct** structs, uint32_t numStructs)
+{
+    Function func;
+    func.identifier = ReadString(buf);
+    func.returnType = ReadType(buf, structs, numStructs);
+    func.modifiedRegisters = (uint16_t)Read32(buf);
+    func.variadicArguments = Read32(buf) != 0;
+    func.isForwardDecl = Read32(buf) != 0;
+
+    uint32_t numParameters = Read32(buf);
+    func.parameters = GenericList_Create(sizeof(Variable));
+    for (uint32_t i = 0; i < numParameters; i++)
+    {
+        Variable param = ReadVariable(buf, structs, numStructs);
+        GenericList_Append(&func.parameters, &param);
+    }
+    return func;
+}
+
+void PCH_PopulateScope(Scope* globalScope)
+{
+    ReadBuffer buf = {ctx->pchData, ctx->pchLength, 0};
+    SkipDefines(&buf);
+
+    // Structs are created up front, as members may refer to any of them
+    uint32_t numStructs = Read32(&buf);
+    Struct** structs = xmalloc((numStructs + 1) * sizeof(Struct*));
+    for (uint32_t i = 0; i < numStructs; i++)
+    {
+        Struct* s = xmalloc(sizeof(Struct));
+        s->identifier = ReadString(&buf);
+        s->sizeInWords = (int)Read32(&buf);
+        s->members = GenericList_Create(sizeof(Variable));
+        if (Read32(&buf))
+            Scope_AddStruct(globalScope, s);
+        structs[i] = s;
+    }
+    for (uint32_t i = 0; i < numStructs; i++)
+    {
+        uint32_t numMembers = Read32(&buf);
+        for (uint32_t j = 0; j < numMembers; j++)
+        {
+            Variable member = ReadVariable(&buf, structs, numStructs);
+            GenericList_Append(&structs[i]->members, &member);
+        }
+    }
+
+    uint32_t numTypedefs = Read32(&buf);
+    for (uint32_t i = 0; i < numTypedefs; i++)
+    {
+        Typedef td;
+        td.name = ReadString(&buf);
+        td.type = ReadType(&buf, structs, numStructs);
+        Scope_AddTypedef(globalScope, td);
+    }
+
+    uint32_t numEnums = Read32(&buf);
+    for (uint32_t i = 0; i < numEnums; i++)
+        Scope_AddEnum(globalScope, (Enum){ReadString(&buf)});
+
+    uint32_t numWords = Read32(&buf);
+    if (buf.position + numWords * sizeof(uint16_t) > buf.length)
+        Error("Corrupt precompiled header");
+    size_t dataBase = GetGlobalDataIndex();
+    for (uint32_t i = 0; i < numWords; i++)
+    {
+        uint16_t word;
+        memcpy(&word, buf.data + buf.position, sizeof(uint16_t));
+        buf.position += sizeof(uint16_t);
+        AllocateGlobalWord(word);
+    }
+
+    uint32_t numVariables = Read32(&buf);
+    for (uint32_t i = 0; i < numVariables; i++)
+    {
+        Variable var = ReadVariable(&buf, structs, numStructs);
+        if (var.value.addressType == AddressType_Memory)
+        {
+            var.value.address += (int32_t)dataBase;
+            var.value.dataRelative = Relocation_IsRecording();
+        }
+        Scope_AddVariable(globalScope, var);
+    }
+
+    uint32_t numFunctions = Read32(&buf);
+    for (uint32_t i = 0; i < numFunctions; i++)
+        Function_Add(ReadFunction(&buf, structs, numStructs));
+
+    free(structs);
+}
+
+void PCH_Dispose()
+{
+    if (ctx->pchData != NULL)
+        munmap((void*)ctx->pchData, ctx->pchLength);
+    ctx->pchData = NULL;
+    ctx->pchLength = 0;
+}
+
+PCHContext* PCH_CreateContext()
+{
+    PCHContext* context = xmalloc(sizeof(PCHContext));
+    memset(context, 0, sizeof(PCHContext));
+    return context;
+}
+
+void PCH_DisposeContext(PCHContext* context)
+{
+    if (context->pchData != NULL)
+        munmap((void*)context->pchData, context->pchLength);
+    if (context->recordingSources)
+        GenericList_Dispose(&context->sources);
+    if (ctx == context)
+        ctx = NULL;
+    free(context);
+}
+
+void PCH_UseContext(PCHContext* context)
+{
+    ctx = context;
+}
+#endif
+
+#ifdef CUSTOM_COMP
+void PCH_BeginWrite(const char* sourcePath) {}
+void PCH_AddSource(const char* path) {}
+void PCH_Write(const char* path, Scope* globalScope)
+{
+    Error("Precompiled headers are not supported");
+}
+bool PCH_Load(const char* path)
+{
+    return false;
+}
+bool PCH_IsLoaded()
+{
+    return false;
+}
+void PCH_ApplyDefines() {}
+void PCH_PopulateScope(Scope* globalScope) {}
+void PCH_Dispose() {}
+PCHContext* PCH_CreateContext()
+{
+    return NULL;
+}
+void PCH_DisposeContext(PCHContext* context) {}
+void PCH_UseContext(PCHContext* context) {}
+#endif
@@ -0,0 +1,36 @@
+#pragma once
+#include "Scope.h"
+#include <stdbool.h>
+
+// Precompiled headers store the global scope of a translation unit (types,
+// structs, typedefs, enums, global variables and function prototypes) along with the
+// preprocessor defines, so headers don't have to be parsed again for every file.
+// Including a header that is part of the PCH relies on its #pragma once (or
+// include guard) define to skip it.
+
+// Records the global data of the current translation unit, needs to be called before compiling it.
+// The PCH is only loaded as long as sourcePath and the files added with PCH_AddSource are unchanged.
+void PCH_BeginWrite(const char* sourcePath);
+// Adds a file read by the translation unit that is written as a PCH, if any.
+void PCH_AddSource(const char* path);
+// Serializes the global scope, functions and global data of the current translation unit.
+void PCH_Write(const char* path, Scope* globalScope);
+
+bool PCH_Load(const char* path);
+bool PCH_IsLoaded();
+// Restores the defines of the loaded PCH. Needs to be called before lexing each file.
+void PCH_ApplyDefines();
+// Adds the declarations of the loaded PCH to the (empty) global scope and function list.
+// Global variables get a fresh copy of their data, as every translation unit has its own.
+void PCH_PopulateScope(Scope* globalScope);
+void PCH_Dispose();
+
+#ifndef CUSTOM_COMP
+typedef struct PCHContext PCHContext;
+#endif
+#ifdef CUSTOM_COMP
+typedef struct PCHContext {} PCHContext;
+#endif
+PCHContext* PCH_CreateContext();
+void PCH_DisposeContext(PCHContext* context);
+void PCH_UseContext(PCHContext* context);
@@ -0,0 +1,719 @@
+#include "Parallel.h"
+#include "Compiler.h"
+#include "Error.h"
+#include "Lexer.h"
+#include "Outfile.h"
+#include "Peephole.h"
+#include "Relocation.h"
+#include "Util.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef CUSTOM_COMP
+#include <dirent.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// Every unit is compiled once, with the data address and label id the first unit starts
+// with, while its worker records the relocations of its output (see Relocation.h). The
+// parent then adds how far the unit really starts after that to the recorded numbers. Units
+// whose output depends on their addresses in ways the move doesn't survive are compiled again
+// with their final base state.
+typedef struct
+{
+    // Items first to end - 1 are compiled one after another into the output of the unit
+    size_t first;
+    size_t end;
+    size_t dataSize;
+    int numLabels;
+    // The temporary output of the unit was compiled with base
+    CompilerState base;
+    RelocationInfo relocations;
+    // Of the peephole report, added up once the unit is compiled for good
+    size_t peepholeCounts[PeepholeRule_Count];
+} Unit;
+
+// Sent from the parent to a worker
+typedef struct
+{
+    uint32_t unit;
+    uint32_t first;
+    uint32_t end;
+    CompilerState base;
+} Job;
+
+// Ends the batch of the followers. The state they continue with is in base,
+// the results of all items of the batch follow the job.
+static const uint32_t END_BATCH = UINT32_MAX;
+
+// Sent back once a job is done. Followed by the values compile returned for the items of the
+// job, the excluded deltas (int32_t) and the relocations of its output.
+typedef struct
+{
+    uint32_t unit;
+    uint32_t dataSize;
+    int32_t numLabels;
+    int32_t maxDelta;
+    uint32_t numExcluded;
+    uint32_t numRelocations;
+    size_t peepholeCounts[PeepholeRule_Count];
+} JobResult;
+
+typedef struct
+{
+    int numWorkers;
+    pid_t* workers;
+    // Ends of the pipes to and from each worker that the parent uses
+    int* jobFds;
+    int* resultFds;
+    // In a worker, its index and its ends of the pipes. -1 in the parent.
+    int self;
+    int jobFd;
+    int resultFd;
+    // Whether the workers are followers, see Parallel_StartFollowers
+    bool following;
+    size_t numFollowers;
+    // Followers print to /dev/null, except while running a job
+    int stdoutFd;
+    int stderrFd;
+    int devNullFd;
+} Pool;
+
+static Pool pool = {0, NULL, NULL, NULL, -1, -1, -1, false, 0, -1, -1, -1};
+
+// Holds the output of the units while it is not merged yet
+static char tempDir[PATH_MAX];
+
+static void TempPath(char* out, size_t size, size_t unit, const char* extension)
+{
+    snprintf(out, size, "%s/%zu.%s", tempDir, unit, extension);
+}
+
+static void RemoveTemporaries()
+{
+    DIR* dir = opendir(tempDir);
+    if (dir != NULL)
+    {
+        struct dirent* entry;
+        while ((entry = readdir(dir)) != NULL)
+            if (strcmp(entry->d_name, ".") != 0 && strcmp(entry->d_name, "..") != 0)
+                unlinkat(dirfd(dir), entry->d_name, 0);
+        closedir(dir);
+    }
+    rmdir(tempDir);
+}
+
+// Ends the workers and removes their output. Also run by Error_Abort, so neither
+// stays behind when compilation fails.
+static void Shutdown()
+{
+    Error_SetCleanup(NULL);
+    // Workers have nothing left to do that is needed, followers may still be going
+    for (int w = 0; w < pool.numWorkers; w++)
+    {
+        close(pool.jobFds[w]);
+        close(pool.resultFds[w]);
+        kill(pool.workers[w], SIGKILL);
+        waitpid(pool.workers[w], NULL, 0);
+    }
+    free(pool.workers);
+    free(pool.jobFds);
+    free(pool.resultFds);
+    pool.numWorkers = 0;
+    pool.workers = NULL;
+    pool.jobFds = NULL;
+    pool.resultFds = NULL;
+    pool.following = false;
+    RemoveTemporaries();
+}
+
+static void CreateTemporaries()
+{
+    const char* parent = getenv("TMPDIR");
+    if (parent == NULL || parent[0] == 0)
+        parent = "/tmp";
+    // Leaves room for the file names in it
+    if (strlen(parent) + 64 > sizeof(tempDir))
+        Error("Path of TMPDIR is too long");
+    snprintf(tempDir, sizeof(tempDir), "%s/comp-XXXXXX", parent);
+    if (mkdtemp(tempDir) == NULL)
+        Error("Could not create temporary directory");
+    Error_SetCleanup(Shutdown);
+}
+
+static char* ReadTemporary(size_t unit, const char* extension, size_t* size)
+{
+    char path[PATH_MAX];
+    TempPath(path, sizeof(path), unit, extension);
+    char* content = readFileAsString(path, size);
+    if (content == NULL)
+        Error("Could not read temporary output file");
+    return content;
+}
+
+static bool ReadAll(int fd, void* buffer, size_t size)
+{
+    while (size != 0)
+    {
+        ssize_t n = read(fd, buffer, size);
+        if (n <= 0)
+            return false;
+        buffer = (char*)buffer + n;
+        size -= (size_t)n;
+    }
+    return true;
+}
+
+static bool WriteAll(int fd, const void* buffer, size_t size)
+{
+    while (size != 0)
+    {
+        ssize_t n = write(fd, buffer, size);
+        if (n <= 0)
+            return false;
+        buffer = (const char*)buffer + n;
+        size -= (size_t)n;
+    }
+    return true;
+}
+
+// Followers only show what they print while running a job, the parent prints everything else itself
+static void ShowOutput(bool show)
+{
+    fflush(stdout);
+    fflush(stderr);
+    dup2(show ? pool.stdoutFd : pool.devNullFd, STDOUT_FILENO);
+    dup2(show ? pool.stderrFd : pool.devNullFd, STDERR_FILENO);
+}
+
+// Starts numWorkers workers. Returns in the parent and, with pool.self set, in each worker.
+static void StartWorkers(int numWorkers)
+{
+    // Workers must not inherit unwritten output
+    Outfile_Flush();
+    fflush(NULL);
+    pool.workers = xmalloc(numWorkers * sizeof(pid_t));
+    pool.jobFds = xmalloc(numWorkers * sizeof(int));
+    pool.resultFds = xmalloc(numWorkers * sizeof(int));
+    for (int w = 0; w < numWorkers; w++)
+    {
+        int jobsPipe[2];
+        int resultsPipe[2];
+        if (pipe(jobsPipe) != 0)
+            Error("Could not create pipe");
+        if (pipe(resultsPipe) != 0)
+        {
+            close(jobsPipe[0]);
+            close(jobsPipe[1]);
+            Error("Could not create pipe");
+        }
+
+        pid_t pid = fork();
+        if (pid < 0)
+        {
+            close(jobsPipe[0]);
+            close(jobsPipe[1]);
+            close(resultsPipe[0]);
+            close(resultsPipe[1]);
+            Error("Could not start worker process");
+        }
+        if (pid == 0)
+        {
+            // Workers only talk to the parent, they must not keep the pipes of other workers open
+            for (int other = 0; other < w; other++)
+            {
+                close(pool.jobFds[other]);
+                close(pool.resultFds[other]);
+            }
+            close(jobsPipe[1]);
+            close(resultsPipe[0]);
+            pool.numWorkers = 0;
+            pool.self = w;
+            pool.jobFd = jobsPipe[0];
+            pool.resultFd = resultsPipe[1];
+
+            // Output goes to the temporary files of each job
+            Outfile_CloseFiles();
+            // Errors end the worker, not whatever the parent would have recovered to.
+            // The parent removes the temporary files then, other workers may still be writing theirs.
+            Error_SetRecoveryPoint(NULL);
+            Error_SetCleanup(NULL);
+            return;
+        }
+        close(jobsPipe[0]);
+        close(resultsPipe[1]);
+        pool.workers[w] = pid;
+        pool.jobFds[w] = jobsPipe[1];
+        pool.resultFds[w] = resultsPipe[0];
+        pool.numWorkers = w + 1;
+    }
+}
+
+static void RunJob(const Job* job, uint32_t (*compile)(size_t index))
+{
+    char asmPath[PATH_MAX];
+    char dataPath[PATH_MAX];
+    TempPath(asmPath, sizeof(asmPath), job->unit, "s");
+    TempPath(dataPath, sizeof(dataPath), job->unit, "bin");
+    if (!Outfile_TryOpen(asmPath, dataPath))
+        Error("Could not open temporary output file");
+    if (pool.following)
+        ShowOutput(true);
+
+    Compiler_SetState(job->base);
+    // Only the counts of this job go to the parent
+    size_t peepholeCounts[PeepholeRule_Count];
+    Compiler_TakePeepholeCounts(peepholeCounts);
+    size_t numValues = job->end - job->first;
+    uint32_t* values = xmalloc(numValues * sizeof(uint32_t));
+    RelocationInfo info = RelocationInfo_Create();
+    Relocation_Begin(&info);
+    for (size_t i = job->first; i < job->end; i++)
+        values[i - job->first] = compile(i);
+    Relocation_End();
+    Outfile_CloseFiles();
+    if (pool.following)
+        ShowOutput(false);
+
+    CompilerState state = Compiler_GetState();
+    JobResult result = {job->unit,
+                        (uint32_t)(state.dataIndex - job->base.dataIndex),
+                        state.labelID - job->base.labelID,
+                        info.maxDelta,
+                        (uint32_t)info.excludedDeltas.count,
+                        (uint32_t)info.relocations.count,
+                        {0}};
+    Compiler_TakePeepholeCounts(result.peepholeCounts);
+    if (!WriteAll(pool.resultFd, &result, sizeof(result)) ||
+        !WriteAll(pool.resultFd, values, numValues * sizeof(uint32_t)) ||
+        !WriteAll(pool.resultFd, info.excludedDeltas.data, result.numExcluded * sizeof(int32_t)) ||
+        !WriteAll(pool.resultFd, info.relocations.data, result.numRelocations * sizeof(Relocation)))
+        Error("Could not report result to parent");
+    RelocationInfo_Dispose(&info);
+    free(values);
+}
+
+// Runs the jobs the parent sends. Followers return once the batch ends, with the results of all
+// its items and the state the parent ended up with. Other workers exit when there are no more jobs.
+static void ServeJobs(uint32_t (*compile)(size_t index), size_t count, uint32_t* results)
+{
+    Job job;
+    while (ReadAll(pool.jobFd, &job, sizeof(job)))
+    {
+        if (job.unit == END_BATCH)
+        {
+            if (!ReadAll(pool.jobFd, results, count * sizeof(uint32_t)))
+                break;
+            Compiler_SetState(job.base);
+            return;
+        }
+        RunJob(&job, compile);
+    }
+    exit(0);
+}
+
+// Reads the result of a job of worker into its unit. False if the worker failed.
+static bool ReadResult(int worker, Unit* units, uint32_t* values)
+{
+    int fd = pool.resultFds[worker];
+    JobResult result;
+    if (!ReadAll(fd, &result, sizeof(result)))
+        return false;
+    Unit* unit = &units[result.unit];
+    unit->dataSize = result.dataSize;
+    unit->numLabels = result.numLabels;
+    memcpy(unit->peepholeCounts, result.peepholeCounts, sizeof(unit->peepholeCounts));
+    if (!ReadAll(fd, values + (unit->first - units[0].first), (unit->end - unit->first) * sizeof(uint32_t)))
+        return false;
+
+    int32_t* excluded = xmalloc(result.numExcluded * sizeof(int32_t));
+    Relocation* relocations = xmalloc(result.numRelocations * sizeof(Relocation));
+    bool complete = ReadAll(fd, excluded, result.numExcluded * sizeof(int32_t)) &&
+                    ReadAll(fd, relocations, result.numRelocations * sizeof(Relocation));
+    RelocationInfo_Dispose(&unit->relocations);
+    unit->relocations = RelocationInfo_Create();
+    unit->relocations.maxDelta = result.maxDelta;
+    for (uint32_t i = 0; i < result.numExcluded; i++)
+        GenericList_Append(&unit->relocations.excludedDeltas, &excluded[i]);
+    for (uint32_t i = 0; i < result.numRelocations; i++)
+        GenericList_Append(&unit->relocations.relocations, &relocations[i]);
+    free(relocations);
+    free(excluded);
+    return complete;
+}
+
+// Runs the jobs on the workers, each as soon as one is free, and stores the results in units and values.
+// The first numStarted jobs already run on the workers of the same index. Aborts if any job fails, the
+// worker will already have reported the error.
+static void RunJobs(const Job* jobs, size_t numJobs, size_t numStarted, Unit* units, uint32_t* values)
+{
+    // Index of the job each worker runs, or SIZE_MAX
+    size_t* running = xmalloc(pool.numWorkers * sizeof(size_t));
+    struct pollfd* fds = xmalloc(pool.numWorkers * sizeof(struct pollfd));
+    int* polled = xmalloc(pool.numWorkers * sizeof(int));
+    for (int w = 0; w < pool.numWorkers; w++)
+        running[w] = (size_t)w < numStarted ? (size_t)w : SIZE_MAX;
+
+    size_t next = numStarted;
+    size_t done = 0;
+    while (done < numJobs)
+    {
+        nfds_t numFds = 0;
+        for (int w = 0; w < pool.numWorkers; w++)
+        {
+            if (running[w] == SIZE_MAX && next < numJobs)
+            {
+                if (!WriteAll(pool.jobFds[w], &jobs[next], sizeof(Job)))
+                    Error_Abort();
+                running[w] = next++;
+            }
+            if (running[w] != SIZE_MAX)
+            {
+                fds[numFds].fd = pool.resultFds[w];
+                fds[numFds].events = POLLIN;
+                polled[numFds++] = w;
+            }
+        }
+
+        if (poll(fds, numFds, -1) < 0)
+            continue; // Interrupted
+        for (nfds_t i = 0; i < numFds; i++)
+        {
+            if (fds[i].revents == 0)
+                continue;
+            if (!ReadResult(polled[i], units, values))
+                Error_Abort();
+            units[jobs[running[polled[i]]].unit].base = jobs[running[polled[i]]].base;
+            running[polled[i]] = SIZE_MAX;
+            done++;
+        }
+    }
+    free(polled);
+    free(fds);
+    free(running);
+}
+
+// The text with delta added to its data addresses and labelDelta to its label ids.
+// The relocations are in the order the text was written in.
+static char* RelocateText(const char* text, size_t size, const RelocationInfo* info, int32_t delta,
+                          int32_t labelDelta)
+{
+    // A number grows by at most 11 characters
+    char* out = xmalloc(size + info->relocations.count * 11 + 1);
+    size_t length = 0;
+    size_t position = 0;
+    for (size_t i = 0; i < info->relocations.count; i++)
+    {
+        const Relocation* relocation = GenericList_At(&info->relocations, i);
+        if (relocation->kind == Relocation_Data)
+            continue;
+        if (relocation->offset < position || relocation->offset >= size)
+            Error("Corrupt temporary output file");
+
+        memcpy(out + length, text + position, relocation->offset - position);
+        length += relocation->offset - position;
+        char* numberEnd;
+        long number = strtol(text + relocation->offset, &numberEnd, 10);
+        number += relocation->kind == Relocation_Label ? labelDelta : delta;
+        length += (size_t)sprintf(out + length, "%ld", number);
+        position = (size_t)(numberEnd - text);
+    }
+    memcpy(out + length, text + position, size - position);
+    out[length + size - position] = 0;
+    return out;
+}
+
+// Adds delta to the words of data that hold data addresses
+static void RelocateData(uint8_t* data, size_t size, const RelocationInfo* info, int32_t delta)
+{
+    for (size_t i = 0; i < info->relocations.count; i++)
+    {
+        const Relocation* relocation = GenericList_At(&info->relocations, i);
+        if (relocation->kind != Relocation_Data)
+            continue;
+        if ((relocation->offset + 1) * sizeof(uint16_t) > size)
+            Error("Corrupt temporary output file");
+
+        uint16_t word;
+        memcpy(&word, data + relocation->offset * sizeof(uint16_t), sizeof(uint16_t));
+        word = (uint16_t)(word + delta);
+        memcpy(data + relocation->offset * sizeof(uint16_t), &word, sizeof(uint16_t));
+    }
+}
+
+// Runs of zeros are handed to OutWriteZeros, so they stay holes in the output
+static void MergeData(const uint8_t* data, size_t size)
+{
+    const uint16_t* words = (const uint16_t*)data;
+    size_t numWords = size / sizeof(uint16_t);
+    size_t start = 0;
+    size_t i = 0;
+    while (i < numWords)
+    {
+        size_t zerosEnd = i;
+        while (zerosEnd < numWords && words[zerosEnd] == 0)
+            zerosEnd++;
+        // Short runs are cheaper to write along with the rest
+        if (zerosEnd - i >= 64 || (zerosEnd == numWords && zerosEnd != i))
+        {
+            OutWriteData((const uint8_t*)(words + start), (i - start) * sizeof(uint16_t));
+            OutWriteZeros(zerosEnd - i);
+            start = zerosEnd;
+        }
+        i = zerosEnd + 1;
+    }
+    if (start < numWords)
+        OutWriteData((const uint8_t*)(words + start), (numWords - start) * sizeof(uint16_t));
+}
+
+static CompilerState Advance(CompilerState state, const Unit* unit)
+{
+    state.dataIndex += unit->dataSize;
+    state.labelID += unit->numLabels;
+    state.generatedHeader = true;
+    return state;
+}
+
+// The job a unit is first compiled with. How far a unit advances the state doesn't depend on where it
+// starts, so they all start where the first does. At address 0, the units after the first start a word
+// later, unless the first has no data: their data addresses then aren't 0 already, which would compare
+// equal to null.
+static Job FirstJob(const Unit* units, size_t i, CompilerState start)
+{
+    Job job = {(uint32_t)i, (uint32_t)units[i].first, (uint32_t)units[i].end, start};
+    if (i != 0)
+    {
+        if (start.dataIndex == 0)
+            job.base.dataIndex++;
+        job.base.generatedHeader = true;
+    }
+    return job;
+}
+
+// Workers know the units as well as the parent, so each starts with the unit of its own index right away
+static void RunFirstJob(const Unit* units, size_t numUnits, uint32_t (*compile)(size_t index))
+{
+    if ((size_t)pool.self < numUnits)
+    {
+        Job job = FirstJob(units, (size_t)pool.self, Compiler_GetState());
+        RunJob(&job, compile);
+    }
+}
+
+// Compiles the units on the workers of the pool, values[i] is set to what compile returned for item
+// units[0].first + i. The workers must have started with RunFirstJob. Returns the state the units
+// start with, the compiler state is set to where they end.
+static CompilerState CompileUnits(Unit* units, size_t numUnits, uint32_t* values)
+{
+    Job* jobs = xmalloc(numUnits * sizeof(Job));
+    CompilerState start = Compiler_GetState();
+    for (size_t i = 0; i < numUnits; i++)
+    {
+        units[i].relocations = RelocationInfo_Create();
+        jobs[i] = FirstJob(units, i, start);
+    }
+    size_t numStarted = (size_t)pool.numWorkers < numUnits ? (size_t)pool.numWorkers : numUnits;
+    RunJobs(jobs, numUnits, numStarted, units, values);
+
+    size_t numJobs = 0;
+    CompilerState state = start;
+    for (size_t i = 0; i < numUnits; i++)
+    {
+        if (!RelocationInfo_Holds(&units[i].relocations, (int32_t)(state.dataIndex - units[i].base.dataIndex)))
+        {
+            Job job = {(uint32_t)i, (uint32_t)units[i].first, (uint32_t)units[i].end, state};
+            jobs[numJobs++] = job;
+        }
+        state = Advance(state, &units[i]);
+    }
+    if (numJobs != 0)
+        RunJobs(jobs, numJobs, 0, units, values);
+    free(jobs);
+    for (size_t i = 0; i < numUnits; i++)
+        Compiler_AddPeepholeCounts(units[i].peepholeCounts);
+
+    Compiler_SetState(state);
+    return start;
+}
+
+// Appends the output of the units in order, moved to where they start after start
+static void MergeUnits(Unit* units, size_t numUnits, CompilerState start)
+{
+    CompilerState state = start;
+    for (size_t i = 0; i < numUnits; i++)
+    {
+        Unit* unit = &units[i];
+        int32_t delta = (int32_t)(state.dataIndex - unit->base.dataIndex);
+        int32_t labelDelta = state.labelID - unit->base.labelID;
+
+        size_t size;
+        char* text = ReadTemporary(i, "s", &size);
+        char* relocated = RelocateText(text, size, &unit->relocations, delta, labelDelta);
+        OutWrite("%s", relocated);
+        free(relocated);
+        free(text);
+
+        char* data = ReadTemporary(i, "bin", &size);
+        RelocateData((uint8_t*)data, size, &unit->relocations, delta);
+        MergeData((const uint8_t*)data, size);
+        free(data);
+
+        RelocationInfo_Dispose(&unit->relocations);
+        state = Advance(state, unit);
+    }
+}
+
+void Parallel_Compile(size_t first, size_t end, int numWorkers, uint32_t (*compile)(size_t index), uint32_t* results)
+{
+    if (numWorkers <= 1 || end - first <= 1)
+    {
+        for (size_t i = first; i < end; i++)
+        {
+            uint32_t value = compile(i);
+            if (results != NULL)
+                results[i - first] = value;
+        }
+        return;
+    }
+
+    size_t count = end - first;
+    if ((size_t)numWorkers > count)
+        numWorkers = (int)count;
+    Unit* units = xmalloc(count * sizeof(Unit));
+    for (size_t i = 0; i < count; i++)
+    {
+        units[i].first = first + i;
+        units[i].end = first + i + 1;
+    }
+
+    CreateTemporaries();
+    StartWorkers(numWorkers);
+    if (pool.self >= 0)
+    {
+        RunFirstJob(units, count, compile);
+        ServeJobs(compile, 0, NULL);
+    }
+
+    uint32_t* values = xmalloc(count * sizeof(uint32_t));
+    CompilerState start = CompileUnits(units, count, values);
+    MergeUnits(units, count, start);
+    Shutdown();
+
+    if (results != NULL)
+        memcpy(results, values, count * sizeof(uint32_t));
+    free(values);
+    free(units);
+}
+
+void Parallel_StartFollowers(int numWorkers)
+{
+    CreateTemporaries();
+    pool.following = true;
+    pool.numFollowers = (size_t)numWorkers;
+    StartWorkers(numWorkers);
+    if (pool.self >= 0)
+    {
+        pool.stdoutFd = dup(STDOUT_FILENO);
+        pool.stderrFd = dup(STDERR_FILENO);
+        pool.devNullFd = open("/dev/null", O_WRONLY);
+        ShowOutput(false);
+    }
+}
+
+bool Parallel_HasFollowers()
+{
+    return pool.following;
+}
+
+void Parallel_CompileOnFollowers(size_t count, const size_t* weights, uint32_t (*compile)(size_t index),
+                                 uint32_t* results)
+{
+    // Followers split the items just like the parent
+    size_t numUnits = pool.numFollowers < count ? pool.numFollowers : count;
+    size_t total = 0;
+    for (size_t i = 0; i < count; i++)
+        total += weights[i];
+
+    // Each unit takes items until it has its share of the weight, and at least one.
+    // Enough items are left for the units after it.
+    Unit* units = xmalloc(numUnits * sizeof(Unit));
+    size_t item = 0;
+    size_t weight = 0;
+    for (size_t k = 0; k < numUnits; k++)
+    {
+        size_t share = total * (k + 1) / numUnits;
+        units[k].first = item;
+        while (item < count - (numUnits - 1 - k) && (item == units[k].first || weight < share))
+            weight += weights[item++];
+        units[k].end = item;
+    }
+    units[numUnits - 1].end = count;
+
+    if (pool.self >= 0)
+    {
+        RunFirstJob(units, numUnits, compile);
+        free(units);
+        ServeJobs(compile, count, results);
+        return;
+    }
+
+    CompilerState start = CompileUnits(units, numUnits, results);
+
+    // Followers continue with the results and state of the parent, while it merges the output
+    Job endBatch = {END_BATCH, 0, 0, Compiler_GetState()};
+    for (int w = 0; w < pool.numWorkers; w++)
+        if (!WriteAll(pool.jobFds[w], &endBatch, sizeof(endBatch)) ||
+            !WriteAll(pool.jobFds[w], results, count * sizeof(uint32_t)))
+            Error_Abort();
+    MergeUnits(units, numUnits, start);
+    free(units);
+}
+
+void Parallel_StopFollowers()
+{
+    if (!pool.following)
+        return;
+    if (pool.self >= 0)
+        exit(0);
+    Shutdown();
+}
+#endif
+
+#ifdef CUSTOM_COMP
+void Parallel_Compile(size_t first, size_t end, int numWorkers, uint32_t (*compile)(size_t index), uint32_t* results)
+{
+    for (size_t i = first; i < end; i++)
+    {
+        uint32_t value = compile(i);
+        if (results != NULL)
+            results[i - first] = value;
+    }
+}
+
+void Parallel_StartFollowers(int numWorkers)
+{
+}
+
+bool Parallel_HasFollowers()
+{
+    return false;
+}
+
+void Parallel_CompileOnFollowers(size_t count, const size_t* weights, uint32_t (*compile)(size_t index),
+                                 uint32_t* results)
+{
+    for (size_t i = 0; i < count; i++)
+        results[i] = compile(i);
+}
+
+void Parallel_StopFollowers()
+{
+}
+#endif
@@ -0,0 +1,26 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Compiles units first to end - 1 on numWorkers worker processes. The output of each unit is
+// moved to the compiler state it would have when compiling the units one after another, and
+// appended in unit order, so it is identical to that of a sequential build.
+// compile(index) compiles unit index into the current output files. What it returns is
+// stored in results[index - first], unless results is NULL.
+void Parallel_Compile(size_t first, size_t end, int numWorkers, uint32_t (*compile)(size_t index), uint32_t* results);
+
+// Starts numWorkers followers: worker processes that go on running the code of the caller after
+// the fork, just like it does, so they build up the same state without it being sent to them.
+// What they print and output is discarded, the caller reports the same errors itself.
+void Parallel_StartFollowers(int numWorkers);
+// True in the caller and in the followers while there are followers.
+bool Parallel_HasFollowers();
+// Compiles items 0 to count - 1 on the followers, each taking one contiguous range of about the
+// same total weight, and appends the output in order like Parallel_Compile. The caller and all
+// followers have to call this at the same point with the same arguments. All of them end up
+// with the results and compiler state of the caller.
+void Parallel_CompileOnFollowers(size_t count, const size_t* weights, uint32_t (*compile)(size_t index),
+                                 uint32_t* results);
+// The followers exit here, the caller continues alone.
+void Parallel_StopFollowers();
@@ -1,5 +1,6 @@
 #include "P_Expression.h"
 #include "../AST.h"
+#include "../Compiler.h"
 #include "../Function.h"
 #include "../Optimizer.h"
 #include "../Scope.h"
@@ -21,7 +22,7 @@ bool TryParseTypeCast(Token* b, size_t length, size_t* i, Scope* scope, AST_Expr
 
         P_Type_PopCur(b, length, i, RBrClose);
 
-        AST_Expression_TypeCast* retval = xmalloc(sizeof(AST_Expression_TypeCast));
+        AST_Expression_TypeCast* retval = AST_Alloc(sizeof(AST_Expression_TypeCast));
         ParseExpressionPrec(b, length, i, scope, 14 - 2, &retval->exprA);
 
         retval->newType = newType;
@@ -40,7 +41,7 @@ bool TryParseFunctionCall(Token* b, int length, size_t* i, Scope* scope, AST_Exp
 {
     if (b[*i].type == Identifier)
     {
-        char* identifier = b[*i].data;
+        char* identifier = Token_GetData(&b[*i]);
         if (length < 3 || b[*i + 1].type != RBrOpen)
             return false;
 
@@ -58,7 +59,10 @@ bool TryParseFunctionCall(Token* b, int length, size_t* i, Scope* scope, AST_Exp
         }*/
         outFunc = Function_Find(identifier);
         if (outFunc)
+        {
+            Compiler_FinishFunction(outFunc);
             Optimizer_LogFunctionCall(outFunc->modifiedRegisters);
+        }
         else
             Optimizer_LogFunctionCall(0xFFFF);
 
@@ -130,18 +134,13 @@ bool TryParseFunctionCall(Token* b, int length, size_t* i, Scope* scope, AST_Exp
                     SyntaxErrorAtToken(b);
             }
 
-        GenericList_ShrinkToSize(&params);
-        AST_Expression_FunctionCall* retval = xmalloc(sizeof(AST_Expression_FunctionCall));
+        AST_Expression_FunctionCall* retval = AST_Alloc(sizeof(AST_Expression_FunctionCall));
         retval->loc = Token_GetLocationP(&b[*i]);
         retval->type = AST_ExpressionType_FunctionCall;
         retval->id = identifier;
 
-        retval->parameters = params.data;
         retval->numParameters = params.count;
-
-        if (!outFunc)
-            // Hacky cast here, but this works because of struct layout
-            Optimizer_LogAccess((AST_Expression_VariableAccess*)retval);
+        retval->parameters = AST_CopyList(&params);
 
         *outExpr = retval;
 
@@ -163,7 +162,7 @@ bool TryParseSizeOf(Token* b, int length, Scope* scope, AST_Expression_IntLitera
     int size = SizeInWords(type);
     Type_RemoveReference(type);
 
-    AST_Expression_IntLiteral* retval = xmalloc(sizeof(AST_Expression_IntLiteral));
+    AST_Expression_IntLiteral* retval = AST_Alloc(sizeof(AST_Expression_IntLiteral));
     retval->type = AST_ExpressionType_IntLiteral;
     retval->loc = Token_GetLocationP(&b[0]);
     if (size < 1)
@@ -209,23 +208,19 @@ static void ParsePrimaryExpression(Token* b, size_t length, size_t* i, Scope* sc
             }
             P_Type_Inc(b, length, i);
 
-            GenericList_ShrinkToSize(&expressions);
-
-            AST_Expression_ListLiteral* retval = xmalloc(sizeof(AST_Expression_ListLiteral));
+            AST_Expression_ListLiteral* retval = AST_Alloc(sizeof(AST_Expression_ListLiteral));
             retval->type = AST_ExpressionType_ListLiteral;
-            retval->expressions = expressions.data;
             retval->numExpr = expressions.count;
+            retval->expressions = AST_CopyList(&expressions);
             retval->loc = Token_GetLocationP(&b[0]);
             *outExpr = (AST_Expression*)retval;
             break;
         }
         case IntLiteral:
         {
-            int32_t* literal = (int32_t*)b[*i].data;
-
-            AST_Expression_IntLiteral* retval = xmalloc(sizeof(AST_Expression_IntLiteral));
+            AST_Expression_IntLiteral* retval = AST_Alloc(sizeof(AST_Expression_IntLiteral));
             retval->type = AST_ExpressionType_IntLiteral;
-            retval->literal = *literal;
+            retval->literal = (int32_t)b[*i].data;
             retval->loc = Token_GetLocationP(b);
             *outExpr = (void*)retval;
             P_Type_Inc(b, length, i);
@@ -233,9 +228,9 @@ static void ParsePrimaryExpression(Token* b, size_t length, size_t* i, Scope* sc
         }
         case StringLiteral:
         {
-            AST_Expression_StringLiteral* retval = xmalloc(sizeof(AST_Expression_StringLiteral));
+            AST_Expression_StringLiteral* retval = AST_Alloc(sizeof(AST_Expression_StringLiteral));
             retval->type = AST_ExpressionType_StringLiteral;
-            retval->data = b[*i].data;
+            retval->data = AST_CopyString(Token_GetData(&b[*i]));
             retval->loc = Token_GetLocationP(b);
             *outExpr = (void*)retval;
             P_Type_Inc(b, length, i);
@@ -246,12 +241,12 @@ static void ParsePrimaryExpression(Token* b, size_t length, size_t* i, Scope* sc
             if (TryParseFunctionCall(b, length, i, scope, (AST_Expression_FunctionCall**)outExpr))
                 break;
 
-            AST_Expression_VariableAccess* retval = xmalloc(sizeof(AST_Expression_VariableAccess));
+            AST_Expression_VariableAccess* retval = AST_Alloc(sizeof(AST_Expression_VariableAccess));
             retval->type = AST_ExpressionType_VariableAccess;
-            retval->id = b[*i].data;
+            retval->id = Token_GetData(&b[*i]);
+            retval->isLastUse = false;
             retval->loc = Token_GetLocationP(b);
             *outExpr = (void*)retval;
-            Optimizer_LogAccess(retval);
             P_Type_Inc(b, length, i);
             break;
         }
@@ -263,7 +258,7 @@ static void ParsePrimaryExpression(Token* b, size_t length, size_t* i, Scope* sc
             int size = SizeInWords(type);
             Type_RemoveReference(type);
 
-            AST_Expression_IntLiteral* retval = xmalloc(sizeof(AST_Expression_IntLiteral));
+            AST_Expression_IntLiteral* retval = AST_Alloc(sizeof(AST_Expression_IntLiteral));
             retval->type = AST_ExpressionType_IntLiteral;
             retval->loc = Token_GetLocationP(&b[0]);
             if (size < 1)
@@ -280,7 +275,7 @@ static void ParsePrimaryExpression(Token* b, size_t length, size_t* i, Scope* sc
             TokenType type = b[*i].type;
             if (type >= BitwiseNOT && type <= Ampersand)
             {
-                AST_Expression_UnOp* unop = xmalloc(sizeof(AST_Expression_UnOp));
+                AST_Expression_UnOp* unop = AST_Alloc(sizeof(AST_Expression_UnOp));
                 unop->type = AST_ExpressionType_UnaryOP;
                 unop->loc = Token_GetLocationP(&b[*i]);
                 unop->op = b[*i].type - BitwiseNOT;
@@ -372,7 +367,7 @@ static void ParseExpressionPrec(Token* b, int length, size_t* i, Scope* scope, i
         if (next.type >= Increment && next.type <= Decrement)
         {
             // Postfix unary operators
-            AST_Expression_UnOp* unop = xmalloc(sizeof(AST_Expression_UnOp));
+            AST_Expression_UnOp* unop = AST_Alloc(sizeof(AST_Expression_UnOp));
             unop->type = AST_ExpressionType_UnaryOP;
             unop->loc = Token_GetLocationP(&b[*i]);
             unop->op = next.type - Increment + UnOp_PostIncrement;
@@ -385,10 +380,11 @@ static void ParseExpressionPrec(Token* b, int length, size_t* i, Scope* scope, i
         else if (next.type == Arrow || next.type == Dot) 
         {
             // Only valid RHS for struct access is identifier
-            AST_Expression_VariableAccess* rightAcc = xmalloc(sizeof(AST_Expression_VariableAccess));
+            AST_Expression_VariableAccess* rightAcc = AST_Alloc(sizeof(AST_Expression_VariableAccess));
             rightAcc->loc = Token_GetLocationP(&b[*i]);
             rightAcc->type = AST_ExpressionType_VariableAccess;
             rightAcc->id = P_Type_PopCur(b, length, i, Identifier); 
+            rightAcc->isLastUse = false;
             right = (AST_Expression*)rightAcc;
         }
         else
@@ -404,7 +400,7 @@ static void ParseExpressionPrec(Token* b, int length, size_t* i, Scope* scope, i
         if (next.type == QuestionMark)
         {
             P_Type_PopCur(b, length, i, Colon);
-            AST_Expression_TernaryOp* op = xmalloc(sizeof(AST_Expression_TernaryOp));
+            AST_Expression_TernaryOp* op = AST_Alloc(sizeof(AST_Expression_TernaryOp));
             ParseExpressionPrec(b, length, i, scope, prec, &op->exprB);
             op->cond = left;
             op->exprA = right;
@@ -418,7 +414,7 @@ static void ParseExpressionPrec(Token* b, int length, size_t* i, Scope* scope, i
             if (next.type == ABrOpen)
                 P_Type_PopCur(b, length, i, ABrClose);
 
-            AST_Expression_BinOp* op = xmalloc(sizeof(AST_Expression_BinOp));
+            AST_Expression_BinOp* op = AST_Alloc(sizeof(AST_Expression_BinOp));
             op->exprA = left;
             op->exprB = right;
             op->loc = loc;
@@ -15,7 +15,7 @@ static bool TryParseReturnStatement(TokenArray* t, size_t* i, Scope* scope, AST_
     if (t->tokens[(*i)].type == ReturnKeyword)
     {
         VariableType* returnType = Function_GetCurrent()->returnType;
-        AST_Statement_Return* retval = xmalloc(sizeof(AST_Statement_Return));
+        AST_Statement_Return* retval = AST_Alloc(sizeof(AST_Statement_Return));
         retval->loc = Token_GetLocation(*i);
 
         Inc(i);
@@ -42,7 +42,7 @@ static bool TryParseIfStatement(TokenArray* t, size_t* i, Scope* scope, AST_Stat
 {
     if (t->tokens[*i].type == IfKeyword)
     {
-        AST_Statement_If* retval = xmalloc(sizeof(AST_Statement_If));
+        AST_Statement_If* retval = AST_Alloc(sizeof(AST_Statement_If));
         retval->type = AST_StatementType_If;
         retval->loc = Token_GetLocation(*i);
 
@@ -74,8 +74,7 @@ static bool TryParseWhileLoop(TokenArray* t, size_t* i, Scope* scope, AST_Statem
 {
     if (t->tokens[*i].type == WhileKeyword)
     {
-        Optimizer_EnterLoop();
-        AST_Statement_While* retval = xmalloc(sizeof(AST_Statement_While));
+        AST_Statement_While* retval = AST_Alloc(sizeof(AST_Statement_While));
         retval->type = AST_StatementType_While;
         retval->loc = Token_GetLocation(*i);
 
@@ -87,7 +86,6 @@ static bool TryParseWhileLoop(TokenArray* t, size_t* i, Scope* scope, AST_Statem
 
         ParseStatement(t, i, scope, &retval->body);
 
-        Optimizer_ExitLoop(retval);
         *outStmt = retval;
 
         return true;
@@ -99,8 +97,7 @@ static bool TryParseDoWhileLoop(TokenArray* t, size_t* i, Scope* scope, AST_Stat
 {
     if (t->tokens[*i].type == DoKeyword)
     {
-        Optimizer_EnterLoop();
-        AST_Statement_Do* retval = xmalloc(sizeof(AST_Statement_Do));
+        AST_Statement_Do* retval = AST_Alloc(sizeof(AST_Statement_Do));
         retval->type = AST_StatementType_Do;
         retval->loc = Token_GetLocation(*i);
 
@@ -115,7 +112,6 @@ static bool TryParseDoWhileLoop(TokenArray* t, size_t* i, Scope* scope, AST_Stat
 
         PopNextInc(i, Semicolon);
 
-        Optimizer_ExitLoop(retval);
         *outStmt = retval;
 
         return true;
@@ -127,26 +123,23 @@ static bool TryParseForLoop(TokenArray* t, size_t* i, Scope* scope, AST_Statemen
 {
     if (t->tokens[*i].type == ForKeyword)
     {
-        AST_Statement_For* retval = xmalloc(sizeof(AST_Statement_For));
+        AST_Statement_For* retval = AST_Alloc(sizeof(AST_Statement_For));
         retval->type = AST_StatementType_For;
         retval->loc = Token_GetLocation(*i);
         Optimizer_EnterNewScope();
-        retval->statementScope = xmalloc(sizeof(Scope));
+        retval->statementScope = AST_Alloc(sizeof(Scope));
         *retval->statementScope = Scope_Create(scope);
 
         PopNextInc(i, RBrOpen);
 
         ParseStatement(t, i, retval->statementScope, &retval->init);
 
-        Optimizer_EnterLoop();
-
         ParseNextExpression(t, i, retval->statementScope, &retval->cond);
         Inc(i);
         ParseNextExpressionWithSeparator(t, i, retval->statementScope, &retval->count, RBrClose, 1);
         Inc(i);
         ParseStatement(t, i, retval->statementScope, &retval->body);
 
-        Optimizer_ExitLoop(retval);
         Optimizer_ExitScope(&retval->statementScope->preferredRegisters[0]);
         *outExpr = retval;
         return true;
@@ -161,12 +154,12 @@ bool TryParseNewScope(TokenArray* t, size_t* i, Scope* scope, AST_Statement_Scop
     {
         Optimizer_EnterNewScope();
 
-        AST_Statement_Scope* retval = xmalloc(sizeof(AST_Statement_Scope));
+        AST_Statement_Scope* retval = AST_Alloc(sizeof(AST_Statement_Scope));
         retval->type = AST_StatementType_Scope;
         retval->loc = Token_GetLocation(*i);
 
         GenericList statements = GenericList_Create(sizeof(AST_Statement*));
-        Scope* newScope = xmalloc(sizeof(Scope));
+        Scope* newScope = AST_Alloc(sizeof(Scope));
         *newScope = Scope_Create(scope);
 
         Inc(i);
@@ -180,9 +173,8 @@ bool TryParseNewScope(TokenArray* t, size_t* i, Scope* scope, AST_Statement_Scop
 
         PopCur(i, CBrClose);
 
-        GenericList_ShrinkToSize(&statements);
-        retval->statements = statements.data;
         retval->numStatements = statements.count;
+        retval->statements = AST_CopyList(&statements);
         retval->scope = newScope;
 
         Optimizer_ExitScope(&newScope->preferredRegisters[0]);
@@ -197,7 +189,7 @@ static bool TryParseSwitchCase(TokenArray* t, size_t* i, Scope* scope, AST_State
 {
     if (t->tokens[*i].type == SwitchKeyword)
     {
-        AST_Statement_Switch* retval = xmalloc(sizeof(AST_Statement_Switch));
+        AST_Statement_Switch* retval = AST_Alloc(sizeof(AST_Statement_Switch));
         retval->type = AST_StatementType_Switch;
         retval->loc = Token_GetLocation(*i);
         retval->defaultCaseStmts = NULL;
@@ -209,7 +201,6 @@ static bool TryParseSwitchCase(TokenArray* t, size_t* i, Scope* scope, AST_State
 
         PopNextInc(i, CBrOpen);
 
-        Optimizer_EnterLoop();
         GenericList cases = GenericList_Create(sizeof(AST_Statement_Switch_SwitchCase));
 
         while (t->tokens[*i].type == CaseKeyword || t->tokens[*i].type == DefaultKeyword)
@@ -256,26 +247,21 @@ static bool TryParseSwitchCase(TokenArray* t, size_t* i, Scope* scope, AST_State
                 //     SyntaxErrorAtIndex((*i) - 1);
             }
 
-            GenericList_ShrinkToSize(&list);
             if (isDefaultCase)
             {
-                retval->defaultCaseStmts = list.data;
                 retval->numStmtsDefCase = list.count;
+                retval->defaultCaseStmts = AST_CopyList(&list);
             }
             else
             {
-                c.statements = list.data;
                 c.numStatements = list.count;
+                c.statements = AST_CopyList(&list);
                 GenericList_Append(&cases, &c);
             }
         }
 
-        Optimizer_ExitLoop(retval);
-
-        GenericList_ShrinkToSize(&cases);
-
-        retval->cases = cases.data;
         retval->numCases = cases.count;
+        retval->cases = AST_CopyList(&cases);
 
         *outStmt = retval;
 
@@ -290,7 +276,7 @@ static bool TryParseDeclaration(TokenArray* t, size_t* i, Scope* scope, AST_Stat
 {
     if (IsDataToken(t->tokens[*i], scope))
     {
-        AST_Statement_Declaration* retval = xmalloc(sizeof(AST_Statement_Declaration));
+        AST_Statement_Declaration* retval = AST_Alloc(sizeof(AST_Statement_Declaration));
         retval->loc = Token_GetLocation(*i);
         retval->type = AST_StatementType_Declaration;
 
@@ -365,7 +351,7 @@ void ParseStatement(TokenArray* t, size_t* i, Scope* scope, AST_Statement** outS
             break;
         case Semicolon:
         {
-            AST_Statement* stmt = xmalloc(sizeof(AST_Statement));
+            AST_Statement* stmt = AST_Alloc(sizeof(AST_Statement));
             stmt->type = AST_StatementType_Empty;
             stmt->loc = Token_GetLocation(*i);
             *outStmt = stmt;
@@ -374,10 +360,10 @@ void ParseStatement(TokenArray* t, size_t* i, Scope* scope, AST_Statement** outS
         }
         case AsmKeyword:
         {
-            AST_Statement_ASM* stmt = xmalloc(sizeof(AST_Statement_ASM));
-            Optimizer_LogInlineASM(stmt);
+            AST_Statement_ASM* stmt = AST_Alloc(sizeof(AST_Statement_ASM));
+            Optimizer_LogInlineASM();
             stmt->type = AST_StatementType_ASM;
-            stmt->code = t->tokens[*i].data;
+            stmt->code = AST_CopyString(Token_GetData(&t->tokens[*i]));
             *outStmt = (AST_Statement*)stmt;
             Inc(i);
             break;
@@ -385,7 +371,7 @@ void ParseStatement(TokenArray* t, size_t* i, Scope* scope, AST_Statement** outS
         case ContinueKeyword:
         case BreakKeyword:
         {
-            AST_Statement* stmt = xmalloc(sizeof(AST_Statement));
+            AST_Statement* stmt = AST_Alloc(sizeof(AST_Statement));
 
             if (t->tokens[*i].type == ContinueKeyword)
                 stmt->type = AST_StatementType_Continue;
@@ -405,7 +391,7 @@ void ParseStatement(TokenArray* t, size_t* i, Scope* scope, AST_Statement** outS
             }
             else
             {
-                AST_Statement_Expr* stmt = xmalloc(sizeof(AST_Statement_Expr));
+                AST_Statement_Expr* stmt = AST_Alloc(sizeof(AST_Statement_Expr));
                 stmt->type = AST_StatementType_Expr;
                 ParseNextExpression(t, i, scope, &stmt->expr);
                 *outStmt = (AST_Statement*)stmt;
@@ -13,7 +13,7 @@ void* P_Type_PopNext(Token* tokens, const size_t maxLen, size_t* const i, TokenT
     if (tokens[*i].type != type)
         SyntaxErrorAtToken(&tokens[*i]);
 
-    return tokens[*i].data;
+    return Token_GetData(&tokens[*i]);
 }
 
 void* P_Type_PopNextInc(Token* tokens, const size_t maxLen, size_t* const i, TokenType type)
@@ -23,7 +23,7 @@ void* P_Type_PopNextInc(Token* tokens, const size_t maxLen, size_t* const i, Tok
     if (tokens[*i].type != type)
         SyntaxErrorAtToken(&tokens[*i]);
 
-    void* retval = tokens[*i].data;
+    void* retval = Token_GetData(&tokens[*i]);
     if (++(*i) > maxLen)
         SyntaxErrorAtToken(&tokens[*i - 1]);
     return retval;
@@ -33,7 +33,7 @@ void* P_Type_PopCur(Token* tokens, const size_t maxLen, size_t* const i, TokenTy
 {
     if (tokens[*i].type != type)
         SyntaxErrorAtToken(&tokens[*i]);
-    void* retval = tokens[*i].data;
+    void* retval = Token_GetData(&tokens[*i]);
     if (++(*i) > maxLen)
         SyntaxErrorAtToken(&tokens[*i - 1]);
     return retval;
@@ -86,7 +86,7 @@ VariableType* ParseVariableType(Token* tokens, size_t* i, size_t maxLen, Scope*
         case Identifier:
         {
             Typedef* td;
-            if ((td = Scope_FindTypedef(scope, token.data)))
+            if ((td = Scope_FindTypedef(scope, Token_GetData(&token))))
             {
                 // TODO: Copy isn't really necessary when not modifying type
                 vtype = Type_Copy(td->type);
@@ -112,7 +112,7 @@ VariableType* ParseVariableType(Token* tokens, size_t* i, size_t maxLen, Scope*
             char* id = NULL;
             if (tokens[*i].type == Identifier)
             {
-                id = tokens[*i].data;
+                id = Token_GetData(&tokens[*i]);
                 P_Type_Inc(tokens, maxLen, i);
             }
 
@@ -149,8 +149,8 @@ VariableType* ParseVariableType(Token* tokens, size_t* i, size_t maxLen, Scope*
                     VariableType* memType = ParseVariableType(tokens, i, maxLen, scope, &id, false);
                     int size = SizeInWords(memType);
 
-                    Variable v = (Variable){
-                        memType, id, {(int32_t)(isUnion ? 0 : struc->sizeInWords), AddressType_StructMember, size}, NULL};
+                    Value value = {(int32_t)(isUnion ? 0 : struc->sizeInWords), AddressType_StructMember, size, false};
+                    Variable v = (Variable){memType, id, value, -1, false};
                     GenericList_Append(&struc->members, &v);
 
                     if (!isUnion)
@@ -196,7 +196,7 @@ VariableType* ParseVariableType(Token* tokens, size_t* i, size_t maxLen, Scope*
             char* id = NULL;
             if (tokens[*i].type == Identifier)
             {
-                id = tokens[*i].data;
+                id = Token_GetData(&tokens[*i]);
                 P_Type_Inc(tokens, maxLen, i);
             }
 
@@ -210,14 +210,14 @@ VariableType* ParseVariableType(Token* tokens, size_t* i, size_t maxLen, Scope*
                 {
                     if (tokens[(*i)].type != Identifier)
                         SyntaxErrorAtToken(&tokens[*i]);
-                    char* label = tokens[*i].data;
+                    char* label = Token_GetData(&tokens[*i]);
                     P_Type_Inc(tokens, maxLen, i);
 
                     if (tokens[(*i)].type == Assignment)
                         currentId = (*((uint32_t*)P_Type_PopNextInc(tokens, maxLen, i, IntLiteral)));
 
                     Scope_AddVariable(scope, (Variable){Type_AddReference(&MachineUIntType), label,
-                                                        Value_Literal((currentId++)), NULL});
+                                                        Value_Literal((currentId++)), -1, false});
 
                     if (tokens[(*i)].type == Comma)
                         P_Type_Inc(tokens, maxLen, i);
@@ -251,7 +251,7 @@ VariableType* ParseVariableType(Token* tokens, size_t* i, size_t maxLen, Scope*
         {
             case Identifier:
                 if (identifier)
-                    *identifier = tokens[*i].data;
+                    *identifier = Token_GetData(&tokens[*i]);
                 else
                     break;
                 P_Type_Inc(tokens, maxLen, i);
@@ -336,8 +336,8 @@ VariableType* ParseVariableType(Token* tokens, size_t* i, size_t maxLen, Scope*
                                 ErrorAtIndex("Invalid type", *i);
 
                             index += size;
-                            Variable var =
-                                (Variable){vt, id, (Value){(int32_t)index, AddressType_MemoryRelative, size}, NULL};
+                            Variable var = (Variable){
+                                vt, id, (Value){(int32_t)index, AddressType_MemoryRelative, size, false}, -1, false};
                             GenericList_Append(&parameters, &var);
                         }
                         else if (tokens[*i].type == DotDotDot)
@@ -0,0 +1,690 @@
+#include "Passes.h"
+#include "Allocator.h"
+#include "Relocation.h"
+#include "SSA.h"
+#include "Util.h"
+#include <stdlib.h>
+#include <string.h>
+
+typedef enum
+{
+    // Not known to be executed yet
+    Lattice_Top,
+    Lattice_Constant,
+    // Not constant
+    Lattice_Bottom,
+} LatticeState;
+
+typedef struct
+{
+    LatticeState state;
+    int32_t value;
+    // The constant is a data address of the unit, see Relocation.h
+    bool relative;
+} Lattice;
+
+// Constant flags
+static const int FLAG_Z = 1;
+static const int FLAG_S = 2;
+static const int FLAG_C = 4;
+static const int FLAG_C_KNOWN = 8;
+
+static Lattice LatticeOf(LatticeState state)
+{
+    Lattice l;
+    l.state = state;
+    l.value = 0;
+    l.relative = false;
+    return l;
+}
+
+static Lattice Constant(int32_t value)
+{
+    Lattice l;
+    l.state = Lattice_Constant;
+    l.value = value & 0xFFFF;
+    l.relative = false;
+    return l;
+}
+
+static Lattice RelativeConstant(int32_t value, bool relative)
+{
+    Lattice l = Constant(value);
+    l.relative = relative;
+    return l;
+}
+
+static Lattice Meet(Lattice a, Lattice b)
+{
+    if (a.state == Lattice_Top)
+        return b;
+    if (b.state == Lattice_Top)
+        return a;
+    if (a.state == Lattice_Constant && b.state == Lattice_Constant &&
+        Relocation_Equal(a.value, a.relative, b.value, b.relative))
+        return a;
+    return LatticeOf(Lattice_Bottom);
+}
+
+static IRInstruction* Instruction(SSA* ssa, size_t i)
+{
+    return GenericList_At(&ssa->function->instructions, i);
+}
+
+static IRBlock* Block(SSA* ssa, size_t i)
+{
+    return GenericList_At(&ssa->function->blocks, i);
+}
+
+// Results of machine instructions on constant words
+static Lattice Evaluate(IROpcode op, Lattice a, Lattice b)
+{
+    if (op == IR_Mov)
+        return b;
+    if (op == IR_Not)
+    {
+        if (b.state != Lattice_Constant)
+            return b;
+        if (b.relative)
+            Relocation_AssumeFixed();
+        return Constant(~b.value);
+    }
+    if (a.state == Lattice_Bottom || b.state == Lattice_Bottom)
+        return LatticeOf(Lattice_Bottom);
+    if (a.state == Lattice_Top || b.state == Lattice_Top)
+        return LatticeOf(Lattice_Top);
+
+    int32_t x = a.value;
+    int32_t y = b.value;
+    // Only an address plus or minus a number moves along with the address
+    if (op == IR_Add && !(a.relative && b.relative))
+        return RelativeConstant(x + y, a.relative || b.relative);
+    if (op == IR_Sub && !(b.relative && !a.relative))
+        return RelativeConstant(x - y, a.relative && !b.relative);
+    if (a.relative || b.relative)
+        Relocation_AssumeFixed();
+    switch (op)
+    {
+        case IR_Add: return Constant(x + y);
+        case IR_Sub: return Constant(x - y);
+        case IR_Mul: return Constant((int32_t)(((uint32_t)x * (uint32_t)y) & 0xFFFF));
+        case IR_And: return Constant(x & y);
+        case IR_Or: return Constant(x | y);
+        case IR_Xor: return Constant(x ^ y);
+        case IR_ShiftLeft:
+            if (y < 16)
+                return Constant(x << y);
+            break;
+        case IR_ShiftRight:
+            // Same for logical and arithmetic shifts
+            if (y < 16 && x < 0x8000)
+                return Constant(x >> y);
+            break;
+        default: break;
+    }
+    return LatticeOf(Lattice_Bottom);
+}
+
+static Lattice EvaluateFlags(IROpcode op, Lattice a, Lattice b, Lattice result)
+{
+    if (result.state != Lattice_Constant)
+        return result;
+
+    int flags = 0;
+    if (Relocation_IsZero(result.value, result.relative))
+        flags |= FLAG_Z;
+    if ((result.value & 0x8000) != 0)
+        flags |= FLAG_S;
+    if (result.relative && (flags & FLAG_S) == 0)
+        Relocation_AssumeAtMost(result.value, (int32_t)0x7FFF);
+    if (op == IR_Add && a.state == Lattice_Constant && b.state == Lattice_Constant)
+    {
+        flags |= FLAG_C_KNOWN;
+        if (a.value + b.value > 0xFFFF)
+            flags |= FLAG_C;
+        if (a.relative && b.relative)
+            Relocation_AssumeFixed();
+        else if ((a.relative || b.relative) && (flags & FLAG_C) == 0)
+            Relocation_AssumeAtMost(a.value + b.value, (int32_t)0xFFFF);
+    }
+    return Constant((int32_t)flags);
+}
+
+// Constant 1 if the condition holds, 0 if it doesn't
+static Lattice EvaluateCondition(Flag flag, Lattice flags)
+{
+    if (flags.state != Lattice_Constant)
+        return flags;
+
+    int f = (int)flags.value;
+    bool holds;
+    switch (flag)
+    {
+        case Flag_Z: holds = (f & FLAG_Z) != 0; break;
+        case Flag_NZ: holds = (f & FLAG_Z) == 0; break;
+        case Flag_S: holds = (f & FLAG_S) != 0; break;
+        case Flag_NS: holds = (f & FLAG_S) == 0; break;
+        case Flag_C:
+        case Flag_NC:
+            if ((f & FLAG_C_KNOWN) == 0)
+                return LatticeOf(Lattice_Bottom);
+            holds = ((f & FLAG_C) != 0) == (flag == Flag_C);
+            break;
+        default: return LatticeOf(Lattice_Bottom);
+    }
+    return Constant((int32_t)(holds ? 1 : 0));
+}
+
+static bool IsConstant(Lattice l, int value)
+{
+    return l.state == Lattice_Constant && l.value == (int32_t)value;
+}
+
+// Wegman and Zadeck, "Constant Propagation with Conditional Branches". Only blocks
+// reached by executable edges are evaluated, so constants on paths that are never
+// taken don't lower the values at joins.
+typedef struct
+{
+    SSA* ssa;
+    Lattice* values;
+    bool* executableEdges;
+    bool* executableBlocks;
+    bool changed;
+} SCCP;
+
+static void Lower(SCCP* sccp, int32_t value, Lattice l)
+{
+    Lattice old = sccp->values[(size_t)value];
+    Lattice lowered = Meet(old, l);
+    if (lowered.state != old.state || lowered.value != old.value || lowered.relative != old.relative)
+    {
+        sccp->values[(size_t)value] = lowered;
+        sccp->changed = true;
+    }
+}
+
+static void MarkEdge(SCCP* sccp, size_t edge)
+{
+    if (sccp->executableEdges[edge])
+        return;
+    sccp->executableEdges[edge] = true;
+    sccp->executableBlocks[SSA_Edge(sccp->ssa, edge)->to] = true;
+    sccp->changed = true;
+}
+
+static Lattice OperandValue(SCCP* sccp, IRInstruction* inst, size_t i, int slot)
+{
+    IROperand* op = IR_OperandAt(inst, slot);
+    switch (op->type)
+    {
+        case IROperand_Literal: return RelativeConstant(op->value, op->dataRelative);
+        case IROperand_Zero: return Constant((int32_t)0);
+        case IROperand_Register: return sccp->values[(size_t)sccp->ssa->instructions[i].use[slot]];
+        default: return LatticeOf(Lattice_Bottom);
+    }
+}
+
+static void VisitPhi(SCCP* sccp, int32_t phi)
+{
+    SSA* ssa = sccp->ssa;
+    SSAValue* value = SSA_Value(ssa, phi);
+    SSABlock* block = &ssa->blocks[value->block];
+    Lattice result = LatticeOf(Lattice_Top);
+    for (size_t k = 0; k < SSA_NumPhiArgs(ssa, phi); k++)
+    {
+        // The additional argument of the first block is always executable
+        if (k < block->numPreds && !sccp->executableEdges[ssa->predEdges[block->firstPred + k]])
+            continue;
+        int32_t arg = *(int32_t*)GenericList_At(&ssa->phiArgs, value->firstArg + k);
+        result = Meet(result, sccp->values[(size_t)arg]);
+    }
+    Lower(sccp, phi, result);
+}
+
+static void VisitInstruction(SCCP* sccp, size_t i)
+{
+    IRInstruction* inst = Instruction(sccp->ssa, i);
+    SSAInstruction* s = &sccp->ssa->instructions[i];
+    if (inst->op > IR_Not)
+        return;
+
+    Lattice a = LatticeOf(Lattice_Bottom);
+    if (inst->op != IR_Mov && inst->op != IR_Not)
+        a = OperandValue(sccp, inst, i, IRSlot_A);
+    Lattice b = OperandValue(sccp, inst, i, IRSlot_B);
+    Lattice result = Evaluate(inst->op, a, b);
+    // Only evaluated when needed, as it records what it assumes about addresses
+    Lattice flags = LatticeOf(Lattice_Bottom);
+    if (s->flagsDef != -1)
+        flags = EvaluateFlags(inst->op, a, b, result);
+
+    if (inst->flag != Flag_None)
+    {
+        Lattice condition = EvaluateCondition(inst->flag, sccp->values[(size_t)s->flagsUse]);
+        Lattice old = LatticeOf(Lattice_Bottom);
+        if (s->def != -1)
+            old = sccp->values[(size_t)s->use[IRSlot_Dst]];
+        Lattice oldFlags = sccp->values[(size_t)s->flagsUse];
+
+        if (condition.state == Lattice_Top)
+        {
+            result = condition;
+            flags = condition;
+        }
+        else if (IsConstant(condition, 0))
+        {
+            result = old;
+            flags = oldFlags;
+        }
+        else if (condition.state == Lattice_Bottom)
+        {
+            result = Meet(result, old);
+            flags = Meet(flags, oldFlags);
+        }
+    }
+
+    if (s->def != -1)
+        Lower(sccp, s->def, result);
+    if (s->flagsDef != -1)
+        Lower(sccp, s->flagsDef, flags);
+}
+
+static void MarkSuccessors(SCCP* sccp, size_t b)
+{
+    SSA* ssa = sccp->ssa;
+    SSABlock* block = &ssa->blocks[b];
+    IRBlock* irBlock = Block(ssa, b);
+
+    if (irBlock->end != irBlock->first)
+    {
+        IRInstruction* last = Instruction(ssa, irBlock->end - 1);
+        if (last->op == IR_Jump && last->flag != Flag_None)
+        {
+            Lattice condition =
+                EvaluateCondition(last->flag, sccp->values[(size_t)ssa->instructions[irBlock->end - 1].flagsUse]);
+            if (condition.state == Lattice_Top)
+                return;
+            if (IsConstant(condition, 1))
+            {
+                MarkEdge(sccp, ssa->succEdges[block->firstSucc]);
+                return;
+            }
+            if (IsConstant(condition, 0))
+            {
+                if (block->numSuccs > 1)
+                    MarkEdge(sccp, ssa->succEdges[block->firstSucc + 1]);
+                return;
+            }
+        }
+    }
+
+    for (size_t s = 0; s < block->numSuccs; s++)
+        MarkEdge(sccp, ssa->succEdges[block->firstSucc + s]);
+}
+
+static bool HasPush(const IRInstruction* inst)
+{
+    return inst->dst.type == IROperand_Push || inst->a.type == IROperand_Push || inst->b.type == IROperand_Push;
+}
+
+static IROperand WordOperand(Lattice l)
+{
+    if (Relocation_IsZero(l.value, l.relative))
+        return IR_Zero();
+    IROperand literal = IR_Literal(l.value);
+    literal.dataRelative = l.relative;
+    return literal;
+}
+
+// Replaces the register read through slot by its constant value, if it has one
+// The two operand form reads and writes the same [r], and moves and nots repeat dst in a.
+// Replacing dst or a then replaces both, replacing b leaves them alone.
+static bool SharesDstAndA(const IRInstruction* inst, int slot)
+{
+    return slot != IRSlot_B && inst->dst.type == IROperand_MemoryRegister && IR_OperandEquals(inst->dst, inst->a);
+}
+
+static bool SubstituteConstant(SCCP* sccp, IRInstruction* inst, size_t i, int slot)
+{
+    int32_t value = sccp->ssa->instructions[i].use[slot];
+    if (value == -1 || sccp->values[(size_t)value].state != Lattice_Constant)
+        return false;
+
+    IROperand* op = IR_OperandAt(inst, slot);
+    IROperand replacement;
+    if (op->type == IROperand_Register)
+        replacement = WordOperand(sccp->values[(size_t)value]);
+    else if (op->type == IROperand_MemoryRegister)
+    {
+        replacement = IR_Memory(sccp->values[(size_t)value].value);
+        replacement.dataRelative = sccp->values[(size_t)value].relative;
+    }
+    else
+        return false;
+
+    IRInstruction candidate = *inst;
+    *IR_OperandAt(&candidate, slot) = replacement;
+    if (SharesDstAndA(inst, slot))
+    {
+        candidate.dst = replacement;
+        candidate.a = replacement;
+    }
+    if (!IR_IsEncodable(&candidate))
+        return false;
+    *inst = candidate;
+    return true;
+}
+
+static bool RewriteInstruction(SCCP* sccp, size_t i)
+{
+    SSA* ssa = sccp->ssa;
+    IRInstruction* inst = Instruction(ssa, i);
+    SSAInstruction* s = &ssa->instructions[i];
+
+    bool changed = false;
+    if (inst->flag != Flag_None && (inst->op == IR_Jump || inst->op <= IR_Not))
+    {
+        Lattice condition = EvaluateCondition(inst->flag, sccp->values[(size_t)s->flagsUse]);
+        if (IsConstant(condition, 0))
+        {
+            inst->op = IR_Nop;
+            return true;
+        }
+        if (IsConstant(condition, 1))
+        {
+            // Reads the same values as before
+            inst->flag = Flag_None;
+            changed = true;
+        }
+    }
+
+    if (inst->op == IR_Call)
+        return SubstituteConstant(sccp, inst, i, IRSlot_A);
+    if (inst->op > IR_Not)
+        return changed;
+
+    // Constant results nothing else needs from become moves
+    if (s->def != -1 && sccp->values[(size_t)s->def].state == Lattice_Constant && inst->flag == Flag_None &&
+        inst->op != IR_Mov && (s->flagsDef == -1 || SSA_Value(ssa, s->flagsDef)->numUses == 0) && !HasPush(inst))
+    {
+        inst->op = IR_Mov;
+        inst->a = inst->dst;
+        inst->b = WordOperand(sccp->values[(size_t)s->def]);
+        return true;
+    }
+
+    if (inst->dst.type == IROperand_MemoryRegister && SubstituteConstant(sccp, inst, i, IRSlot_Dst))
+        changed = true;
+    if (inst->op != IR_Mov && inst->op != IR_Not && SubstituteConstant(sccp, inst, i, IRSlot_A))
+        changed = true;
+    if (SubstituteConstant(sccp, inst, i, IRSlot_B))
+        changed = true;
+    return changed;
+}
+
+static bool PropagateConstants(SSA* ssa)
+{
+    SCCP sccp;
+    sccp.ssa = ssa;
+    sccp.values = xmalloc((ssa->values.count + 1) * sizeof(Lattice));
+    sccp.executableEdges = xmalloc(ssa->edges.count + 1);
+    sccp.executableBlocks = xmalloc(ssa->numBlocks + 1);
+    memset(sccp.executableEdges, 0, ssa->edges.count + 1);
+    memset(sccp.executableBlocks, 0, ssa->numBlocks + 1);
+    for (size_t v = 0; v < ssa->values.count; v++)
+    {
+        bool unknown = SSA_Value(ssa, (int32_t)v)->kind == SSAValue_Unknown;
+        sccp.values[v] = LatticeOf(unknown ? Lattice_Bottom : Lattice_Top);
+    }
+    sccp.executableBlocks[0] = true;
+
+    // Evaluate everything reachable until nothing changes, values only ever go down
+    sccp.changed = true;
+    while (sccp.changed)
+    {
+        sccp.changed = false;
+        for (size_t v = 0; v < ssa->values.count; v++)
+        {
+            SSAValue* value = SSA_Value(ssa, (int32_t)v);
+            if (value->kind == SSAValue_Phi && sccp.executableBlocks[value->block])
+                VisitPhi(&sccp, (int32_t)v);
+        }
+        for (size_t j = 0; j < ssa->numOrdered; j++)
+        {
+            size_t b = ssa->order[j];
+            if (!sccp.executableBlocks[b])
+                continue;
+            IRBlock* block = Block(ssa, b);
+            for (size_t i = block->first; i < block->end; i++)
+                VisitInstruction(&sccp, i);
+            MarkSuccessors(&sccp, b);
+        }
+    }
+
+    bool changed = false;
+    for (size_t b = 0; b < ssa->numBlocks; b++)
+    {
+        IRBlock* block = Block(ssa, b);
+        for (size_t i = block->first; i < block->end; i++)
+        {
+            IRInstruction* inst = Instruction(ssa, i);
+            if (sccp.executableBlocks[b])
+            {
+                if (RewriteInstruction(&sccp, i))
+                    changed = true;
+            }
+            else if (inst->op != IR_Label && inst->op != IR_Nop)
+            {
+                inst->op = IR_Nop;
+                changed = true;
+            }
+        }
+    }
+
+    free(sccp.values);
+    free(sccp.executableEdges);
+    free(sccp.executableBlocks);
+    return changed;
+}
+
+// Register that holds the same value right before instruction i, because value is a copy of it
+static int CopySource(SSA* ssa, int32_t value, size_t i)
+{
+    SSAValue* v = SSA_Value(ssa, value);
+    if (v->kind != SSAValue_Instruction)
+        return -1;
+    IRInstruction* def = Instruction(ssa, v->inst);
+    if (def->op != IR_Mov || def->flag != Flag_None || def->b.type != IROperand_Register)
+        return -1;
+    int source = (int)def->b.value;
+    if (SSA_ValueBefore(ssa, source, i) != ssa->instructions[v->inst].use[IRSlot_B])
+        return -1;
+    return source;
+}
+
+static bool PropagateCopy(SSA* ssa, size_t i, int slot)
+{
+    IRInstruction* inst = Instruction(ssa, i);
+    IROperand* op = IR_OperandAt(inst, slot);
+    int32_t value = ssa->instructions[i].use[slot];
+    if (value == -1 || (op->type != IROperand_Register && op->type != IROperand_MemoryRegister))
+        return false;
+    int source = CopySource(ssa, value, i);
+    if (source == -1 || source == (int)op->value)
+        return false;
+
+    IRInstruction candidate = *inst;
+    IR_OperandAt(&candidate, slot)->value = (int32_t)source;
+    if (SharesDstAndA(inst, slot))
+    {
+        candidate.dst.value = (int32_t)source;
+        candidate.a.value = (int32_t)source;
+    }
+    if (!IR_IsEncodable(&candidate))
+        return false;
+    *inst = candidate;
+    return true;
+}
+
+// Reads of a register that was copied from another one read the original instead,
+// where it still holds the value. The copies then often become dead.
+static bool PropagateCopies(SSA* ssa)
+{
+    bool changed = false;
+    for (size_t j = 0; j < ssa->numOrdered; j++)
+    {
+        IRBlock* block = Block(ssa, ssa->order[j]);
+        for (size_t i = block->first; i < block->end; i++)
+        {
+            IRInstruction* inst = Instruction(ssa, i);
+            if (inst->op == IR_Call && PropagateCopy(ssa, i, IRSlot_A))
+                changed = true;
+            if (inst->op > IR_Not)
+                continue;
+            if (inst->dst.type == IROperand_MemoryRegister && PropagateCopy(ssa, i, IRSlot_Dst))
+                changed = true;
+            if (inst->op != IR_Mov && inst->op != IR_Not && PropagateCopy(ssa, i, IRSlot_A))
+                changed = true;
+            if (PropagateCopy(ssa, i, IRSlot_B))
+                changed = true;
+        }
+    }
+    return changed;
+}
+
+// Instructions that only write a register and the flags
+static bool IsRemovable(const IRInstruction* inst)
+{
+    return inst->op <= IR_Not && (inst->dst.type == IROperand_Register || inst->dst.type == IROperand_Zero) &&
+           !HasPush(inst);
+}
+
+static bool IsLive(const bool* live, int32_t value)
+{
+    return value != -1 && live[(size_t)value];
+}
+
+static void MarkLive(bool* live, int32_t* work, size_t* numWork, int32_t value)
+{
+    if (value == -1 || IsLive(live, value))
+        return;
+    live[(size_t)value] = true;
+    work[(*numWork)++] = value;
+}
+
+static void MarkUses(SSA* ssa, bool* live, int32_t* work, size_t* numWork, size_t i)
+{
+    SSAInstruction* s = &ssa->instructions[i];
+    for (int slot = IRSlot_Dst; slot <= IRSlot_B; slot++)
+        MarkLive(live, work, numWork, s->use[slot]);
+    MarkLive(live, work, numWork, s->flagsUse);
+}
+
+// Removes instructions whose results nothing reads, starting from the instructions
+// with other effects and following the values they read.
+static bool EliminateDeadCode(SSA* ssa)
+{
+    bool* live = xmalloc(ssa->values.count + 1);
+    memset(live, 0, ssa->values.count + 1);
+    int32_t* work = xmalloc((ssa->values.count + 1) * sizeof(int32_t));
+    size_t numWork = 0;
+
+    for (size_t j = 0; j < ssa->numOrdered; j++)
+    {
+        IRBlock* block = Block(ssa, ssa->order[j]);
+        for (size_t i = block->first; i < block->end; i++)
+        {
+            if (!IsRemovable(Instruction(ssa, i)))
+                MarkUses(ssa, live, work, &numWork, i);
+        }
+    }
+
+    while (numWork != 0)
+    {
+        int32_t v = work[--numWork];
+        SSAValue* value = SSA_Value(ssa, v);
+        if (value->kind == SSAValue_Instruction)
+            MarkUses(ssa, live, work, &numWork, value->inst);
+        else if (value->kind == SSAValue_Phi)
+        {
+            for (size_t k = 0; k < SSA_NumPhiArgs(ssa, v); k++)
+                MarkLive(live, work, &numWork, *(int32_t*)GenericList_At(&ssa->phiArgs, value->firstArg + k));
+        }
+    }
+
+    bool changed = false;
+    for (size_t j = 0; j < ssa->numOrdered; j++)
+    {
+        IRBlock* block = Block(ssa, ssa->order[j]);
+        for (size_t i = block->first; i < block->end; i++)
+        {
+            IRInstruction* inst = Instruction(ssa, i);
+            SSAInstruction* s = &ssa->instructions[i];
+            if (IsRemovable(inst) && !IsLive(live, s->def) && !IsLive(live, s->flagsDef))
+            {
+                inst->op = IR_Nop;
+                changed = true;
+            }
+        }
+    }
+
+    free(live);
+    free(work);
+    return changed;
+}
+
+typedef enum
+{
+    Pass_ConstantPropagation,
+    Pass_CopyPropagation,
+    Pass_DeadCodeElimination,
+    Pass_Count,
+} Pass;
+
+static bool RunPass(SSA* ssa, Pass pass)
+{
+    switch (pass)
+    {
+        case Pass_ConstantPropagation: return PropagateConstants(ssa);
+        case Pass_CopyPropagation: return PropagateCopies(ssa);
+        case Pass_DeadCodeElimination: return EliminateDeadCode(ssa);
+        default: return false;
+    }
+}
+
+bool Passes_Run(IRFunction* function, int level)
+{
+    // Virtual registers have to be assigned at any level
+    bool hasVirtualRegisters = IR_HasVirtualRegisters(function);
+    if (level < 1 && !hasVirtualRegisters)
+        return true;
+
+    // The SSA form is rebuilt after a pass changed the code
+    SSA* ssa = SSA_Build(function);
+    if (ssa == NULL)
+        return !hasVirtualRegisters;
+    // Runs until no pass changes anything. This terminates: passes only remove instructions,
+    // replace registers by constants, or replace a register by the one it was copied from,
+    // whose definition dominates the copy.
+    bool changed = level >= 1;
+    while (changed)
+    {
+        changed = false;
+        for (int pass = 0; pass < Pass_Count; pass++)
+        {
+            if (ssa == NULL)
+                ssa = SSA_Build(function);
+            if (RunPass(ssa, (Pass)pass))
+            {
+                changed = true;
+                SSA_Dispose(ssa);
+                ssa = NULL;
+            }
+        }
+    }
+    if (ssa == NULL)
+        ssa = SSA_Build(function);
+    bool assigned = Allocator_Run(ssa) || !hasVirtualRegisters;
+    SSA_Dispose(ssa);
+    return assigned;
+}
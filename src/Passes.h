@@ -0,0 +1,11 @@
+#pragma once
+#include "IR.h"
+
+// Optimizes the code of a function before it is printed. Level 0 leaves it as generated,
+// except that virtual registers are assigned (Allocator.h).
+// Level 1 runs sparse conditional constant propagation, copy propagation and dead code
+// elimination on the SSA form of the function (SSA.h) until none of them changes anything,
+// then reassigns its registers (Allocator.h). The peephole optimizer (Peephole.h) cleans up
+// the result afterwards.
+// Returns false if the virtual registers of the function could neither be assigned nor spilled.
+bool Passes_Run(IRFunction* function, int level);
@@ -0,0 +1,354 @@
+#include "Peephole.h"
+#include "Relocation.h"
+#include "Util.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char* ruleNames[6] = {"move-to-self", "store-load",   "jump-to-next",
+                                   "jump-to-jump", "stack-adjust", "redundant-test"};
+
+// Jumps followed when looking for reads of the flags
+static const int MAX_JUMPS = 4;
+
+typedef struct
+{
+    IRFunction* function;
+    // Instruction of each label, SIZE_MAX for labels not defined in the function
+    size_t* labelIndex;
+    size_t numLabels;
+    // Entries of jump tables, which have to stay where they are
+    bool* inJumpTable;
+} Peephole;
+
+static IRInstruction* Instruction(Peephole* p, size_t i)
+{
+    return GenericList_At(&p->function->instructions, i);
+}
+
+static size_t NumInstructions(Peephole* p)
+{
+    return p->function->instructions.count;
+}
+
+static size_t LabelIndex(Peephole* p, IROperand label)
+{
+    if (label.type != IROperand_Label || (size_t)label.value >= p->numLabels)
+        return SIZE_MAX;
+    return p->labelIndex[(size_t)label.value];
+}
+
+// Next instruction after i that wasn't removed
+static size_t Next(Peephole* p, size_t i)
+{
+    i++;
+    while (i < NumInstructions(p) && Instruction(p, i)->op == IR_Nop)
+        i++;
+    return i;
+}
+
+// Previous instruction before i that wasn't removed, SIZE_MAX if there is none
+static size_t Previous(Peephole* p, size_t i)
+{
+    while (i > 0)
+    {
+        i--;
+        if (Instruction(p, i)->op != IR_Nop)
+            return i;
+    }
+    return SIZE_MAX;
+}
+
+// First instruction from i on that isn't a label
+static size_t SkipLabels(Peephole* p, size_t i)
+{
+    while (i < NumInstructions(p) && (Instruction(p, i)->op == IR_Label || Instruction(p, i)->op == IR_Nop))
+        i++;
+    return i;
+}
+
+static bool IsUnconditionalJump(const IRInstruction* inst)
+{
+    return inst->op == IR_Jump && inst->flag == Flag_None;
+}
+
+static bool IsStackAdjustment(const IRInstruction* inst)
+{
+    return (inst->op == IR_Add || inst->op == IR_Sub) && inst->flag == Flag_None && inst->dst.type == IROperand_SP &&
+           inst->a.type == IROperand_SP && inst->b.type == IROperand_Literal;
+}
+
+static bool IsZeroOrSign(Flag flag)
+{
+    return flag == Flag_Z || flag == Flag_NZ || flag == Flag_S || flag == Flag_NS;
+}
+
+// Whether the flags at instruction i may be read before they are set again. With zeroAndSign,
+// only conditions on other flags count. Unknown jump targets count as reads.
+static bool FlagsRead(Peephole* p, size_t i, bool zeroAndSign, int numJumps)
+{
+    if (numJumps > MAX_JUMPS)
+        return true;
+    for (; i < NumInstructions(p); i++)
+    {
+        IRInstruction* inst = Instruction(p, i);
+        if (inst->op == IR_Nop || inst->op == IR_Label)
+            continue;
+        if (inst->flag != Flag_None && !(zeroAndSign && IsZeroOrSign(inst->flag)))
+            return true;
+
+        if (inst->op == IR_Jump)
+        {
+            size_t target = LabelIndex(p, inst->a);
+            if (target == SIZE_MAX || FlagsRead(p, target, zeroAndSign, numJumps + 1))
+                return true;
+            if (inst->flag == Flag_None)
+                return false;
+            continue;
+        }
+        // The code after a call doesn't see the flags from before it
+        if (inst->op == IR_Call)
+            return false;
+        if (inst->op > IR_Not)
+            return true;
+        if (inst->dst.type == IROperand_IP)
+        {
+            // Callers don't read the flags of a return either
+            if (inst->op == IR_Mov && inst->b.type == IROperand_Stack)
+            {
+                if (inst->flag == Flag_None)
+                    return false;
+                continue;
+            }
+            return true;
+        }
+        if (inst->op != IR_Mov && inst->flag == Flag_None)
+            return false;
+    }
+    return false;
+}
+
+static bool MoveToSelf(Peephole* p, size_t i)
+{
+    IRInstruction* inst = Instruction(p, i);
+    if (inst->op != IR_Mov || !IR_OperandEquals(inst->dst, inst->b))
+        return false;
+    // Other addresses may be device registers
+    if (inst->dst.type != IROperand_Register && inst->dst.type != IROperand_Stack)
+        return false;
+    inst->op = IR_Nop;
+    return true;
+}
+
+static bool StoreLoad(Peephole* p, size_t i)
+{
+    IRInstruction* store = Instruction(p, i);
+    if (store->op != IR_Mov || store->flag != Flag_None || store->dst.type != IROperand_Stack)
+        return false;
+    if (store->b.type != IROperand_Register && store->b.type != IROperand_Zero && store->b.type != IROperand_Literal)
+        return false;
+
+    size_t j = Next(p, i);
+    if (j == NumInstructions(p))
+        return false;
+    IRInstruction* load = Instruction(p, j);
+    if (load->op != IR_Mov || load->dst.type != IROperand_Register || !IR_OperandEquals(load->b, store->dst))
+        return false;
+
+    if (IR_OperandEquals(load->dst, store->b))
+    {
+        load->op = IR_Nop;
+        return true;
+    }
+    IROperand address = load->b;
+    load->b = store->b;
+    if (!IR_IsEncodable(load))
+    {
+        load->b = address;
+        return false;
+    }
+    return true;
+}
+
+static bool JumpToNext(Peephole* p, size_t i)
+{
+    IRInstruction* inst = Instruction(p, i);
+    if (inst->op != IR_Jump || p->inJumpTable[i])
+        return false;
+    for (size_t j = Next(p, i); j < NumInstructions(p); j = Next(p, j))
+    {
+        IRInstruction* label = Instruction(p, j);
+        if (label->op != IR_Label)
+            return false;
+        if (label->a.value == inst->a.value)
+        {
+            inst->op = IR_Nop;
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool JumpToJump(Peephole* p, size_t i)
+{
+    IRInstruction* inst = Instruction(p, i);
+    if (inst->op != IR_Jump)
+        return false;
+
+    // Follows the chain to its end. A chain with more jumps than there are labels
+    // is a cycle, which is left alone, so that the jump isn't moved around it forever.
+    IROperand target = inst->a;
+    size_t numJumps = 0;
+    while (true)
+    {
+        size_t label = LabelIndex(p, target);
+        if (label == SIZE_MAX)
+            break;
+        size_t j = SkipLabels(p, label);
+        if (j == NumInstructions(p) || !IsUnconditionalJump(Instruction(p, j)))
+            break;
+        if (j == i || numJumps == p->numLabels)
+            return false;
+        target = Instruction(p, j)->a;
+        numJumps++;
+    }
+    if (IR_OperandEquals(target, inst->a))
+        return false;
+    inst->a = target;
+    return true;
+}
+
+static bool StackAdjust(Peephole* p, size_t i)
+{
+    IRInstruction* first = Instruction(p, i);
+    if (!IsStackAdjustment(first))
+        return false;
+    size_t j = Next(p, i);
+    if (j == NumInstructions(p) || !IsStackAdjustment(Instruction(p, j)))
+        return false;
+    // The merged instruction sets the flags differently, if at all
+    if (FlagsRead(p, j + 1, false, 0))
+        return false;
+
+    IRInstruction* second = Instruction(p, j);
+    int32_t delta = first->op == IR_Add ? first->b.value : -first->b.value;
+    delta += second->op == IR_Add ? second->b.value : -second->b.value;
+    first->op = IR_Nop;
+    if (delta == 0)
+        second->op = IR_Nop;
+    else
+    {
+        second->op = delta > 0 ? IR_Add : IR_Sub;
+        second->b = IR_Literal(delta > 0 ? delta : -delta);
+    }
+    return true;
+}
+
+// Adding, subtracting or or-ing 0 tests r: it sets the zero and sign flags for r the same
+// way the instruction that computed r did. Only the carry differs.
+static bool RedundantTest(Peephole* p, size_t i)
+{
+    IRInstruction* test = Instruction(p, i);
+    if ((test->op != IR_Add && test->op != IR_Sub && test->op != IR_Or) || test->flag != Flag_None ||
+        test->a.type != IROperand_Register)
+        return false;
+    if (test->b.type != IROperand_Zero &&
+        !(test->b.type == IROperand_Literal && Relocation_IsZero(test->b.value, test->b.dataRelative)))
+        return false;
+    if (test->dst.type != IROperand_Zero && !IR_OperandEquals(test->dst, test->a))
+        return false;
+
+    size_t j = Previous(p, i);
+    if (j == SIZE_MAX)
+        return false;
+    IRInstruction* prev = Instruction(p, j);
+    if (prev->op >= IR_Mov || prev->flag != Flag_None || !IR_OperandEquals(prev->dst, test->a))
+        return false;
+    if (FlagsRead(p, i + 1, true, 0))
+        return false;
+    test->op = IR_Nop;
+    return true;
+}
+
+static bool ApplyRule(Peephole* p, PeepholeRule rule, size_t i)
+{
+    switch (rule)
+    {
+        case PeepholeRule_MoveToSelf: return MoveToSelf(p, i);
+        case PeepholeRule_StoreLoad: return StoreLoad(p, i);
+        case PeepholeRule_JumpToNext: return JumpToNext(p, i);
+        case PeepholeRule_JumpToJump: return JumpToJump(p, i);
+        case PeepholeRule_StackAdjust: return StackAdjust(p, i);
+        case PeepholeRule_RedundantTest: return RedundantTest(p, i);
+        default: return false;
+    }
+}
+
+static void FindLabels(Peephole* p)
+{
+    p->numLabels = 0;
+    for (size_t i = 0; i < NumInstructions(p); i++)
+    {
+        IRInstruction* inst = Instruction(p, i);
+        if ((inst->op == IR_Label || inst->op == IR_Jump) && (size_t)inst->a.value + 1 > p->numLabels)
+            p->numLabels = (size_t)inst->a.value + 1;
+    }
+    p->labelIndex = xmalloc((p->numLabels + 1) * sizeof(size_t));
+    for (size_t i = 0; i < p->numLabels; i++)
+        p->labelIndex[i] = SIZE_MAX;
+
+    p->inJumpTable = xmalloc(NumInstructions(p) + 1);
+    memset(p->inJumpTable, 0, NumInstructions(p) + 1);
+    bool jumpTable = false;
+    for (size_t i = 0; i < NumInstructions(p); i++)
+    {
+        IRInstruction* inst = Instruction(p, i);
+        if (inst->op == IR_Label)
+            p->labelIndex[(size_t)inst->a.value] = i;
+
+        jumpTable = jumpTable && IsUnconditionalJump(inst);
+        p->inJumpTable[i] = jumpTable;
+        if (inst->op == IR_Add && inst->dst.type == IROperand_IP)
+            jumpTable = true;
+    }
+}
+
+void Peephole_Run(IRFunction* function, size_t* counts)
+{
+    if (IR_DependsOnAddresses(function))
+        return;
+
+    Peephole p;
+    p.function = function;
+    FindLabels(&p);
+
+    // Terminates: each rule removes an instruction, replaces a stack operand by a register
+    // or literal, or moves a jump to the end of its chain, where it stays until another
+    // rule changes the code.
+    bool changed = true;
+    while (changed)
+    {
+        changed = false;
+        for (size_t i = 0; i < NumInstructions(&p); i++)
+        {
+            for (int rule = 0; rule < PeepholeRule_Count && Instruction(&p, i)->op != IR_Nop; rule++)
+            {
+                if (ApplyRule(&p, (PeepholeRule)rule, i))
+                {
+                    changed = true;
+                    if (counts != NULL)
+                        counts[rule]++;
+                }
+            }
+        }
+    }
+
+    free(p.labelIndex);
+    free(p.inJumpTable);
+}
+
+const char* Peephole_RuleName(PeepholeRule rule)
+{
+    return ruleNames[rule];
+}
@@ -0,0 +1,30 @@
+#pragma once
+#include "IR.h"
+#include <stddef.h>
+
+// Rules of the peephole optimizer. Each replaces a short instruction sequence of a
+// function with registers assigned by a cheaper one.
+typedef enum
+{
+    // mov x, x
+    PeepholeRule_MoveToSelf,
+    // mov [sp-n], x; mov r, [sp-n] loads x instead
+    PeepholeRule_StoreLoad,
+    // Jump to a label that directly follows it
+    PeepholeRule_JumpToNext,
+    // Jump to a label followed by a jump goes to the target of that jump instead
+    PeepholeRule_JumpToJump,
+    // Consecutive adjustments of sp are merged into one
+    PeepholeRule_StackAdjust,
+    // add r, 0 or sub rz, r, 0 after an instruction that set the zero and sign flags for r
+    PeepholeRule_RedundantTest,
+    PeepholeRule_Count,
+} PeepholeRule;
+
+// Applies the rules to the code of a function until none of them changes anything.
+// Removed instructions become IR_Nop. Functions whose code depends on instruction
+// addresses, like those with inline assembly, are left as they are, and so are the
+// entries of switch jump tables. If counts isn't NULL, counts[rule] is increased
+// each time a rule fires.
+void Peephole_Run(IRFunction* function, size_t* counts);
+const char* Peephole_RuleName(PeepholeRule rule);
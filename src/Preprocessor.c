@@ -1,21 +1,203 @@
 #include "Preprocessor.h"
 #include "Error.h"
+#include "Intern.h"
 #include "Lexer.h"
 #include "Util.h"
 #include <stdlib.h>
 #include <string.h>
 
-static char* defines[64];
-static size_t currentLenDefines = 0;
-static const size_t maxLenDefines = 64;
+// Set of interned symbol ids, optionally with a value for each of them. The symbols
+// are kept in insertion order for enumeration, with an open addressing index (of
+// positions in symbols) for lookups. Symbol ids are dense, so they are used as their own hash.
+typedef struct
+{
+    uint32_t* symbols;
+    uint32_t* values;
+    size_t count;
+    size_t maxCount;
+    uint32_t* slots;
+    size_t numSlots;
+} SymbolSet;
+
+static const uint32_t FREE_SLOT = 0xFFFFFFFF;
+
+typedef struct PreprocessorContext
+{
+    SymbolSet defines;
+    // Files that contained #pragma once
+    SymbolSet onceFiles;
+    // Files with an include guard, the guard macro is the value. Kept across translation units.
+    SymbolSet guardedFiles;
+    // Defines that are kept across translation units
+    size_t numPredefined;
+    GenericList* eventLog;
+} PreprocessorContext;
+
+#ifndef CUSTOM_COMP
+static _Thread_local PreprocessorContext* ctx = NULL;
+#endif
+#ifdef CUSTOM_COMP
+static PreprocessorContext* ctx = NULL;
+#endif
+
+static size_t FindSlot(const SymbolSet* set, uint32_t symbol)
+{
+    size_t i = (size_t)symbol & (set->numSlots - 1);
+    while (set->slots[i] != FREE_SLOT && set->symbols[(size_t)set->slots[i]] != symbol)
+        i = (i + 1) & (set->numSlots - 1);
+    return i;
+}
+
+static void RebuildIndex(SymbolSet* set)
+{
+    for (size_t i = 0; i < set->numSlots; i++)
+        set->slots[i] = FREE_SLOT;
+    for (size_t i = 0; i < set->count; i++)
+        set->slots[FindSlot(set, set->symbols[i])] = (uint32_t)i;
+}
+
+// Position of symbol in the set, FREE_SLOT if it is not contained
+static uint32_t SymbolSet_Find(const SymbolSet* set, uint32_t symbol)
+{
+    if (set->count == 0)
+        return FREE_SLOT;
+    return set->slots[FindSlot(set, symbol)];
+}
+
+static bool SymbolSet_Contains(const SymbolSet* set, uint32_t symbol)
+{
+    return SymbolSet_Find(set, symbol) != FREE_SLOT;
+}
+
+// Adds symbol, or replaces its value if it is already contained
+static void SymbolSet_Put(SymbolSet* set, uint32_t symbol, uint32_t value)
+{
+    uint32_t index = SymbolSet_Find(set, symbol);
+    if (index != FREE_SLOT)
+    {
+        set->values[(size_t)index] = value;
+        return;
+    }
+
+    if (set->count == set->maxCount)
+    {
+        set->maxCount = (set->maxCount == 0) ? 64 : set->maxCount * 2;
+        set->symbols = xrealloc(set->symbols, set->maxCount * sizeof(uint32_t));
+        set->values = xrealloc(set->values, set->maxCount * sizeof(uint32_t));
+    }
+    set->symbols[set->count] = symbol;
+    set->values[set->count] = value;
+    set->count++;
+
+    // Keep the load factor below 1/2
+    if (set->count * 2 > set->numSlots)
+    {
+        set->numSlots = set->maxCount * 2;
+        set->slots = xrealloc(set->slots, set->numSlots * sizeof(uint32_t));
+        RebuildIndex(set);
+    }
+    else
+        set->slots[FindSlot(set, symbol)] = (uint32_t)(set->count - 1);
+}
+
+static void SymbolSet_Add(SymbolSet* set, uint32_t symbol)
+{
+    uint32_t value = 0;
+    SymbolSet_Put(set, symbol, value);
+}
+
+// Removal is rare (#undef), so the index is simply rebuilt.
+static void SymbolSet_Remove(SymbolSet* set, uint32_t symbol)
+{
+    for (size_t i = 0; i < set->count; i++)
+    {
+        if (set->symbols[i] == symbol)
+        {
+            for (size_t j = i + 1; j < set->count; j++)
+            {
+                set->symbols[j - 1] = set->symbols[j];
+                set->values[j - 1] = set->values[j];
+            }
+            set->count--;
+            RebuildIndex(set);
+            return;
+        }
+    }
+}
+
+// Keeps only the first count symbols
+static void SymbolSet_Truncate(SymbolSet* set, size_t count)
+{
+    if (count >= set->count)
+        return;
+    set->count = count;
+    RebuildIndex(set);
+}
+
+static void SymbolSet_Dispose(SymbolSet* set)
+{
+    free(set->symbols);
+    free(set->values);
+    free(set->slots);
+    set->symbols = NULL;
+    set->values = NULL;
+    set->slots = NULL;
+    set->count = 0;
+    set->maxCount = 0;
+    set->numSlots = 0;
+}
+
+PreprocessorContext* Preprocessor_CreateContext()
+{
+    PreprocessorContext* context = xmalloc(sizeof(PreprocessorContext));
+    memset(context, 0, sizeof(PreprocessorContext));
+    return context;
+}
+
+void Preprocessor_DisposeContext(PreprocessorContext* context)
+{
+    SymbolSet_Dispose(&context->defines);
+    SymbolSet_Dispose(&context->onceFiles);
+    SymbolSet_Dispose(&context->guardedFiles);
+    if (ctx == context)
+        ctx = NULL;
+    free(context);
+}
+
+void Preprocessor_UseContext(PreprocessorContext* context)
+{
+    ctx = context;
+}
+
+static void LogEvent(PreprocessorEventType type, uint32_t symbol, bool result)
+{
+    if (ctx->eventLog == NULL)
+        return;
+    PreprocessorEvent e = {type, symbol, result};
+    GenericList_Append(ctx->eventLog, &e);
+}
+
+static uint32_t ToSymbol(const char* id)
+{
+    return Intern_Symbol(id, strlen(id));
+}
+
+void Preprocessor_SetLog(GenericList* log)
+{
+    ctx->eventLog = log;
+}
+
+GenericList* Preprocessor_GetLog()
+{
+    return ctx->eventLog;
+}
 
 bool Preprocessor_IsValid(const char* id)
 {
     if (!isalpha(*id) && *id != '_')
         return false;
-    id++;
 
-    while (*id++)
+    for (id++; *id != 0; id++)
         if (!isalpha(*id) && !isdigit(*id) && *id != '_')
             return false;
 
@@ -24,58 +206,82 @@ bool Preprocessor_IsValid(const char* id)
 
 bool Preprocessor_IsDefined(const char* id)
 {
-    for (size_t i = 0; i < currentLenDefines; i++)
-    {
-        if (strcmp(id, defines[i]) == 0)
-            return true;
-    }
-    return false;
+    uint32_t symbol = ToSymbol(id);
+    bool result = SymbolSet_Contains(&ctx->defines, symbol);
+    LogEvent(PreprocessorEvent_Query, symbol, result);
+    return result;
 }
 
 void Preprocessor_Define(const char* id)
 {
-    if (Preprocessor_IsDefined(id))
-        return;
-
-    if (currentLenDefines == maxLenDefines)
-        Error("Too many defines!");
+    uint32_t symbol = ToSymbol(id);
+    LogEvent(PreprocessorEvent_Define, symbol, true);
+    SymbolSet_Add(&ctx->defines, symbol);
+}
 
-    char* copy = xmalloc(strlen(id) + 1);
-    strcpy(copy, id);
-    defines[currentLenDefines++] = copy;
+void Preprocessor_Predefine(const char* id)
+{
+    if (ctx->defines.count != ctx->numPredefined)
+        Error("Predefines have to be made before any other defines");
+    SymbolSet_Add(&ctx->defines, ToSymbol(id));
+    ctx->numPredefined = ctx->defines.count;
 }
 
 void Preprocessor_Clear()
 {
-    for (size_t i = 1; i < currentLenDefines; i++)
-    {
-        free(defines[i]);
-    }
-    currentLenDefines = 1;
+    SymbolSet_Truncate(&ctx->defines, ctx->numPredefined);
+    SymbolSet_Truncate(&ctx->onceFiles, 0);
 }
 
 void Preprocessor_Undefine(const char* id)
 {
-    for (size_t i = 0; i < currentLenDefines; i++)
-    {
-        if (strcmp(id, defines[i]) == 0)
-        {
-            free(defines[i]);
-            for (size_t j = i + 1; j < currentLenDefines; j++)
-            {
-                defines[j - 1] = defines[j];
-                currentLenDefines--;
-                return;
-            }
-        }
-    }
+    SymbolSet_Remove(&ctx->defines, ToSymbol(id));
 }
 
-void Preprocessor_End()
+bool Preprocessor_IsOnceFile(const char* file)
 {
-    for (size_t i = 0; i < currentLenDefines; i++)
-    {
-        if (defines[i] != NULL)
-            free(defines[i]);
-    }
-}
\ No newline at end of file
+    uint32_t symbol = ToSymbol(file);
+    bool result = SymbolSet_Contains(&ctx->onceFiles, symbol);
+    LogEvent(PreprocessorEvent_OnceQuery, symbol, result);
+    return result;
+}
+
+void Preprocessor_AddOnceFile(const char* file)
+{
+    uint32_t symbol = ToSymbol(file);
+    LogEvent(PreprocessorEvent_Once, symbol, true);
+    SymbolSet_Add(&ctx->onceFiles, symbol);
+}
+
+void Preprocessor_SetIncludeGuard(const char* file, const char* macro)
+{
+    SymbolSet_Put(&ctx->guardedFiles, ToSymbol(file), ToSymbol(macro));
+}
+
+bool Preprocessor_IsIncludeGuarded(const char* file)
+{
+    uint32_t index = SymbolSet_Find(&ctx->guardedFiles, ToSymbol(file));
+    if (index == FREE_SLOT)
+        return false;
+    return Preprocessor_IsDefined(Intern_GetSymbol(ctx->guardedFiles.values[(size_t)index]));
+}
+
+size_t Preprocessor_NumDefines()
+{
+    return ctx->defines.count;
+}
+
+const char* Preprocessor_GetDefine(size_t index)
+{
+    return Intern_GetSymbol(ctx->defines.symbols[index]);
+}
+
+size_t Preprocessor_NumOnceFiles()
+{
+    return ctx->onceFiles.count;
+}
+
+const char* Preprocessor_GetOnceFile(size_t index)
+{
+    return Intern_GetSymbol(ctx->onceFiles.symbols[index]);
+}
@@ -1,10 +1,58 @@
 #pragma once
+#include "GenericList.h"
 #include "Token.h"
 #include <stdbool.h>
+#include <stdint.h>
+
+typedef enum
+{
+    PreprocessorEvent_Query,
+    PreprocessorEvent_Define,
+    PreprocessorEvent_OnceQuery,
+    PreprocessorEvent_Once,
+} PreprocessorEventType;
+
+typedef struct
+{
+    PreprocessorEventType type;
+    uint32_t symbol; // interned id of the define or file
+    bool result;     // result of a query
+} PreprocessorEvent;
 
 bool Preprocessor_IsValid(const char* id);
 bool Preprocessor_IsDefined(const char* id);
 void Preprocessor_Define(const char* id);
+// Defines id for all translation units, has to be called before any other define.
+void Preprocessor_Predefine(const char* id);
+// Removes all defines and once files of the current translation unit.
 void Preprocessor_Clear();
 void Preprocessor_Undefine(const char* id);
-void Preprocessor_End();
\ No newline at end of file
+
+// Files (by canonical path) that contained #pragma once and are skipped when included again.
+bool Preprocessor_IsOnceFile(const char* file);
+void Preprocessor_AddOnceFile(const char* file);
+
+// Files (by canonical path) that are entirely wrapped in #ifndef macro. They can be
+// skipped without reading them while the macro is defined.
+void Preprocessor_SetIncludeGuard(const char* file, const char* macro);
+bool Preprocessor_IsIncludeGuarded(const char* file);
+
+// Enumerates the current defines.
+size_t Preprocessor_NumDefines();
+const char* Preprocessor_GetDefine(size_t index);
+size_t Preprocessor_NumOnceFiles();
+const char* Preprocessor_GetOnceFile(size_t index);
+
+// While a log is set, every query and define (of defines and once files) is appended to it as a PreprocessorEvent.
+void Preprocessor_SetLog(GenericList* log);
+GenericList* Preprocessor_GetLog();
+
+#ifndef CUSTOM_COMP
+typedef struct PreprocessorContext PreprocessorContext;
+#endif
+#ifdef CUSTOM_COMP
+typedef struct PreprocessorContext {} PreprocessorContext;
+#endif
+PreprocessorContext* Preprocessor_CreateContext();
+void Preprocessor_DisposeContext(PreprocessorContext* context);
+void Preprocessor_UseContext(PreprocessorContext* context);
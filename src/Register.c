@@ -1,7 +1,9 @@
 #include "Register.h"
+#include "Error.h"
 #include "Function.h"
-#include "Outfile.h"
+#include "IR.h"
 #include "Stack.h"
+#include "Util.h"
 #include <assert.h>
 #include <stdbool.h>
 #include <stdint.h>
@@ -9,19 +11,71 @@
 #include <stdlib.h>
 #include <string.h>
 
-static uint16_t usedRegisters = (uint16_t)0;
+typedef struct RegisterContext
+{
+    uint16_t usedRegisters;
+    // One for each register from Register_Virtual to Register_End
+    bool usedVirtual[48];
+    uint16_t preferredRegisters[8];
+} RegisterContext;
+
+#ifndef CUSTOM_COMP
+static _Thread_local RegisterContext* ctx = NULL;
+#endif
+#ifdef CUSTOM_COMP
+static RegisterContext* ctx = NULL;
+#endif
+
+RegisterContext* Registers_CreateContext()
+{
+    RegisterContext* context = xmalloc(sizeof(RegisterContext));
+    memset(context, 0, sizeof(RegisterContext));
+    return context;
+}
+
+void Registers_DisposeContext(RegisterContext* context)
+{
+    if (ctx == context)
+        ctx = NULL;
+    free(context);
+}
+
+void Registers_UseContext(RegisterContext* context)
+{
+    ctx = context;
+}
+
 const int NUM_REGISTERS = 8;
-uint16_t preferredRegisters[8];
 
 int16_t Registers_GetUsed()
 {
-    return usedRegisters;
+    return ctx->usedRegisters;
 }
 
 // TODO make this pointer to array when supported
 void Registers_SetPreferred(const uint16_t* prefRegs)
 {
-    memcpy(&preferredRegisters[0], prefRegs, sizeof(uint16_t) * 8);
+    memcpy(&ctx->preferredRegisters[0], prefRegs, sizeof(uint16_t) * 8);
+}
+
+static int GetVirtual(Function* f)
+{
+    for (int i = 0; i < Register_End - Register_Virtual; i++)
+        if (!ctx->usedVirtual[(size_t)i])
+        {
+            ctx->usedVirtual[(size_t)i] = true;
+            // It may end up in any machine register
+            f->modifiedRegisters |= (1 << NUM_REGISTERS) - 1;
+            return Register_Virtual + i;
+        }
+
+    Error("Expression too complex");
+    return -1;
+}
+
+int Registers_GetVirtual()
+{
+    return GetVirtual(Function_GetCurrent());
 }
 
 int Registers_GetFree()
@@ -32,14 +86,15 @@ int Registers_GetFree()
 
     // Find most preferred register
     for (int i = 0; i < NUM_REGISTERS; i++)
-        if (!(usedRegisters & (1 << i)) && preferredRegisters[i] > lastScore)
+        if (!(ctx->usedRegisters & (1 << i)) && ctx->preferredRegisters[i] > lastScore)
         {
             r = i;
-            lastScore = preferredRegisters[i];
+            lastScore = ctx->preferredRegisters[i];
         }
 
-    assert(r != -1);
-    usedRegisters |= (1 << r);
+    if (r == -1)
+        return GetVirtual(f);
+    ctx->usedRegisters |= (1 << r);
     f->modifiedRegisters |= (1 << r);
     return r;
 }
@@ -47,29 +102,40 @@ void Register_Free(int r)
 {
     if (r == -1)
         return;
-    usedRegisters &= ~(1 << r);
+    if (r >= Register_Virtual)
+        ctx->usedVirtual[(size_t)(r - Register_Virtual)] = false;
+    else
+        ctx->usedRegisters &= ~(1 << r);
 }
 void Register_GetSpecific(int r)
 {
-    assert(!(usedRegisters & (1 << r)));
-    usedRegisters |= (1 << r);
+    if (r >= Register_Virtual)
+    {
+        assert(!ctx->usedVirtual[(size_t)(r - Register_Virtual)]);
+        ctx->usedVirtual[(size_t)(r - Register_Virtual)] = true;
+        return;
+    }
+    assert(!(ctx->usedRegisters & (1 << r)));
+    ctx->usedRegisters |= (1 << r);
 }
 void Registers_FreeAll()
 {
-    usedRegisters = 0;
+    ctx->usedRegisters = 0;
+    for (int i = 0; i < Register_End - Register_Virtual; i++)
+        ctx->usedVirtual[(size_t)i] = false;
 }
 uint16_t Registers_PushAllUsed(int* num)
 {
     for (int i = 0; i < NUM_REGISTERS; i++)
     {
-        if ((usedRegisters & (1 << i)) != 0)
+        if ((ctx->usedRegisters & (1 << i)) != 0)
         {
-            OutWrite("mov [sp++], r%i\n", i);
+            IR_EmitMove(IR_Mov, IR_Push(), IR_Register(i));
             if (num != NULL)
                 (*num)++;
         }
     }
-    return usedRegisters;
+    return ctx->usedRegisters;
 }
 // Only pushes registers that have a 1 in the mask
 uint16_t Registers_PushAllUsedMasked(int* num, uint16_t mask)
@@ -77,14 +143,14 @@ uint16_t Registers_PushAllUsedMasked(int* num, uint16_t mask)
     *num = 0;
     for (int i = 0; i < NUM_REGISTERS; i++)
     {
-        if ((usedRegisters & (1 << i)) && (mask & (1 << i)))
+        if ((ctx->usedRegisters & (1 << i)) && (mask & (1 << i)))
         {
-            OutWrite("mov [sp++], r%i\n", i);
+            IR_EmitMove(IR_Mov, IR_Push(), IR_Register(i));
             if (num != NULL)
                 (*num)++;
         }
     }
-    return usedRegisters & mask;
+    return ctx->usedRegisters & mask;
 }
 
 // Get number of registers that are not modified by any function
@@ -95,7 +161,7 @@ int Registers_GetNumPreferred()
     int num = 0;
     for (int i = 0; i < NUM_REGISTERS; i++)
     {
-        if (!(usedRegisters & (1 << i)) && (preferredRegisters[i] == 0xFFFF))
+        if (!(ctx->usedRegisters & (1 << i)) && (ctx->preferredRegisters[i] == 0xFFFF))
             num++;
     }
     return num;
@@ -106,7 +172,7 @@ int Registers_GetNumUsed()
     int num = 0;
     for (int i = 0; i < NUM_REGISTERS; i++)
     {
-        if ((usedRegisters & (1 << i)) != 0)
+        if ((ctx->usedRegisters & (1 << i)) != 0)
         {
             num++;
         }
@@ -119,7 +185,7 @@ int Registers_GetNumUsedMasked(uint16_t mask)
     int num = 0;
     for (int i = 0; i < NUM_REGISTERS; i++)
     {
-        if ((usedRegisters & (1 << i)) && (mask & (1 << i)))
+        if ((ctx->usedRegisters & (1 << i)) && (mask & (1 << i)))
         {
             num++;
         }
@@ -131,7 +197,7 @@ int Registers_GetNumFree()
     int num = 0;
     for (int i = 0; i < NUM_REGISTERS; i++)
     {
-        if ((usedRegisters & (1 << i)) == 0)
+        if ((ctx->usedRegisters & (1 << i)) == 0)
         {
             num++;
         }
@@ -145,15 +211,15 @@ void Registers_Pop(uint16_t pushedRegisters, int fromAddr)
     {
         if ((pushedRegisters & (1 << i)) != 0)
         {
-            OutWrite("mov r%i, [sp-%u]\n", i, offset++);
+            IR_EmitMove(IR_Mov, IR_Register(i), IR_Stack(offset++));
 
             // check if any of the lower bits are set
             // if so, another register is going to be popped,
             // so we need to generate a nop
-            // if ((usedRegisters & ((1 << i) - 1)) != 0) OutWrite("nop\n");
+            // if ((ctx->usedRegisters & ((1 << i) - 1)) != 0) OutWrite("nop\n");
         }
     }
-    usedRegisters |= pushedRegisters;
+    ctx->usedRegisters |= pushedRegisters;
     // OutWrite("sub sp, %i\n", offset - 1);
     // OffsetStackPointer((offset - 1));
 }
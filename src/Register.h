@@ -13,10 +13,17 @@ enum Register
 	Register_R7 = 7,
 	Register_IP = 8,
 	Register_SP = 9,
+	// Handed out when all machine registers are used. They are assigned a machine
+	// register or a stack slot once the code of the function is complete (Allocator.h).
+	Register_Virtual = 16,
+	// All register numbers are below this
+	Register_End = 64,
 };
 
 int16_t Registers_GetUsed();
 int Registers_GetFree();
+// A virtual register even if machine registers are free, for values the allocator places
+int Registers_GetVirtual();
 void Register_Free(int r);
 void Register_GetSpecific(int r);
 void Registers_FreeAll();
@@ -28,3 +35,13 @@ int Registers_GetNumFree();
 int Registers_GetNumPreferred();
 void Registers_Pop(uint16_t pushedRegisters, int fromAddr);
 void Registers_SetPreferred(const uint16_t* prefRegs);
+
+#ifndef CUSTOM_COMP
+typedef struct RegisterContext RegisterContext;
+#endif
+#ifdef CUSTOM_COMP
+typedef struct RegisterContext {} RegisterContext;
+#endif
+RegisterContext* Registers_CreateContext();
+void Registers_DisposeContext(RegisterContext* context);
+void Registers_UseContext(RegisterContext* context);
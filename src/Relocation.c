@@ -0,0 +1,113 @@
+#include "Relocation.h"
+#include "Data.h"
+
+// Only workers record, and they have a single thread
+static RelocationInfo* recording = NULL;
+static size_t dataBase = 0;
+
+RelocationInfo RelocationInfo_Create()
+{
+    RelocationInfo info;
+    info.relocations = GenericList_Create(sizeof(Relocation));
+    info.maxDelta = 0x7FFFFFFF;
+    info.excludedDeltas = GenericList_Create(sizeof(int32_t));
+    return info;
+}
+
+void RelocationInfo_Dispose(RelocationInfo* info)
+{
+    GenericList_Dispose(&info->relocations);
+    GenericList_Dispose(&info->excludedDeltas);
+}
+
+bool RelocationInfo_Holds(const RelocationInfo* info, int32_t delta)
+{
+    if (delta < 0 || delta > info->maxDelta)
+        return false;
+    for (size_t i = 0; i < info->excludedDeltas.count; i++)
+        if (*(int32_t*)GenericList_At(&info->excludedDeltas, i) == delta)
+            return false;
+    return true;
+}
+
+void Relocation_Begin(RelocationInfo* info)
+{
+    recording = info;
+    dataBase = GetGlobalDataIndex();
+}
+
+void Relocation_End()
+{
+    recording = NULL;
+}
+
+bool Relocation_IsRecording()
+{
+    return recording != NULL;
+}
+
+static void Add(RelocationKind kind, size_t offset)
+{
+    Relocation relocation;
+    relocation.kind = (uint32_t)kind;
+    relocation.offset = (uint32_t)offset;
+    GenericList_Append(&recording->relocations, &relocation);
+}
+
+void Relocation_AddText(RelocationKind kind, size_t offset)
+{
+    if (recording != NULL)
+        Add(kind, offset);
+}
+
+void Relocation_AddDataWord()
+{
+    if (recording != NULL)
+        Add(Relocation_Data, GetGlobalDataIndex() - dataBase);
+}
+
+void Relocation_AssumeFixed()
+{
+    if (recording != NULL)
+        recording->maxDelta = 0;
+}
+
+void Relocation_AssumeAtMost(int32_t address, int32_t limit)
+{
+    if (recording != NULL && limit - address < recording->maxDelta)
+        recording->maxDelta = limit - address;
+}
+
+// The word, a data address of the unit, must not become value
+static void Exclude(int32_t word, int32_t value)
+{
+    int32_t delta = (value - word) & 0xFFFF;
+    if (delta == 0)
+    {
+        Relocation_AssumeFixed();
+        return;
+    }
+    for (size_t i = 0; i < recording->excludedDeltas.count; i++)
+        if (*(int32_t*)GenericList_At(&recording->excludedDeltas, i) == delta)
+            return;
+    GenericList_Append(&recording->excludedDeltas, &delta);
+}
+
+bool Relocation_Equal(int32_t a, bool aRelative, int32_t b, bool bRelative)
+{
+    if (recording != NULL && aRelative != bRelative)
+    {
+        if (aRelative)
+            Exclude(a, b);
+        else
+            Exclude(b, a);
+    }
+    return a == b;
+}
+
+bool Relocation_IsZero(int32_t word, bool relative)
+{
+    if (recording != NULL && relative)
+        Exclude(word, (int32_t)0);
+    return word == 0;
+}
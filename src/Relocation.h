@@ -0,0 +1,61 @@
+#pragma once
+#include "GenericList.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Workers (Parallel.h) compile each unit once, with the data address and label id the batch
+// starts with, and the parent moves the output to where the unit really starts. While recording,
+// addresses of data the unit allocates are marked (dataRelative in Value and IROperand), and the
+// output records where numbers derived from them and the ids of generated labels end up.
+// Some code depends on the value of an address, like whether it fits into 8 bits. The output
+// also records what it assumes about the addresses, so the parent knows which moves it survives.
+
+typedef enum
+{
+    // Decimal data address in the text, at a byte offset
+    Relocation_Text,
+    // Decimal label id in the text, at a byte offset
+    Relocation_Label,
+    // Word of data holding a data address, at a word offset
+    Relocation_Data,
+} RelocationKind;
+
+typedef struct
+{
+    uint32_t kind;
+    uint32_t offset;
+} Relocation;
+
+typedef struct
+{
+    GenericList relocations;
+    // The output stays the same when the data moves up by at most maxDelta words,
+    // except by the excluded deltas (int32_t)
+    int32_t maxDelta;
+    GenericList excludedDeltas;
+} RelocationInfo;
+
+RelocationInfo RelocationInfo_Create();
+void RelocationInfo_Dispose(RelocationInfo* info);
+// Whether the output the info was recorded for is right after moving its data up by delta words
+bool RelocationInfo_Holds(const RelocationInfo* info, int32_t delta);
+
+// Records into info until Relocation_End. Data allocated from now on belongs to the unit,
+// data offsets are relative to the current data address.
+void Relocation_Begin(RelocationInfo* info);
+void Relocation_End();
+bool Relocation_IsRecording();
+// A data address or label id is printed at offset of the text
+void Relocation_AddText(RelocationKind kind, size_t offset);
+// The next word of data that is allocated holds a data address of the unit
+void Relocation_AddDataWord();
+
+// The output assumes that the data of the unit doesn't move
+void Relocation_AssumeFixed();
+// ... that address, a data address of the unit, stays at most limit
+void Relocation_AssumeAtMost(int32_t address, int32_t limit);
+// Compares two words that may be data addresses of the unit, and records what the result assumes
+bool Relocation_Equal(int32_t a, bool aRelative, int32_t b, bool bRelative);
+// Whether word is zero, recording what the result assumes
+bool Relocation_IsZero(int32_t word, bool relative);
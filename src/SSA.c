@@ -0,0 +1,604 @@
+#include "SSA.h"
+#include "Util.h"
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+static IRInstruction* Instruction(IRFunction* function, size_t i)
+{
+    return GenericList_At(&function->instructions, i);
+}
+
+static IRBlock* Block(IRFunction* function, size_t i)
+{
+    return GenericList_At(&function->blocks, i);
+}
+
+static bool IsReturn(const IRInstruction* inst)
+{
+    return inst->op == IR_Mov && inst->dst.type == IROperand_IP && inst->b.type == IROperand_Stack;
+}
+
+static bool IsSingleJump(IRFunction* function, size_t block)
+{
+    IRBlock* b = Block(function, block);
+    if (b->end - b->first != 1)
+        return false;
+    IRInstruction* inst = Instruction(function, b->first);
+    return inst->op == IR_Jump && inst->flag == Flag_None;
+}
+
+static void AddEdge(SSA* ssa, size_t from, size_t to)
+{
+    SSAEdge edge;
+    edge.from = from;
+    edge.to = to;
+    GenericList_Append(&ssa->edges, &edge);
+}
+
+// Fails for jumps to labels outside of the function
+static bool BuildEdges(SSA* ssa)
+{
+    IRFunction* function = ssa->function;
+
+    // Labels always start a block
+    size_t numLabels = 0;
+    for (size_t i = 0; i < function->instructions.count; i++)
+    {
+        IRInstruction* inst = Instruction(function, i);
+        if ((inst->op == IR_Label || inst->op == IR_Jump) && (size_t)inst->a.value + 1 > numLabels)
+            numLabels = (size_t)inst->a.value + 1;
+    }
+    size_t* labelBlock = xmalloc((numLabels + 1) * sizeof(size_t));
+    for (size_t i = 0; i < numLabels; i++)
+        labelBlock[i] = SIZE_MAX;
+    for (size_t i = 0; i < function->instructions.count; i++)
+    {
+        IRInstruction* inst = Instruction(function, i);
+        if (inst->op == IR_Label)
+            labelBlock[(size_t)inst->a.value] = ssa->blockOfInstruction[i];
+    }
+
+    for (size_t b = 0; b < ssa->numBlocks; b++)
+    {
+        ssa->blocks[b].firstSucc = ssa->edges.count;
+        IRBlock* block = Block(function, b);
+        bool hasNext = b + 1 < ssa->numBlocks;
+        IRInstruction* last = NULL;
+        if (block->end != block->first)
+            last = Instruction(function, block->end - 1);
+
+        if (last != NULL && last->op == IR_Jump)
+        {
+            if (labelBlock[(size_t)last->a.value] == SIZE_MAX)
+            {
+                free(labelBlock);
+                return false;
+            }
+            AddEdge(ssa, b, labelBlock[(size_t)last->a.value]);
+            if (last->flag != Flag_None && hasNext)
+                AddEdge(ssa, b, b + 1);
+        }
+        else if (last != NULL && last->op <= IR_Not && last->dst.type == IROperand_IP)
+        {
+            size_t next = b + 1;
+            if (!IsReturn(last))
+            {
+                // Any entry of the jump table that follows
+                while (next < ssa->numBlocks && IsSingleJump(function, next))
+                    AddEdge(ssa, b, next++);
+            }
+            if (last->flag != Flag_None && next == b + 1 && hasNext)
+                AddEdge(ssa, b, b + 1);
+        }
+        else if (hasNext)
+            AddEdge(ssa, b, b + 1);
+
+        ssa->blocks[b].numSuccs = ssa->edges.count - ssa->blocks[b].firstSucc;
+    }
+    free(labelBlock);
+
+    size_t numEdges = ssa->edges.count;
+    ssa->succEdges = xmalloc((numEdges + 1) * sizeof(size_t));
+    ssa->predEdges = xmalloc((numEdges + 1) * sizeof(size_t));
+    for (size_t e = 0; e < numEdges; e++)
+    {
+        ssa->succEdges[e] = e;
+        ssa->blocks[SSA_Edge(ssa, e)->to].numPreds++;
+    }
+    size_t first = 0;
+    for (size_t b = 0; b < ssa->numBlocks; b++)
+    {
+        ssa->blocks[b].firstPred = first;
+        first += ssa->blocks[b].numPreds;
+        ssa->blocks[b].numPreds = 0;
+    }
+    for (size_t e = 0; e < numEdges; e++)
+    {
+        SSABlock* to = &ssa->blocks[SSA_Edge(ssa, e)->to];
+        ssa->predEdges[to->firstPred + to->numPreds] = e;
+        to->numPreds++;
+    }
+    return true;
+}
+
+static void ComputeOrder(SSA* ssa)
+{
+    size_t* stack = xmalloc((ssa->numBlocks + 1) * sizeof(size_t));
+    size_t* nextSucc = xmalloc((ssa->numBlocks + 1) * sizeof(size_t));
+    size_t* postorder = xmalloc((ssa->numBlocks + 1) * sizeof(size_t));
+    size_t numPostorder = 0;
+    size_t depth = 0;
+
+    ssa->blocks[0].reachable = true;
+    stack[depth] = 0;
+    nextSucc[depth] = 0;
+    depth++;
+    while (depth != 0)
+    {
+        SSABlock* block = &ssa->blocks[stack[depth - 1]];
+        if (nextSucc[depth - 1] == block->numSuccs)
+        {
+            postorder[numPostorder++] = stack[depth - 1];
+            depth--;
+            continue;
+        }
+        size_t to = SSA_Edge(ssa, ssa->succEdges[block->firstSucc + nextSucc[depth - 1]])->to;
+        nextSucc[depth - 1]++;
+        if (!ssa->blocks[to].reachable)
+        {
+            ssa->blocks[to].reachable = true;
+            stack[depth] = to;
+            nextSucc[depth] = 0;
+            depth++;
+        }
+    }
+
+    ssa->order = xmalloc((numPostorder + 1) * sizeof(size_t));
+    ssa->numOrdered = numPostorder;
+    for (size_t i = 0; i < numPostorder; i++)
+        ssa->order[i] = postorder[numPostorder - 1 - i];
+    free(stack);
+    free(nextSucc);
+    free(postorder);
+}
+
+static size_t Intersect(SSA* ssa, const size_t* orderIndex, size_t a, size_t b)
+{
+    while (a != b)
+    {
+        while (orderIndex[a] > orderIndex[b])
+            a = ssa->blocks[a].idom;
+        while (orderIndex[b] > orderIndex[a])
+            b = ssa->blocks[b].idom;
+    }
+    return a;
+}
+
+// Cooper, Harvey and Kennedy, "A Simple, Fast Dominance Algorithm"
+static void ComputeDominators(SSA* ssa)
+{
+    size_t* orderIndex = xmalloc((ssa->numBlocks + 1) * sizeof(size_t));
+    for (size_t b = 0; b < ssa->numBlocks; b++)
+        ssa->blocks[b].idom = SIZE_MAX;
+    for (size_t i = 0; i < ssa->numOrdered; i++)
+        orderIndex[ssa->order[i]] = i;
+    ssa->blocks[0].idom = 0;
+
+    bool changed = true;
+    while (changed)
+    {
+        changed = false;
+        for (size_t i = 1; i < ssa->numOrdered; i++)
+        {
+            SSABlock* block = &ssa->blocks[ssa->order[i]];
+            size_t idom = SIZE_MAX;
+            for (size_t p = 0; p < block->numPreds; p++)
+            {
+                size_t pred = SSA_Edge(ssa, ssa->predEdges[block->firstPred + p])->from;
+                if (ssa->blocks[pred].idom == SIZE_MAX)
+                    continue;
+                idom = idom == SIZE_MAX ? pred : Intersect(ssa, orderIndex, pred, idom);
+            }
+            if (block->idom != idom)
+            {
+                block->idom = idom;
+                changed = true;
+            }
+        }
+    }
+    ssa->blocks[0].idom = SIZE_MAX;
+    free(orderIndex);
+}
+
+static bool CallClobbers(SSA* ssa, const IRInstruction* inst, int location)
+{
+    if (location == ssa->flagsLocation)
+        return true;
+    // Virtual registers aren't assigned yet, they are kept out of the registers calls modify
+    if (location >= IR_NUM_PHYSICAL_REGISTERS)
+        return false;
+    // The registers a function modifies aren't complete while its own code is generated
+    if (inst->a.type == IROperand_Label)
+    {
+        const char* name = IR_LabelName(inst->a.value);
+        if (name[0] == '_' && strcmp(name + 1, ssa->function->name) == 0)
+            return true;
+    }
+    return ((int)inst->clobbers & (1 << location)) != 0;
+}
+
+static bool Defines(SSA* ssa, const IRInstruction* inst, int location)
+{
+    if (inst->op == IR_Call)
+        return CallClobbers(ssa, inst, location);
+    if (inst->op > IR_Not)
+        return false;
+    if (location == ssa->flagsLocation)
+        return inst->op != IR_Mov;
+    return inst->dst.type == IROperand_Register && inst->dst.value == (int32_t)location;
+}
+
+static int32_t NewValue(SSA* ssa, SSAValueKind kind, int location, size_t inst)
+{
+    SSAValue value;
+    memset(&value, 0, sizeof(SSAValue));
+    value.kind = kind;
+    value.location = location;
+    value.inst = inst;
+    GenericList_Append(&ssa->values, &value);
+    return (int32_t)(ssa->values.count - 1);
+}
+
+// Pruning isn't needed, dead code elimination removes phis nothing reads
+static int32_t* PlacePhis(SSA* ssa)
+{
+    int numLocations = ssa->numLocations;
+    size_t numBlocks = ssa->numBlocks;
+
+    GenericList* frontiers = xmalloc((numBlocks + 1) * sizeof(GenericList));
+    for (size_t b = 0; b < numBlocks; b++)
+        frontiers[b] = GenericList_Create(sizeof(size_t));
+    for (size_t i = 0; i < ssa->numOrdered; i++)
+    {
+        size_t b = ssa->order[i];
+        SSABlock* block = &ssa->blocks[b];
+        // Code may jump back to the start of the function, which is also entered from outside
+        if (block->numPreds + (b == 0 ? 1 : 0) < 2)
+            continue;
+        for (size_t p = 0; p < block->numPreds; p++)
+        {
+            size_t runner = SSA_Edge(ssa, ssa->predEdges[block->firstPred + p])->from;
+            if (!ssa->blocks[runner].reachable)
+                continue;
+            while (runner != block->idom)
+            {
+                GenericList* frontier = &frontiers[runner];
+                if (frontier->count == 0 || *(size_t*)GenericList_At(frontier, frontier->count - 1) != b)
+                    GenericList_Append(frontier, &b);
+                runner = ssa->blocks[runner].idom;
+            }
+        }
+    }
+
+    int32_t* phis = xmalloc((numBlocks * (size_t)numLocations + 1) * sizeof(int32_t));
+    for (size_t i = 0; i < numBlocks * (size_t)numLocations; i++)
+        phis[i] = -1;
+
+    size_t* work = xmalloc((numBlocks + 1) * sizeof(size_t));
+    size_t* queuedFor = xmalloc((numBlocks + 1) * sizeof(size_t));
+    for (int loc = 0; loc < numLocations; loc++)
+    {
+        size_t numWork = 0;
+        for (size_t b = 0; b < numBlocks; b++)
+        {
+            queuedFor[b] = SIZE_MAX;
+            if (!ssa->blocks[b].reachable)
+                continue;
+            IRBlock* block = Block(ssa->function, b);
+            for (size_t i = block->first; i < block->end; i++)
+            {
+                if (Defines(ssa, Instruction(ssa->function, i), loc))
+                {
+                    work[numWork++] = b;
+                    queuedFor[b] = (size_t)loc;
+                    break;
+                }
+            }
+        }
+
+        while (numWork != 0)
+        {
+            GenericList* frontier = &frontiers[work[--numWork]];
+            for (size_t j = 0; j < frontier->count; j++)
+            {
+                size_t y = *(size_t*)GenericList_At(frontier, j);
+                if (phis[y * (size_t)numLocations + (size_t)loc] != -1)
+                    continue;
+
+                int32_t phi = NewValue(ssa, SSAValue_Phi, loc, SIZE_MAX);
+                SSAValue* value = SSA_Value(ssa, phi);
+                value->block = y;
+                value->firstArg = ssa->phiArgs.count;
+                int32_t none = -1;
+                for (size_t p = 0; p < SSA_NumPhiArgs(ssa, phi); p++)
+                    GenericList_Append(&ssa->phiArgs, &none);
+                phis[y * (size_t)numLocations + (size_t)loc] = phi;
+
+                if (queuedFor[y] != (size_t)loc)
+                {
+                    queuedFor[y] = (size_t)loc;
+                    work[numWork++] = y;
+                }
+            }
+        }
+    }
+
+    for (size_t b = 0; b < numBlocks; b++)
+        GenericList_Dispose(&frontiers[b]);
+    free(frontiers);
+    free(work);
+    free(queuedFor);
+    return phis;
+}
+
+static int32_t Use(SSA* ssa, int32_t value)
+{
+    SSA_Value(ssa, value)->numUses++;
+    return value;
+}
+
+static void ReadSlot(SSA* ssa, IRInstruction* inst, SSAInstruction* s, int slot, const int32_t* current)
+{
+    IROperand* op = IR_OperandAt(inst, slot);
+    if (op->type == IROperand_Register || op->type == IROperand_MemoryRegister)
+        s->use[slot] = Use(ssa, current[(size_t)op->value]);
+}
+
+static void RenameInstruction(SSA* ssa, size_t i, int32_t* current)
+{
+    IRInstruction* inst = Instruction(ssa->function, i);
+    SSAInstruction* s = &ssa->instructions[i];
+    int flags = ssa->flagsLocation;
+
+    if (inst->op == IR_Call)
+    {
+        ReadSlot(ssa, inst, s, IRSlot_A, current);
+        s->firstClobber = (int32_t)ssa->values.count;
+        for (int loc = 0; loc < ssa->numLocations; loc++)
+        {
+            if (CallClobbers(ssa, inst, loc))
+                current[loc] = NewValue(ssa, SSAValue_Unknown, loc, i);
+        }
+        return;
+    }
+    if (inst->op == IR_Jump && inst->flag != Flag_None)
+        s->flagsUse = Use(ssa, current[flags]);
+    if (inst->op > IR_Not)
+        return;
+
+    if (inst->flag != Flag_None)
+        s->flagsUse = Use(ssa, current[flags]);
+    if (inst->dst.type == IROperand_MemoryRegister || (inst->dst.type == IROperand_Register && inst->flag != Flag_None))
+        ReadSlot(ssa, inst, s, IRSlot_Dst, current);
+    if (inst->op != IR_Mov && inst->op != IR_Not)
+        ReadSlot(ssa, inst, s, IRSlot_A, current);
+    ReadSlot(ssa, inst, s, IRSlot_B, current);
+
+    if (inst->dst.type == IROperand_Register)
+    {
+        s->def = NewValue(ssa, SSAValue_Instruction, (int)inst->dst.value, i);
+        current[(size_t)inst->dst.value] = s->def;
+    }
+    if (inst->op != IR_Mov)
+    {
+        s->flagsDef = NewValue(ssa, SSAValue_Instruction, flags, i);
+        current[flags] = s->flagsDef;
+    }
+}
+
+typedef struct
+{
+    int32_t* phis;
+    size_t* predIndex;
+    size_t* firstChild;
+    size_t* nextSibling;
+} RenameState;
+
+static void Rename(SSA* ssa, RenameState* state, size_t b, const int32_t* inherited)
+{
+    size_t numLocations = (size_t)ssa->numLocations;
+    int32_t* current = xmalloc(numLocations * sizeof(int32_t));
+    memcpy(current, inherited, numLocations * sizeof(int32_t));
+    for (size_t loc = 0; loc < numLocations; loc++)
+    {
+        if (state->phis[b * numLocations + loc] != -1)
+            current[loc] = state->phis[b * numLocations + loc];
+    }
+    memcpy(&ssa->entryValues[b * numLocations], current, numLocations * sizeof(int32_t));
+
+    IRBlock* block = Block(ssa->function, b);
+    for (size_t i = block->first; i < block->end; i++)
+        RenameInstruction(ssa, i, current);
+
+    SSABlock* ssaBlock = &ssa->blocks[b];
+    for (size_t s = 0; s < ssaBlock->numSuccs; s++)
+    {
+        size_t edge = ssa->succEdges[ssaBlock->firstSucc + s];
+        size_t to = SSA_Edge(ssa, edge)->to;
+        for (size_t loc = 0; loc < numLocations; loc++)
+        {
+            int32_t phi = state->phis[to * numLocations + loc];
+            if (phi == -1)
+                continue;
+            size_t arg = SSA_Value(ssa, phi)->firstArg + state->predIndex[edge];
+            *(int32_t*)GenericList_At(&ssa->phiArgs, arg) = Use(ssa, current[loc]);
+        }
+    }
+
+    for (size_t child = state->firstChild[b]; child != SIZE_MAX; child = state->nextSibling[child])
+        Rename(ssa, state, child, current);
+    free(current);
+}
+
+SSA* SSA_Build(IRFunction* function)
+{
+    if (IR_DependsOnAddresses(function))
+        return NULL;
+
+    SSA* ssa = xmalloc(sizeof(SSA));
+    memset(ssa, 0, sizeof(SSA));
+    ssa->function = function;
+    ssa->numBlocks = function->blocks.count;
+    ssa->edges = GenericList_Create(sizeof(SSAEdge));
+    ssa->values = GenericList_Create(sizeof(SSAValue));
+    ssa->phiArgs = GenericList_Create(sizeof(int32_t));
+
+    size_t numInstructions = function->instructions.count;
+    int numRegisters = IR_NUM_PHYSICAL_REGISTERS;
+    for (size_t i = 0; i < numInstructions; i++)
+    {
+        IRInstruction* inst = Instruction(function, i);
+        for (int slot = IRSlot_Dst; slot <= IRSlot_B; slot++)
+        {
+            IROperand* op = IR_OperandAt(inst, slot);
+            if ((op->type == IROperand_Register || op->type == IROperand_MemoryRegister) && (int)op->value >= numRegisters)
+                numRegisters = (int)op->value + 1;
+        }
+    }
+    ssa->numLocations = numRegisters + 1;
+    ssa->flagsLocation = numRegisters;
+
+    ssa->blocks = xmalloc((ssa->numBlocks + 1) * sizeof(SSABlock));
+    memset(ssa->blocks, 0, (ssa->numBlocks + 1) * sizeof(SSABlock));
+    ssa->blockOfInstruction = xmalloc((numInstructions + 1) * sizeof(size_t));
+    for (size_t b = 0; b < ssa->numBlocks; b++)
+    {
+        IRBlock* block = Block(function, b);
+        for (size_t i = block->first; i < block->end; i++)
+            ssa->blockOfInstruction[i] = b;
+    }
+    ssa->instructions = xmalloc((numInstructions + 1) * sizeof(SSAInstruction));
+    for (size_t i = 0; i < numInstructions; i++)
+    {
+        SSAInstruction* s = &ssa->instructions[i];
+        s->use[0] = -1;
+        s->use[1] = -1;
+        s->use[2] = -1;
+        s->def = -1;
+        s->flagsUse = -1;
+        s->flagsDef = -1;
+        s->firstClobber = -1;
+    }
+
+    if (!BuildEdges(ssa))
+    {
+        SSA_Dispose(ssa);
+        return NULL;
+    }
+    ComputeOrder(ssa);
+    ComputeDominators(ssa);
+
+    size_t numLocations = (size_t)ssa->numLocations;
+    ssa->entryValues = xmalloc((ssa->numBlocks * numLocations + 1) * sizeof(int32_t));
+    for (size_t i = 0; i < ssa->numBlocks * numLocations; i++)
+        ssa->entryValues[i] = -1;
+
+    RenameState state;
+    state.phis = PlacePhis(ssa);
+    state.predIndex = xmalloc((ssa->edges.count + 1) * sizeof(size_t));
+    state.firstChild = xmalloc((ssa->numBlocks + 1) * sizeof(size_t));
+    state.nextSibling = xmalloc((ssa->numBlocks + 1) * sizeof(size_t));
+    for (size_t b = 0; b < ssa->numBlocks; b++)
+    {
+        SSABlock* block = &ssa->blocks[b];
+        for (size_t p = 0; p < block->numPreds; p++)
+            state.predIndex[ssa->predEdges[block->firstPred + p]] = p;
+        state.firstChild[b] = SIZE_MAX;
+        state.nextSibling[b] = SIZE_MAX;
+    }
+    // Reverse order, so children are renamed in the order of the code
+    for (size_t i = ssa->numOrdered; i > 1; i--)
+    {
+        size_t b = ssa->order[i - 1];
+        size_t idom = ssa->blocks[b].idom;
+        state.nextSibling[b] = state.firstChild[idom];
+        state.firstChild[idom] = b;
+    }
+
+    int32_t* entry = xmalloc(numLocations * sizeof(int32_t));
+    for (size_t loc = 0; loc < numLocations; loc++)
+    {
+        entry[loc] = NewValue(ssa, SSAValue_Unknown, (int)loc, SIZE_MAX);
+        int32_t phi = state.phis[loc];
+        if (phi != -1)
+        {
+            size_t arg = SSA_Value(ssa, phi)->firstArg + ssa->blocks[0].numPreds;
+            *(int32_t*)GenericList_At(&ssa->phiArgs, arg) = Use(ssa, entry[loc]);
+        }
+    }
+    Rename(ssa, &state, 0, entry);
+
+    free(entry);
+    free(state.phis);
+    free(state.predIndex);
+    free(state.firstChild);
+    free(state.nextSibling);
+    return ssa;
+}
+
+void SSA_Dispose(SSA* ssa)
+{
+    free(ssa->blocks);
+    GenericList_Dispose(&ssa->edges);
+    free(ssa->predEdges);
+    free(ssa->succEdges);
+    free(ssa->order);
+    free(ssa->blockOfInstruction);
+    free(ssa->instructions);
+    GenericList_Dispose(&ssa->values);
+    GenericList_Dispose(&ssa->phiArgs);
+    free(ssa->entryValues);
+    free(ssa);
+}
+
+SSAValue* SSA_Value(SSA* ssa, int32_t value)
+{
+    return GenericList_At(&ssa->values, (size_t)value);
+}
+
+size_t SSA_NumPhiArgs(SSA* ssa, int32_t phi)
+{
+    SSAValue* value = SSA_Value(ssa, phi);
+    return ssa->blocks[value->block].numPreds + (value->block == 0 ? 1 : 0);
+}
+
+SSAEdge* SSA_Edge(SSA* ssa, size_t edge)
+{
+    return GenericList_At(&ssa->edges, edge);
+}
+
+int32_t SSA_ValueBefore(SSA* ssa, int location, size_t inst)
+{
+    size_t b = ssa->blockOfInstruction[inst];
+    assert(ssa->blocks[b].reachable);
+    IRBlock* block = Block(ssa->function, b);
+
+    for (size_t j = inst; j > block->first; j--)
+    {
+        SSAInstruction* s = &ssa->instructions[j - 1];
+        if (s->firstClobber != -1)
+        {
+            for (int32_t v = s->firstClobber; (size_t)v < ssa->values.count && SSA_Value(ssa, v)->inst == j - 1; v++)
+            {
+                if (SSA_Value(ssa, v)->location == location)
+                    return v;
+            }
+        }
+        if (location == ssa->flagsLocation && s->flagsDef != -1)
+            return s->flagsDef;
+        if (s->def != -1 && SSA_Value(ssa, s->def)->location == location)
+            return s->def;
+    }
+    return ssa->entryValues[b * (size_t)ssa->numLocations + (size_t)location];
+}
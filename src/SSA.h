@@ -0,0 +1,99 @@
+#pragma once
+#include "GenericList.h"
+#include "IR.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Static single assignment view of an IRFunction. The code keeps using machine registers,
+// but every write to a register or the flags defines a new value, and phis merge the values
+// reaching a block from its predecessors. Locations are the register numbers, followed by
+// the flags at ssa->flagsLocation.
+
+typedef enum
+{
+    // Contents at function entry, or of a location clobbered by the call inst
+    SSAValue_Unknown,
+    // Written by instruction inst
+    SSAValue_Instruction,
+    SSAValue_Phi,
+} SSAValueKind;
+
+typedef struct
+{
+    SSAValueKind kind;
+    int location;
+    // SIZE_MAX for the contents at entry
+    size_t inst;
+    // For phis: the block, and its arguments at phiArgs[firstArg...] in order of the predecessors.
+    // Arguments from unreachable predecessors are -1. Phis of the first block have
+    // the contents at function entry as an additional last argument.
+    size_t block;
+    size_t firstArg;
+    // Number of reads by instructions and phis
+    size_t numUses;
+} SSAValue;
+
+typedef struct
+{
+    // Value read through each operand slot: the register operand, or the register of [r].
+    // The dst slot of a conditional instruction reads the value it may keep. -1 for none.
+    int32_t use[3];
+    // Value written to the dst register, -1 for none
+    int32_t def;
+    int32_t flagsUse;
+    int32_t flagsDef;
+    // Values of the clobbered locations of a call, consecutive in location order
+    int32_t firstClobber;
+} SSAInstruction;
+
+typedef struct
+{
+    size_t from;
+    size_t to;
+} SSAEdge;
+
+typedef struct
+{
+    // Indices into ssa->predEdges and ssa->succEdges. A conditional jump has
+    // the jump target as its first successor and the next block as its second.
+    size_t firstPred;
+    size_t numPreds;
+    size_t firstSucc;
+    size_t numSuccs;
+    // Immediate dominator, SIZE_MAX for the entry and unreachable blocks
+    size_t idom;
+    bool reachable;
+} SSABlock;
+
+typedef struct
+{
+    IRFunction* function;
+    int numLocations;
+    int flagsLocation;
+    size_t numBlocks;
+    SSABlock* blocks;
+    GenericList edges;
+    size_t* predEdges;
+    size_t* succEdges;
+    // Reachable blocks in reverse postorder
+    size_t* order;
+    size_t numOrdered;
+    size_t* blockOfInstruction;
+    SSAInstruction* instructions;
+    GenericList values;
+    GenericList phiArgs;
+    // Value of each location at the start of each block, after its phis
+    int32_t* entryValues;
+} SSA;
+
+// Returns NULL for functions that can't be analyzed: with inline assembly, jumps out of the
+// function, or code that depends on instruction addresses other than switch jump tables.
+SSA* SSA_Build(IRFunction* function);
+void SSA_Dispose(SSA* ssa);
+
+SSAValue* SSA_Value(SSA* ssa, int32_t value);
+size_t SSA_NumPhiArgs(SSA* ssa, int32_t phi);
+SSAEdge* SSA_Edge(SSA* ssa, size_t edge);
+// Value of location right before instruction inst, which has to be in a reachable block
+int32_t SSA_ValueBefore(SSA* ssa, int location, size_t inst);
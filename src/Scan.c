@@ -0,0 +1,176 @@
+#include "Scan.h"
+#include <ctype.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#ifndef CUSTOM_COMP
+#ifdef __SSE2__
+#define SCAN_SSE2
+#include <emmintrin.h>
+#endif
+#endif
+
+static bool IsIdentifierChar(char c)
+{
+    return isalpha(c) || isdigit(c) || c == '_';
+}
+
+static bool IsStringBodyChar(char c)
+{
+    return c != '\"' && c != '\\' && c != '\n';
+}
+
+#ifdef SCAN_SSE2
+// Each of these returns a 16 bit mask with one bit per byte of the chunk. Bytes
+// outside of ASCII are negative when compared as signed, so they never match.
+static inline int WhitespaceMask(__m128i chunk)
+{
+    // ' ' or '\t' through '\r'
+    __m128i control = _mm_and_si128(_mm_cmpgt_epi8(chunk, _mm_set1_epi8('\t' - 1)),
+                                    _mm_cmplt_epi8(chunk, _mm_set1_epi8('\r' + 1)));
+    return _mm_movemask_epi8(_mm_or_si128(control, _mm_cmpeq_epi8(chunk, _mm_set1_epi8(' '))));
+}
+
+static inline int IdentifierMask(__m128i chunk)
+{
+    __m128i lower = _mm_or_si128(chunk, _mm_set1_epi8(0x20));
+    __m128i letter = _mm_and_si128(_mm_cmpgt_epi8(lower, _mm_set1_epi8('a' - 1)),
+                                   _mm_cmplt_epi8(lower, _mm_set1_epi8('z' + 1)));
+    __m128i digit = _mm_and_si128(_mm_cmpgt_epi8(chunk, _mm_set1_epi8('0' - 1)),
+                                  _mm_cmplt_epi8(chunk, _mm_set1_epi8('9' + 1)));
+    __m128i underscore = _mm_cmpeq_epi8(chunk, _mm_set1_epi8('_'));
+    return _mm_movemask_epi8(_mm_or_si128(_mm_or_si128(letter, digit), underscore));
+}
+
+static inline int ByteMask(__m128i chunk, char c)
+{
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, _mm_set1_epi8(c)));
+}
+
+static inline __m128i Load(const char* code, size_t i)
+{
+    return _mm_loadu_si128((const __m128i*)(code + i));
+}
+
+// Bits of mask below bit n
+static inline int Below(int mask, int n)
+{
+    return mask & ((1 << n) - 1);
+}
+#endif
+
+size_t Scan_Whitespace(const char* code, size_t length, size_t i, int* newlines)
+{
+    int count = 0;
+#ifdef SCAN_SSE2
+    while (i + 16 <= length)
+    {
+        __m128i chunk = Load(code, i);
+        int end = ~WhitespaceMask(chunk) & 0xFFFF;
+        int lineFeeds = ByteMask(chunk, '\n');
+        if (end != 0)
+        {
+            int n = __builtin_ctz((unsigned)end);
+            *newlines += count + __builtin_popcount((unsigned)Below(lineFeeds, n));
+            return i + (size_t)n;
+        }
+        count += __builtin_popcount((unsigned)lineFeeds);
+        i += 16;
+    }
+#endif
+    while (i < length && isspace(code[i]))
+    {
+        if (code[i] == '\n')
+            count++;
+        i++;
+    }
+    *newlines += count;
+    return i;
+}
+
+size_t Scan_Identifier(const char* code, size_t length, size_t i)
+{
+#ifdef SCAN_SSE2
+    while (i + 16 <= length)
+    {
+        int end = ~IdentifierMask(Load(code, i)) & 0xFFFF;
+        if (end != 0)
+            return i + (size_t)__builtin_ctz((unsigned)end);
+        i += 16;
+    }
+#endif
+    while (i < length && IsIdentifierChar(code[i]))
+        i++;
+    return i;
+}
+
+size_t Scan_LineComment(const char* code, size_t length, size_t i)
+{
+#ifdef SCAN_SSE2
+    while (i + 16 <= length)
+    {
+        int end = ByteMask(Load(code, i), '\n');
+        if (end != 0)
+            return i + (size_t)__builtin_ctz((unsigned)end);
+        i += 16;
+    }
+#endif
+    while (i < length && code[i] != '\n')
+        i++;
+    return i;
+}
+
+size_t Scan_BlockComment(const char* code, size_t length, size_t i, int* newlines)
+{
+    int count = 0;
+#ifdef SCAN_SSE2
+    while (i + 16 <= length)
+    {
+        __m128i chunk = Load(code, i);
+        int slashes = ByteMask(chunk, '/');
+        int lineFeeds = ByteMask(chunk, '\n');
+        while (slashes != 0)
+        {
+            int n = __builtin_ctz((unsigned)slashes);
+            // i is behind the opening "/*", so code[i - 1] is always valid
+            if (code[i + (size_t)n - 1] == '*')
+            {
+                *newlines += count + __builtin_popcount((unsigned)Below(lineFeeds, n));
+                return i + (size_t)n + 1;
+            }
+            slashes &= slashes - 1;
+        }
+        count += __builtin_popcount((unsigned)lineFeeds);
+        i += 16;
+    }
+#endif
+    while (i < length && !(code[i] == '/' && code[i - 1] == '*'))
+    {
+        if (code[i] == '\n')
+            count++;
+        i++;
+    }
+    *newlines += count;
+    if (i < length)
+        i++;
+    return i;
+}
+
+size_t Scan_StringBody(const char* code, size_t length, size_t i)
+{
+#ifdef SCAN_SSE2
+    while (i + 16 <= length)
+    {
+        __m128i chunk = Load(code, i);
+        int end = ByteMask(chunk, '\"') | ByteMask(chunk, '\\') | ByteMask(chunk, '\n');
+        if (end != 0)
+            return i + (size_t)__builtin_ctz((unsigned)end);
+        i += 16;
+    }
+#endif
+    while (i < length && IsStringBodyChar(code[i]))
+        i++;
+    return i;
+}
@@ -0,0 +1,18 @@
+#pragma once
+#include <stddef.h>
+
+// Scanning of character runs for the lexer. All functions start at index i and
+// return the index of the first character that is not part of the run (or length).
+// Uses SSE2 where available, with a scalar fallback otherwise.
+
+// Spaces, tabs and newlines. Adds the number of newlines in the run to *newlines.
+size_t Scan_Whitespace(const char* code, size_t length, size_t i, int* newlines);
+// Letters, digits and underscores.
+size_t Scan_Identifier(const char* code, size_t length, size_t i);
+// Body of a // comment, stops at the newline.
+size_t Scan_LineComment(const char* code, size_t length, size_t i);
+// Body of a /* comment, i points behind the opening "/*". Returns the index
+// behind the closing "*/" and adds the number of newlines in the comment to *newlines.
+size_t Scan_BlockComment(const char* code, size_t length, size_t i, int* newlines);
+// Plain characters of a string literal, stops at quotes, backslashes and newlines.
+size_t Scan_StringBody(const char* code, size_t length, size_t i);
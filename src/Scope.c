@@ -9,13 +9,12 @@
 
 #include <memory.h>
 
-// These following comparison methods are passed as arguments to GenericList_Find
+// These following comparison methods are passed as arguments to GenericList_Find.
+// All identifiers are interned by the lexer, so comparing pointers is sufficient.
 bool CompareVariableToID(const void* variable, const void* identifier)
 {
     Variable* var = (Variable*)variable;
-    char* id = (char*)identifier;
-
-    return strcmp(var->name, id) == 0;
+    return var->name == identifier;
 }
 
 static bool CompareVariableToValue(const void* variable, const void* value)
@@ -30,25 +29,19 @@ static bool CompareVariableToValue(const void* variable, const void* value)
 static bool CompareStructToID(const void* variable, const void* identifier)
 {
     Struct* s = *((Struct**)variable);
-    char* id = (char*)identifier;
-
-    return strcmp(s->identifier, id) == 0;
+    return s->identifier == identifier;
 }
 
 static bool CompareEnumToID(const void* variable, const void* identifier)
 {
     Enum* e = (Enum*)variable;
-    char* id = (char*)identifier;
-
-    return strcmp(e->identifier, id) == 0;
+    return e->identifier == identifier;
 }
 
 static bool CompareTypedefToID(const void* variable, const void* identifier)
 {
     Typedef* td = (Typedef*)variable;
-    char* id = (char*)identifier;
-
-    return strcmp(td->name, id) == 0;
+    return td->name == identifier;
 }
 
 void Scope_Dispose(Scope* this)
@@ -56,7 +49,8 @@ void Scope_Dispose(Scope* this)
     for (size_t i = 0; i < this->variables.count; i++)
     {
         Variable* handle = (Variable*)GenericList_At(&this->variables, i);
-        Value_FreeValue(&handle->value);
+        if (!handle->released)
+            Value_FreeValue(&handle->value);
         Type_RemoveReference(handle->type);
     }
 
@@ -93,47 +87,51 @@ bool Scope_NameIsUsed(Scope* this, char* id)
            GenericList_Find(&this->enums, CompareEnumToID, id) != NULL;
 }
 
-void Scope_DeleteVariable(Scope* this, Variable* var)
+// Releases the variables that are dead according to the live set of a join (see Liveness.h),
+// and takes the registers of released ones that are live again back.
+void Scope_SetLive(Scope* this, const uint16_t* live)
 {
-    if (GenericList_Contains(&this->variables, var))
-    {
-        Type_RemoveReference(var->type);
-        GenericList_Delete(&this->variables, var);
-    }
-    else if (this->parent != NULL)
-        Scope_DeleteVariable(this->parent, var);
-    else
-        assert(0);
-}
+    if (live == NULL)
+        return;
 
-// The AST Optimizer marks variables that need to be deleted
-// after a loop (those that are last accessed in a loop).
-// We delete them by calling this after a loop.
-void Scope_DeleteVariablesAfterLoop(Scope* this, void* loop)
-{   
     do
     {
         for (size_t i = 0; i < this->variables.count; i++)
         {
             Variable* var = GenericList_At(&this->variables, i);
-            if (var->lastAccess == loop)
+            if (var->liveIndex == -1)
+                continue;
+
+            bool isLive = (live[var->liveIndex / 16] & (1 << (var->liveIndex % 16))) != 0;
+            if (!isLive && !var->released)
             {
                 Value_FreeValue(&var->value);
-                Type_RemoveReference(var->type);
-                GenericList_Delete(&this->variables, var);
+                var->released = true;
+            }
+            else if (isLive && var->released)
+            {
+                Value_Reserve(&var->value);
+                var->released = false;
             }
         }
     } while ((this = this->parent) != NULL);
 }
 
+// Variables stay in their scope until it ends, even when they're released. One that is declared
+// again in the same scope hides the old one, so the list is searched from the back.
 Variable* Scope_FindVariable(Scope* this, char* id)
 {
-    Variable* retval = GenericList_Find(&this->variables, CompareVariableToID, id);
+    for (size_t i = this->variables.count; i > 0; i--)
+    {
+        Variable* var = GenericList_At(&this->variables, i - 1);
+        if (var->name == id)
+            return var;
+    }
 
-    if (retval == NULL && this->parent != NULL)
+    if (this->parent != NULL)
         return Scope_FindVariable(this->parent, id);
 
-    return retval;
+    return NULL;
 }
 
 Variable* Scope_FindVariableByValue(Scope* this, Value* val)
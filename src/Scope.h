@@ -35,8 +35,7 @@ Scope Scope_Create(Scope* parent);
 void Scope_Dispose(Scope* this);
 
 bool Scope_NameIsUsed(Scope* this, char* id);
-void Scope_DeleteVariable(Scope* this, Variable* var);
-void Scope_DeleteVariablesAfterLoop(Scope* this, void* loop);
+void Scope_SetLive(Scope* this, const uint16_t* live);
 
 bool CompareVariableToID(const void* variable, const void* identifier);
 
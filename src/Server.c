@@ -0,0 +1,236 @@
+#include "Server.h"
+#include "Compiler.h"
+#include "Error.h"
+#include "Util.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef CUSTOM_COMP
+#include <errno.h>
+#include <setjmp.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// Limits for the size of a request, anything larger is considered malformed
+static const uint32_t MAX_ARGS = 4096;
+static const uint32_t MAX_ARG_LENGTH = 4096;
+
+static bool WriteAll(int fd, const void* data, size_t length)
+{
+    const char* bytes = data;
+    while (length > 0)
+    {
+        ssize_t n = write(fd, bytes, length);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        bytes += n;
+        length -= (size_t)n;
+    }
+    return true;
+}
+
+static bool ReadAll(int fd, void* data, size_t length)
+{
+    char* bytes = data;
+    while (length > 0)
+    {
+        ssize_t n = read(fd, bytes, length);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        bytes += n;
+        length -= (size_t)n;
+    }
+    return true;
+}
+
+static bool WriteString(int fd, const char* str)
+{
+    uint32_t length = (uint32_t)strlen(str);
+    return WriteAll(fd, &length, sizeof(length)) && WriteAll(fd, str, length);
+}
+
+static void FreeArgs(char** args, uint32_t numArgs)
+{
+    for (uint32_t i = 0; i < numArgs; i++)
+        free(args[i]);
+    free(args);
+}
+
+// Returns NULL if the request is malformed
+static char** ReadArgs(int fd, uint32_t* outNumArgs)
+{
+    uint32_t numArgs;
+    if (!ReadAll(fd, &numArgs, sizeof(numArgs)) || numArgs == 0 || numArgs > MAX_ARGS)
+        return NULL;
+
+    char** args = xmalloc(numArgs * sizeof(char*));
+    memset(args, 0, numArgs * sizeof(char*));
+    for (uint32_t i = 0; i < numArgs; i++)
+    {
+        uint32_t length;
+        if (!ReadAll(fd, &length, sizeof(length)) || length > MAX_ARG_LENGTH)
+        {
+            FreeArgs(args, numArgs);
+            return NULL;
+        }
+        args[i] = xmalloc(length + 1);
+        if (!ReadAll(fd, args[i], length))
+        {
+            FreeArgs(args, numArgs);
+            return NULL;
+        }
+        args[i][length] = 0;
+    }
+    *outNumArgs = numArgs;
+    return args;
+}
+
+static void Serve(int connection, void (*run)(int numArgs, char** args))
+{
+    uint32_t numArgs;
+    char** args = ReadArgs(connection, &numArgs);
+    if (args == NULL)
+        return;
+
+    // Diagnostics are printed to stdout, so it is redirected to the client while compiling
+    fflush(stdout);
+    int savedStdout = dup(STDOUT_FILENO);
+    dup2(connection, STDOUT_FILENO);
+
+    uint8_t status = 0;
+    jmp_buf recoveryPoint;
+    if (setjmp(recoveryPoint) == 0)
+    {
+        Error_SetRecoveryPoint(&recoveryPoint);
+        if (chdir(args[0]) != 0)
+            Error("Could not change to the working directory of the request");
+        run((int)numArgs, args);
+    }
+    else
+        status = 1;
+    Error_SetRecoveryPoint(NULL);
+    // Every request starts from scratch, only the caches are kept
+    Compiler_ResetContext();
+
+    fflush(stdout);
+    dup2(savedStdout, STDOUT_FILENO);
+    close(savedStdout);
+
+    uint8_t trailer[2] = {0, status};
+    WriteAll(connection, trailer, sizeof(trailer));
+    FreeArgs(args, numArgs);
+}
+
+static int CreateSocket(const char* socketPath, struct sockaddr_un* addr)
+{
+    if (strlen(socketPath) >= sizeof(addr->sun_path))
+        Error("Socket path is too long");
+    memset(addr, 0, sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+    strcpy(addr->sun_path, socketPath);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+        Error("Could not create socket");
+    return fd;
+}
+
+int Server_Run(const char* socketPath, void (*run)(int numArgs, char** args))
+{
+    // Clients that disconnect early must not take the server down
+    signal(SIGPIPE, SIG_IGN);
+
+    struct sockaddr_un addr;
+    int fd = CreateSocket(socketPath, &addr);
+    unlink(socketPath);
+    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0 || listen(fd, 16) != 0)
+        Error("Could not listen on socket");
+
+    CompilerContext* context = Compiler_CreateContext();
+    Compiler_UseContext(context);
+    while (true)
+    {
+        int connection = accept(fd, NULL, NULL);
+        if (connection < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            Error("Could not accept connection");
+        }
+        Serve(connection, run);
+        close(connection);
+    }
+}
+
+int Server_Request(const char* socketPath, int numArgs, char** args)
+{
+    struct sockaddr_un addr;
+    int fd = CreateSocket(socketPath, &addr);
+    if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0)
+        Error("Could not connect to server");
+
+    char* cwd = getcwd(NULL, 0);
+    if (cwd == NULL)
+        Error("Could not get working directory");
+    uint32_t count = (uint32_t)numArgs;
+    bool sent = WriteAll(fd, &count, sizeof(count)) && WriteString(fd, cwd);
+    for (int i = 1; i < numArgs && sent; i++)
+        sent = WriteString(fd, args[i]);
+    free(cwd);
+    if (!sent)
+        Error("Could not send request to server");
+
+    // The last two bytes are the trailer, everything before it is printed
+    char buffer[4096];
+    char trailer[2];
+    size_t trailerLength = 0;
+    ssize_t n;
+    while ((n = read(fd, buffer, sizeof(buffer))) != 0)
+    {
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+        for (ssize_t i = 0; i < n; i++)
+        {
+            if (trailerLength < 2)
+            {
+                trailer[trailerLength++] = buffer[i];
+                continue;
+            }
+            putchar(trailer[0]);
+            trailer[0] = trailer[1];
+            trailer[1] = buffer[i];
+        }
+    }
+    close(fd);
+
+    if (trailerLength != 2 || trailer[0] != 0)
+        Error("Server closed the connection");
+    return (unsigned char)trailer[1];
+}
+#endif
+
+#ifdef CUSTOM_COMP
+int Server_Run(const char* socketPath, void (*run)(int numArgs, char** args))
+{
+    Error("Server mode is not supported");
+    return 1;
+}
+int Server_Request(const char* socketPath, int numArgs, char** args)
+{
+    Error("Server mode is not supported");
+    return 1;
+}
+#endif
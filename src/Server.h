@@ -0,0 +1,12 @@
+#pragma once
+
+// The server keeps a compiler context alive between compiler invocations, so headers don't
+// have to be lexed again. A request is the working directory and the command line of an
+// invocation. The response is the diagnostics, followed by a zero byte and the exit status.
+
+// Serves requests on the Unix domain socket at socketPath, one at a time. run is called
+// with the command line of each request (the working directory in place of the program name).
+int Server_Run(const char* socketPath, void (*run)(int numArgs, char** args));
+// Sends the command line args[1..numArgs - 1] to the server at socketPath and prints
+// the diagnostics. Returns the exit status of the request.
+int Server_Request(const char* socketPath, int numArgs, char** args);
@@ -0,0 +1,878 @@
+#include "Spill.h"
+#include "Util.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Depths are offsets of the stack pointer from its value at function entry, and stack addresses
+// are relative to that value as well. The words of the caller, like the return address and the
+// parameters, are below 0 and stay where they are. Everything the function puts on the stack
+// itself moves up by the number of reserved slots, which take the words from 0 up. Slots of
+// spilled parameters are the words the caller passed them in instead.
+
+typedef struct
+{
+    SSA* ssa;
+    const int* slotOfValue;
+    int numSlots;
+    // Address of each slot, below 0 for the word of a parameter
+    int* address;
+    // Instruction that loads the parameter of each slot, SIZE_MAX for other slots
+    size_t* parameterLoad;
+    int numReserved;
+    // Virtual register of each slot for the current instruction, -1 for none
+    int* temporary;
+    int nextRegister;
+    GenericList code;
+} Spiller;
+
+static IRInstruction* Instruction(SSA* ssa, size_t i)
+{
+    return GenericList_At(&ssa->function->instructions, i);
+}
+
+static IRBlock* Block(SSA* ssa, size_t i)
+{
+    return GenericList_At(&ssa->function->blocks, i);
+}
+
+static IRInstruction TwoOperands(IROpcode op, IROperand dst, IROperand src)
+{
+    IRInstruction inst;
+    memset(&inst, 0, sizeof(IRInstruction));
+    inst.op = op;
+    inst.flag = Flag_None;
+    inst.dst = dst;
+    inst.a = dst;
+    inst.b = src;
+    return inst;
+}
+
+static int Moved(int address, int numSlots)
+{
+    if (address >= 0)
+        return numSlots;
+    return 0;
+}
+
+// Adds the change of the stack pointer by the instruction to depth. Fails for changes
+// that aren't constant.
+static bool Advance(const IRInstruction* inst, int* depth)
+{
+    // Calls return with the stack pointer where it was
+    if (inst->op > IR_Not)
+        return true;
+    if (inst->dst.type == IROperand_SP)
+    {
+        if (inst->flag != Flag_None || inst->a.type != IROperand_SP || inst->b.type != IROperand_Literal)
+            return false;
+        if (inst->op == IR_Add)
+            *depth += (int)inst->b.value;
+        else if (inst->op == IR_Sub)
+            *depth -= (int)inst->b.value;
+        else
+            return false;
+        return true;
+    }
+
+    int numPushes = 0;
+    if (inst->dst.type == IROperand_Push || inst->a.type == IROperand_Push)
+        numPushes++;
+    if (inst->b.type == IROperand_Push)
+        numPushes++;
+    if (numPushes != 0 && inst->flag != Flag_None)
+        return false;
+    *depth += numPushes;
+    return true;
+}
+
+// Depth before each instruction of the reachable blocks. In reverse postorder, a block comes
+// after one of its predecessors.
+static bool ComputeDepths(SSA* ssa, int* depth)
+{
+    int* entry = xmalloc((ssa->numBlocks + 1) * sizeof(int));
+    bool* known = xmalloc(ssa->numBlocks + 1);
+    memset(known, 0, ssa->numBlocks + 1);
+    entry[0] = 0;
+    known[0] = true;
+
+    bool ok = true;
+    for (size_t j = 0; ok && j < ssa->numOrdered; j++)
+    {
+        size_t b = ssa->order[j];
+        int d = entry[b];
+        IRBlock* block = Block(ssa, b);
+        for (size_t i = block->first; ok && i < block->end; i++)
+        {
+            depth[i] = d;
+            ok = Advance(Instruction(ssa, i), &d);
+        }
+
+        SSABlock* s = &ssa->blocks[b];
+        for (size_t k = 0; ok && k < s->numSuccs; k++)
+        {
+            size_t to = SSA_Edge(ssa, ssa->succEdges[s->firstSucc + k])->to;
+            if (known[to])
+                ok = entry[to] == d;
+            entry[to] = d;
+            known[to] = true;
+        }
+    }
+    free(entry);
+    free(known);
+    return ok;
+}
+
+// Offset an add or subtract of a literal or rz adds to its first operand
+static bool GetOffset(const IRInstruction* inst, int* offset)
+{
+    if ((inst->op != IR_Add && inst->op != IR_Sub) || inst->flag != Flag_None)
+        return false;
+    if (inst->b.type == IROperand_Zero)
+        *offset = 0;
+    else if (inst->b.type == IROperand_Literal)
+        *offset = (int)inst->b.value;
+    else
+        return false;
+    if (inst->op == IR_Sub)
+        *offset = -*offset;
+    return true;
+}
+
+static void SetOffset(IRInstruction* inst, int offset)
+{
+    inst->op = IR_Add;
+    if (offset < 0)
+    {
+        inst->op = IR_Sub;
+        offset = -offset;
+    }
+    inst->b = IR_Literal((int32_t)offset);
+}
+
+static bool RelocateStack(IROperand* op, int depth, int numSlots)
+{
+    if (op->type != IROperand_Stack)
+        return true;
+    int address = depth - (int)op->value;
+    int delta = (int)op->value + Moved(depth, numSlots) - Moved(address, numSlots);
+    op->value = (int32_t)delta;
+    return delta >= 0;
+}
+
+// Literal the register read through slot of instruction i was set to by a move
+static bool RegisterLiteral(SSA* ssa, size_t i, int slot, int* literal)
+{
+    int32_t value = ssa->instructions[i].use[slot];
+    if (value == -1 || SSA_Value(ssa, value)->kind != SSAValue_Instruction)
+        return false;
+    IRInstruction* def = Instruction(ssa, SSA_Value(ssa, value)->inst);
+    if (def->op != IR_Mov || def->flag != Flag_None || def->b.type != IROperand_Literal || def->b.dataRelative)
+        return false;
+    *literal = (int)def->b.value;
+    return true;
+}
+
+// d = sp + offset. Offsets too large for the encoding are in a register, those are
+// left as they are if the address doesn't move relative to the stack pointer.
+static bool RelocateAddress(SSA* ssa, IRInstruction* inst, size_t i, int depth, int numSlots)
+{
+    if (inst->dst.type == IROperand_Stack && !IR_OperandEquals(inst->dst, inst->a) &&
+        !RelocateStack(&inst->dst, depth, numSlots))
+        return false;
+
+    int offset = 0;
+    if (GetOffset(inst, &offset))
+    {
+        SetOffset(inst, offset + Moved(depth + offset, numSlots) - Moved(depth, numSlots));
+        return IR_IsEncodable(inst);
+    }
+    if ((inst->op != IR_Add && inst->op != IR_Sub) || inst->flag != Flag_None ||
+        !RegisterLiteral(ssa, i, IRSlot_B, &offset))
+        return false;
+    if (inst->op == IR_Sub)
+        offset = -offset;
+    return Moved(depth + offset, numSlots) == Moved(depth, numSlots);
+}
+
+// r = s + sp, followed by adding the offset of the array to r, is the address of an element
+// of an array on the stack
+static bool RelocateElementAddress(IRInstruction* inst, IRInstruction* next, int depth, int numSlots)
+{
+    if (inst->op != IR_Add || inst->flag != Flag_None || inst->dst.type != IROperand_Register)
+        return false;
+
+    int offset = 0;
+    bool hasOffset = next != NULL && IR_OperandEquals(next->dst, inst->dst) && IR_OperandEquals(next->a, inst->dst) &&
+                     GetOffset(next, &offset);
+    int moved = Moved(depth + offset, numSlots) - Moved(depth, numSlots);
+    if (moved == 0)
+        return true;
+    if (!hasOffset)
+        return false;
+    SetOffset(next, offset + moved);
+    return true;
+}
+
+// Adjusts the stack addresses of instruction i of code, which is in the block ending at end
+static bool Relocate(SSA* ssa, IRInstruction* code, size_t i, size_t end, int depth, int numSlots)
+{
+    IRInstruction* inst = &code[i];
+    if (inst->op > IR_Not)
+        return true;
+    if (inst->dst.type == IROperand_SP)
+    {
+        int after = depth;
+        Advance(inst, &after);
+        SetOffset(inst, after + Moved(after, numSlots) - depth - Moved(depth, numSlots));
+        return true;
+    }
+    if (inst->a.type == IROperand_SP)
+        return RelocateAddress(ssa, inst, i, depth, numSlots);
+    if (inst->b.type == IROperand_SP)
+    {
+        IRInstruction* next = NULL;
+        if (i + 1 < end)
+            next = &code[i + 1];
+        return RelocateElementAddress(inst, next, depth, numSlots);
+    }
+
+    // Operands that don't fit the encoding anymore are split off by SplitStackOperands
+    bool twoOperands = IR_OperandEquals(inst->dst, inst->a);
+    if (!RelocateStack(&inst->a, depth, numSlots) || !RelocateStack(&inst->b, depth, numSlots))
+        return false;
+    if (twoOperands)
+        inst->dst = inst->a;
+    else if (!RelocateStack(&inst->dst, depth, numSlots))
+        return false;
+    return true;
+}
+
+static int SlotOf(Spiller* spiller, int32_t value)
+{
+    if (value == -1)
+        return -1;
+    return spiller->slotOfValue[(size_t)value];
+}
+
+static int Temporary(Spiller* spiller, int slot)
+{
+    if (spiller->temporary[(size_t)slot] == -1)
+        spiller->temporary[(size_t)slot] = spiller->nextRegister++;
+    return spiller->temporary[(size_t)slot];
+}
+
+// Whether value, the flags before instruction i, may be read from i on
+static bool FlagsRead(SSA* ssa, int32_t value, size_t i)
+{
+    size_t* pending = xmalloc((ssa->numBlocks + 1) * sizeof(size_t));
+    bool* visited = xmalloc(ssa->numBlocks + 1);
+    memset(visited, 0, ssa->numBlocks + 1);
+    size_t numPending = 0;
+    size_t b = ssa->blockOfInstruction[i];
+    bool read = false;
+    while (!read)
+    {
+        IRBlock* block = Block(ssa, b);
+        bool set = false;
+        for (; !set && !read && i < block->end; i++)
+        {
+            SSAInstruction* s = &ssa->instructions[i];
+            read = s->flagsUse == value;
+            set = s->flagsDef != -1 || Instruction(ssa, i)->op == IR_Call;
+        }
+
+        SSABlock* sb = &ssa->blocks[b];
+        for (size_t k = 0; !set && !read && k < sb->numSuccs; k++)
+        {
+            size_t to = SSA_Edge(ssa, ssa->succEdges[sb->firstSucc + k])->to;
+            int32_t entry = ssa->entryValues[to * (size_t)ssa->numLocations + (size_t)ssa->flagsLocation];
+            // A phi that is read anywhere might read value
+            if (entry != value)
+                read = entry == -1 || SSA_Value(ssa, entry)->numUses != 0;
+            else if (!visited[to])
+            {
+                visited[to] = true;
+                pending[numPending++] = to;
+            }
+        }
+
+        if (numPending == 0)
+            break;
+        b = pending[--numPending];
+        i = Block(ssa, b)->first;
+    }
+    free(pending);
+    free(visited);
+    return read;
+}
+
+// Whether the flags may still be read before instruction i, or after it
+static bool FlagsLive(SSA* ssa, size_t i, bool after)
+{
+    int32_t value = SSA_ValueBefore(ssa, ssa->flagsLocation, i);
+    if (!after)
+        return FlagsRead(ssa, value, i);
+
+    SSAInstruction* s = &ssa->instructions[i];
+    if (s->flagsDef != -1)
+        value = s->flagsDef;
+    else if (Instruction(ssa, i)->op == IR_Call)
+        return false;
+    if (i + 1 < Block(ssa, ssa->blockOfInstruction[i])->end)
+        return FlagsRead(ssa, value, i + 1);
+
+    // The flags after the last instruction of a block reach its successors
+    SSABlock* sb = &ssa->blocks[ssa->blockOfInstruction[i]];
+    for (size_t k = 0; k < sb->numSuccs; k++)
+    {
+        size_t to = SSA_Edge(ssa, ssa->succEdges[sb->firstSucc + k])->to;
+        IRBlock* block = Block(ssa, to);
+        if (block->first == block->end || FlagsRead(ssa, value, block->first))
+            return true;
+    }
+    return false;
+}
+
+// Moves between the temporary of slot and the slot, before instruction i for loads and after
+// it for stores, at the given depth. Below the depth at function entry, reserved slots are above
+// the stack pointer, which is moved up to them around the access if the flags are dead there.
+// Slots too far below the stack pointer, e.g. under a large array, are addressed through a
+// register, which needs the flags to be dead as well.
+static bool AppendAccess(Spiller* spiller, int slot, int depth, bool load, size_t i)
+{
+    int address = spiller->address[slot];
+    int raise = 0;
+    if (depth < 0 && address >= depth)
+    {
+        if (FlagsLive(spiller->ssa, i, !load))
+            return false;
+        raise = spiller->numReserved - depth;
+    }
+    int delta = depth + raise + Moved(depth, spiller->numReserved) - address;
+    IROperand reg = IR_Register(Temporary(spiller, slot));
+    IROperand stack = IR_Stack(delta);
+    if (delta > 255)
+    {
+        if (FlagsLive(spiller->ssa, i, !load))
+            return false;
+        IROperand address = IR_Register(spiller->nextRegister++);
+        IRInstruction copy = TwoOperands(IR_Mov, address, IR_SP());
+        IRInstruction sub = TwoOperands(IR_Sub, address, IR_Literal((int32_t)delta));
+        GenericList_Append(&spiller->code, &copy);
+        GenericList_Append(&spiller->code, &sub);
+        stack = IR_MemoryRegister((int)address.value);
+    }
+    IRInstruction inst = TwoOperands(IR_Mov, stack, reg);
+    if (load)
+        inst = TwoOperands(IR_Mov, reg, stack);
+
+    IRInstruction up = TwoOperands(IR_Add, IR_SP(), IR_Literal((int32_t)raise));
+    IRInstruction down = TwoOperands(IR_Sub, IR_SP(), IR_Literal((int32_t)raise));
+    if (raise != 0)
+        GenericList_Append(&spiller->code, &up);
+    GenericList_Append(&spiller->code, &inst);
+    if (raise != 0)
+        GenericList_Append(&spiller->code, &down);
+    return IR_IsEncodable(&inst) && IR_IsEncodable(&up);
+}
+
+// A relocated stack operand might not fit the encoding of its instruction anymore, e.g. the
+// offset of shl r0, [sp-3], 2 differs from the literal. Such operands are moved through new
+// virtual registers, loaded before the instruction. *oStored is set to the stack operand the
+// instruction writes, if it had to be replaced, IROperand_None otherwise.
+static bool SplitStackOperands(Spiller* spiller, IRInstruction* inst, IROperand* oStored)
+{
+    oStored->type = IROperand_None;
+    if (IR_IsEncodable(inst))
+        return true;
+    if (inst->dst.type == IROperand_Push || inst->a.type == IROperand_Push || inst->b.type == IROperand_Push)
+        return false;
+
+    bool onlyB = inst->op == IR_Mov || inst->op == IR_Not;
+    bool twoOperands = IR_OperandEquals(inst->dst, inst->a);
+    for (int k = IRSlot_Dst; k <= IRSlot_B && !IR_IsEncodable(inst); k++)
+    {
+        IROperand* op = IR_OperandAt(inst, k);
+        if (op->type != IROperand_Stack || (k == IRSlot_A && twoOperands))
+            continue;
+        IROperand stack = *op;
+        IROperand reg = IR_Register(spiller->nextRegister++);
+        bool writes = k == IRSlot_Dst;
+        // A conditional write keeps the old value if the condition doesn't hold
+        bool reads = k != IRSlot_Dst || (twoOperands && !onlyB) || inst->flag != Flag_None;
+        if (reads)
+        {
+            IRInstruction load = TwoOperands(IR_Mov, reg, stack);
+            GenericList_Append(&spiller->code, &load);
+            if (!IR_IsEncodable(&load))
+                return false;
+        }
+        *op = reg;
+        if (writes)
+        {
+            if (twoOperands)
+                inst->a = reg;
+            *oStored = stack;
+        }
+    }
+    return IR_IsEncodable(inst);
+}
+
+// Replaces the register operands of inst at the positions in mask by the stack operands of their
+// slots, if the instruction can still be encoded then
+static bool FoldSlots(Spiller* spiller, IRInstruction* inst, int* slots, int mask, int depth)
+{
+    IRInstruction folded = *inst;
+    bool twoOperands = IR_OperandEquals(inst->dst, inst->a);
+    for (int k = IRSlot_Dst; k <= IRSlot_B; k++)
+    {
+        if ((mask & (1 << k)) != 0)
+            *IR_OperandAt(&folded, k) = IR_Stack(depth + spiller->numReserved - spiller->address[slots[k]]);
+    }
+    if (twoOperands)
+        folded.a = folded.dst;
+    if (!IR_IsEncodable(&folded))
+        return false;
+    *inst = folded;
+    return true;
+}
+
+// Lets inst read and write spilled values on the stack where the encoding allows it, instead of
+// through temporaries. Returns the positions of the operands that were replaced as a mask.
+static int FoldSpilledOperands(Spiller* spiller, IRInstruction* inst, size_t i, int depth)
+{
+    SSAInstruction* s = &spiller->ssa->instructions[i];
+    int after = depth;
+    // Below the depth at function entry, the slots are above the stack pointer
+    if (inst->op > IR_Not || depth < 0 || !Advance(inst, &after) || after != depth)
+        return 0;
+
+    bool twoOperands = IR_OperandEquals(inst->dst, inst->a);
+    int slots[3];
+    int candidates = 0;
+    for (int k = IRSlot_Dst; k <= IRSlot_B; k++)
+    {
+        int32_t value = s->use[k];
+        if (k == IRSlot_Dst)
+            value = s->def;
+        slots[k] = SlotOf(spiller, value);
+        if (slots[k] != -1 && IR_OperandAt(inst, k)->type == IROperand_Register)
+            candidates |= 1 << k;
+    }
+    // The register written and read by a conditional or two operand instruction is in one slot
+    bool tied = twoOperands && inst->op != IR_Mov && inst->op != IR_Not;
+    if (((tied || inst->flag != Flag_None) && (candidates & (1 << IRSlot_Dst)) != 0 &&
+         SlotOf(spiller, s->use[tied ? IRSlot_A : IRSlot_Dst]) != slots[IRSlot_Dst]) ||
+        (twoOperands && (candidates & (1 << IRSlot_Dst)) == 0))
+        candidates &= ~((1 << IRSlot_Dst) | (1 << IRSlot_A));
+    if (twoOperands && (candidates & (1 << IRSlot_Dst)) != 0)
+        candidates |= 1 << IRSlot_A;
+
+    if (candidates == 0 || FoldSlots(spiller, inst, &slots[0], candidates, depth))
+        return candidates;
+    // Otherwise one of them, the written one first as it saves a load and a store. The first
+    // operand of two is the written one.
+    int dst = (1 << IRSlot_Dst) | (twoOperands ? 1 << IRSlot_A : 0);
+    int order[3] = {dst, 1 << IRSlot_B, 1 << IRSlot_A};
+    for (int n = 0; n < (twoOperands ? 2 : 3); n++)
+    {
+        int mask = order[n];
+        if ((candidates & mask) == mask && FoldSlots(spiller, inst, &slots[0], mask, depth))
+            return mask;
+    }
+    return 0;
+}
+
+// Appends inst, which is instruction i at the given depth, between loads of the spilled values
+// it reads and the store of the one it writes
+static bool AppendInstruction(Spiller* spiller, IRInstruction inst, size_t i, int depth)
+{
+    SSAInstruction* s = &spiller->ssa->instructions[i];
+    int stored = SlotOf(spiller, s->def);
+    if (stored != -1 && spiller->parameterLoad[stored] == i)
+        return true;
+    int folded = FoldSpilledOperands(spiller, &inst, i, depth);
+    bool twoOperands = IR_OperandEquals(inst.dst, inst.a);
+    bool ok = true;
+    int slots[3];
+    for (int k = IRSlot_Dst; k <= IRSlot_B; k++)
+    {
+        slots[k] = -1;
+        if ((folded & (1 << k)) != 0)
+            continue;
+        int slot = SlotOf(spiller, s->use[k]);
+        if (slot != -1 && spiller->temporary[(size_t)slot] == -1)
+            ok = AppendAccess(spiller, slot, depth, true, i) && ok;
+        if (k == IRSlot_Dst && slot == -1)
+            slot = SlotOf(spiller, s->def);
+        slots[k] = slot;
+    }
+
+    for (int k = IRSlot_Dst; k <= IRSlot_B; k++)
+    {
+        if (slots[k] != -1)
+            IR_OperandAt(&inst, k)->value = (int32_t)Temporary(spiller, slots[k]);
+    }
+    if (twoOperands)
+        inst.a = inst.dst;
+    IROperand split;
+    ok = SplitStackOperands(spiller, &inst, &split) && ok;
+    GenericList_Append(&spiller->code, &inst);
+    if (split.type != IROperand_None)
+    {
+        IRInstruction store = TwoOperands(IR_Mov, split, inst.dst);
+        GenericList_Append(&spiller->code, &store);
+    }
+
+    if (stored != -1 && (folded & (1 << IRSlot_Dst)) == 0)
+    {
+        int after = depth;
+        Advance(&inst, &after);
+        ok = AppendAccess(spiller, stored, after, false, i) && ok;
+    }
+    for (int k = IRSlot_Dst; k <= IRSlot_B; k++)
+    {
+        if (slots[k] != -1)
+            spiller->temporary[(size_t)slots[k]] = -1;
+    }
+    return ok;
+}
+
+static void AppendBlock(GenericList* blocks, size_t first, size_t end)
+{
+    IRBlock block;
+    block.first = first;
+    block.end = end;
+    GenericList_Append(blocks, &block);
+}
+
+// Whether instruction i, which is in a block ending at end, is only followed by the return
+static bool IsReturned(SSA* ssa, size_t i, size_t end)
+{
+    for (size_t k = i + 1; k < end; k++)
+    {
+        IRInstruction* inst = Instruction(ssa, k);
+        if (inst->op == IR_Nop || (inst->op <= IR_Not && inst->flag == Flag_None && inst->dst.type == IROperand_SP))
+            continue;
+        return inst->op == IR_Mov && inst->flag == Flag_None && inst->dst.type == IROperand_IP;
+    }
+    return false;
+}
+
+// Number of operands of the reachable code that are the stack word at address. The return
+// value may be written to it, the function doesn't need the word after that anymore.
+static size_t NumAccesses(SSA* ssa, const int* depth, int address)
+{
+    size_t num = 0;
+    for (size_t j = 0; j < ssa->numOrdered; j++)
+    {
+        IRBlock* block = Block(ssa, ssa->order[j]);
+        for (size_t i = block->first; i < block->end; i++)
+        {
+            IRInstruction* inst = Instruction(ssa, i);
+            for (int k = IRSlot_Dst; inst->op <= IR_Not && k <= IRSlot_B; k++)
+            {
+                IROperand* op = IR_OperandAt(inst, k);
+                if (op->type != IROperand_Stack || depth[i] - (int)op->value != address ||
+                    (k == IRSlot_A && IR_OperandEquals(inst->dst, inst->a)))
+                    continue;
+                if (k != IRSlot_Dst || inst->op != IR_Mov || inst->flag != Flag_None ||
+                    !IsReturned(ssa, i, block->end))
+                    num++;
+            }
+        }
+    }
+    return num;
+}
+
+// A spilled parameter stays in the word it was passed in, if nothing else accesses that word.
+// The load at function entry is left out then.
+static void FindParameterSlots(Spiller* spiller, const int* depth)
+{
+    SSA* ssa = spiller->ssa;
+    IRBlock* entry = Block(ssa, 0);
+    // A loop that starts with the function would load them again
+    if (entry->first == entry->end || Instruction(ssa, entry->first)->op == IR_Label)
+        return;
+    // The slot mustn't be written before its parameter is loaded
+    bool* written = xmalloc((size_t)spiller->numSlots + 1);
+    memset(written, 0, (size_t)spiller->numSlots + 1);
+    for (size_t i = entry->first; i < entry->end; i++)
+    {
+        IRInstruction* inst = Instruction(ssa, i);
+        if (inst->op != IR_Mov || inst->flag != Flag_None || inst->b.type != IROperand_Stack)
+            break;
+        int slot = SlotOf(spiller, ssa->instructions[i].def);
+        if (slot == -1)
+            continue;
+        int address = depth[i] - (int)inst->b.value;
+        if (!written[slot] && address < 0 && NumAccesses(ssa, depth, address) == 1)
+        {
+            spiller->address[slot] = address;
+            spiller->parameterLoad[slot] = i;
+        }
+        written[slot] = true;
+    }
+    free(written);
+}
+
+bool Spill_Run(SSA* ssa, const int* slotOfValue, int numSlots)
+{
+    IRFunction* function = ssa->function;
+    size_t count = function->instructions.count;
+    int* depth = xmalloc((count + 1) * sizeof(int));
+    IRInstruction* relocated = xmalloc((count + 1) * sizeof(IRInstruction));
+    for (size_t i = 0; i < count; i++)
+        relocated[i] = *Instruction(ssa, i);
+
+    Spiller spiller;
+    spiller.ssa = ssa;
+    spiller.slotOfValue = slotOfValue;
+    spiller.numSlots = numSlots;
+    spiller.address = xmalloc(((size_t)numSlots + 1) * sizeof(int));
+    spiller.parameterLoad = xmalloc(((size_t)numSlots + 1) * sizeof(size_t));
+    spiller.temporary = xmalloc(((size_t)numSlots + 1) * sizeof(int));
+    for (int slot = 0; slot < numSlots; slot++)
+    {
+        spiller.parameterLoad[(size_t)slot] = SIZE_MAX;
+        spiller.temporary[(size_t)slot] = -1;
+    }
+
+    bool ok = ComputeDepths(ssa, depth);
+    if (ok)
+        FindParameterSlots(&spiller, depth);
+    spiller.numReserved = 0;
+    for (int slot = 0; slot < numSlots; slot++)
+    {
+        if (spiller.parameterLoad[(size_t)slot] == SIZE_MAX)
+            spiller.address[(size_t)slot] = spiller.numReserved++;
+    }
+
+    for (size_t j = 0; ok && j < ssa->numOrdered; j++)
+    {
+        IRBlock* block = Block(ssa, ssa->order[j]);
+        for (size_t i = block->first; ok && i < block->end; i++)
+            ok = Relocate(ssa, relocated, i, block->end, depth[i], spiller.numReserved);
+    }
+
+    spiller.nextRegister = ssa->flagsLocation;
+    spiller.code = GenericList_Create(sizeof(IRInstruction));
+    GenericList blocks = GenericList_Create(sizeof(IRBlock));
+
+    // Not part of a loop that starts with the function
+    IRBlock* entry = Block(ssa, 0);
+    bool ownBlock = entry->first == entry->end || Instruction(ssa, entry->first)->op == IR_Label;
+    if (spiller.numReserved != 0)
+    {
+        IRInstruction reserve = TwoOperands(IR_Add, IR_SP(), IR_Literal((int32_t)spiller.numReserved));
+        GenericList_Append(&spiller.code, &reserve);
+        if (ownBlock)
+            AppendBlock(&blocks, 0, 1);
+    }
+
+    for (size_t b = 0; ok && b < ssa->numBlocks; b++)
+    {
+        IRBlock* block = Block(ssa, b);
+        size_t first = spiller.code.count;
+        if (b == 0 && !ownBlock)
+            first = 0;
+        for (size_t i = block->first; ok && i < block->end; i++)
+        {
+            if (ssa->blocks[b].reachable)
+                ok = AppendInstruction(&spiller, relocated[i], i, depth[i]);
+            else
+                GenericList_Append(&spiller.code, &relocated[i]);
+        }
+        AppendBlock(&blocks, first, spiller.code.count);
+    }
+
+    if (ok)
+    {
+        GenericList_Dispose(&function->instructions);
+        GenericList_Dispose(&function->blocks);
+        function->instructions = spiller.code;
+        function->blocks = blocks;
+    }
+    else
+    {
+        GenericList_Dispose(&spiller.code);
+        GenericList_Dispose(&blocks);
+    }
+    free(depth);
+    free(relocated);
+    free(spiller.address);
+    free(spiller.parameterLoad);
+    free(spiller.temporary);
+    return ok;
+}
+
+// Slot an operand of an instruction at the given depth is, -1 for other operands
+static int SlotAt(IROperand op, int depth, int numSlots)
+{
+    if (op.type != IROperand_Stack)
+        return -1;
+    int address = depth - (int)op.value;
+    if (address < 0 || address >= numSlots)
+        return -1;
+    return address;
+}
+
+// What the machine registers hold
+typedef struct
+{
+    // Slot each register has the value of, -1 for none
+    int slot[8];
+    // Registers that might hold a stack address, through which slots could be accessed
+    bool isAddress[8];
+} Contents;
+
+typedef struct
+{
+    int numSlots;
+    Contents contents;
+    // Store to each slot that nothing in the block read yet, SIZE_MAX for none
+    size_t* store;
+} Accesses;
+
+static void ForgetRegisters(Contents* contents, uint16_t registers)
+{
+    for (int r = 0; r < IR_NUM_PHYSICAL_REGISTERS; r++)
+    {
+        if (((int)registers & (1 << r)) != 0)
+        {
+            contents->slot[r] = -1;
+            contents->isAddress[r] = false;
+        }
+    }
+}
+
+// Registers with the value of slot don't have it anymore, those of any slot for -1
+static void ForgetSlot(Contents* contents, int slot)
+{
+    for (int r = 0; r < IR_NUM_PHYSICAL_REGISTERS; r++)
+    {
+        if (contents->slot[r] == slot || slot == -1)
+            contents->slot[r] = -1;
+    }
+}
+
+static void ForgetStores(Accesses* acc)
+{
+    for (int slot = 0; slot < acc->numSlots; slot++)
+        acc->store[(size_t)slot] = SIZE_MAX;
+}
+
+static bool IsAddress(Contents* contents, IROperand op)
+{
+    return op.type == IROperand_SP || ((op.type == IROperand_Register || op.type == IROperand_MemoryRegister) &&
+                                       (int)op.value < IR_NUM_PHYSICAL_REGISTERS && contents->isAddress[(int)op.value]);
+}
+
+// Updates what is known about registers and slots for instruction i, and removes it or an
+// earlier store if they're redundant
+static void VisitAccesses(SSA* ssa, Accesses* acc, size_t i, int depth)
+{
+    IRInstruction* inst = Instruction(ssa, i);
+    Contents* contents = &acc->contents;
+    // Other blocks only continue with what this one leaves if it is their single predecessor
+    if (inst->op == IR_Nop || inst->op == IR_Jump || inst->op == IR_Label)
+        return;
+    if (inst->op > IR_Not)
+    {
+        // Calls neither read nor write the slots
+        ForgetRegisters(contents, inst->clobbers);
+        if (inst->op != IR_Call)
+        {
+            ForgetRegisters(contents, (uint16_t)0xFF);
+            ForgetStores(acc);
+        }
+        return;
+    }
+
+    bool conditional = inst->flag != Flag_None;
+    bool isMove = inst->op == IR_Mov || inst->op == IR_Not;
+    int loaded = SlotAt(inst->b, depth, acc->numSlots);
+    if (inst->op == IR_Mov && !conditional && inst->dst.type == IROperand_Register && loaded != -1 &&
+        contents->slot[(int)inst->dst.value] == loaded)
+    {
+        inst->op = IR_Nop;
+        return;
+    }
+
+    bool readsDst = inst->dst.type == IROperand_MemoryRegister || conditional;
+    for (int k = IRSlot_Dst; k <= IRSlot_B; k++)
+    {
+        IROperand* op = IR_OperandAt(inst, k);
+        if ((k == IRSlot_Dst && !readsDst) || (k == IRSlot_A && isMove))
+            continue;
+        int slot = SlotAt(*op, depth, acc->numSlots);
+        if (slot != -1)
+            acc->store[(size_t)slot] = SIZE_MAX;
+        if (op->type == IROperand_MemoryRegister && IsAddress(contents, *op))
+            ForgetStores(acc);
+    }
+
+    int stored = SlotAt(inst->dst, depth, acc->numSlots);
+    if (stored != -1)
+    {
+        size_t previous = acc->store[(size_t)stored];
+        if (!conditional && previous != SIZE_MAX)
+            Instruction(ssa, previous)->op = IR_Nop;
+        acc->store[(size_t)stored] = SIZE_MAX;
+        if (inst->op == IR_Mov && !conditional)
+            acc->store[(size_t)stored] = i;
+        ForgetSlot(contents, stored);
+        if (inst->op == IR_Mov && !conditional && inst->b.type == IROperand_Register)
+            contents->slot[(int)inst->b.value] = stored;
+    }
+    else if (inst->dst.type == IROperand_MemoryRegister && IsAddress(contents, inst->dst))
+        ForgetSlot(contents, -1);
+    else if (inst->dst.type == IROperand_Register)
+    {
+        int r = (int)inst->dst.value;
+        contents->isAddress[r] = IsAddress(contents, inst->b) || (!isMove && IsAddress(contents, inst->a)) ||
+                                 (conditional && contents->isAddress[r]);
+        contents->slot[r] = -1;
+        if (inst->op == IR_Mov && !conditional)
+            contents->slot[r] = loaded;
+    }
+}
+
+void Spill_RemoveRedundantAccesses(SSA* ssa, int numSlots)
+{
+    size_t count = ssa->function->instructions.count;
+    int* depth = xmalloc((count + 1) * sizeof(int));
+    // What the registers hold at the end of each block visited so far
+    Contents* atEnd = xmalloc((ssa->numBlocks + 1) * sizeof(Contents));
+    bool* visited = xmalloc(ssa->numBlocks + 1);
+    memset(visited, 0, ssa->numBlocks + 1);
+    Accesses acc;
+    acc.numSlots = numSlots;
+    acc.store = xmalloc(((size_t)numSlots + 1) * sizeof(size_t));
+    if (ComputeDepths(ssa, depth))
+    {
+        for (size_t j = 0; j < ssa->numOrdered; j++)
+        {
+            size_t b = ssa->order[j];
+            IRBlock* block = Block(ssa, b);
+            // A block with a single predecessor starts with what that ends with
+            SSABlock* sb = &ssa->blocks[b];
+            size_t from = SIZE_MAX;
+            if (sb->numPreds == 1 && b != 0)
+                from = SSA_Edge(ssa, ssa->predEdges[sb->firstPred])->from;
+            if (from != SIZE_MAX && visited[from])
+                acc.contents = atEnd[from];
+            else
+                ForgetRegisters(&acc.contents, (uint16_t)0xFF);
+            ForgetStores(&acc);
+            for (size_t i = block->first; i < block->end; i++)
+                VisitAccesses(ssa, &acc, i, depth[i]);
+            atEnd[b] = acc.contents;
+            visited[b] = true;
+        }
+    }
+    free(depth);
+    free(atEnd);
+    free(visited);
+    free(acc.store);
+}
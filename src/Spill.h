@@ -0,0 +1,19 @@
+#pragma once
+#include "SSA.h"
+#include <stdbool.h>
+
+// Moves values of a function to stack slots. The slots are reserved when the function is
+// entered, below everything else it puts on the stack, and the stack addresses of its code
+// are adjusted to that. Each instruction that reads or writes spilled values gets a new
+// virtual register per slot, loaded before and stored after the instruction, unless it can
+// access the slot directly. A spilled parameter keeps the word the caller passed it in.
+// slotOfValue has the slot of each value of ssa, -1 for values that stay in registers.
+// Returns false and leaves the code as it is if that isn't possible, e.g. because the stack
+// pointer doesn't have a known offset everywhere or a slot is out of reach.
+bool Spill_Run(SSA* ssa, const int* slotOfValue, int numSlots);
+
+// Removes loads of slots into registers that still hold their value, also on entry of a block
+// with a single predecessor, and stores to slots that are written again in the same block
+// before anything reads them. For the code of ssa after its registers were assigned, with
+// numSlots slots reserved by all rounds of spilling.
+void Spill_RemoveRedundantAccesses(SSA* ssa, int numSlots);
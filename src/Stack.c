@@ -1,65 +1,98 @@
 #include "Stack.h"
-#include "Outfile.h"
+#include "IR.h"
+#include "Util.h"
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct StackContext
+{
+    int curFuncStackSize;
+    int curStackPointerOffset;
+} StackContext;
+
+#ifndef CUSTOM_COMP
+static _Thread_local StackContext* ctx = NULL;
+#endif
+#ifdef CUSTOM_COMP
+static StackContext* ctx = NULL;
+#endif
+
+StackContext* Stack_CreateContext()
+{
+    StackContext* context = xmalloc(sizeof(StackContext));
+    memset(context, 0, sizeof(StackContext));
+    return context;
+}
+
+void Stack_DisposeContext(StackContext* context)
+{
+    if (ctx == context)
+        ctx = NULL;
+    free(context);
+}
+
+void Stack_UseContext(StackContext* context)
+{
+    ctx = context;
+}
 
-static int curFuncStackSize = 0;
-static int curStackPointerOffset = 0;
 void Stack_Align()
 {
-    if (curStackPointerOffset > 0)
-        OutWrite("sub sp, %i\n", curStackPointerOffset);
-    if (curStackPointerOffset < 0)
-        OutWrite("add sp, %i\n", -curStackPointerOffset);
+    if (ctx->curStackPointerOffset > 0)
+        IR_Emit2(IR_Sub, IR_SP(), IR_Literal((int32_t)ctx->curStackPointerOffset));
+    if (ctx->curStackPointerOffset < 0)
+        IR_Emit2(IR_Add, IR_SP(), IR_Literal((int32_t)(-ctx->curStackPointerOffset)));
 
-    curStackPointerOffset = 0;
+    ctx->curStackPointerOffset = 0;
 }
 void Stack_ToAddress(int addr)
 {
-    int delta = curStackPointerOffset + addr;
+    int delta = ctx->curStackPointerOffset + addr;
 
     if (delta > 0)
-        OutWrite("sub sp, %i\n", delta);
+        IR_Emit2(IR_Sub, IR_SP(), IR_Literal((int32_t)delta));
     else if (delta < 0)
-        OutWrite("add sp, %i\n", -delta);
+        IR_Emit2(IR_Add, IR_SP(), IR_Literal((int32_t)(-delta)));
 
-    curStackPointerOffset = -addr;
+    ctx->curStackPointerOffset = -addr;
 }
 void Stack_Reset()
 {
-    int delta = curFuncStackSize + curStackPointerOffset;
+    int delta = ctx->curFuncStackSize + ctx->curStackPointerOffset;
     if (delta > 0)
-        OutWrite("sub sp, %i\n", delta);
+        IR_Emit2(IR_Sub, IR_SP(), IR_Literal((int32_t)delta));
     else if (delta < 0)
-        OutWrite("add sp, %i\n", -delta);
+        IR_Emit2(IR_Add, IR_SP(), IR_Literal((int32_t)(-delta)));
 
-    curStackPointerOffset = -curFuncStackSize;
+    ctx->curStackPointerOffset = -ctx->curFuncStackSize;
 }
 int Stack_GetDelta(int addr)
 {
-    return curStackPointerOffset + addr;
+    return ctx->curStackPointerOffset + addr;
 }
 void Stack_SetSize(int n)
 {
-    curFuncStackSize = n;
+    ctx->curFuncStackSize = n;
 }
 void Stack_SetOffset(int n)
 {
-    curStackPointerOffset = n;
+    ctx->curStackPointerOffset = n;
 }
 int Stack_GetSize()
 {
-    return curFuncStackSize;
+    return ctx->curFuncStackSize;
 }
 int Stack_GetOffset()
 {
-    return curStackPointerOffset;
+    return ctx->curStackPointerOffset;
 }
 void Stack_Offset(int n)
 {
-    curStackPointerOffset += n;
+    ctx->curStackPointerOffset += n;
 }
 void Stack_OffsetSize(int n)
 {
-    curFuncStackSize += n;
+    ctx->curFuncStackSize += n;
 }
\ No newline at end of file
@@ -20,4 +20,14 @@ void Stack_Offset(int n);
 // Adds n to current stack size
 void Stack_OffsetSize(int n);
 
-int Stack_GetDelta(int addr);
\ No newline at end of file
+int Stack_GetDelta(int addr);
+
+#ifndef CUSTOM_COMP
+typedef struct StackContext StackContext;
+#endif
+#ifdef CUSTOM_COMP
+typedef struct StackContext {} StackContext;
+#endif
+StackContext* Stack_CreateContext();
+void Stack_DisposeContext(StackContext* context);
+void Stack_UseContext(StackContext* context);
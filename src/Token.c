@@ -1,5 +1,6 @@
 #include "Token.h"
 #include "Error.h"
+#include "Intern.h"
 #include "Util.h"
 #include <assert.h>
 #include <string.h>
@@ -7,75 +8,154 @@
 // We create a LUT that keeps track of the last token on any given lineNumber
 // in any given sourceFile. This way we can look these up for error messages
 // without having to store them for every individual token.
-static void StoreLocation(TokenArray* t, size_t tokenIndex, uint16_t lineNumber, char* sourceFile)
+static void StoreLocation(TokenArray* t, size_t tokenIndex, uint32_t lineNumber)
 {
-    if (t->locationsCount == 0 || (t->locations[(t->locationsCount - 1)]).location.lineNumber != lineNumber ||
-        strcmp(t->locations[t->locationsCount - 1].location.sourceFile, sourceFile) != 0)
+    if (t->locationsCount != 0)
     {
-        t->locationsCount++;
-        if (t->locationsCount > t->maxLocationsCount)
+        TokenSourceGroup* last = &t->locations[t->locationsCount - 1];
+        if (last->lineNumber == lineNumber && last->fileId == t->currentFileId)
         {
-            t->maxLocationsCount += 128;
-            t->locations = xrealloc(t->locations, (t->maxLocationsCount) * sizeof(TokenSourceGroup));
+            last->highestTokenIndex = (uint32_t)tokenIndex;
+            return;
         }
-
-        char* newString = NULL;
-        // No need to create another copy of the file name string in memory if it is still the same
-        if (t->locationsCount >= 2 && strcmp(t->locations[t->locationsCount - 2].location.sourceFile, sourceFile) == 0)
-        {
-            newString = t->locations[t->locationsCount - 2].location.sourceFile;
-        }
-        else
-        {
-            newString = xmalloc(strlen(sourceFile) + 1);
-            strcpy(newString, sourceFile);
-        }
-        t->locations[t->locationsCount - 1].location.sourceFile = newString;
-
-        t->locations[t->locationsCount - 1].location.lineNumber = lineNumber;
-        t->locations[t->locationsCount - 1].highestTokenIndex = tokenIndex;
     }
-    else
+
+    if (t->locationsCount + 1 > t->maxLocationsCount)
     {
-        t->locations[t->locationsCount - 1].highestTokenIndex = tokenIndex;
+        t->maxLocationsCount *= 2;
+        t->locations = xrealloc(t->locations, (t->maxLocationsCount) * sizeof(TokenSourceGroup));
     }
+
+    TokenSourceGroup* group = &t->locations[t->locationsCount++];
+    group->highestTokenIndex = (uint32_t)tokenIndex;
+    group->lineNumber = lineNumber;
+    group->fileId = t->currentFileId;
+}
+typedef struct TokenContext
+{
+    // Array that token indices in error messages refer to
+    TokenArray* currentTokenArray;
+} TokenContext;
+
+#ifndef CUSTOM_COMP
+static _Thread_local TokenContext* ctx = NULL;
+#endif
+#ifdef CUSTOM_COMP
+static TokenContext* ctx = NULL;
+#endif
+
+TokenContext* Token_CreateContext()
+{
+    TokenContext* context = xmalloc(sizeof(TokenContext));
+    memset(context, 0, sizeof(TokenContext));
+    return context;
+}
+
+void Token_DisposeContext(TokenContext* context)
+{
+    if (ctx == context)
+        ctx = NULL;
+    free(context);
+}
+
+void Token_UseContext(TokenContext* context)
+{
+    ctx = context;
+}
+
+uint32_t Token_GetFileId(const char* sourceFile)
+{
+    return Intern_Symbol(sourceFile, strlen(sourceFile));
+}
+
+char* Token_GetFileName(uint32_t fileId)
+{
+    return Intern_GetSymbol(fileId);
+}
+
+uint32_t Token_SetSourceFile(TokenArray* array, uint32_t fileId)
+{
+    uint32_t previous = array->currentFileId;
+    array->currentFileId = fileId;
+    return previous;
 }
-static TokenArray* currentTokenArray = NULL;
 
 SourceLocation Token_GetLocationP(const Token* token)
 {
-    size_t offset = (void*)token - (void*)currentTokenArray->tokens;
+    size_t offset = (void*)token - (void*)ctx->currentTokenArray->tokens;
     offset /= sizeof(Token);
-    assert(offset < currentTokenArray->curLength);
+    assert(offset < ctx->currentTokenArray->curLength);
 
     return Token_GetLocation(offset);
 }
 
 SourceLocation Token_GetLocation(size_t tokenIndex)
 {
-    for (size_t i = 0; i < currentTokenArray->locationsCount; i++)
+    assert(tokenIndex < ctx->currentTokenArray->curLength);
+
+    // Groups are sorted by token index, find the first one that contains tokenIndex.
+    size_t low = 0;
+    size_t high = ctx->currentTokenArray->locationsCount - 1;
+    while (low < high)
     {
-        if (currentTokenArray->locations[i].highestTokenIndex >= tokenIndex)
-            return currentTokenArray->locations[i].location;
+        size_t mid = low + (high - low) / 2;
+        if ((size_t)ctx->currentTokenArray->locations[mid].highestTokenIndex < tokenIndex)
+            low = mid + 1;
+        else
+            high = mid;
     }
-    assert(0);
+
+    TokenSourceGroup* group = &ctx->currentTokenArray->locations[low];
+    SourceLocation loc = {group->lineNumber, Token_GetFileName(group->fileId)};
+    return loc;
 }
 
 Token Token_Get(TokenType type)
 {
-    Token t = {type, NULL};
+    Token t = {type, (uint32_t)0};
     return t;
 }
-Token Token_GetString(TokenType type, char* string)
+Token Token_GetIdentifier(const char* id, size_t length)
 {
-    Token t = {type, string};
+    Token t = {Identifier, Intern_Symbol(id, length)};
     return t;
 }
-Token Token_GetInt(TokenType type, int32_t* integer)
+Token Token_GetInt(TokenType type, int32_t integer)
 {
-    Token t = {type, integer};
+    Token t = {type, (uint32_t)integer};
     return t;
 }
+
+uint32_t Token_ReserveString(TokenArray* array, size_t size)
+{
+    if (array->stringsLength + size > array->maxStringsLength)
+    {
+        while (array->stringsLength + size > array->maxStringsLength)
+            array->maxStringsLength *= 2;
+        array->strings = xrealloc(array->strings, array->maxStringsLength);
+    }
+
+    uint32_t offset = (uint32_t)array->stringsLength;
+    array->stringsLength += size;
+    return offset;
+}
+
+char* Token_StringAt(const TokenArray* array, uint32_t offset)
+{
+    return array->strings + (size_t)offset;
+}
+
+void* Token_GetData(const Token* token)
+{
+    switch (token->type)
+    {
+        case Identifier: return Intern_GetSymbol(token->data);
+        case StringLiteral:
+        case AsmKeyword: return Token_StringAt(ctx->currentTokenArray, token->data);
+        case IntLiteral: return (void*)&token->data;
+        default: return NULL;
+    }
+}
 TokenArray* Token_CreateArray(size_t size)
 {
     TokenArray* arr = xmalloc(sizeof(TokenArray));
@@ -87,84 +167,146 @@ TokenArray* Token_CreateArray(size_t size)
     arr->locationsCount = 0;
     arr->maxLocationsCount = 32;
     arr->locations = xmalloc(sizeof(TokenSourceGroup) * 32);
+    arr->currentFileId = 0;
+    arr->stringsLength = 0;
+    arr->maxStringsLength = 1024;
+    arr->strings = xmalloc(arr->maxStringsLength);
 
-    currentTokenArray = arr;
+    ctx->currentTokenArray = arr;
 
     return arr;
 }
 
 void Token_DeleteArray(TokenArray* array)
 {
-    // Freeing the strings is a little more involved, as they are
-    // reused for many locations
-    for (size_t i = 0; i < array->locationsCount; i++)
-    {
-        void* cur = array->locations[i].location.sourceFile;
-        void* next;
-        if (i + 1 >= array->locationsCount)
-            next = NULL;
-        else
-            next = array->locations[i + 1].location.sourceFile;
-
-        if (cur != next)
-            free(cur);
-    }
-    for (size_t i = 0; i < array->curLength; i++)
-    {
-        void* data = array->tokens[i].data;
-        if (data)
-            free(data);
-    }
+    // Token payloads are stored inline or in the string pool
+    free(array->strings);
     free(array->tokens);
     free(array->locations);
     free(array);
 }
-void Token_AppendArray(Token t, TokenArray* array, uint16_t lineNumber, char* sourceFile)
+void Token_AppendArray(Token t, TokenArray* array, uint32_t lineNumber)
 {
     if (array->curLength + 1 > array->maxLength)
     {
         array->tokens = xrealloc(array->tokens, (array->maxLength *= 2) * sizeof(Token));
     }
 
-    StoreLocation(array, array->curLength, lineNumber, sourceFile);
+    StoreLocation(array, array->curLength, lineNumber);
     array->tokens[array->curLength++] = t;
 }
 
+void Token_AppendTokens(TokenArray* array, const Token* tokens, size_t count, const TokenSourceGroup* locations,
+                        size_t locationsCount, const char* strings, size_t stringsLength)
+{
+    if (count == 0)
+        return;
+
+    while (array->curLength + count > array->maxLength)
+        array->maxLength *= 2;
+    array->tokens = xrealloc(array->tokens, array->maxLength * sizeof(Token));
+
+    while (array->locationsCount + locationsCount > array->maxLocationsCount)
+        array->maxLocationsCount *= 2;
+    array->locations = xrealloc(array->locations, array->maxLocationsCount * sizeof(TokenSourceGroup));
+
+    uint32_t stringBase = Token_ReserveString(array, stringsLength);
+    memcpy(Token_StringAt(array, stringBase), strings, stringsLength);
+
+    size_t tokenBase = array->curLength;
+    for (size_t i = 0; i < count; i++)
+    {
+        Token t = tokens[i];
+        if (t.type == StringLiteral || t.type == AsmKeyword)
+            t.data += stringBase;
+        array->tokens[tokenBase + i] = t;
+    }
+    array->curLength += count;
+
+    for (size_t i = 0; i < locationsCount; i++)
+    {
+        TokenSourceGroup group = locations[i];
+        group.highestTokenIndex += (uint32_t)tokenBase;
+        array->locations[array->locationsCount++] = group;
+    }
+}
+
+void Token_Release(TokenArray* array, size_t count)
+{
+    if (count == 0)
+        return;
+
+    // Strings are appended in token order, so everything below the
+    // first string of a remaining token belongs to released tokens.
+    size_t firstString = array->stringsLength;
+    for (size_t i = count; i < array->curLength; i++)
+    {
+        TokenType type = array->tokens[i].type;
+        if ((type == StringLiteral || type == AsmKeyword) && (size_t)array->tokens[i].data < firstString)
+            firstString = (size_t)array->tokens[i].data;
+    }
+
+    for (size_t i = count; i < array->curLength; i++)
+    {
+        Token t = array->tokens[i];
+        if (t.type == StringLiteral || t.type == AsmKeyword)
+            t.data -= (uint32_t)firstString;
+        array->tokens[i - count] = t;
+    }
+    array->curLength -= count;
+
+    for (size_t i = firstString; i < array->stringsLength; i++)
+        array->strings[i - firstString] = array->strings[i];
+    array->stringsLength -= firstString;
+
+    size_t firstLocation = 0;
+    while (firstLocation < array->locationsCount &&
+           (size_t)array->locations[firstLocation].highestTokenIndex < count)
+        firstLocation++;
+    for (size_t i = firstLocation; i < array->locationsCount; i++)
+    {
+        TokenSourceGroup group = array->locations[i];
+        group.highestTokenIndex -= (uint32_t)count;
+        array->locations[i - firstLocation] = group;
+    }
+    array->locationsCount -= firstLocation;
+}
+
 // Some helper methods for easier parsing
 void* PopNext(size_t* i, TokenType type)
 {
-    if (++(*i) >= currentTokenArray->curLength)
+    if (++(*i) >= ctx->currentTokenArray->curLength)
         SyntaxErrorAtIndex(*i - 1);
-    if (currentTokenArray->tokens[*i].type != type)
+    if (ctx->currentTokenArray->tokens[*i].type != type)
         SyntaxErrorAtIndex(*i);
         
-    return currentTokenArray->tokens[*i].data;
+    return Token_GetData(&ctx->currentTokenArray->tokens[*i]);
 }
 
 void* PopNextInc(size_t* i, TokenType type)
 {
-    if (++(*i) >= currentTokenArray->curLength)
+    if (++(*i) >= ctx->currentTokenArray->curLength)
         SyntaxErrorAtIndex(*i - 1);
-    if (currentTokenArray->tokens[*i].type != type)
+    if (ctx->currentTokenArray->tokens[*i].type != type)
         SyntaxErrorAtIndex(*i);
-    if (++(*i) >= currentTokenArray->curLength)
+    if (++(*i) >= ctx->currentTokenArray->curLength)
         SyntaxErrorAtIndex(*i - 1);
 
-    return currentTokenArray->tokens[(*i) - 1].data;
+    return Token_GetData(&ctx->currentTokenArray->tokens[(*i) - 1]);
 }
 
 void* PopCur(size_t* i, TokenType type)
 {
-    if (currentTokenArray->tokens[*i].type != type)
+    if (ctx->currentTokenArray->tokens[*i].type != type)
         SyntaxErrorAtIndex(*i);
-    if (++(*i) >= currentTokenArray->curLength)
+    if (++(*i) >= ctx->currentTokenArray->curLength)
         SyntaxErrorAtIndex(*i - 1);
 
-    return currentTokenArray->tokens[(*i) - 1].data;
+    return Token_GetData(&ctx->currentTokenArray->tokens[(*i) - 1]);
 }
 
 void Inc(size_t* i)
 {
-    if (++(*i) >= currentTokenArray->curLength)
+    if (++(*i) >= ctx->currentTokenArray->curLength)
         SyntaxErrorAtIndex(*i);
 }
\ No newline at end of file
@@ -114,28 +114,35 @@ typedef enum
     PointerToken,
 } TokenType;
 
+// Tokens are packed into 8 bytes, with the payload stored inline:
+// IntLiteral: the value itself
+// Identifier: the interned symbol id
+// StringLiteral, AsmKeyword: offset of the text in the string pool of the token array
 typedef struct
 {
     TokenType type;
-    void* data;
+    uint32_t data;
 } Token;
 
 Token Token_Get(TokenType type);
 
-Token Token_GetString(TokenType type, char* string);
+Token Token_GetIdentifier(const char* id, size_t length);
 
-Token Token_GetInt(TokenType type, int32_t* integer);
+Token Token_GetInt(TokenType type, int32_t integer);
 
 typedef struct
 {
-    uint16_t lineNumber;
+    uint32_t lineNumber;
     char* sourceFile;
 } SourceLocation;
 
+// All tokens up to highestTokenIndex (and after the previous group)
+// are on the same line of the same file.
 typedef struct
 {
-    size_t highestTokenIndex;
-    SourceLocation location;
+    uint32_t highestTokenIndex;
+    uint32_t lineNumber;
+    uint32_t fileId;
 } TokenSourceGroup;
 
 typedef struct
@@ -148,12 +155,43 @@ typedef struct
     size_t maxLocationsCount;
     TokenSourceGroup* locations;
 
+    // Text of string literals and inline assembly
+    char* strings;
+    size_t stringsLength;
+    size_t maxStringsLength;
+
+    // File that appended tokens are attributed to
+    uint32_t currentFileId;
 } TokenArray;
 
 TokenArray* Token_CreateArray(size_t size);
 void Token_DeleteArray(TokenArray* array);
 
-void Token_AppendArray(Token t, TokenArray* array, uint16_t lineNumber, char* sourceFile);
+void Token_AppendArray(Token t, TokenArray* array, uint32_t lineNumber);
+// Appends a previously lexed token stream, e.g. a cached header. Token indices in locations
+// are relative to the first token, string offsets relative to the start of strings.
+void Token_AppendTokens(TokenArray* array, const Token* tokens, size_t count, const TokenSourceGroup* locations,
+                        size_t locationsCount, const char* strings, size_t stringsLength);
+
+// File ids are the interned file names, so they are shared by all token arrays.
+uint32_t Token_GetFileId(const char* sourceFile);
+char* Token_GetFileName(uint32_t fileId);
+// Attributes tokens appended from now on to the given file. Returns the previous file.
+uint32_t Token_SetSourceFile(TokenArray* array, uint32_t fileId);
+
+// Drops the first count tokens with their locations and strings. The remaining
+// tokens move to the front, so their indices and string offsets change.
+void Token_Release(TokenArray* array, size_t count);
+
+// Reserves size bytes in the string pool and returns their offset.
+// Pointers into the pool are only stable until more tokens are lexed or released.
+uint32_t Token_ReserveString(TokenArray* array, size_t size);
+char* Token_StringAt(const TokenArray* array, uint32_t offset);
+
+// Returns the payload of a token of the current token array as a pointer:
+// the string for identifiers, string literals and inline assembly, a
+// pointer to the value for int literals and NULL otherwise.
+void* Token_GetData(const Token* token);
 
 SourceLocation Token_GetLocation(size_t tokenIndex);
 SourceLocation Token_GetLocationP(const Token* token);
@@ -162,4 +200,14 @@ void* PopNext(size_t* i, TokenType type);
 void* PopNextInc(size_t* i, TokenType type);
 void* PopCur(size_t* i, TokenType type);
 void Inc(size_t* i);
-void Token_SetTokenArray(const TokenArray* t);
\ No newline at end of file
+void Token_SetTokenArray(const TokenArray* t);
+
+#ifndef CUSTOM_COMP
+typedef struct TokenContext TokenContext;
+#endif
+#ifdef CUSTOM_COMP
+typedef struct TokenContext {} TokenContext;
+#endif
+TokenContext* Token_CreateContext();
+void Token_DisposeContext(TokenContext* context);
+void Token_UseContext(TokenContext* context);
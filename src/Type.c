@@ -66,9 +66,11 @@ bool IsDataToken(Token token, Scope* scope)
         case Identifier:
             if (scope == NULL)
                 return true;
-            return Scope_FindStruct(scope, token.data) != NULL || 
-                Scope_FindEnum(scope, token.data) != NULL ||
-                Scope_FindTypedef(scope, token.data) != NULL;
+        {
+            char* id = Token_GetData(&token);
+            return Scope_FindStruct(scope, id) != NULL || Scope_FindEnum(scope, id) != NULL ||
+                   Scope_FindTypedef(scope, id) != NULL;
+        }
 
         default:
             return false;
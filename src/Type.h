@@ -13,11 +13,8 @@ typedef enum
     Qualifier_Restrict = 4,
     Qualifier_Register = 8,
     Qualifier_Static = 16,
+    // The address of the variable is taken, so it has to be on the stack
     Qualifier_Stack = 32,
-    // Stack and Register force,
-    // these are just recommendations
-    Qualifier_OptimizerStack = 64,
-    Qualifier_OptimizerRegister = 128,
 } Qualifiers;
 
 // Currently in the process of transitioning VariableType
@@ -68,18 +65,24 @@ typedef struct
     Function func;
 } VariableTypeFunctionPointer;
 
-// FIXME, there's no extern, so currently these are defined and allocd for every TU
+// FIXME, there's no extern, so currently these are defined and allocd for every TU.
+// They are reference counted, so every thread needs its own copy.
 #ifndef CUSTOM_COMP
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wunused-variable"
+static _Thread_local VariableType AnyVariableType = {None, Qualifier_None, 1};
+static _Thread_local VariableType MachineUIntType = {UintKeyword, Qualifier_None, 1};
+static _Thread_local VariableType MachineIntType = {IntKeyword, Qualifier_None, 1};
+static _Thread_local VariableType MachineInt32Type = {Int32Keyword, Qualifier_None, 1};
+static _Thread_local VariableType MachineUInt32Type = {Uint32Keyword, Qualifier_None, 1};
+#pragma GCC diagnostic pop
 #endif
+#ifdef CUSTOM_COMP
 static VariableType AnyVariableType = {None, Qualifier_None, 1};
 static VariableType MachineUIntType = {UintKeyword, Qualifier_None, 1};
 static VariableType MachineIntType = {IntKeyword, Qualifier_None, 1};
 static VariableType MachineInt32Type = {Int32Keyword, Qualifier_None, 1};
 static VariableType MachineUInt32Type = {Uint32Keyword, Qualifier_None, 1};
-#ifndef CUSTOM_COMP
-#pragma GCC diagnostic pop
 #endif
 
 VariableType* Type_AddReference(VariableType* type);
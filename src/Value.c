@@ -1,6 +1,7 @@
 #include "Value.h"
-#include "Outfile.h"
+#include "IR.h"
 #include "Register.h"
+#include "Relocation.h"
 #include "Stack.h"
 #include "Variables.h"
 
@@ -9,7 +10,7 @@
 int Value_GetR0(const Value* v)
 {
     assert(v->addressType == AddressType_Register || v->addressType == AddressType_MemoryRegister);
-    return ((uint16_t)v->address) % 8;
+    return ((uint16_t)v->address) % Register_End;
 }
 
 int Value_GetR1(const Value* v)
@@ -18,7 +19,7 @@ int Value_GetR1(const Value* v)
     assert(v->address != (int32_t)(-1));
     if (v->size < 2)
         return -1;
-    return ((uint16_t)v->address) / 8;
+    return ((uint16_t)v->address) / Register_End;
 }
 
 void Value_ValueAddrToStackPointer(const Value* v)
@@ -29,12 +30,12 @@ void Value_ValueAddrToStackPointer(const Value* v)
 
 Value Value_FromRegister(int r0)
 {
-    return (Value){(int32_t)r0, AddressType_Register, 1};
+    return (Value){(int32_t)r0, AddressType_Register, 1, false};
 }
 
 Value Value_FromRegisters(int r0, int r1)
 {
-    return (Value){(int32_t)(r0 + r1 * 8), AddressType_Register, 2};
+    return (Value){(int32_t)(r0 + r1 * Register_End), AddressType_Register, 2, false};
 }
 
 Value Value_Register(int size)
@@ -63,7 +64,7 @@ Value Value_GetLowerWord(const Value* value)
             break;
         case AddressType_Register:
             if (retval.address != -1)
-                retval.address = (int32_t)(((int16_t)retval.address) % 8);
+                retval.address = (int32_t)(((int16_t)retval.address) % Register_End);
             break;
         default:
             break;
@@ -81,7 +82,7 @@ Value Value_GetUpperWord(const Value* value, bool* oReadOnly)
     {
         case AddressType_Register:
             if (retval.address != -1)
-                retval.address = (int32_t)(((int16_t)retval.address) / 8);
+                retval.address = (int32_t)(((int16_t)retval.address) / Register_End);
             *oReadOnly = true;
             break;
         case AddressType_Memory:
@@ -92,11 +93,13 @@ Value Value_GetUpperWord(const Value* value, bool* oReadOnly)
 #ifndef CUSTOM_COMP
             retval.address >>= 16;
 #endif
+            // Data addresses fit into the lower word
+            retval.dataRelative = false;
             *oReadOnly = true;
             break;
         case AddressType_MemoryRegister:
             retval = Value_Register(1);
-            OutWrite("add r%i, r%i, 1\n", Value_GetR0(&retval), Value_GetR0(value));
+            IR_Emit3(IR_Add, IR_Register(Value_GetR0(&retval)), IR_Register(Value_GetR0(value)), IR_Literal((int32_t)1));
             retval.addressType = AddressType_MemoryRegister;
             *oReadOnly = false;
             break;
@@ -114,6 +117,10 @@ Value Value_GetUpperWord(const Value* value, bool* oReadOnly)
 
 void Value_FreeValue(Value* value)
 {
+    // The zero register isn't allocated
+    if (value->addressType == AddressType_Register && value->address == -1)
+        return;
+
     if (value->addressType == AddressType_Register || value->addressType == AddressType_MemoryRegister)
     {
         assert(Value_GetR0(value) != -1);
@@ -137,20 +144,49 @@ void Value_FreeValue(Value* value)
     }*/
 }
 
+void Value_Reserve(Value* value)
+{
+    if (value->addressType == AddressType_Register && value->address == -1)
+        return;
+
+    if (value->addressType == AddressType_Register || value->addressType == AddressType_MemoryRegister)
+    {
+        Register_GetSpecific(Value_GetR0(value));
+        if (value->size == 2 && value->addressType != AddressType_MemoryRegister)
+            Register_GetSpecific(Value_GetR1(value));
+    }
+}
+
 Value Value_MemoryRelative(int addr, int size)
 {
-    return (Value){(int32_t)addr, AddressType_MemoryRelative, size};
+    return (Value){(int32_t)addr, AddressType_MemoryRelative, size, false};
 }
 
 Value Value_Memory(uint16_t addr, int size)
 {
-    return (Value){(int32_t)addr, AddressType_Memory, size};
+    return (Value){(int32_t)addr, AddressType_Memory, size, false};
+}
+
+IROperand Value_LiteralOperand(const Value* value, int word)
+{
+    if (word != 0)
+        return IR_Literal(value->address >> 16);
+    IROperand operand = IR_Literal(value->address & 0xFFFF);
+    operand.dataRelative = value->dataRelative;
+    return operand;
+}
+
+IROperand Value_MemoryOperand(const Value* value, int32_t offset)
+{
+    IROperand operand = IR_Memory(value->address + offset);
+    operand.dataRelative = value->dataRelative;
+    return operand;
 }
 
 Value Value_Literal(int32_t literal)
 {
 #ifndef CUSTOM_COMP
-    return (Value){literal, AddressType_Literal, (uint32_t)literal > 0xFFFF ? 2 : 1};
+    return (Value){literal, AddressType_Literal, (uint32_t)literal > 0xFFFF ? 2 : 1, false};
 #endif
 // TODO replace this with ternary once implemented.
 #ifdef CUSTOM_COMP
@@ -159,7 +195,7 @@ Value Value_Literal(int32_t literal)
         size = 2;
     else
         size = 1;
-    return (Value){literal, AddressType_Literal, size};
+    return (Value){literal, AddressType_Literal, size, false};
 #endif
 }
 
@@ -174,24 +210,28 @@ void Value_GenerateMemCpy(Value dstValue, Value srcValue)
     //    (dstValue.addressType == AddressType_MemoryRelative && GetStackPointerDelta(dstValue.address) < 0))
     //   AlignStack();
 
+    // The zero register is copied as the literal it stands for
+    if (srcValue.addressType == AddressType_Register && srcValue.address == -1)
+        srcValue = Value_Literal((int32_t)0);
+
     // Quickly handle Literals
     if (srcValue.addressType == AddressType_Literal)
     {
         if (dstValue.addressType == AddressType_Register)
         {
-            OutWrite("mov r%i, %i\n", Value_GetR0((&dstValue)), srcValue.address & 0xFFFF);
+            IR_EmitMove(IR_Mov, IR_Register(Value_GetR0(&dstValue)), Value_LiteralOperand(&srcValue, 0));
             if (dstValue.size == 2)
-                OutWrite("mov r%i, %i\n", Value_GetR1(&dstValue), srcValue.address >> 16);
+                IR_EmitMove(IR_Mov, IR_Register(Value_GetR1(&dstValue)), Value_LiteralOperand(&srcValue, 1));
         }
         else if (dstValue.addressType == AddressType_Memory)
         {
             int temp = Registers_GetFree();
-            OutWrite("mov r%i, %i\n", temp, srcValue.address & 0xFFFF);
-            OutWrite("mov [%i], r%i\n", dstValue.address, temp);
+            IR_EmitMove(IR_Mov, IR_Register(temp), Value_LiteralOperand(&srcValue, 0));
+            IR_EmitMove(IR_Mov, Value_MemoryOperand(&dstValue, (int32_t)0), IR_Register(temp));
             if (dstValue.size == 2)
             {
-                OutWrite("mov r%i, %i\n", temp, srcValue.address & 0xFFFF);
-                OutWrite("mov [%i], r%i\n", dstValue.address + 1, srcValue.address >> 16);
+                IR_EmitMove(IR_Mov, IR_Register(temp), Value_LiteralOperand(&srcValue, 1));
+                IR_EmitMove(IR_Mov, Value_MemoryOperand(&dstValue, (int32_t)1), IR_Register(temp));
             }
             Register_Free(temp);
         }
@@ -200,22 +240,22 @@ void Value_GenerateMemCpy(Value dstValue, Value srcValue)
         {
 
             Stack_ToAddress((int)dstValue.address);
-            OutWrite("mov [sp++], %i\n", srcValue.address & 0xFFFF);
+            IR_EmitMove(IR_Mov, IR_Push(), Value_LiteralOperand(&srcValue, 0));
             Stack_Offset(1);
             if (dstValue.size == 2)
             {
-                OutWrite("mov [sp++], %i\n", srcValue.address >> 16);
+                IR_EmitMove(IR_Mov, IR_Push(), Value_LiteralOperand(&srcValue, 1));
                 Stack_Offset(1);
             }
         }
         else if (dstValue.addressType == AddressType_MemoryRegister)
         {
-            OutWrite("mov [r%i], %i\n", Value_GetR0(&dstValue), srcValue.address & 0xFFFF);
+            IR_EmitMove(IR_Mov, IR_MemoryRegister(Value_GetR0(&dstValue)), Value_LiteralOperand(&srcValue, 0));
             if (dstValue.size == 2)
             {
-                OutWrite("add r%i, 1\n", Value_GetR0(&dstValue));
-                OutWrite("mov [r%i], %i\n", Value_GetR0(&dstValue), srcValue.address >> 16);
-                OutWrite("sub r%i, 1\n", Value_GetR0(&dstValue));
+                IR_Emit2(IR_Add, IR_Register(Value_GetR0(&dstValue)), IR_Literal((int32_t)1));
+                IR_EmitMove(IR_Mov, IR_MemoryRegister(Value_GetR0(&dstValue)), Value_LiteralOperand(&srcValue, 1));
+                IR_Emit2(IR_Sub, IR_Register(Value_GetR0(&dstValue)), IR_Literal((int32_t)1));
             }
         }
         else
@@ -253,6 +293,9 @@ void Value_GenerateMemCpy(Value dstValue, Value srcValue)
             block_size = Registers_GetNumFree();
             if (block_size > size)
                 block_size = size;
+            // Copied through a virtual register
+            if (block_size == 0)
+                block_size = 1;
         }
         else
             block_size = 1;
@@ -277,32 +320,33 @@ void Value_GenerateMemCpy(Value dstValue, Value srcValue)
                     int delta = Stack_GetDelta((int)srcValue.address);
                     if (delta >= 0 && delta <= 255)
                     {
-                        OutWrite("mov r%i, [sp-%i]\n", regs[j], delta);
+                        IR_EmitMove(IR_Mov, IR_Register(regs[j]), IR_Stack(delta));
                     }
                     else
                     {
                         Stack_ToAddress((int)srcValue.address);
                         if (size > 1)
                         {
-                            OutWrite("mov r%i, [sp++]\n", regs[j]);
+                            IR_EmitMove(IR_Mov, IR_Register(regs[j]), IR_Push());
                             Stack_Offset(1);
                         }
                         else
                         {
-                            OutWrite("mov r%i, [sp]\n", regs[j]);
+                            IR_EmitMove(IR_Mov, IR_Register(regs[j]), IR_Stack(0));
                         }
                     }
                     (srcValue.address)--;
                 }
                 else if (srcValue.addressType == AddressType_MemoryRegister)
                 {
-                    OutWrite("mov r%i, [r%i]\n", regs[j], Value_GetR0(&srcValue));
+                    IR_EmitMove(IR_Mov, IR_Register(regs[j]), IR_MemoryRegister(Value_GetR0(&srcValue)));
                     if (size - i - j != 1)
-                        OutWrite("add r%i, 1\n", Value_GetR0(&srcValue));
+                        IR_Emit2(IR_Add, IR_Register(Value_GetR0(&srcValue)), IR_Literal((int32_t)1));
                 }
                 else if (srcValue.addressType == AddressType_Memory)
                 {
-                    OutWrite("mov r%i, [%i]\n", regs[j], srcValue.address++);
+                    IR_EmitMove(IR_Mov, IR_Register(regs[j]), Value_MemoryOperand(&srcValue, (int32_t)0));
+                    srcValue.address++;
                 }
             }
 
@@ -319,39 +363,40 @@ void Value_GenerateMemCpy(Value dstValue, Value srcValue)
                     int delta = Stack_GetDelta((int)dstValue.address);
                     if (delta > 0 && delta <= 255)
                     {
-                        OutWrite("mov [sp-%i], r%i\n", delta, regs[j]);
+                        IR_EmitMove(IR_Mov, IR_Stack(delta), IR_Register(regs[j]));
                     }
                     else
                     {
                         Stack_ToAddress((int)dstValue.address);
                         // if (size > 1)
                         {
-                            OutWrite("mov [sp++], r%i\n", regs[j]);
+                            IR_EmitMove(IR_Mov, IR_Push(), IR_Register(regs[j]));
                             Stack_Offset(1);
                         }
                         /*else
                         {
-                            OutWrite("mov [sp], r%i\n", regs[j]);
+                            IR_EmitMove(IR_Mov, IR_Stack(0), IR_Register(regs[j]));
                         }*/
                     }
                     dstValue.address--;
                 }
                 else if (dstValue.addressType == AddressType_MemoryRegister)
                 {
-                    OutWrite("mov [r%i], r%i\n", Value_GetR0(&dstValue), regs[j]);
+                    IR_EmitMove(IR_Mov, IR_MemoryRegister(Value_GetR0(&dstValue)), IR_Register(regs[j]));
                     if (size - i - j != 1)
-                        OutWrite("add r%i, 1\n", Value_GetR0(&dstValue));
+                        IR_Emit2(IR_Add, IR_Register(Value_GetR0(&dstValue)), IR_Literal((int32_t)1));
                 }
                 else if (dstValue.addressType == AddressType_Memory)
                 {
-                    OutWrite("mov [%i], r%i\n", dstValue.address++, regs[j]);
+                    IR_EmitMove(IR_Mov, Value_MemoryOperand(&dstValue, (int32_t)0), IR_Register(regs[j]));
+                    dstValue.address++;
                 }
                 else if (dstValue.addressType == AddressType_Register)
                 {
                     if (j == 0)
-                        OutWrite("mov r%i, r%i\n", Value_GetR0(&dstValue), regs[j]);
+                        IR_EmitMove(IR_Mov, IR_Register(Value_GetR0(&dstValue)), IR_Register(regs[j]));
                     else if (j == 1)
-                        OutWrite("mov r%i, r%i\n", Value_GetR1(&dstValue), regs[j]);
+                        IR_EmitMove(IR_Mov, IR_Register(Value_GetR1(&dstValue)), IR_Register(regs[j]));
                 }
             }
         i += block_size;
@@ -359,10 +404,10 @@ void Value_GenerateMemCpy(Value dstValue, Value srcValue)
 
     // TODO this is unnecessaty for read-only
     if (srcValue.addressType == AddressType_MemoryRegister && size > 1)
-        OutWrite("sub r%i, %i\n", Value_GetR0(&srcValue), size - 1);
+        IR_Emit2(IR_Sub, IR_Register(Value_GetR0(&srcValue)), IR_Literal((int32_t)(size - 1)));
 
     if (dstValue.addressType == AddressType_MemoryRegister && size > 1)
-        OutWrite("sub r%i, %i\n", Value_GetR0(&dstValue), size - 1);
+        IR_Emit2(IR_Sub, IR_Register(Value_GetR0(&dstValue)), IR_Literal((int32_t)(size - 1)));
 
     // If we allocated registers previously, we free them
     if (srcValue.addressType != AddressType_Register && dstValue.addressType != AddressType_Register)
@@ -375,20 +420,19 @@ void Value_Push(Value* value)
     Stack_Align();
     if (value->addressType == AddressType_Register)
     {
-        OutWrite("mov [sp++], r%i\n", Value_GetR0(value));
+        IR_EmitMove(IR_Mov, IR_Push(), IR_Register(Value_GetR0(value)));
         if (value->size == 2)
-            OutWrite("mov [sp++], r%i\n", Value_GetR1(value));
+            IR_EmitMove(IR_Mov, IR_Push(), IR_Register(Value_GetR1(value)));
 
         assert(value->size == 1 || value->size == 2);
     }
     else if (value->addressType == AddressType_Memory)
     {
         int tmp = Registers_GetFree();
-        int32_t addr = value->address;
         for (int i = 0; i < value->size; i++)
         {
-            OutWrite("mov r%i, [%i]\n", tmp, addr++);
-            OutWrite("mov [sp++], r%i\n", tmp);
+            IR_EmitMove(IR_Mov, IR_Register(tmp), Value_MemoryOperand(value, (int32_t)i));
+            IR_EmitMove(IR_Mov, IR_Push(), IR_Register(tmp));
         }
         Register_Free(tmp);
     }
@@ -402,9 +446,9 @@ void Value_Push(Value* value)
     else if (value->addressType == AddressType_Literal)
     {
         assert(value->size == 1 || value->size == 2);
-        OutWrite("mov [sp++], %i\n", value->address & 0xFFFF);
+        IR_EmitMove(IR_Mov, IR_Push(), Value_LiteralOperand(value, 0));
         if (value->size == 2)
-            OutWrite("mov [sp++], %i\n", value->address >> 16);
+            IR_EmitMove(IR_Mov, IR_Push(), Value_LiteralOperand(value, 1));
     }
 
     Stack_OffsetSize(value->size);
@@ -414,15 +458,15 @@ void Value_MemSet(Value* value, uint16_t n)
 {
     if (value->addressType == AddressType_Register)
     {
-        OutWrite("mov r%i, %i\n", Value_GetR0(value), n);
+        IR_EmitMove(IR_Mov, IR_Register(Value_GetR0(value)), IR_Literal((int32_t)n));
         if (value->size == 2)
-            OutWrite("mov r%i, %i\n", Value_GetR1(value), n);
+            IR_EmitMove(IR_Mov, IR_Register(Value_GetR1(value)), IR_Literal((int32_t)n));
     }
 
     if (value->addressType == AddressType_Memory)
     {
         for (int i = 0; i < value->size; i++)
-            OutWrite("mov [%i], %i\n", value->address + (int32_t)i, n);
+            IR_EmitMove(IR_Mov, Value_MemoryOperand(value, (int32_t)i), IR_Literal((int32_t)n));
     }
 
     if (value->addressType == AddressType_MemoryRelative)
@@ -431,13 +475,13 @@ void Value_MemSet(Value* value, uint16_t n)
 
         for (int i = 0; i < value->size; i++)
         {
-            OutWrite("mov [sp++], %i\n", n);
+            IR_EmitMove(IR_Mov, IR_Push(), IR_Literal((int32_t)n));
             Stack_Offset(1);
         }
     }
 }
 
-void PrintValueAsOperand(const Value* val)
+IROperand Value_ToOperand(const Value* val)
 {
     switch (val->addressType)
     {
@@ -446,30 +490,22 @@ void PrintValueAsOperand(const Value* val)
             // TODO put this in the switch, once the implemenation
             // doesn't create a jump table from 8 to 0xFFFF
             if (val->address == -1)
-            {
-                OutWrite("rz"); // Zero register
-                return;
-            }
+                return IR_Zero();
 
             switch ((int)val->address)
             {
                 case Register_IP:
-                    OutWrite("ip");
-                    return;
+                    return IR_IP();
                 case Register_SP:
-                    OutWrite("sp");
-                    return;
+                    return IR_SP();
                 default:
-                    OutWrite("r%i", val->address);
-                    return;
+                    return IR_Register(Value_GetR0(val));
             }
             break;
         case AddressType_Memory:
-            OutWrite("[%i]", val->address);
-            break;
+            return Value_MemoryOperand(val, (int32_t)0);
         case AddressType_MemoryRegister:
-            OutWrite("[r%i]", val->address);
-            break;
+            return IR_MemoryRegister(Value_GetR0(val));
         case AddressType_MemoryRelative:;
             int delta = Stack_GetOffset() + (int)val->address;
             assert(delta >= 0);
@@ -478,20 +514,18 @@ void PrintValueAsOperand(const Value* val)
             {
                 // If the address is at the top of the stack, increment
                 // the sp as well, to keep the stack aligned.
-                OutWrite("[sp++]", delta);
                 Stack_Offset(1);
+                return IR_Push();
             }
-            else if (delta == 0)
-                OutWrite("[sp]", delta);
-            else
-                OutWrite("[sp-%i]", delta);
-            break;
-        case AddressType_Literal:
-            OutWrite("%i", val->address);
-            break;
+            return IR_Stack(delta);
+        case AddressType_Literal:;
+            IROperand literal = IR_Literal(val->address);
+            literal.dataRelative = val->dataRelative;
+            return literal;
         default:
             assert(0);
     }
+    return IR_Zero();
 }
 
 // Stores whether the value is true or false in the zero flag.
@@ -501,12 +535,12 @@ void Value_ToFlag(Value* value)
     if (value->addressType == AddressType_Register)
     {
         if (value->size == 1)
-            OutWrite("add r%i, 0\n", Value_GetR0(value));
+            IR_Emit2(IR_Add, IR_Register(Value_GetR0(value)), IR_Literal((int32_t)0));
         else if (value->size == 2)
         {
             int temp = Registers_GetFree();
-            OutWrite("mov r%i, r%i\n", temp, Value_GetR0(value));
-            OutWrite("or r%i, r%i\n", temp, Value_GetR1(value));
+            IR_EmitMove(IR_Mov, IR_Register(temp), IR_Register(Value_GetR0(value)));
+            IR_Emit2(IR_Or, IR_Register(temp), IR_Register(Value_GetR1(value)));
             Register_Free(temp);
         }
         return;
@@ -514,12 +548,12 @@ void Value_ToFlag(Value* value)
     if (value->addressType == AddressType_Memory)
     {
         if (value->size == 1)
-            OutWrite("add [%i], rz\n", value->address);
+            IR_Emit2(IR_Add, Value_MemoryOperand(value, (int32_t)0), IR_Zero());
         else if (value->size == 2)
         {
             int temp = Registers_GetFree();
-            OutWrite("mov r%i, [%i]\n", temp, value->address);
-            OutWrite("or r%i, [%i]\n", temp, value->address + (int32_t)1);
+            IR_EmitMove(IR_Mov, IR_Register(temp), Value_MemoryOperand(value, (int32_t)0));
+            IR_Emit2(IR_Or, IR_Register(temp), Value_MemoryOperand(value, (int32_t)1));
             Register_Free(temp);
         }
         return;
@@ -527,14 +561,14 @@ void Value_ToFlag(Value* value)
     if (value->addressType == AddressType_MemoryRegister)
     {
         if (value->size == 1)
-            OutWrite("add [r%i], 0\n", Value_GetR0(value));
+            IR_Emit2(IR_Add, IR_MemoryRegister(Value_GetR0(value)), IR_Literal((int32_t)0));
         else if (value->size == 2)
         {
             int temp = Registers_GetFree();
-            OutWrite("mov r%i, [r%i]\n", temp, Value_GetR0(value));
-            OutWrite("add r%i, 1\n", Value_GetR0(value));
-            OutWrite("or r%i, [r%i]\n", temp, Value_GetR0(value));
-            OutWrite("sub r%i, 1\n", Value_GetR0(value));
+            IR_EmitMove(IR_Mov, IR_Register(temp), IR_MemoryRegister(Value_GetR0(value)));
+            IR_Emit2(IR_Add, IR_Register(Value_GetR0(value)), IR_Literal((int32_t)1));
+            IR_Emit2(IR_Or, IR_Register(temp), IR_MemoryRegister(Value_GetR0(value)));
+            IR_Emit2(IR_Sub, IR_Register(Value_GetR0(value)), IR_Literal((int32_t)1));
             Register_Free(temp);
         }
         return;
@@ -546,12 +580,12 @@ void Value_ToFlag(Value* value)
             int delta = Stack_GetDelta((int)value->address);
             if (delta <= 255 && delta > 0)
             {
-                OutWrite("add rz, [sp-%u]\n", delta);
+                IR_Emit2(IR_Add, IR_Zero(), IR_Stack(delta));
             }
             else
             {
                 Stack_ToAddress((int)value->address);
-                OutWrite("add rz, [sp]\n");
+                IR_Emit2(IR_Add, IR_Zero(), IR_Stack(0));
             }
         }
         // todo make this sp-relative too
@@ -559,9 +593,9 @@ void Value_ToFlag(Value* value)
         {
             Stack_ToAddress((int)value->address);
             int temp = Registers_GetFree();
-            OutWrite("mov r%i, [sp]\n", temp);
+            IR_EmitMove(IR_Mov, IR_Register(temp), IR_Stack(0));
             Stack_ToAddress((int)value->address + 1);
-            OutWrite("or r%i, [sp]\n", temp);
+            IR_Emit2(IR_Or, IR_Register(temp), IR_Stack(0));
             Register_Free(temp);
         }
         return;
@@ -569,10 +603,10 @@ void Value_ToFlag(Value* value)
 
     if (value->addressType == AddressType_Literal)
     {
-        if (value->address != 0)
-            OutWrite("add rz, 1\n");
+        if (!Relocation_IsZero(value->address, value->dataRelative))
+            IR_Emit2(IR_Add, IR_Zero(), IR_Literal((int32_t)1));
         else
-            OutWrite("add rz, 0\n");
+            IR_Emit2(IR_Add, IR_Zero(), IR_Literal((int32_t)0));
         return;
     }
 
@@ -581,10 +615,11 @@ void Value_ToFlag(Value* value)
 
 bool Value_Equals(const Value* a, const Value* b)
 {
-    return a->address == b->address && a->addressType == b->addressType && a->size == b->size;
+    return a->addressType == b->addressType && a->size == b->size &&
+           Relocation_Equal(a->address, a->dataRelative, b->address, b->dataRelative);
 }
 
 Value Value_Flag(Flag f)
 {
-    return (Value){(int32_t)f, AddressType_Flag, -1};
+    return (Value){(int32_t)f, AddressType_Flag, -1, false};
 }
@@ -1,6 +1,7 @@
 #pragma once
 #include "Error.h"
 #include "Flags.h"
+#include "IR.h"
 #include "Register.h"
 #include "Stack.h"
 #include "assert.h"
@@ -25,16 +26,18 @@ typedef struct
     int32_t address;
     AddressType addressType;
     int size;
+    // The literal or memory address is a data address of the unit, see Relocation.h
+    bool dataRelative;
 } Value;
 
 #ifndef CUSTOM_COMP
-static const Value NullValue = {-1, AddressType_None, -1};
-static const Value FlagValue = {Flag_None, AddressType_Flag, -1};
+static const Value NullValue = {-1, AddressType_None, -1, false};
+static const Value FlagValue = {Flag_None, AddressType_Flag, -1, false};
 #endif
 
 #ifdef CUSTOM_COMP
-static const Value NullValue = {0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF};
-static const Value FlagValue = {(int32)Flag_None, AddressType_Flag, 0xFFFF};
+static const Value NullValue = {0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0};
+static const Value FlagValue = {(int32)Flag_None, AddressType_Flag, 0xFFFF, 0};
 #endif
 
 int Value_GetR0(const Value* v);
@@ -49,6 +52,8 @@ Value Value_FromRegisters(int r0, int r1);
 Value Value_Register(int size);
 
 void Value_FreeValue(Value* value);
+// Takes the registers of a value that was freed again, they have to be free
+void Value_Reserve(Value* value);
 
 Value Value_MemoryRelative(int addr, int size);
 
@@ -56,6 +61,11 @@ Value Value_Memory(uint16_t addr, int size);
 
 Value Value_Literal(int32_t literal);
 
+// Operand for the lower (word 0) or upper (word 1) word of a literal value
+IROperand Value_LiteralOperand(const Value* value, int word);
+// [address + offset] of a memory value
+IROperand Value_MemoryOperand(const Value* value, int32_t offset);
+
 Value Value_GetLowerWord(const Value* value);
 
 Value Value_GetUpperWord(const Value* value, bool* oReadOnly);
@@ -75,7 +85,9 @@ void Value_Push(Value* value);
 // Moves n into all words of value
 void Value_MemSet(Value* value, uint16_t n);
 
-void PrintValueAsOperand(const Value* val);
+// Operand of an instruction that accesses the value. Values on top of the stack are
+// accessed with [sp++], which moves the stack pointer offset.
+IROperand Value_ToOperand(const Value* val);
 
 // Sets zero flag if no bits in passed value are set.
 // Otherwise, zero flags is unset. Used for conditional
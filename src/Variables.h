@@ -25,7 +25,10 @@ typedef struct
     VariableType* type;
     char* name;
     Value value;
-    void* lastAccess;
+    // Index in live sets of the function (Liveness.h), -1 if the variable is never released
+    int liveIndex;
+    // Set when the variable is dead, its registers are free
+    bool released;
 } Variable;
 
 void ShiftAddressSpace(Scope* scope, int offset);
@@ -32,6 +32,7 @@ const int ERANGE = 34;
 void assert(bool a);
 
 int strcmp(const char* a, const char* b);
+int memcmp(const void* a, const void* b, size_t len);
 char* strcpy(char* dst, char* src);
 
 void printf(const char* str, ...);
@@ -0,0 +1,23 @@
+# Compiles a regression test with COMP at LEVEL (-O0 or -O1) in WORK_DIR, runs it with
+# EMULATOR and compares the value main returns to the "// expect: N" line of the test.
+file(STRINGS ${TEST} expectLine REGEX "^// expect: -?[0-9]+$")
+if(NOT expectLine)
+    message(FATAL_ERROR "${TEST} has no expect line")
+endif()
+string(REGEX REPLACE "^// expect: " "" expected "${expectLine}")
+
+file(MAKE_DIRECTORY ${WORK_DIR})
+execute_process(COMMAND ${COMP} ${LEVEL} -o ${WORK_DIR}/out.s --data ${WORK_DIR}/data.bin ${TEST}
+                RESULT_VARIABLE compileResult)
+if(NOT compileResult EQUAL 0)
+    message(FATAL_ERROR "Compiling ${TEST} failed")
+endif()
+
+execute_process(COMMAND ${EMULATOR} ${WORK_DIR}/out.s ${WORK_DIR}/data.bin
+                RESULT_VARIABLE runResult OUTPUT_VARIABLE actual OUTPUT_STRIP_TRAILING_WHITESPACE)
+if(NOT runResult EQUAL 0)
+    message(FATAL_ERROR "Running ${TEST} failed: ${actual}")
+endif()
+if(NOT actual STREQUAL expected)
+    message(FATAL_ERROR "main returned ${actual}, expected ${expected}")
+endif()
@@ -0,0 +1,17 @@
+// Copies between array elements whose indices are partly folded to constants
+// expect: 56
+int g[64];
+
+int Copy(int a, int b)
+{
+    int w2 = 0;
+    g[(a >> 4) * (b - a) & 63] = g[(7 * (8 - (w2 | w2))) & 63];
+    return g[0];
+}
+
+int main()
+{
+    // The source index is 7 * (8 - 0) = 56
+    g[56] = 56;
+    return Copy(0, 9);
+}
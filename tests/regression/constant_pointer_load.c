@@ -0,0 +1,18 @@
+// Loads through a pointer whose address is folded to a constant
+// expect: 25
+int g[64];
+
+int Load(int a)
+{
+    int* p = &g[5];
+    int x = *p;
+    g[6] = x + a;
+    return x;
+}
+
+int main()
+{
+    g[5] = 11;
+    int x = Load(3);
+    return x + g[6];
+}
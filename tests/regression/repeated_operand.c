@@ -0,0 +1,38 @@
+// A variable read on both sides of a binary operator, with its last read inside the
+// right operand
+// expect: 112
+int Sum(int a, int b)
+{
+    int v = a + 48;
+    return v + (b - (a & v));
+}
+
+int Compare(int a, int b)
+{
+    int v = a * 3;
+    if (v == (b - (a & v)))
+        return 1;
+    return 0;
+}
+
+int Assign(int a, int b)
+{
+    int v = b - a;
+    int w = v * (a + (v | b));
+    return w;
+}
+
+int Update(int a)
+{
+    int v = a + 2;
+    v += v - (a & v);
+    int w = a - 1;
+    w = (w * 2) - (w | a);
+    return v + w;
+}
+
+int main()
+{
+    // 60 + (56 - 12) = 104, 1, 2 * (12 + 14) = 52, 10 + (10 - 8) + (14 - 15) = 11
+    return Sum(12, 56) + Compare(5, 20) - Assign(12, 14) + Update(8) + 48;
+}
@@ -0,0 +1,26 @@
+// Needs more registers than there are at -O0. A parameter is shifted by an amount equal to
+// its stack offset, which stops fitting the encoding once spill slots move it.
+// expect: 36
+int g[64];
+
+int Store(int a, int b)
+{
+    int c = b - a;
+    for (int i = 0; i < 1; i++)
+    {
+        int d = b;
+        if (((i ^ i) ^ 5) > ((i & 19) | (d + 7)) || ((d << 3) << 0) > c + 10)
+        {
+            int e = 8;
+            for (int j = 0; j < 2; j++)
+                g[((e * 2) & (a + 18)) & 63] = (((b | j) ^ 11) ^ ((12 + b) * (j | a))) & d;
+        }
+    }
+    return (a - a) * ((0 * (a << 4)) - ((b | 17) & (a << 2)));
+}
+
+int main()
+{
+    Store(3, 100);
+    return g[0] + g[16];
+}
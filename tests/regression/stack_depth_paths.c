@@ -0,0 +1,65 @@
+// Code that moves the stack pointer differently on the paths into a label, and values
+// spilled while a store to a parameter left the stack pointer below the parameters.
+// expect: -100
+int g[64];
+
+int Identity(int x)
+{
+    return x;
+}
+
+int Spilled(int a, int b)
+{
+    a = 4;
+    int c = 0;
+    int d = g[((b * 13) & (19 * a)) & 63] + b;
+    int e = a;
+    for (int i = 0; i < 4; i++)
+    {
+        for (int j = 0; j < 5; j++)
+            a += ((c - 9) ^ ((20 | (5 - b)) + ((b + e) + (d - i))));
+    }
+    return a;
+}
+
+int Ternary(int c, int x)
+{
+    int r = 1;
+    r += Identity(c ? (x << 2) : 3);
+    return r;
+}
+
+int FallThrough(int s, int x)
+{
+    switch (s & 7)
+    {
+        case 2: x = 8;
+        case 3: x += s;
+    }
+    return x;
+}
+
+int Break(int n)
+{
+    int r = 0;
+    int k = 0;
+    while (k < 3)
+    {
+        int t = k * 10;
+        for (int i = 0; i < n; i++)
+        {
+            int u = i * 2;
+            if (u > 4)
+                break;
+            r += u + t;
+        }
+        k++;
+    }
+    return r;
+}
+
+int main()
+{
+    return Spilled(1, 2) + Ternary(1, 5) + Ternary(0, 5) + FallThrough(2, 100) + FallThrough(3, 100) +
+           FallThrough(4, 100) + Break(10);
+}
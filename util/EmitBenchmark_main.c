@@ -0,0 +1,90 @@
+// Compares OutWrite (src/Outfile.c), which formats into a memory buffer, against
+// calling vfprintf on the output file for every instruction, as it did before.
+// Both write a typical mix of instructions and operands to /dev/null.
+// Usage: emit_benchmark [NUMBER OF INSTRUCTIONS]
+
+#include "Outfile.h"
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+typedef void (*Writer)(const char* format, ...);
+
+static FILE* directFile;
+
+static void DirectWrite(const char* format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    vfprintf(directFile, format, args);
+    va_end(args);
+}
+
+// Like the code generator, operands are written separately from their instruction
+static void Emit(Writer write, size_t numInstructions)
+{
+    for (size_t i = 0; i < numInstructions; i++)
+    {
+        int32_t r = (int32_t)(i & 7);
+        switch (i % 6)
+        {
+            case 0:
+                write("add ");
+                write("r%i", r);
+                write(", ");
+                write("[%i]", (int32_t)(i & 0x7FFF));
+                write(", %i\n", (int32_t)i - 1000);
+                break;
+            case 1: write("mov r%i, [sp+%u]\n", r, (unsigned)(i & 31)); break;
+            case 2: write("jnz while_end%u\n", (unsigned)i); break;
+            case 3: write("while_loop%zi:\n", (size_t)i); break;
+            case 4: write("_%s:\n", "Value_GenerateMemCpy"); break;
+            case 5: write("mov [sp++], ip\n"); break;
+        }
+    }
+}
+
+static double Now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+int main(int numArgs, char** args)
+{
+    size_t numInstructions = numArgs > 1 ? strtoul(args[1], NULL, 10) : 10000000;
+
+    directFile = fopen("/dev/null", "w");
+    if (directFile == NULL)
+        return 1;
+    // Warm up
+    Emit(DirectWrite, numInstructions / 10);
+    double start = Now();
+    Emit(DirectWrite, numInstructions);
+    fflush(directFile);
+    double directTime = Now() - start;
+    fclose(directFile);
+
+    OutfileContext* context = Outfile_CreateContext();
+    Outfile_UseContext(context);
+    if (!Outfile_TryOpen("/dev/null", "/dev/null"))
+        return 1;
+    Emit(OutWrite, numInstructions / 10);
+    start = Now();
+    for (size_t done = 0; done < numInstructions; done += 1000)
+    {
+        // Flushed between items, as in Compile
+        Emit(OutWrite, 1000);
+        Outfile_FlushIfFull();
+    }
+    Outfile_Flush();
+    double bufferedTime = Now() - start;
+    Outfile_DisposeContext(context);
+
+    printf("vfprintf: %6.2f ns/instruction\n", directTime * 1e9 / (double)numInstructions);
+    printf("OutWrite: %6.2f ns/instruction\n", bufferedTime * 1e9 / (double)numInstructions);
+    return 0;
+}
@@ -0,0 +1,504 @@
+// Runs main of a compiled program and prints the value it returns, for the regression
+// tests in tests/regression. Every instruction takes one word, which is enough for the
+// code the compiler generates, including jump tables. Inline assembly is not supported.
+// Usage: emulator ASSEMBLY DATA
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// The data is loaded at address 0, the stack grows upwards from here
+static const uint16_t STACK_START = 0x8000;
+// main returns to this address, which ends the program
+static const uint16_t EXIT_ADDRESS = 0xFFF0;
+static const uint64_t MAX_STEPS = 100000000;
+
+typedef enum
+{
+    Operand_Register,
+    Operand_Zero,
+    Operand_IP,
+    Operand_SP,
+    Operand_Literal,
+    Operand_Memory,
+    Operand_MemoryRegister,
+    Operand_Stack,
+    Operand_Push,
+    Operand_Label,
+} OperandType;
+
+typedef struct
+{
+    OperandType type;
+    // Register number, literal, address, offset below sp or label index
+    int32_t value;
+    // Name of a label until it is resolved
+    char* name;
+} Operand;
+
+typedef enum
+{
+    Op_Add,
+    Op_Sub,
+    Op_Mul,
+    Op_And,
+    Op_Div,
+    Op_Or,
+    Op_Xor,
+    Op_ShiftLeft,
+    Op_ShiftRight,
+    Op_MulH,
+    Op_MulQ,
+    Op_InvQ,
+    Op_Mov,
+    Op_Not,
+    Op_Jump,
+    Op_Count,
+} Opcode;
+
+static const char* opcodeNames[Op_Count] = {"add", "sub", "mul",  "and",  "div",  "or",  "xor", "shl",
+                                            "shr", "mulh", "mulq", "invq", "mov", "not", "jmp"};
+// Same order as Flag in src/Flags.h
+static const char* flagNames[8] = {"nz", "z", "np", "p", "ns", "s", "nc", "c"};
+
+typedef struct
+{
+    Opcode op;
+    // Index into flagNames, -1 if unconditional
+    int flag;
+    Operand dst;
+    Operand a;
+    Operand b;
+    int lineNumber;
+} Instruction;
+
+typedef struct
+{
+    char* name;
+    size_t index;
+} Label;
+
+typedef struct
+{
+    Instruction* instructions;
+    size_t numInstructions;
+    Label* labels;
+    size_t numLabels;
+
+    uint16_t memory[0x10000];
+    uint16_t registers[8];
+    uint16_t sp;
+    bool zero;
+    bool sign;
+    bool carry;
+} Machine;
+
+static void Fail(const char* message, int lineNumber)
+{
+    if (lineNumber != 0)
+        printf("emulator: line %i: %s\n", lineNumber, message);
+    else
+        printf("emulator: %s\n", message);
+    exit(1);
+}
+
+static void* Allocate(size_t size)
+{
+    void* p = malloc(size);
+    if (p == NULL)
+        Fail("Out of memory", 0);
+    return p;
+}
+
+static char* Trim(char* s)
+{
+    while (*s == ' ' || *s == '\t')
+        s++;
+    size_t length = strlen(s);
+    while (length > 0 && (s[length - 1] == ' ' || s[length - 1] == '\t' || s[length - 1] == '\n' ||
+                          s[length - 1] == '\r'))
+        s[--length] = 0;
+    return s;
+}
+
+static bool ParseNumber(const char* s, int32_t* out)
+{
+    char* end;
+    long value = strtol(s, &end, 10);
+    if (end == s || *end != 0)
+        return false;
+    *out = (int32_t)value;
+    return true;
+}
+
+static Operand ParseOperand(char* s, int lineNumber)
+{
+    Operand operand = {Operand_Literal, 0, NULL};
+    size_t length = strlen(s);
+    if (length == 0)
+        Fail("Missing operand", lineNumber);
+
+    if (s[0] == '[')
+    {
+        if (s[length - 1] != ']')
+            Fail("Invalid memory operand", lineNumber);
+        s[length - 1] = 0;
+        char* inner = s + 1;
+        if (strcmp(inner, "sp++") == 0)
+            operand.type = Operand_Push;
+        else if (strcmp(inner, "sp") == 0)
+            operand.type = Operand_Stack;
+        else if (strncmp(inner, "sp-", 3) == 0)
+        {
+            operand.type = Operand_Stack;
+            if (!ParseNumber(inner + 3, &operand.value))
+                Fail("Invalid stack operand", lineNumber);
+        }
+        else if (inner[0] == 'r' && inner[1] >= '0' && inner[1] <= '7' && inner[2] == 0)
+        {
+            operand.type = Operand_MemoryRegister;
+            operand.value = inner[1] - '0';
+        }
+        else
+        {
+            operand.type = Operand_Memory;
+            if (!ParseNumber(inner, &operand.value))
+                Fail("Invalid memory operand", lineNumber);
+        }
+        return operand;
+    }
+
+    if (strcmp(s, "rz") == 0)
+        operand.type = Operand_Zero;
+    else if (strcmp(s, "ip") == 0)
+        operand.type = Operand_IP;
+    else if (strcmp(s, "sp") == 0)
+        operand.type = Operand_SP;
+    else if (s[0] == 'r' && s[1] >= '0' && s[1] <= '7' && s[2] == 0)
+    {
+        operand.type = Operand_Register;
+        operand.value = s[1] - '0';
+    }
+    else if (!ParseNumber(s, &operand.value))
+    {
+        operand.type = Operand_Label;
+        operand.name = strdup(s);
+    }
+    return operand;
+}
+
+static void ParseInstruction(Machine* m, char* line, int lineNumber)
+{
+    char* operands = line;
+    while (*operands != 0 && *operands != ' ')
+        operands++;
+    if (*operands != 0)
+        *operands++ = 0;
+
+    Instruction inst;
+    inst.flag = -1;
+    inst.lineNumber = lineNumber;
+    char* flag = strchr(line, '_');
+    if (flag != NULL)
+    {
+        *flag++ = 0;
+        for (int i = 0; i < 8; i++)
+            if (strcmp(flag, flagNames[i]) == 0)
+                inst.flag = i;
+        if (inst.flag == -1)
+            Fail("Unknown condition", lineNumber);
+    }
+    inst.op = Op_Count;
+    for (int i = 0; i < Op_Count; i++)
+        if (strcmp(line, opcodeNames[i]) == 0)
+            inst.op = (Opcode)i;
+    if (inst.op == Op_Count)
+        Fail("Unknown instruction", lineNumber);
+
+    Operand parsed[3];
+    size_t numOperands = 0;
+    char* next = operands;
+    while (next != NULL)
+    {
+        char* comma = strchr(next, ',');
+        if (comma != NULL)
+            *comma = 0;
+        if (numOperands == 3)
+            Fail("Too many operands", lineNumber);
+        parsed[numOperands++] = ParseOperand(Trim(next), lineNumber);
+        next = comma != NULL ? comma + 1 : NULL;
+    }
+
+    if (inst.op == Op_Jump)
+    {
+        if (numOperands != 1)
+            Fail("Invalid jump", lineNumber);
+        inst.a = parsed[0];
+    }
+    else if (numOperands == 2)
+    {
+        inst.dst = parsed[0];
+        inst.a = parsed[0];
+        inst.b = parsed[1];
+    }
+    else if (numOperands == 3 && inst.op != Op_Mov && inst.op != Op_Not)
+    {
+        inst.dst = parsed[0];
+        inst.a = parsed[1];
+        inst.b = parsed[2];
+    }
+    else
+        Fail("Wrong number of operands", lineNumber);
+
+    m->instructions[m->numInstructions++] = inst;
+}
+
+static void ResolveLabel(Machine* m, Operand* operand, int lineNumber)
+{
+    if (operand->type != Operand_Label)
+        return;
+    for (size_t i = 0; i < m->numLabels; i++)
+    {
+        if (strcmp(m->labels[i].name, operand->name) == 0)
+        {
+            operand->value = (int32_t)m->labels[i].index;
+            return;
+        }
+    }
+    Fail("Undefined label", lineNumber);
+}
+
+static void ReadAssembly(Machine* m, const char* path)
+{
+    FILE* f = fopen(path, "r");
+    if (f == NULL)
+        Fail("Could not open assembly", 0);
+
+    size_t capacity = 1024;
+    m->instructions = Allocate(capacity * sizeof(Instruction));
+    m->labels = Allocate(capacity * sizeof(Label));
+    m->numInstructions = 0;
+    m->numLabels = 0;
+
+    char buffer[512];
+    int lineNumber = 0;
+    while (fgets(buffer, sizeof(buffer), f) != NULL)
+    {
+        lineNumber++;
+        if (m->numInstructions == capacity || m->numLabels == capacity)
+        {
+            capacity *= 2;
+            m->instructions = realloc(m->instructions, capacity * sizeof(Instruction));
+            m->labels = realloc(m->labels, capacity * sizeof(Label));
+            if (m->instructions == NULL || m->labels == NULL)
+                Fail("Out of memory", 0);
+        }
+
+        char* line = Trim(buffer);
+        size_t length = strlen(line);
+        if (length == 0)
+            continue;
+        if (line[length - 1] == ':')
+        {
+            line[length - 1] = 0;
+            m->labels[m->numLabels].name = strdup(line);
+            m->labels[m->numLabels].index = m->numInstructions;
+            m->numLabels++;
+            continue;
+        }
+        ParseInstruction(m, line, lineNumber);
+    }
+    fclose(f);
+
+    for (size_t i = 0; i < m->numInstructions; i++)
+    {
+        Instruction* inst = &m->instructions[i];
+        if (inst->op == Op_Jump)
+            ResolveLabel(m, &inst->a, inst->lineNumber);
+        else
+        {
+            ResolveLabel(m, &inst->a, inst->lineNumber);
+            ResolveLabel(m, &inst->b, inst->lineNumber);
+        }
+    }
+}
+
+static void ReadData(Machine* m, const char* path)
+{
+    memset(m->memory, 0, sizeof(m->memory));
+    FILE* f = fopen(path, "rb");
+    if (f == NULL)
+        Fail("Could not open data", 0);
+    uint8_t word[2];
+    for (size_t address = 0; address < STACK_START && fread(word, 1, 2, f) == 2; address++)
+        m->memory[address] = (uint16_t)(word[0] | (word[1] << 8));
+    fclose(f);
+}
+
+static uint16_t Address(Machine* m, Operand operand)
+{
+    switch (operand.type)
+    {
+        case Operand_Memory: return (uint16_t)operand.value;
+        case Operand_MemoryRegister: return m->registers[operand.value];
+        case Operand_Stack: return (uint16_t)(m->sp - operand.value);
+        default: return 0;
+    }
+}
+
+static uint16_t Read(Machine* m, Operand operand, uint16_t ip)
+{
+    switch (operand.type)
+    {
+        case Operand_Register: return m->registers[operand.value];
+        case Operand_Zero: return 0;
+        case Operand_IP: return ip;
+        case Operand_SP: return m->sp;
+        case Operand_Literal:
+        case Operand_Label: return (uint16_t)operand.value;
+        case Operand_Push: return m->memory[m->sp++];
+        default: return m->memory[Address(m, operand)];
+    }
+}
+
+// Returns whether ip was written, in which case execution continues after *ip
+static bool Write(Machine* m, Operand operand, uint16_t value, bool pushed, uint16_t* ip)
+{
+    switch (operand.type)
+    {
+        case Operand_Register: m->registers[operand.value] = value; break;
+        case Operand_Zero: break;
+        case Operand_IP: *ip = value; return true;
+        case Operand_SP: m->sp = value; break;
+        case Operand_Push:
+            // The same word that was read as a
+            if (pushed)
+                m->memory[(uint16_t)(m->sp - 1)] = value;
+            else
+                m->memory[m->sp++] = value;
+            break;
+        case Operand_Literal:
+        case Operand_Label: break;
+        default: m->memory[Address(m, operand)] = value; break;
+    }
+    return false;
+}
+
+static bool Condition(Machine* m, int flag)
+{
+    switch (flag)
+    {
+        case -1: return true;
+        case 0: return !m->zero;
+        case 1: return m->zero;
+        case 4: return !m->sign;
+        case 5: return m->sign;
+        case 6: return !m->carry;
+        case 7: return m->carry;
+        default: Fail("Unsupported condition", 0); return false;
+    }
+}
+
+static uint16_t Compute(Machine* m, Opcode op, uint16_t x, uint16_t y)
+{
+    uint32_t result;
+    bool carry = false;
+    switch (op)
+    {
+        case Op_Add:
+            result = (uint32_t)x + y;
+            carry = result > 0xFFFF;
+            break;
+        case Op_Sub:
+            result = (uint32_t)x - y;
+            carry = x >= y;
+            break;
+        case Op_Mul: result = (uint32_t)x * y; break;
+        case Op_And: result = x & y; break;
+        case Op_Div: result = y == 0 ? 0xFFFF : x / y; break;
+        case Op_Or: result = x | y; break;
+        case Op_Xor: result = x ^ y; break;
+        case Op_ShiftLeft: result = y < 16 ? (uint32_t)x << y : 0; break;
+        case Op_ShiftRight: result = y < 16 ? x >> y : 0; break;
+        case Op_MulH: result = ((uint32_t)x * y) >> 16; break;
+        case Op_MulQ: result = (uint32_t)(((int32_t)(int16_t)x * (int16_t)y) >> 8); break;
+        case Op_InvQ: result = (int16_t)y == 0 ? 0 : (uint32_t)(65536 / (int32_t)(int16_t)y); break;
+        case Op_Not: result = (uint16_t)~y; break;
+        default: result = y; break;
+    }
+    result &= 0xFFFF;
+    if (op != Op_Mov)
+    {
+        m->zero = result == 0;
+        m->sign = (result & 0x8000) != 0;
+        m->carry = carry;
+    }
+    return (uint16_t)result;
+}
+
+static int16_t Run(Machine* m)
+{
+    size_t entry = SIZE_MAX;
+    for (size_t i = 0; i < m->numLabels; i++)
+        if (strcmp(m->labels[i].name, "_main") == 0)
+            entry = m->labels[i].index;
+    if (entry == SIZE_MAX)
+        Fail("No main function", 0);
+
+    // Slot for the return value, then the return address
+    uint16_t result = STACK_START;
+    m->sp = STACK_START;
+    m->memory[m->sp++] = 0;
+    m->memory[m->sp++] = EXIT_ADDRESS;
+    memset(m->registers, 0, sizeof(m->registers));
+
+    uint16_t ip = (uint16_t)entry;
+    for (uint64_t steps = 0; steps < MAX_STEPS; steps++)
+    {
+        if (ip == EXIT_ADDRESS + 1)
+            return (int16_t)m->memory[result];
+        if (ip >= m->numInstructions)
+            Fail("Jumped outside of the code", 0);
+
+        Instruction* inst = &m->instructions[ip];
+        uint16_t next = ip + 1;
+        if (!Condition(m, inst->flag))
+        {
+            ip = next;
+            continue;
+        }
+        if (inst->op == Op_Jump)
+        {
+            ip = (uint16_t)inst->a.value;
+            continue;
+        }
+
+        uint16_t x = inst->op == Op_Mov || inst->op == Op_Not ? 0 : Read(m, inst->a, ip);
+        uint16_t y = Read(m, inst->b, ip);
+        uint16_t value = Compute(m, inst->op, x, y);
+        bool pushed = inst->dst.type == Operand_Push && inst->a.type == Operand_Push && inst->op != Op_Mov &&
+                      inst->op != Op_Not;
+        uint16_t target;
+        if (Write(m, inst->dst, value, pushed, &target))
+            next = target + 1;
+        ip = next;
+    }
+    Fail("Step limit reached", 0);
+    return 0;
+}
+
+int main(int numArgs, char** args)
+{
+    if (numArgs != 3)
+    {
+        printf("usage: emulator ASSEMBLY DATA\n");
+        return 1;
+    }
+    Machine* m = Allocate(sizeof(Machine));
+    ReadAssembly(m, args[1]);
+    ReadData(m, args[2]);
+    printf("%i\n", Run(m));
+    return 0;
+}
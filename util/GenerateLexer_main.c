@@ -1,5 +1,6 @@
 #include <assert.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -10,96 +11,99 @@ typedef struct Keyword
     char* name;
     char* tokenType;
     bool strict;
+    // Value of IntLiteral keywords
+    int literal;
 
 } Keyword;
 
 Keyword keywords[] = {
-    {"void", "VoidKeyword", true},
-    {"struct", "StructKeyword", true},
-    {"bool", "UintKeyword", true},
-    {"int", "IntKeyword", true},
-    {"int16", "IntKeyword", true},
-    {"int16_t", "IntKeyword", true},
-    {"int32", "Int32Keyword", true},
-    {"long", "Int32Keyword", true},
-    {"int32_t", "Int32Keyword", true},
-    {"uint", "UintKeyword", true},
-    {"uint16", "UintKeyword", true},
-    {"uint16_t", "UintKeyword", true},
-    {"size_t", "UintKeyword", true},
-    {"char", "UintKeyword", true},
-    {"uint32", "Uint32Keyword", true},
-    {"uint32_t", "Uint32Keyword", true},
-    {"fixed", "FixedKeyword", true},
-    {"if", "IfKeyword", true},
-    {"else", "ElseKeyword", true},
-    {"while", "WhileKeyword", true},
-    {"do", "DoKeyword", true},
-    {"for", "ForKeyword", true},
-    {"return", "ReturnKeyword", true},
-    {"continue", "ContinueKeyword", true},
-    {"break", "BreakKeyword", true},
-    {"switch", "SwitchKeyword", true},
-    {"case", "CaseKeyword", true},
-    {"default", "DefaultKeyword", true},
-    {"enum", "EnumKeyword", true},
-    {"typedef", "TypedefKeyword", true},
-    {"sizeof", "SizeOfKeyword", true},
-    {"const", "ConstKeyword", true},
-    {"restrict", "RestrictKeyword", true},
-    {"goto", "GotoKeyword", true},
-    {"register", "RegisterKeyword", true},
-    {"union", "UnionKeyword", true},
-    {"static", "StaticKeyword", true},
-    {"NULL", "NULL", true},
-    {"true", "TRUE", true},
-    {"false", "FALSE", true},
-    {"...", "DotDotDot", false},
-    {"(", "RBrOpen", false},
-    {")", "RBrClose", false},
-    {"{", "CBrOpen", false},
-    {"}", "CBrClose", false},
-    {"[", "ABrOpen", false},
-    {"]", "ABrClose", false},
-    {";", "Semicolon", false},
-    {"=", "Assignment", false},
-    {"+=", "AssignmentAdd", false},
-    {"-=", "AssignmentSub", false},
-    {"*=", "AssignmentMul", false},
-    {"/=", "AssignmentDiv", false},
-    {"%=", "AssignmentMod", false},
-    {"&=", "AssignmentAND", false},
-    {"|=", "AssignmentOR", false},
-    {"^=", "AssignmentXOR", false},
-    {">>=", "AssignmentShiftRight", false},
-    {"<<=", "AssignmentShiftLeft", false},
-    {"+", "Plus", false},
-    {"-", "Minus", false},
-    {"*", "Star", false},
-    {"/", "Slash", false},
-    {"<<", "ShiftLeft", false},
-    {">>", "ShiftRight", false},
-    {">", "GreaterThan", false},
-    {">=", "GreaterThanEq", false},
-    {"<", "LessThan", false},
-    {"<=", "LessThanEq", false},
-    {"==", "Equals", false},
-    {"!=", "NotEquals", false},
-    {"&", "Ampersand", false},
-    {"%", "Percent", false},
-    {"^", "BitwiseXOR", false},
-    {"|", "BitwiseOR", false},
-    {"~", "BitwiseNOT", false},
-    {"&&", "LogicalAND", false},
-    {"||", "LogicalOR", false},
-    {"!", "LogicalNOT", false},
-    {"++", "Increment", false},
-    {"--", "Decrement", false},
-    {",", "Comma", false},
-    {".", "Dot", false},
-    {"->", "Arrow", false},
-    {":", "Colon", false},
-    {"?", "QuestionMark", false},
+    {"void", "VoidKeyword", true, 0},
+    {"struct", "StructKeyword", true, 0},
+    {"bool", "UintKeyword", true, 0},
+    {"int", "IntKeyword", true, 0},
+    {"int16", "IntKeyword", true, 0},
+    {"int16_t", "IntKeyword", true, 0},
+    {"int32", "Int32Keyword", true, 0},
+    {"long", "Int32Keyword", true, 0},
+    {"int32_t", "Int32Keyword", true, 0},
+    {"uint", "UintKeyword", true, 0},
+    {"uint16", "UintKeyword", true, 0},
+    {"uint16_t", "UintKeyword", true, 0},
+    {"size_t", "UintKeyword", true, 0},
+    {"char", "UintKeyword", true, 0},
+    {"uint32", "Uint32Keyword", true, 0},
+    {"uint32_t", "Uint32Keyword", true, 0},
+    {"fixed", "FixedKeyword", true, 0},
+    {"if", "IfKeyword", true, 0},
+    {"else", "ElseKeyword", true, 0},
+    {"while", "WhileKeyword", true, 0},
+    {"do", "DoKeyword", true, 0},
+    {"for", "ForKeyword", true, 0},
+    {"return", "ReturnKeyword", true, 0},
+    {"continue", "ContinueKeyword", true, 0},
+    {"break", "BreakKeyword", true, 0},
+    {"switch", "SwitchKeyword", true, 0},
+    {"case", "CaseKeyword", true, 0},
+    {"default", "DefaultKeyword", true, 0},
+    {"enum", "EnumKeyword", true, 0},
+    {"typedef", "TypedefKeyword", true, 0},
+    {"sizeof", "SizeOfKeyword", true, 0},
+    {"const", "ConstKeyword", true, 0},
+    {"restrict", "RestrictKeyword", true, 0},
+    {"goto", "GotoKeyword", true, 0},
+    {"register", "RegisterKeyword", true, 0},
+    {"union", "UnionKeyword", true, 0},
+    {"static", "StaticKeyword", true, 0},
+    {"asm", "AsmKeyword", true, 0},
+    {"NULL", "IntLiteral", true, 0},
+    {"true", "IntLiteral", true, 1},
+    {"false", "IntLiteral", true, 0},
+    {"...", "DotDotDot", false, 0},
+    {"(", "RBrOpen", false, 0},
+    {")", "RBrClose", false, 0},
+    {"{", "CBrOpen", false, 0},
+    {"}", "CBrClose", false, 0},
+    {"[", "ABrOpen", false, 0},
+    {"]", "ABrClose", false, 0},
+    {";", "Semicolon", false, 0},
+    {"=", "Assignment", false, 0},
+    {"+=", "AssignmentAdd", false, 0},
+    {"-=", "AssignmentSub", false, 0},
+    {"*=", "AssignmentMul", false, 0},
+    {"/=", "AssignmentDiv", false, 0},
+    {"%=", "AssignmentMod", false, 0},
+    {"&=", "AssignmentAND", false, 0},
+    {"|=", "AssignmentOR", false, 0},
+    {"^=", "AssignmentXOR", false, 0},
+    {">>=", "AssignmentShiftRight", false, 0},
+    {"<<=", "AssignmentShiftLeft", false, 0},
+    {"+", "Plus", false, 0},
+    {"-", "Minus", false, 0},
+    {"*", "Star", false, 0},
+    {"/", "Slash", false, 0},
+    {"<<", "ShiftLeft", false, 0},
+    {">>", "ShiftRight", false, 0},
+    {">", "GreaterThan", false, 0},
+    {">=", "GreaterThanEq", false, 0},
+    {"<", "LessThan", false, 0},
+    {"<=", "LessThanEq", false, 0},
+    {"==", "Equals", false, 0},
+    {"!=", "NotEquals", false, 0},
+    {"&", "Ampersand", false, 0},
+    {"%", "Percent", false, 0},
+    {"^", "BitwiseXOR", false, 0},
+    {"|", "BitwiseOR", false, 0},
+    {"~", "BitwiseNOT", false, 0},
+    {"&&", "LogicalAND", false, 0},
+    {"||", "LogicalOR", false, 0},
+    {"!", "LogicalNOT", false, 0},
+    {"++", "Increment", false, 0},
+    {"--", "Decrement", false, 0},
+    {",", "Comma", false, 0},
+    {".", "Dot", false, 0},
+    {"->", "Arrow", false, 0},
+    {":", "Colon", false, 0},
+    {"?", "QuestionMark", false, 0},
 };
 
 typedef struct Node
@@ -136,67 +140,330 @@ void Insert(Node* root, char* string, Keyword* keyword)
     root->keyword = keyword;
 }
 
-void PrintParser(Node* root, size_t depth, bool printReturn)
+void Indent(int level)
+{
+    for (int i = 0; i < level; i++)
+        printf("    ");
+}
+
+void PrintToken(Keyword* keyword, int level)
+{
+    Indent(level);
+    printf("*token = %s;\n", keyword->tokenType);
+    if (strcmp(keyword->tokenType, "IntLiteral") == 0)
+    {
+        Indent(level);
+        printf("*literal = %i;\n", keyword->literal);
+    }
+}
+
+// Prints the code matching the children of root, then the keyword of root itself.
+// Code inside a case has to return on every path, so it does not fall through.
+void PrintParser(Node* root, size_t depth, int level, bool inCase)
 {
     int numChildren = 0;
-    // Only print next switch if the node has ANY children.
     for (size_t i = 0; i < sizeof(root->nodes) / sizeof(Node*); i++)
         if (root->nodes[i] != NULL)
-        {
             numChildren++;
-        }
 
-    printf("\n");
     if (numChildren > 1)
-        printf("switch (code[i + %zu])\n{\n", depth);
-
-    if (numChildren != 0)
-        for (size_t i = 0; i < sizeof(root->nodes) / sizeof(Node*); i++)
-        {
-            if (root->nodes[i] != NULL)
-            {
-                if (numChildren > 1)
-                    printf("case \'%c\':", (int)i + '!');
-                else
-                    printf("if (code[i + %zu] == \'%c\') {", depth, (int)i + '!');
+    {
+        Indent(level);
+        printf("switch (code[i + %zu])\n", depth);
+        Indent(level);
+        printf("{\n");
+    }
 
-                PrintParser(root->nodes[i], depth + 1, numChildren > 1);
+    for (size_t i = 0; i < sizeof(root->nodes) / sizeof(Node*); i++)
+    {
+        if (root->nodes[i] == NULL)
+            continue;
 
-                if (numChildren == 1)
-                {
-                    printf("}\n");
-                }
-            }
+        if (numChildren > 1)
+        {
+            Indent(level + 1);
+            printf("case '%c':\n", (int)i + '!');
+            PrintParser(root->nodes[i], depth + 1, level + 2, true);
         }
+        else
+        {
+            Indent(level);
+            printf("if (code[i + %zu] == '%c')\n", depth, (int)i + '!');
+            Indent(level);
+            printf("{\n");
+            PrintParser(root->nodes[i], depth + 1, level + 1, false);
+            Indent(level);
+            printf("}\n");
+        }
+    }
 
     if (numChildren > 1)
+    {
+        Indent(level);
         printf("}\n");
+    }
 
-    if (root->keyword != NULL)
+    if (root->keyword != NULL && !root->keyword->strict)
     {
-        if (root->keyword->strict)
-            printf("if (IsNonIDChar(code[i + %i]))\n{\n", (int)depth);
-
-        printf("*token = %s;\n", root->keyword->tokenType);
+        PrintToken(root->keyword, level);
+        Indent(level);
         printf("return i + %zu;\n", depth);
+        return;
+    }
 
-        if (root->keyword->strict)
-            printf("}\n");
+    if (root->keyword != NULL)
+    {
+        Indent(level);
+        printf("if (IsNonIDChar(code[i + %zu]))\n", depth);
+        Indent(level);
+        printf("{\n");
+        PrintToken(root->keyword, level + 1);
+        Indent(level + 1);
+        printf("return i + %zu;\n", depth);
+        Indent(level);
+        printf("}\n");
     }
 
-    else if (printReturn)
+    if (inCase)
+    {
+        Indent(level);
         printf("return 0;\n");
+    }
+}
+
+// Keywords are looked up with a perfect hash over the first, middle and last
+// character and the length. The multipliers are searched for at generation time.
+typedef struct
+{
+    size_t first;
+    size_t middle;
+    size_t last;
+    size_t mask;
+} KeywordHash;
+
+size_t Hash(KeywordHash h, const char* s)
+{
+    size_t len = strlen(s);
+    return ((size_t)s[0] * h.first + (size_t)s[len / 2] * h.middle + (size_t)s[len - 1] * h.last + len) & h.mask;
 }
 
-int main()
+bool IsPerfect(KeywordHash h)
 {
+    bool used[1024] = {0};
+    for (size_t i = 0; i < sizeof(keywords) / sizeof(Keyword); i++)
+    {
+        if (!keywords[i].strict)
+            continue;
+        size_t index = Hash(h, keywords[i].name);
+        if (used[index])
+            return false;
+        used[index] = true;
+    }
+    return true;
+}
+
+KeywordHash FindKeywordHash()
+{
+    // Products of ASCII chars never exceed 16 bits, so the hash is the same on the target.
+    for (size_t size = 64; size <= 1024; size *= 2)
+        for (size_t first = 1; first < 128; first++)
+            for (size_t middle = 0; middle < 128; middle++)
+                for (size_t last = 1; last < 128; last++)
+                {
+                    KeywordHash h = {first, middle, last, size - 1};
+                    if (IsPerfect(h))
+                        return h;
+                }
+
+    fprintf(stderr, "No perfect hash found!\n");
+    exit(1);
+}
+
+void PrintKeywordLookup()
+{
+    KeywordHash h = FindKeywordHash();
+
+    size_t minLength = SIZE_MAX;
+    size_t maxLength = 0;
+    Keyword* table[1024] = {0};
+    for (size_t i = 0; i < sizeof(keywords) / sizeof(Keyword); i++)
+    {
+        if (!keywords[i].strict)
+            continue;
+        size_t len = strlen(keywords[i].name);
+        minLength = len < minLength ? len : minLength;
+        maxLength = len > maxLength ? len : maxLength;
+        table[Hash(h, keywords[i].name)] = &keywords[i];
+    }
+
+    printf("static size_t KeywordHash(const char* code, size_t length)\n{\n");
+    printf("    return ((size_t)code[0] * %zu + (size_t)code[length / 2] * %zu + (size_t)code[length - 1] * %zu + "
+           "length) & %zu;\n",
+           h.first, h.middle, h.last, h.mask);
+    printf("}\n\n");
+
+    printf("// Checks if the identifier code[0..length) is a keyword.\n");
+    printf("bool LookupKeyword(const char* code, size_t length, TokenType* token, int32_t* literal)\n{\n");
+    printf("    if (length < %zu || length > %zu)\n        return false;\n\n", minLength, maxLength);
+    printf("    switch (KeywordHash(code, length))\n    {\n");
+    for (size_t i = 0; i <= h.mask; i++)
+    {
+        if (table[i] == NULL)
+            continue;
+        size_t len = strlen(table[i]->name);
+        printf("        case %zu:\n", i);
+        printf("            if (length == %zu && memcmp(code, \"%s\", %zu) == 0)\n", len, table[i]->name, len);
+        printf("            {\n");
+        PrintToken(table[i], 4);
+        printf("                return true;\n");
+        printf("            }\n");
+        printf("            return false;\n");
+    }
+    printf("    }\n    return false;\n}\n");
+}
+
+// Table-driven alternative to the switch. Every trie node is a DFA state (the root is
+// state 0, which also serves as the dead state, as no transition leads back to it).
+// Chars are mapped to classes first, so the table only needs a column per char that
+// is used in any token.
+typedef struct
+{
+    Node* nodes[256];
+    size_t numNodes;
+    unsigned char classes[256];
+    size_t numClasses;
+} Dfa;
+
+void NumberNodes(Dfa* dfa, Node* node)
+{
+    dfa->nodes[dfa->numNodes++] = node;
+    for (size_t i = 0; i < sizeof(node->nodes) / sizeof(Node*); i++)
+        if (node->nodes[i] != NULL)
+            NumberNodes(dfa, node->nodes[i]);
+}
+
+size_t StateOf(Dfa* dfa, Node* node)
+{
+    for (size_t i = 0; i < dfa->numNodes; i++)
+        if (dfa->nodes[i] == node)
+            return i;
+    assert(0);
+    return 0;
+}
+
+void PrintTable(Node* root)
+{
+    Dfa dfa = {0};
+    NumberNodes(&dfa, root);
+    if (dfa.numNodes > 256)
+    {
+        fprintf(stderr, "Too many states for the table!\n");
+        exit(1);
+    }
+
+    // Class 0 is every char that isn't part of a token
+    dfa.numClasses = 1;
+    for (size_t c = 0; c < sizeof(root->nodes) / sizeof(Node*); c++)
+    {
+        for (size_t n = 0; n < dfa.numNodes; n++)
+            if (dfa.nodes[n]->nodes[c] != NULL)
+            {
+                dfa.classes[c + '!'] = (unsigned char)dfa.numClasses++;
+                break;
+            }
+    }
+
+    for (size_t n = 0; n < dfa.numNodes; n++)
+        if (dfa.nodes[n]->keyword != NULL && dfa.nodes[n]->keyword->strict)
+        {
+            fprintf(stderr, "The table does not support strict keywords!\n");
+            exit(1);
+        }
+
+    printf("static const uint8_t tokenClasses[256] = {");
+    for (size_t c = 0; c < 256; c++)
+        printf("%s%u,", c % 32 == 0 ? "\n    " : " ", dfa.classes[c]);
+    printf("\n};\n\n");
+
+    printf("static const uint8_t tokenTransitions[%zu][%zu] = {\n", dfa.numNodes, dfa.numClasses);
+    for (size_t n = 0; n < dfa.numNodes; n++)
+    {
+        printf("    {");
+        for (size_t c = 0; c < dfa.numClasses; c++)
+        {
+            size_t next = 0;
+            for (size_t ch = 0; ch < sizeof(root->nodes) / sizeof(Node*); ch++)
+                if (dfa.classes[ch + '!'] == c && c != 0 && dfa.nodes[n]->nodes[ch] != NULL)
+                    next = StateOf(&dfa, dfa.nodes[n]->nodes[ch]);
+            printf(c == 0 ? "%zu" : ", %zu", next);
+        }
+        printf("}, // \"%s\"\n", dfa.nodes[n]->string);
+    }
+    printf("};\n\n");
+
+    printf("// Token accepted in each state, None if the state isn't accepting\n");
+    printf("static const uint8_t tokenAccept[%zu] = {", dfa.numNodes);
+    for (size_t n = 0; n < dfa.numNodes; n++)
+        printf("%s%s,", n % 4 == 0 ? "\n    " : " ", dfa.nodes[n]->keyword ? dfa.nodes[n]->keyword->tokenType : "None");
+    printf("\n};\n\n");
+
+    printf("// Returns the index behind the longest token at code[i], or 0 if there is none.\n");
+    printf("size_t TokenizeTable(char* code, TokenType* token, size_t i)\n{\n");
+    printf("    size_t state = 0;\n");
+    printf("    size_t end = 0;\n");
+    printf("    for (size_t n = i;; n++)\n    {\n");
+    printf("        state = tokenTransitions[state][tokenClasses[(uint8_t)code[n]]];\n");
+    printf("        if (state == 0)\n            break;\n");
+    printf("        if (tokenAccept[state] != None)\n        {\n");
+    printf("            *token = (TokenType)tokenAccept[state];\n");
+    printf("            end = n + 1;\n");
+    printf("        }\n    }\n");
+    printf("    return end;\n}\n");
+}
+
+// By default, this prints src/Lexer_generated.h, where identifier-like keywords are
+// looked up after scanning the identifier and everything else is matched char by char.
+// The other modes print standalone matchers that are only used for benchmarking:
+// --keyword-trie matches all keywords char by char as well (KeywordTrie),
+// --table matches operators and punctuation with a transition table (TokenizeTable).
+int main(int numArgs, char** args)
+{
+    bool keywordTrie = numArgs > 1 && strcmp(args[1], "--keyword-trie") == 0;
+    bool table = numArgs > 1 && strcmp(args[1], "--table") == 0;
+
     Node* root = calloc(1, sizeof(Node));
     root->string = "";
 
     for (size_t i = 0; i < sizeof(keywords) / sizeof(Keyword); i++)
     {
-        Insert(root, keywords[i].name, &keywords[i]);
+        if (keywordTrie || !keywords[i].strict)
+            Insert(root, keywords[i].name, &keywords[i]);
+    }
+
+    printf("#pragma once\n");
+    printf("// Generated by util/GenerateLexer_main.c, do not edit.\n");
+    printf("#include \"Token.h\"\n");
+    printf("#include <stdbool.h>\n#include <stdint.h>\n#include <string.h>\n\n");
+
+    if (table)
+    {
+        PrintTable(root);
+        return 0;
     }
 
-    PrintParser(root, 0, true);
-}
\ No newline at end of file
+    if (keywordTrie)
+    {
+        printf("bool IsNonIDChar(char c);\n\n");
+        printf("size_t KeywordTrie(char* code, TokenType* token, int32_t* literal, size_t i)\n{\n");
+    }
+    else
+        printf("size_t TokenizeSwitch(char* code, TokenType* token, size_t i)\n{\n");
+    PrintParser(root, 0, 1, true);
+    printf("}\n");
+
+    if (!keywordTrie)
+    {
+        printf("\n");
+        PrintKeywordLookup();
+    }
+}
@@ -0,0 +1,149 @@
+// Compares keyword recognition with the perfect hash in src/Lexer_generated.h against
+// matching keywords char by char (KeywordTrie, generated with GenerateLexer --keyword-trie).
+// Usage: keyword_benchmark [SOURCE FILES..]
+
+#include "Lexer_generated.h"
+#include "KeywordTrie_generated.h"
+#include "Scan.h"
+#include <ctype.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Keeps the compiler from optimizing the classification away
+static volatile size_t sink;
+
+bool IsNonIDChar(char c)
+{
+    return !(isalpha(c) || isdigit(c) || c == '_');
+}
+
+static size_t length;
+
+// Identifiers are scanned like in the lexer
+static size_t IdentifierEnd(const char* code, size_t i)
+{
+    return Scan_Identifier(code, length, i);
+}
+
+// Like the lexer did before: try to match a keyword first, then inline assembly,
+// otherwise scan an identifier.
+static size_t ClassifyTrie(char* code, const size_t* words, size_t numWords)
+{
+    size_t numKeywords = 0;
+    for (size_t w = 0; w < numWords; w++)
+    {
+        TokenType token = None;
+        int32_t literal = 0;
+        size_t end = KeywordTrie(code, &token, &literal, words[w]);
+        if (end != 0)
+            numKeywords++;
+        else if (strncmp(code + words[w], "asm", 3) == 0 && IsNonIDChar(code[words[w] + 3]))
+            end = words[w] + 3;
+        else
+            end = IdentifierEnd(code, words[w]);
+        sink = end + (size_t)token;
+    }
+    return numKeywords;
+}
+
+// Scan the identifier, then look it up.
+static size_t ClassifyHash(char* code, const size_t* words, size_t numWords)
+{
+    size_t numKeywords = 0;
+    for (size_t w = 0; w < numWords; w++)
+    {
+        TokenType token = None;
+        int32_t literal = 0;
+        size_t end = IdentifierEnd(code, words[w]);
+        if (LookupKeyword(code + words[w], end - words[w], &token, &literal))
+            numKeywords++;
+        sink = end + (size_t)token;
+    }
+    return numKeywords;
+}
+
+static double Now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static double Measure(size_t (*classify)(char*, const size_t*, size_t), char* code, const size_t* words,
+                      size_t numWords, size_t repeats, size_t* numKeywords)
+{
+    double start = Now();
+    for (size_t i = 0; i < repeats; i++)
+        *numKeywords = classify(code, words, numWords);
+    return Now() - start;
+}
+
+int main(int numArgs, char** args)
+{
+    if (numArgs < 2)
+    {
+        fprintf(stderr, "Usage: %s [SOURCE FILES..]\n", args[0]);
+        return 1;
+    }
+
+    char* code = NULL;
+    for (int i = 1; i < numArgs; i++)
+    {
+        FILE* f = fopen(args[i], "rb");
+        if (f == NULL)
+        {
+            fprintf(stderr, "Could not open \"%s\"\n", args[i]);
+            return 1;
+        }
+        fseek(f, 0, SEEK_END);
+        size_t size = (size_t)ftell(f);
+        fseek(f, 0, SEEK_SET);
+        code = realloc(code, length + size + 2);
+        length += fread(code + length, 1, size, f);
+        code[length++] = '\n';
+        fclose(f);
+    }
+    code[length] = 0;
+
+    // Start of every identifier or keyword
+    size_t numWords = 0;
+    size_t* words = malloc(length * sizeof(size_t));
+    for (size_t i = 0; i < length;)
+    {
+        if (isalpha(code[i]) || code[i] == '_')
+        {
+            words[numWords++] = i;
+            i = IdentifierEnd(code, i);
+        }
+        else if (isdigit(code[i]))
+            i = IdentifierEnd(code, i);
+        else
+            i++;
+    }
+
+    // At least 50 million words per run
+    size_t repeats = 50000000 / numWords + 1;
+
+    size_t trieKeywords, hashKeywords;
+    double trieTime = Measure(ClassifyTrie, code, words, numWords, repeats, &trieKeywords);
+    double hashTime = Measure(ClassifyHash, code, words, numWords, repeats, &hashKeywords);
+
+    if (trieKeywords != hashKeywords)
+    {
+        fprintf(stderr, "Results differ!\n");
+        return 1;
+    }
+
+    double total = (double)numWords * (double)repeats;
+    printf("input: %zu words, %zu keywords\n", numWords, hashKeywords);
+    printf("trie:  %6.2f ns/word\n", trieTime * 1e9 / total);
+    printf("hash:  %6.2f ns/word (%.2fx)\n", hashTime * 1e9 / total, trieTime / hashTime);
+
+    free(words);
+    free(code);
+    return 0;
+}
@@ -0,0 +1,193 @@
+// Compares the throughput of the scanning functions in src/Scan.c against the
+// byte-at-a-time loops the lexer used before.
+// Usage: scan_benchmark [SOURCE FILES..]
+
+#include "../src/Scan.h"
+#include <ctype.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+typedef struct
+{
+    size_t whitespace;
+    size_t identifiers;
+    size_t comments;
+    size_t strings;
+    int lines;
+} ScanResult;
+
+static size_t ScalarWhitespace(const char* code, size_t length, size_t i, int* newlines)
+{
+    while (i < length && isspace(code[i]))
+    {
+        if (code[i] == '\n')
+            (*newlines)++;
+        i++;
+    }
+    return i;
+}
+
+static size_t ScalarIdentifier(const char* code, size_t length, size_t i)
+{
+    while (i < length && (isalpha(code[i]) || isdigit(code[i]) || code[i] == '_'))
+        i++;
+    return i;
+}
+
+static size_t ScalarLineComment(const char* code, size_t length, size_t i)
+{
+    while (code[i] != '\n' && i < length)
+        i++;
+    return i;
+}
+
+static size_t ScalarBlockComment(const char* code, size_t length, size_t i, int* newlines)
+{
+    while (i < length && !(code[i] == '/' && code[i - 1] == '*'))
+        if (code[i++] == '\n')
+            (*newlines)++;
+    return i < length ? i + 1 : i;
+}
+
+static size_t ScalarStringBody(const char* code, size_t length, size_t i)
+{
+    while (i < length && code[i] != '\"' && code[i] != '\\' && code[i] != '\n')
+        i++;
+    return i;
+}
+
+typedef struct
+{
+    size_t (*whitespace)(const char* code, size_t length, size_t i, int* newlines);
+    size_t (*identifier)(const char* code, size_t length, size_t i);
+    size_t (*lineComment)(const char* code, size_t length, size_t i);
+    size_t (*blockComment)(const char* code, size_t length, size_t i, int* newlines);
+    size_t (*stringBody)(const char* code, size_t length, size_t i);
+} Scanner;
+
+static const Scanner scalarScanner = {ScalarWhitespace, ScalarIdentifier, ScalarLineComment, ScalarBlockComment,
+                                      ScalarStringBody};
+static const Scanner vectorScanner = {Scan_Whitespace, Scan_Identifier, Scan_LineComment, Scan_BlockComment,
+                                      Scan_StringBody};
+
+// Walks the code like the lexer does, but only skips over the runs the scanner handles.
+static ScanResult Walk(const Scanner* s, const char* code, size_t length)
+{
+    ScanResult r = {0, 0, 0, 0, 1};
+    size_t i = 0;
+    while (i < length)
+    {
+        char c = code[i];
+        if (isspace(c))
+        {
+            r.whitespace++;
+            i = s->whitespace(code, length, i, &r.lines);
+        }
+        else if (isalpha(c) || c == '_')
+        {
+            r.identifiers++;
+            i = s->identifier(code, length, i + 1);
+        }
+        else if (c == '/' && i + 1 < length && code[i + 1] == '/')
+        {
+            r.comments++;
+            i = s->lineComment(code, length, i + 2);
+        }
+        else if (c == '/' && i + 1 < length && code[i + 1] == '*')
+        {
+            r.comments++;
+            i = s->blockComment(code, length, i + 2, &r.lines);
+        }
+        else if (c == '\"')
+        {
+            r.strings++;
+            i = s->stringBody(code, length, i + 1);
+            // Skip the escaped char or closing quote
+            if (i < length && code[i] == '\\')
+                i++;
+            i++;
+        }
+        else
+            i++;
+    }
+    return r;
+}
+
+static double Now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static double Measure(const Scanner* s, const char* code, size_t length, size_t repeats, ScanResult* out)
+{
+    double start = Now();
+    for (size_t i = 0; i < repeats; i++)
+        *out = Walk(s, code, length);
+    return Now() - start;
+}
+
+static bool ResultEquals(const ScanResult* a, const ScanResult* b)
+{
+    return a->whitespace == b->whitespace && a->identifiers == b->identifiers && a->comments == b->comments &&
+           a->strings == b->strings && a->lines == b->lines;
+}
+
+int main(int numArgs, char** args)
+{
+    if (numArgs < 2)
+    {
+        fprintf(stderr, "Usage: %s [SOURCE FILES..]\n", args[0]);
+        return 1;
+    }
+
+    size_t length = 0;
+    char* code = NULL;
+    for (int i = 1; i < numArgs; i++)
+    {
+        FILE* f = fopen(args[i], "rb");
+        if (f == NULL)
+        {
+            fprintf(stderr, "Could not open \"%s\"\n", args[i]);
+            return 1;
+        }
+        fseek(f, 0, SEEK_END);
+        size_t size = (size_t)ftell(f);
+        fseek(f, 0, SEEK_SET);
+        code = realloc(code, length + size + 1);
+        length += fread(code + length, 1, size, f);
+        code[length++] = '\n';
+        fclose(f);
+    }
+
+    // Repeat the input to get at least 256 MB of work per run
+    size_t repeats = (256 << 20) / length + 1;
+
+    ScanResult scalar, scan;
+    // Warm up
+    Measure(&scalarScanner, code, length, 1, &scalar);
+    Measure(&vectorScanner, code, length, 1, &scan);
+
+    double scalarTime = Measure(&scalarScanner, code, length, repeats, &scalar);
+    double scanTime = Measure(&vectorScanner, code, length, repeats, &scan);
+
+    if (!ResultEquals(&scalar, &scan))
+    {
+        fprintf(stderr, "Results differ!\n");
+        return 1;
+    }
+
+    double megabytes = (double)length * (double)repeats / (1024.0 * 1024.0);
+    printf("input:  %zu bytes, %d lines, %zu runs\n", length, scan.lines,
+           scan.whitespace + scan.identifiers + scan.comments + scan.strings);
+    printf("scalar: %8.1f MB/s\n", megabytes / scalarTime);
+    printf("scan:   %8.1f MB/s (%.2fx)\n", megabytes / scanTime, scalarTime / scanTime);
+
+    free(code);
+    return 0;
+}
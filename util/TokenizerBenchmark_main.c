@@ -0,0 +1,205 @@
+// Compares the generated switch (TokenizeSwitch in src/Lexer_generated.h) against the
+// table-driven DFA (TokenizeTable, generated with GenerateLexer --table) for operators
+// and punctuation. Reports lexing throughput and the code and data size of both forms.
+// Usage: tokenizer_benchmark [SOURCE FILES..]
+
+#include "Lexer_generated.h"
+#include "Scan.h"
+#include "TokenizeTable_generated.h"
+#include <ctype.h>
+#include <elf.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+typedef size_t (*Tokenizer)(char* code, TokenType* token, size_t i);
+
+typedef struct
+{
+    size_t tokens;
+    size_t checksum;
+} LexResult;
+
+// Lexes like the lexer, without storing any tokens. Only operators and punctuation
+// go through the tokenizer that is being measured.
+static LexResult Lex(Tokenizer tokenize, char* code, size_t length)
+{
+    LexResult r = {0, 0};
+    int lines = 0;
+    size_t i = 0;
+    while (i < length)
+    {
+        char c = code[i];
+        if (isspace(c))
+            i = Scan_Whitespace(code, length, i, &lines);
+        else if (isalpha(c) || c == '_')
+        {
+            size_t end = Scan_Identifier(code, length, i + 1);
+            TokenType token = Identifier;
+            int32_t literal = 0;
+            LookupKeyword(code + i, end - i, &token, &literal);
+            r.tokens++;
+            r.checksum += (size_t)token;
+            i = end;
+        }
+        else if (isdigit(c))
+        {
+            r.tokens++;
+            i = Scan_Identifier(code, length, i + 1);
+        }
+        else if (c == '/' && code[i + 1] == '/')
+            i = Scan_LineComment(code, length, i + 2);
+        else if (c == '/' && code[i + 1] == '*')
+            i = Scan_BlockComment(code, length, i + 2, &lines);
+        else if (c == '\"' || c == '\'')
+        {
+            // Skip string and char literals, including escapes
+            r.tokens++;
+            for (i++; i < length && code[i] != c && code[i] != '\n'; i++)
+                if (code[i] == '\\')
+                    i++;
+            i++;
+        }
+        else if (c == '#')
+            i = Scan_LineComment(code, length, i);
+        else
+        {
+            TokenType token = None;
+            size_t end = tokenize(code, &token, i);
+            if (end == 0)
+                end = i + 1;
+            else
+            {
+                r.tokens++;
+                r.checksum += (size_t)token * 31 + end - i;
+            }
+            i = end;
+        }
+    }
+    return r;
+}
+
+// Size of a symbol of this executable, 0 if it can't be found
+static size_t SymbolSize(const char* name)
+{
+    FILE* f = fopen("/proc/self/exe", "rb");
+    if (f == NULL)
+        return 0;
+
+    size_t size = 0;
+    Elf64_Ehdr header;
+    if (fread(&header, sizeof(header), 1, f) == 1 && memcmp(header.e_ident, ELFMAG, SELFMAG) == 0 &&
+        header.e_ident[EI_CLASS] == ELFCLASS64)
+    {
+        Elf64_Shdr* sections = malloc(header.e_shnum * sizeof(Elf64_Shdr));
+        fseek(f, (long)header.e_shoff, SEEK_SET);
+        if (fread(sections, sizeof(Elf64_Shdr), header.e_shnum, f) == header.e_shnum)
+        {
+            for (size_t s = 0; s < header.e_shnum && size == 0; s++)
+            {
+                if (sections[s].sh_type != SHT_SYMTAB)
+                    continue;
+
+                Elf64_Shdr* strtab = &sections[sections[s].sh_link];
+                char* strings = malloc(strtab->sh_size);
+                fseek(f, (long)strtab->sh_offset, SEEK_SET);
+                size_t numSymbols = sections[s].sh_size / sizeof(Elf64_Sym);
+                Elf64_Sym* symbols = malloc(sections[s].sh_size);
+                if (fread(strings, 1, strtab->sh_size, f) == strtab->sh_size &&
+                    fseek(f, (long)sections[s].sh_offset, SEEK_SET) == 0 &&
+                    fread(symbols, sizeof(Elf64_Sym), numSymbols, f) == numSymbols)
+                {
+                    for (size_t j = 0; j < numSymbols; j++)
+                        if (symbols[j].st_name < strtab->sh_size && strcmp(strings + symbols[j].st_name, name) == 0)
+                            size = symbols[j].st_size;
+                }
+                free(symbols);
+                free(strings);
+            }
+        }
+        free(sections);
+    }
+    fclose(f);
+    return size;
+}
+
+static double Now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static double Measure(Tokenizer tokenize, char* code, size_t length, size_t repeats, LexResult* out)
+{
+    double start = Now();
+    for (size_t i = 0; i < repeats; i++)
+        *out = Lex(tokenize, code, length);
+    return Now() - start;
+}
+
+static void Report(const char* name, double time, double megabytes, const LexResult* r, size_t repeats,
+                   size_t codeSize, size_t dataSize)
+{
+    printf("%-7s %8.1f MB/s %8.2f ns/token   code %5zu bytes, data %5zu bytes (%zu cache lines)\n", name,
+           megabytes / time, time * 1e9 / ((double)r->tokens * (double)repeats), codeSize, dataSize,
+           (codeSize + 63) / 64 + (dataSize + 63) / 64);
+}
+
+int main(int numArgs, char** args)
+{
+    if (numArgs < 2)
+    {
+        fprintf(stderr, "Usage: %s [SOURCE FILES..]\n", args[0]);
+        return 1;
+    }
+
+    size_t length = 0;
+    char* code = NULL;
+    for (int i = 1; i < numArgs; i++)
+    {
+        FILE* f = fopen(args[i], "rb");
+        if (f == NULL)
+        {
+            fprintf(stderr, "Could not open \"%s\"\n", args[i]);
+            return 1;
+        }
+        fseek(f, 0, SEEK_END);
+        size_t size = (size_t)ftell(f);
+        fseek(f, 0, SEEK_SET);
+        code = realloc(code, length + size + 2);
+        length += fread(code + length, 1, size, f);
+        code[length++] = '\n';
+        fclose(f);
+    }
+    code[length] = 0;
+
+    // Repeat the input to get at least 256 MB of work per run
+    size_t repeats = (256 << 20) / length + 1;
+
+    LexResult switchResult, tableResult;
+    // Warm up
+    Measure(TokenizeSwitch, code, length, 1, &switchResult);
+    Measure(TokenizeTable, code, length, 1, &tableResult);
+
+    double switchTime = Measure(TokenizeSwitch, code, length, repeats, &switchResult);
+    double tableTime = Measure(TokenizeTable, code, length, repeats, &tableResult);
+
+    if (switchResult.tokens != tableResult.tokens || switchResult.checksum != tableResult.checksum)
+    {
+        fprintf(stderr, "Results differ!\n");
+        return 1;
+    }
+
+    double megabytes = (double)length * (double)repeats / (1024.0 * 1024.0);
+    printf("input: %zu bytes, %zu tokens\n", length, switchResult.tokens);
+    Report("switch:", switchTime, megabytes, &switchResult, repeats, SymbolSize("TokenizeSwitch"), 0);
+    Report("table:", tableTime, megabytes, &tableResult, repeats, SymbolSize("TokenizeTable"),
+           SymbolSize("tokenClasses") + SymbolSize("tokenTransitions") + SymbolSize("tokenAccept"));
+
+    free(code);
+    return 0;
+}